@@ -66,6 +66,7 @@ buildfile 'src/unittest-cpp/unittest-cpp.forge';
 
 cc:all {
     'src/forge/forge/all';
+    'src/forge/forge_cache/all';
     'src/forge/forge_hooks/all';
     'src/forge/forge_test/all';
 };
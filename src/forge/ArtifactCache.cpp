@@ -0,0 +1,893 @@
+//
+// ArtifactCache.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "ArtifactCache.hpp"
+#include "Target.hpp"
+#include "Forge.hpp"
+#include "System.hpp"
+#include "Hasher.hpp"
+#include "path_functions.hpp"
+#include <assert/assert.hpp>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <ctime>
+#include <stdlib.h>
+
+using std::string;
+using std::vector;
+using std::pair;
+using std::make_pair;
+using std::unordered_map;
+using namespace sweet;
+using namespace sweet::forge;
+
+/**
+// The name of the file that lists the implicit dependencies of each entry
+// stored under a manifest key.
+*/
+static const char* MANIFEST = "manifest";
+
+/**
+// The name of the file that holds the output captured for an entry.
+*/
+static const char* OUTPUT = "output";
+
+/**
+// Constructor.
+//
+// @param forge
+//  The Forge that this ArtifactCache is part of.
+*/
+ArtifactCache::ArtifactCache( Forge* forge )
+: forge_( forge ),
+  directory_(),
+  maximum_size_( 0 ),
+  content_hashes_(),
+  actions_(),
+  remote_cache_(),
+  hits_( 0 ),
+  misses_( 0 )
+{
+    SWEET_ASSERT( forge_ );
+}
+
+/**
+// Set the directory that entries are stored in.
+//
+// @param directory
+//  The absolute path to the directory to store entries in or the empty
+//  string to disable this ArtifactCache.
+*/
+void ArtifactCache::set_directory( const std::string& directory )
+{
+    directory_ = directory;
+}
+
+/**
+// Get the directory that entries are stored in.
+//
+// @return
+//  The directory or the empty string if this ArtifactCache is disabled.
+*/
+const std::string& ArtifactCache::directory() const
+{
+    return directory_;
+}
+
+/**
+// Set the maximum size of this ArtifactCache.
+//
+// @param maximum_size
+//  The maximum size in bytes or 0 for no maximum.
+*/
+void ArtifactCache::set_maximum_size( uint64_t maximum_size )
+{
+    maximum_size_ = maximum_size;
+}
+
+/**
+// Get the maximum size of this ArtifactCache.
+//
+// @return
+//  The maximum size in bytes or 0 if there is no maximum.
+*/
+uint64_t ArtifactCache::maximum_size() const
+{
+    return maximum_size_;
+}
+
+/**
+// Is this ArtifactCache enabled?
+//
+// @return
+//  True if a directory has been set for this ArtifactCache otherwise false.
+*/
+bool ArtifactCache::enabled() const
+{
+    return !directory_.empty();
+}
+
+/**
+// Get the RemoteCache that is consulted on local misses.
+//
+// @return
+//  The RemoteCache.
+*/
+RemoteCache* ArtifactCache::remote_cache()
+{
+    return &remote_cache_;
+}
+
+/**
+// Get the number of commands restored from this ArtifactCache.
+//
+// @return
+//  The number of hits.
+*/
+int ArtifactCache::hits() const
+{
+    return hits_;
+}
+
+/**
+// Get the number of commands that missed this ArtifactCache.
+//
+// @return
+//  The number of misses.
+*/
+int ArtifactCache::misses() const
+{
+    return misses_;
+}
+
+/**
+// Restore the files of \e target built by executing \e command.
+//
+// If there is an entry for the command and the current contents of its
+// inputs then the files of \e target are replaced by copies of the files
+// in that entry and the output captured when the entry was stored is
+// returned in \e output.  Otherwise \e target is remembered so that output
+// from the command is captured and its files stored once it has been built
+// (see `ArtifactCache::store()`).
+//
+// Failures to read the cache are reported and treated as misses.
+//
+// @param target
+//  The Target being built (assumed not null).
+//
+// @param command
+//  The executable that would be executed to build \e target.
+//
+// @param signature
+//  The signature of the command (see `LuaSystem::signature()`).
+//
+// @param output
+//  Receives the captured output as lines tagged by OutputStream on a hit
+//  (assumed not null).
+//
+// @return
+//  True if the files of \e target were restored otherwise false.
+*/
+bool ArtifactCache::restore( Target* target, const std::string& command, uint64_t signature, std::vector<std::pair<int, std::string>>* output )
+{
+    SWEET_ASSERT( target );
+    SWEET_ASSERT( output );
+    SWEET_ASSERT( enabled() );
+
+    try
+    {
+        uint64_t manifest_key = ArtifactCache::manifest_key( target, command, signature );
+        if ( restore_entry(target, manifest_key, output) || (remote_cache_.enabled() && fetch(manifest_key) && restore_entry(target, manifest_key, output)) )
+        {
+            actions_.erase( target );
+            ++hits_;
+            return true;
+        }
+
+        Action& action = actions_[target];
+        action.manifest_key_ = manifest_key;
+        action.output_.clear();
+        ++misses_;
+    }
+
+    catch ( const std::exception& exception )
+    {
+        forge_->outputf( "forge: Restoring '%s' from the artifact cache failed - %s", target->path().c_str(), exception.what() );
+    }
+    return false;
+}
+
+/**
+// Capture a line of output from the command executed to build \e target.
+//
+// Output is only captured for Targets that missed this ArtifactCache in the
+// current postorder traversal.  The root directory is replaced in captured
+// lines and expanded again when they're restored so that paths in output,
+// e.g. reported dependencies, refer to files in the restoring checkout.
+//
+// @param target
+//  The Target that the command was executed to build.
+//
+// @param stream
+//  The OutputStream that the line was written to.
+//
+// @param line
+//  The line of output.
+*/
+void ArtifactCache::capture( Target* target, int stream, const std::string& line )
+{
+    unordered_map<Target*, Action>::iterator action = actions_.find( target );
+    if ( action != actions_.end() )
+    {
+        action->second.output_.push_back( make_pair(stream, replace_root_directory(line, root_directory())) );
+    }
+}
+
+/**
+// Store the files of Targets that missed this ArtifactCache and have since
+// been built successfully.
+//
+// This is called once a postorder traversal completes so that all of the
+// output from executed commands has been captured and all implicit
+// dependencies have been reported.  Failures to write the cache are
+// reported but don't fail the build.  The cache is trimmed to its maximum
+// size afterwards (see `ArtifactCache::trim()`).
+*/
+void ArtifactCache::store()
+{
+    if ( !actions_.empty() )
+    {
+        for ( unordered_map<Target*, Action>::const_iterator action = actions_.begin(); action != actions_.end(); ++action )
+        {
+            Target* target = action->first;
+            try
+            {
+                if ( target->successful() && target->built() )
+                {
+                    store( target, action->second );
+                }
+            }
+
+            catch ( const std::exception& exception )
+            {
+                forge_->outputf( "forge: Storing '%s' in the artifact cache failed - %s", target->path().c_str(), exception.what() );
+            }
+        }
+        actions_.clear();
+        trim();
+    }
+}
+
+/**
+// Evict the least recently used entries until this ArtifactCache is no
+// larger than 90% of its maximum size.
+//
+// Entries are used when they are stored and restored.  Trimming below the
+// maximum size leaves room for later builds to store entries without
+// trimming every time.  Manifest directories without any remaining entries
+// are removed.
+*/
+void ArtifactCache::trim()
+{
+    if ( maximum_size_ == 0 || !boost::filesystem::is_directory(directory_) )
+    {
+        return;
+    }
+
+    struct Entry
+    {
+        std::time_t time_;
+        uint64_t size_;
+        boost::filesystem::path path_;
+    };
+
+    try
+    {
+        vector<Entry> entries;
+        unordered_map<string, int> entries_by_manifest;
+        uint64_t size = 0;
+        boost::system::error_code error;
+        for ( boost::filesystem::directory_iterator shard(directory_); shard != boost::filesystem::directory_iterator(); ++shard )
+        {
+            if ( !boost::filesystem::is_directory(shard->status()) || shard->path().filename() == "tmp" )
+            {
+                continue;
+            }
+            for ( boost::filesystem::directory_iterator manifest(shard->path()); manifest != boost::filesystem::directory_iterator(); ++manifest )
+            {
+                for ( boost::filesystem::directory_iterator entry(manifest->path()); entry != boost::filesystem::directory_iterator(); ++entry )
+                {
+                    if ( boost::filesystem::is_directory(entry->status()) )
+                    {
+                        Entry cached = { boost::filesystem::last_write_time(entry->path(), error), 0, entry->path() };
+                        for ( boost::filesystem::directory_iterator file(entry->path()); file != boost::filesystem::directory_iterator(); ++file )
+                        {
+                            cached.size_ += boost::filesystem::file_size( file->path(), error );
+                        }
+                        size += cached.size_;
+                        entries.push_back( cached );
+                        ++entries_by_manifest[manifest->path().string()];
+                    }
+                }
+            }
+        }
+
+        if ( size > maximum_size_ )
+        {
+            std::sort( entries.begin(), entries.end(), []( const Entry& lhs, const Entry& rhs ) {
+                return lhs.time_ < rhs.time_;
+            } );
+            uint64_t low_water_mark = maximum_size_ / 10 * 9;
+            vector<Entry>::const_iterator entry = entries.begin();
+            while ( entry != entries.end() && size > low_water_mark )
+            {
+                boost::filesystem::remove_all( entry->path_, error );
+                size -= entry->size_;
+                boost::filesystem::path manifest = entry->path_.parent_path();
+                if ( --entries_by_manifest[manifest.string()] == 0 )
+                {
+                    boost::filesystem::remove_all( manifest, error );
+                }
+                ++entry;
+            }
+        }
+    }
+
+    catch ( const std::exception& exception )
+    {
+        forge_->outputf( "forge: Trimming the artifact cache '%s' failed - %s", directory_.c_str(), exception.what() );
+    }
+}
+
+/**
+// Store the files and captured output of \e target in a new entry.
+//
+// The entry is written to a temporary directory that is then renamed into
+// place so that builds sharing the cache never see partially written
+// entries.  The implicit dependencies of \e target are appended to the
+// manifest unless an earlier entry already listed the same paths.
+//
+// @return
+//  True if the entry was stored or already exists otherwise false.
+*/
+bool ArtifactCache::store( Target* target, const Action& action )
+{
+    SWEET_ASSERT( target );
+
+    const vector<string>& filenames = target->filenames();
+    System* system = forge_->system();
+    for ( vector<string>::const_iterator filename = filenames.begin(); filename != filenames.end(); ++filename )
+    {
+        if ( !system->is_file(*filename) )
+        {
+            return false;
+        }
+    }
+
+    vector<string> paths;
+    string root_directory = ArtifactCache::root_directory();
+    int i = 0;
+    Target* dependency = target->implicit_dependency( i );
+    while ( dependency )
+    {
+        const vector<string>& filenames = dependency->filenames();
+        for ( vector<string>::const_iterator filename = filenames.begin(); filename != filenames.end(); ++filename )
+        {
+            paths.push_back( replace_root_directory(*filename, root_directory) );
+        }
+        ++i;
+        dependency = target->implicit_dependency( i );
+    }
+
+    uint64_t entry_key = 0;
+    if ( !ArtifactCache::entry_key(action.manifest_key_, paths, &entry_key) )
+    {
+        return false;
+    }
+
+    string manifest_directory = ArtifactCache::manifest_directory( action.manifest_key_ );
+    string entry = manifest_directory + "/" + hexadecimal( entry_key );
+    if ( boost::filesystem::exists(entry) )
+    {
+        return true;
+    }
+
+    boost::filesystem::path temporary = boost::filesystem::path( directory_ ) / "tmp" / boost::filesystem::unique_path();
+    boost::filesystem::create_directories( temporary );
+    for ( size_t i = 0; i < filenames.size(); ++i )
+    {
+        system->cp( filenames[i], (temporary / std::to_string(i)).string() );
+    }
+    {
+        std::ofstream captured( (temporary / OUTPUT).string(), std::ios::binary );
+        for ( vector<pair<int, string>>::const_iterator line = action.output_.begin(); line != action.output_.end(); ++line )
+        {
+            captured << char('0' + line->first) << ' ' << line->second << '\n';
+        }
+    }
+
+    if ( !commit(temporary.string(), action.manifest_key_, entry_key, paths) )
+    {
+        return boost::filesystem::exists( entry );
+    }
+
+    // Queue uploads of the files, the action result, and the manifest to
+    // the remote cache.  Files are uploaded before the action result that
+    // refers to them and the action result before the manifest that leads
+    // to it so that other builds never find records without their blobs.
+    if ( remote_cache_.enabled() )
+    {
+        string result = std::to_string( filenames.size() ) + "\n";
+        for ( size_t i = 0; i < filenames.size(); ++i )
+        {
+            string content;
+            read_file( entry + "/" + std::to_string(i), &content );
+            string hash = hexadecimal( Hasher::hash(content.data(), content.size()) );
+            result += hash + "\n";
+            remote_cache_.put( "cas/" + hash, std::move(content) );
+        }
+        string output;
+        read_file( entry + "/" + OUTPUT, &output );
+        remote_cache_.put( "ac/" + hexadecimal(entry_key), result + output );
+        string manifest;
+        read_file( manifest_directory + "/" + MANIFEST, &manifest );
+        merge_remote_manifest( action.manifest_key_, &manifest );
+        remote_cache_.put( "ac/" + hexadecimal(action.manifest_key_), std::move(manifest) );
+    }
+    return true;
+}
+
+/**
+// Restore the files of \e target from a local entry under \e manifest_key.
+//
+// @param target
+//  The Target to restore the files of (assumed not null).
+//
+// @param manifest_key
+//  The manifest key for the command that builds \e target.
+//
+// @param output
+//  Receives the captured output on a hit (assumed not null).
+//
+// @return
+//  True if the files of \e target were restored otherwise false.
+*/
+bool ArtifactCache::restore_entry( Target* target, uint64_t manifest_key, std::vector<std::pair<int, std::string>>* output )
+{
+    SWEET_ASSERT( target );
+    SWEET_ASSERT( output );
+
+    string manifest_directory = ArtifactCache::manifest_directory( manifest_key );
+    std::ifstream manifest( manifest_directory + "/" + MANIFEST );
+    vector<string> paths;
+    while ( read_record(manifest, &paths) )
+    {
+        uint64_t entry_key = 0;
+        if ( ArtifactCache::entry_key(manifest_key, paths, &entry_key) )
+        {
+            string entry = manifest_directory + "/" + hexadecimal( entry_key );
+            if ( boost::filesystem::is_directory(entry) )
+            {
+                output->clear();
+                string root_directory = ArtifactCache::root_directory();
+                std::ifstream captured( entry + "/" + OUTPUT );
+                string line;
+                while ( std::getline(captured, line) && line.size() >= 2 )
+                {
+                    output->push_back( make_pair(line[0] - '0', expand_root_directory(line.substr(2), root_directory)) );
+                }
+
+                const vector<string>& filenames = target->filenames();
+                for ( size_t i = 0; i < filenames.size(); ++i )
+                {
+                    forge_->system()->cp( entry + "/" + std::to_string(i), filenames[i] );
+                }
+
+                boost::system::error_code error;
+                boost::filesystem::last_write_time( entry, std::time(nullptr), error );
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+// Fetch an entry under \e manifest_key from the remote cache into this
+// ArtifactCache.
+//
+// The remote manifest is searched for a record whose implicit dependencies
+// match the local files in the same way as a local manifest.  The action
+// result for the matching entry lists the hashes of the entry's files,
+// which are downloaded concurrently and checked against their hashes,
+// followed by the captured output.
+//
+// @param manifest_key
+//  The manifest key to fetch an entry for.
+//
+// @return
+//  True if an entry was fetched otherwise false.
+*/
+bool ArtifactCache::fetch( uint64_t manifest_key )
+{
+    string manifest;
+    if ( !remote_cache_.get("ac/" + hexadecimal(manifest_key), &manifest) )
+    {
+        return false;
+    }
+
+    std::istringstream records( manifest );
+    vector<string> paths;
+    while ( read_record(records, &paths) )
+    {
+        uint64_t entry_key = 0;
+        string result;
+        if ( !ArtifactCache::entry_key(manifest_key, paths, &entry_key) || !remote_cache_.get("ac/" + hexadecimal(entry_key), &result) )
+        {
+            continue;
+        }
+
+        std::istringstream lines( result );
+        vector<string> hashes;
+        if ( !read_record(lines, &hashes) )
+        {
+            continue;
+        }
+
+        vector<string> blobs;
+        for ( vector<string>::const_iterator hash = hashes.begin(); hash != hashes.end(); ++hash )
+        {
+            blobs.push_back( "cas/" + *hash );
+        }
+        vector<string> contents;
+        if ( !remote_cache_.get(blobs, &contents) )
+        {
+            continue;
+        }
+
+        bool valid = true;
+        for ( size_t i = 0; i < contents.size() && valid; ++i )
+        {
+            valid = hexadecimal( Hasher::hash(contents[i].data(), contents[i].size()) ) == hashes[i];
+        }
+        if ( !valid )
+        {
+            continue;
+        }
+
+        boost::filesystem::path temporary = boost::filesystem::path( directory_ ) / "tmp" / boost::filesystem::unique_path();
+        boost::filesystem::create_directories( temporary );
+        for ( size_t i = 0; i < contents.size(); ++i )
+        {
+            write_file( (temporary / std::to_string(i)).string(), contents[i] );
+        }
+        std::streampos position = lines.tellg();
+        write_file( (temporary / OUTPUT).string(), position >= 0 ? result.substr(size_t(position)) : string() );
+        if ( commit(temporary.string(), manifest_key, entry_key, paths) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+// Merge the records of the remote manifest under \e manifest_key into 
+// \e manifest before it is uploaded.
+//
+// The remote cache replaces the manifest on each put so records uploaded by
+// other builds since this build last fetched the manifest would otherwise
+// be lost.  Records in the remote manifest that aren't in \e manifest are
+// appended to it.  Two builds uploading the same manifest at once can still
+// lose one of the other's records; this only causes a miss for that entry.
+//
+// @param manifest_key
+//  The manifest key of the manifest being uploaded.
+//
+// @param manifest
+//  The contents of the local manifest to append remote records to (assumed
+//  not null).
+*/
+void ArtifactCache::merge_remote_manifest( uint64_t manifest_key, std::string* manifest )
+{
+    SWEET_ASSERT( manifest );
+
+    string remote;
+    if ( !remote_cache_.get("ac/" + hexadecimal(manifest_key), &remote) )
+    {
+        return;
+    }
+
+    vector<vector<string>> listed;
+    std::istringstream local_records( *manifest );
+    vector<string> paths;
+    while ( read_record(local_records, &paths) )
+    {
+        listed.push_back( paths );
+    }
+
+    std::istringstream remote_records( remote );
+    while ( read_record(remote_records, &paths) )
+    {
+        if ( std::find(listed.begin(), listed.end(), paths) == listed.end() )
+        {
+            *manifest += std::to_string( paths.size() ) + "\n";
+            for ( vector<string>::const_iterator path = paths.begin(); path != paths.end(); ++path )
+            {
+                *manifest += *path + "\n";
+            }
+            listed.push_back( paths );
+        }
+    }
+}
+
+/**
+// Get the root directory that paths are keyed relative to.
+*/
+std::string ArtifactCache::root_directory() const
+{
+    return forge_->root().generic_string();
+}
+
+/**
+// Move a complete entry from \e temporary into place under \e manifest_key
+// and \e entry_key.
+//
+// The paths of the implicit dependencies are appended to the manifest 
+// unless they're already listed; entries for the same implicit 
+// dependencies with different contents share a single record.
+//
+// @return
+//  True if the entry was moved into place otherwise false.
+*/
+bool ArtifactCache::commit( const std::string& temporary, uint64_t manifest_key, uint64_t entry_key, const std::vector<std::string>& paths )
+{
+    string manifest_directory = ArtifactCache::manifest_directory( manifest_key );
+    string entry = manifest_directory + "/" + hexadecimal( entry_key );
+    boost::system::error_code error;
+    boost::filesystem::create_directories( manifest_directory );
+    boost::filesystem::rename( temporary, entry, error );
+    if ( error )
+    {
+        boost::filesystem::remove_all( temporary, error );
+        return false;
+    }
+
+    string manifest_filename = manifest_directory + "/" + MANIFEST;
+    std::ifstream manifest( manifest_filename );
+    vector<string> listed;
+    while ( read_record(manifest, &listed) )
+    {
+        if ( listed == paths )
+        {
+            return true;
+        }
+    }
+    manifest.close();
+
+    std::ofstream append( manifest_filename, std::ios::binary | std::ios::app );
+    append << paths.size() << '\n';
+    for ( vector<string>::const_iterator path = paths.begin(); path != paths.end(); ++path )
+    {
+        append << *path << '\n';
+    }
+    return true;
+}
+
+/**
+// Calculate the manifest key for the command that builds \e target.
+//
+// @param target
+//  The Target being built.
+//
+// @param command
+//  The executable that builds \e target.
+//
+// @param signature
+//  The signature of the command.
+//
+// @return
+//  The manifest key.
+*/
+uint64_t ArtifactCache::manifest_key( Target* target, const std::string& command, uint64_t signature )
+{
+    SWEET_ASSERT( target );
+
+    Hasher hasher;
+    hasher.append( &signature, sizeof(signature) );
+    uint64_t hash = 0;
+    content_hash( command, &hash );
+    hasher.append( &hash, sizeof(hash) );
+
+    string root_directory = ArtifactCache::root_directory();
+    int i = 0;
+    Target* dependency = target->explicit_dependency( i );
+    while ( dependency )
+    {
+        const vector<string>& filenames = dependency->filenames();
+        for ( vector<string>::const_iterator filename = filenames.begin(); filename != filenames.end(); ++filename )
+        {
+            hash = 0;
+            content_hash( *filename, &hash );
+            string path = replace_root_directory( *filename, root_directory );
+            hasher.append( path.c_str(), path.size() + 1 );
+            hasher.append( &hash, sizeof(hash) );
+        }
+        ++i;
+        dependency = target->explicit_dependency( i );
+    }
+    return hasher.value();
+}
+
+/**
+// Calculate the entry key for \e paths listed in a manifest.
+//
+// @param manifest_key
+//  The manifest key that \e paths are listed under.
+//
+// @param paths
+//  The paths of the implicit dependencies of the entry with the root 
+//  directory replaced (see `replace_root_directory()`).
+//
+// @param entry_key
+//  Receives the entry key (assumed not null).
+//
+// @return
+//  True if all of \e paths exist and were hashed otherwise false.
+*/
+bool ArtifactCache::entry_key( uint64_t manifest_key, const std::vector<std::string>& paths, uint64_t* entry_key )
+{
+    SWEET_ASSERT( entry_key );
+
+    Hasher hasher;
+    hasher.append( &manifest_key, sizeof(manifest_key) );
+    string root_directory = ArtifactCache::root_directory();
+    for ( vector<string>::const_iterator path = paths.begin(); path != paths.end(); ++path )
+    {
+        uint64_t hash = 0;
+        if ( !content_hash(expand_root_directory(*path, root_directory), &hash) )
+        {
+            return false;
+        }
+        hasher.append( path->c_str(), path->size() + 1 );
+        hasher.append( &hash, sizeof(hash) );
+    }
+    *entry_key = hasher.value();
+    return true;
+}
+
+/**
+// Get the hash of the contents of the file at \e path.
+//
+// Hashes are remembered along with the last write time of the file that
+// they were calculated for so that files shared by many commands, like
+// headers, are only hashed once per build.
+//
+// @param path
+//  The path to the file to hash.
+//
+// @param hash
+//  Receives the hash (assumed not null).
+//
+// @return
+//  True if the file exists and was hashed otherwise false.
+*/
+bool ArtifactCache::content_hash( const std::string& path, uint64_t* hash )
+{
+    SWEET_ASSERT( hash );
+
+    System* system = forge_->system();
+    if ( !system->is_file(path) )
+    {
+        return false;
+    }
+
+    int64_t last_write_time = system->last_write_time( path );
+    pair<int64_t, uint64_t>& content_hash = content_hashes_[path];
+    if ( content_hash.first != last_write_time || last_write_time == 0 )
+    {
+        content_hash.first = last_write_time;
+        content_hash.second = system->content_hash( path );
+    }
+    *hash = content_hash.second;
+    return true;
+}
+
+/**
+// Read the next record from a manifest.
+//
+// Each record is the number of paths on a line by itself followed by each
+// path on a line by itself.
+//
+// @param manifest
+//  The stream to read the record from.
+//
+// @param paths
+//  Receives the paths listed in the record (assumed not null).
+//
+// @return
+//  True if a whole record was read otherwise false.
+*/
+bool ArtifactCache::read_record( std::istream& manifest, std::vector<std::string>* paths )
+{
+    SWEET_ASSERT( paths );
+
+    const unsigned long MAXIMUM_PATHS = 65536;
+    string line;
+    if ( !std::getline(manifest, line) )
+    {
+        return false;
+    }
+
+    char* end = nullptr;
+    unsigned long size = strtoul( line.c_str(), &end, 10 );
+    if ( end == line.c_str() || *end != 0 || size > MAXIMUM_PATHS )
+    {
+        return false;
+    }
+
+    paths->resize( size );
+    for ( vector<string>::iterator path = paths->begin(); path != paths->end(); ++path )
+    {
+        if ( !std::getline(manifest, *path) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+// Get the directory that holds the manifest and entries for a manifest key.
+*/
+std::string ArtifactCache::manifest_directory( uint64_t manifest_key ) const
+{
+    string key = hexadecimal( manifest_key );
+    return directory_ + "/" + key.substr( 0, 2 ) + "/" + key;
+}
+
+/**
+// Format \e value as 16 hexadecimal digits.
+*/
+std::string ArtifactCache::hexadecimal( uint64_t value )
+{
+    static const char DIGITS [] = "0123456789abcdef";
+    char digits [16];
+    for ( int i = 15; i >= 0; --i )
+    {
+        digits[i] = DIGITS[value & 0xf];
+        value >>= 4;
+    }
+    return string( digits, sizeof(digits) );
+}
+
+/**
+// Read the whole of the file at \e path into \e content.
+*/
+bool ArtifactCache::read_file( const std::string& path, std::string* content )
+{
+    SWEET_ASSERT( content );
+    std::ifstream file( path, std::ios::binary );
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    content->assign( stream.str() );
+    return bool(file);
+}
+
+/**
+// Write \e content to the file at \e path replacing it if it exists.
+*/
+void ArtifactCache::write_file( const std::string& path, const std::string& content )
+{
+    std::ofstream file( path, std::ios::binary | std::ios::trunc );
+    file.write( content.data(), std::streamsize(content.size()) );
+    if ( !file )
+    {
+        throw std::runtime_error( "Writing '" + path + "' failed" );
+    }
+}
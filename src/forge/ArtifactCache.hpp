@@ -0,0 +1,120 @@
+#ifndef FORGE_ARTIFACTCACHE_HPP_INCLUDED
+#define FORGE_ARTIFACTCACHE_HPP_INCLUDED
+
+#include "RemoteCache.hpp"
+#include <string>
+#include <istream>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <stdint.h>
+
+namespace sweet
+{
+
+namespace forge
+{
+
+class Target;
+class Forge;
+
+/**
+// The output streams of an executed command that are captured by and
+// replayed from an ArtifactCache.
+*/
+enum OutputStream
+{
+    OUTPUT_DEPENDENCIES, ///< Dependencies reported by the injected build hooks library.
+    OUTPUT_STDOUT, ///< Standard output.
+    OUTPUT_STDERR ///< Standard error.
+};
+
+/**
+// Cache the files of Targets built by executing a command in a local
+// directory keyed by that command and the contents of its inputs.
+//
+// Entries are keyed in two levels.  The manifest key covers the signature of
+// the command, the contents of the executable, and the paths and contents of
+// the files of a Target's explicit dependencies.  The manifest stored under
+// that key lists the implicit dependencies that each entry was built with
+// and the entry key extends the manifest key with the paths and contents of
+// those implicit dependencies.  This allows implicit dependencies that are
+// only discovered by executing the command, like included headers, to be
+// part of the key.  Paths, command lines, and captured output have the root
+// directory replaced (see `replace_root_directory()`) before they're hashed
+// or stored so that checkouts of a project in different directories share
+// entries.
+//
+// Each entry holds a copy of the Target's files and the lines of output that
+// the command wrote, tagged by OutputStream, so that a hit can restore the
+// files and replay the output through the filters the command would have
+// used without executing it.  Files are copied in and out of entries with
+// `System::cp()`, as reflinks where possible, but never hard linked because
+// compilers and linkers rewrite existing outputs in place.  Entries are
+// stored once the postorder traversal that built them completes and all 
+// output has been read.  The least recently used entries are evicted once
+// the cache grows larger than its maximum size.
+//
+// Local misses are looked up in the RemoteCache, if one is enabled, and
+// entries found there are fetched into the local cache before restoring.
+// Entries stored locally are also queued to be uploaded to the RemoteCache
+// along with their manifest merged with the remote manifest.
+*/
+class ArtifactCache
+{
+    /**
+    // A Target whose command missed the cache and whose files are to be
+    // stored once it has been built.
+    */
+    struct Action
+    {
+        uint64_t manifest_key_; ///< The manifest key for the Target's command.
+        std::vector<std::pair<int, std::string>> output_; ///< The output captured from the command.
+    };
+
+    Forge* forge_; ///< The Forge that this ArtifactCache is part of.
+    std::string directory_; ///< The directory that entries are stored in or empty if this ArtifactCache is disabled.
+    uint64_t maximum_size_; ///< The maximum size of the cache in bytes or 0 for no maximum.
+    std::unordered_map<std::string, std::pair<int64_t, uint64_t>> content_hashes_; ///< The last write time and content hash of each file hashed in this run.
+    std::unordered_map<Target*, Action> actions_; ///< The actions waiting to be stored by Target.
+    RemoteCache remote_cache_; ///< The remote cache consulted on local misses.
+    int hits_; ///< The number of commands restored from this ArtifactCache.
+    int misses_; ///< The number of commands that missed this ArtifactCache.
+
+public:
+    ArtifactCache( Forge* forge );
+    void set_directory( const std::string& directory );
+    const std::string& directory() const;
+    void set_maximum_size( uint64_t maximum_size );
+    uint64_t maximum_size() const;
+    bool enabled() const;
+    RemoteCache* remote_cache();
+    int hits() const;
+    int misses() const;
+    bool restore( Target* target, const std::string& command, uint64_t signature, std::vector<std::pair<int, std::string>>* output );
+    void capture( Target* target, int stream, const std::string& line );
+    void store();
+    void trim();
+
+private:
+    bool store( Target* target, const Action& action );
+    bool restore_entry( Target* target, uint64_t manifest_key, std::vector<std::pair<int, std::string>>* output );
+    bool fetch( uint64_t manifest_key );
+    bool commit( const std::string& temporary, uint64_t manifest_key, uint64_t entry_key, const std::vector<std::string>& paths );
+    void merge_remote_manifest( uint64_t manifest_key, std::string* manifest );
+    std::string root_directory() const;
+    uint64_t manifest_key( Target* target, const std::string& command, uint64_t signature );
+    bool entry_key( uint64_t manifest_key, const std::vector<std::string>& paths, uint64_t* entry_key );
+    bool content_hash( const std::string& path, uint64_t* hash );
+    std::string manifest_directory( uint64_t manifest_key ) const;
+    static bool read_record( std::istream& manifest, std::vector<std::string>* paths );
+    static std::string hexadecimal( uint64_t value );
+    static bool read_file( const std::string& path, std::string* content );
+    static void write_file( const std::string& path, const std::string& content );
+};
+
+}
+
+}
+
+#endif
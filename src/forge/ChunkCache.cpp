@@ -0,0 +1,505 @@
+//
+// ChunkCache.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "ChunkCache.hpp"
+#include "Forge.hpp"
+#include "System.hpp"
+#include "Hasher.hpp"
+#include <assert/assert.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <ctime>
+#include <string.h>
+#include <stdio.h>
+#include <lua.hpp>
+
+using std::string;
+using std::vector;
+using std::shared_ptr;
+using namespace sweet;
+using namespace sweet::forge;
+
+/**
+// The most threads used to preload chunks.
+*/
+static const int MAXIMUM_PRELOAD_THREADS = 8;
+
+/**
+// Read the contents of a file.
+//
+// @return
+//  True if the file was read otherwise false.
+*/
+static bool read_file( const string& filename, string* contents )
+{
+    SWEET_ASSERT( contents );
+    std::ifstream file( filename.c_str(), std::ios::binary );
+    if ( !file )
+    {
+        return false;
+    }
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    *contents = stream.str();
+    return !file.bad();
+}
+
+/**
+// Constructor.
+//
+// @param forge
+//  The Forge that this ChunkCache is part of.
+*/
+ChunkCache::ChunkCache( Forge* forge )
+: forge_( forge ),
+  directory_(),
+  mutex_(),
+  condition_(),
+  chunks_(),
+  pending_(),
+  threads_(),
+  stopping_( false ),
+  filenames_(),
+  hits_( 0 ),
+  misses_( 0 )
+{
+    SWEET_ASSERT( forge_ );
+}
+
+/**
+// Destructor.
+//
+// Waits for any chunks being preloaded by workers to finish.
+*/
+ChunkCache::~ChunkCache()
+{
+    stop();
+}
+
+/**
+// Set the directory that compiled chunks are stored in.
+//
+// The directory is created if it doesn't exist and otherwise trimmed to
+// `ChunkCache::MAXIMUM_CHUNKS` (see `ChunkCache::trim()`).
+//
+// @param directory
+//  The absolute path to the directory to store compiled chunks in or the
+//  empty string to disable caching and preloading.
+*/
+void ChunkCache::set_directory( const std::string& directory )
+{
+    directory_ = directory;
+    if ( !directory_.empty() )
+    {
+        boost::system::error_code error;
+        boost::filesystem::create_directories( directory_, error );
+        trim( MAXIMUM_CHUNKS );
+    }
+}
+
+/**
+// Get the directory that compiled chunks are stored in.
+//
+// @return
+//  The directory or the empty string if caching is disabled.
+*/
+const std::string& ChunkCache::directory() const
+{
+    return directory_;
+}
+
+/**
+// Start preloading chunks for files on worker threads.
+//
+// Files that have already been preloaded and not yet loaded are skipped.
+//
+// @param filenames
+//  The absolute paths to the files to preload, e.g. the buildfiles loaded
+//  by the previous run.
+*/
+void ChunkCache::preload( const std::vector<std::string>& filenames )
+{
+    if ( directory_.empty() )
+    {
+        return;
+    }
+
+    stop();
+
+    std::unique_lock<std::mutex> lock( mutex_ );
+    stopping_ = false;
+    for ( vector<string>::const_iterator filename = filenames.begin(); filename != filenames.end(); ++filename )
+    {
+        if ( chunks_.find(*filename) == chunks_.end() )
+        {
+            shared_ptr<Chunk> chunk = std::make_shared<Chunk>();
+            chunk->state_ = CHUNK_PENDING;
+            chunk->read_ = false;
+            chunks_.insert( std::make_pair(*filename, chunk) );
+            pending_.push_back( *filename );
+        }
+    }
+
+    int maximum_threads = std::min( forge_->system()->number_of_logical_processors(), MAXIMUM_PRELOAD_THREADS );
+    int threads = std::min( int(pending_.size()), std::max(1, maximum_threads) );
+    for ( int i = 0; i < threads; ++i )
+    {
+        threads_.push_back( std::thread(&ChunkCache::work, this) );
+    }
+}
+
+/**
+// Load a file as a Lua chunk.
+//
+// Behaves as `luaL_loadfile()` but loads the stored bytecode for the file
+// when its path and source haven't changed since it was last compiled.
+// Files that have been preloaded are taken from the preloaded chunks,
+// waiting for a worker to finish with the file if necessary.
+//
+// @param lua_state
+//  The lua_State to load the chunk into.
+//
+// @param filename
+//  The path to the file to load.
+//
+// @return
+//  The result of loading the chunk; `LUA_OK` with the loaded function on
+//  the stack or an error code with the error message on the stack.
+*/
+int ChunkCache::load( lua_State* lua_state, const std::string& filename )
+{
+    SWEET_ASSERT( lua_state );
+
+    filenames_.insert( filename );
+    if ( directory_.empty() )
+    {
+        return luaL_loadfile( lua_state, filename.c_str() );
+    }
+
+    shared_ptr<Chunk> chunk;
+    bool prepared = false;
+    {
+        std::unique_lock<std::mutex> lock( mutex_ );
+        std::unordered_map<string, shared_ptr<Chunk>>::iterator i = chunks_.find( filename );
+        if ( i != chunks_.end() )
+        {
+            chunk = i->second;
+            chunks_.erase( i );
+            if ( chunk->state_ == CHUNK_PENDING )
+            {
+                chunk->state_ = CHUNK_LOADING;
+            }
+            else
+            {
+                condition_.wait( lock, [&chunk]() { return chunk->state_ == CHUNK_READY; } );
+                prepared = true;
+            }
+        }
+    }
+
+    if ( !chunk )
+    {
+        chunk = std::make_shared<Chunk>();
+        chunk->state_ = CHUNK_LOADING;
+        chunk->read_ = false;
+    }
+
+    if ( !prepared )
+    {
+        prepare( lua_state, filename, chunk.get() );
+    }
+
+    if ( !chunk->bytecode_.empty() )
+    {
+        string chunkname = "@" + filename;
+        int result = luaL_loadbufferx( lua_state, chunk->bytecode_.data(), chunk->bytecode_.size(), chunkname.c_str(), "b" );
+        if ( result == LUA_OK )
+        {
+            return result;
+        }
+        lua_pop( lua_state, 1 );
+        return luaL_loadfile( lua_state, filename.c_str() );
+    }
+
+    return chunk->read_ ? load_source( lua_state, filename, chunk->source_ ) : luaL_loadfile( lua_state, filename.c_str() );
+}
+
+/**
+// Get the files that have been loaded.
+//
+// @return
+//  The paths passed to `ChunkCache::load()`, i.e. the root build script,
+//  modules, and buildfiles loaded so far.
+*/
+const std::unordered_set<std::string>& ChunkCache::filenames() const
+{
+    return filenames_;
+}
+
+/**
+// Get the number of files loaded from stored bytecode.
+*/
+int ChunkCache::hits() const
+{
+    return hits_;
+}
+
+/**
+// Get the number of files compiled because no bytecode was stored for 
+// their current path and source.
+*/
+int ChunkCache::misses() const
+{
+    return misses_;
+}
+
+/**
+// Remove the least recently used chunks until no more than 90% of 
+// \e maximum_chunks are stored.
+//
+// Chunks are used when they are stored and loaded.  Edited buildfiles leave
+// chunks for their earlier sources behind that are never used again so
+// without trimming the directory grows without limit.  Trimming below the
+// maximum leaves room for later runs to store chunks without trimming 
+// every time.  Failures are ignored; the directory is trimmed again by the
+// next run.
+//
+// @param maximum_chunks
+//  The most chunks to keep stored.
+*/
+void ChunkCache::trim( size_t maximum_chunks )
+{
+    SWEET_ASSERT( threads_.empty() );
+
+    struct Stored
+    {
+        std::time_t time_;
+        boost::filesystem::path path_;
+    };
+
+    boost::system::error_code error;
+    vector<Stored> chunks;
+    boost::filesystem::directory_iterator file( directory_, error );
+    while ( !error && file != boost::filesystem::directory_iterator() )
+    {
+        if ( boost::filesystem::is_regular_file(file->status()) )
+        {
+            Stored stored = { boost::filesystem::last_write_time(file->path(), error), file->path() };
+            chunks.push_back( stored );
+        }
+        file.increment( error );
+    }
+
+    if ( chunks.size() > maximum_chunks )
+    {
+        std::sort( chunks.begin(), chunks.end(), []( const Stored& lhs, const Stored& rhs ) {
+            return lhs.time_ < rhs.time_;
+        } );
+        size_t low_water_mark = maximum_chunks - maximum_chunks / 10;
+        for ( size_t i = 0; i < chunks.size() - low_water_mark; ++i )
+        {
+            boost::filesystem::remove( chunks[i].path_, error );
+        }
+    }
+}
+
+/**
+// Stop preloading chunks and wait for workers to finish.
+//
+// Chunks that haven't been picked up by a worker stay pending and are
+// prepared by the main thread when they are loaded.
+*/
+void ChunkCache::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock( mutex_ );
+        stopping_ = true;
+        pending_.clear();
+    }
+    for ( vector<std::thread>::iterator thread = threads_.begin(); thread != threads_.end(); ++thread )
+    {
+        thread->join();
+    }
+    threads_.clear();
+}
+
+/**
+// Preload pending chunks until there are none left or stopping.
+//
+// Each worker compiles in its own lua_State as a lua_State can't be shared
+// between threads.
+*/
+void ChunkCache::work()
+{
+    lua_State* lua_state = luaL_newstate();
+    std::unique_lock<std::mutex> lock( mutex_ );
+    while ( !stopping_ && !pending_.empty() )
+    {
+        string filename = pending_.front();
+        pending_.pop_front();
+        std::unordered_map<string, shared_ptr<Chunk>>::iterator i = chunks_.find( filename );
+        if ( i != chunks_.end() && i->second->state_ == CHUNK_PENDING )
+        {
+            shared_ptr<Chunk> chunk = i->second;
+            chunk->state_ = CHUNK_LOADING;
+            lock.unlock();
+            prepare( lua_state, filename, chunk.get() );
+            lock.lock();
+            chunk->state_ = CHUNK_READY;
+            condition_.notify_all();
+        }
+    }
+    lock.unlock();
+    if ( lua_state )
+    {
+        lua_close( lua_state );
+    }
+}
+
+/**
+// Read the source of a file and find or compile its bytecode.
+//
+// The source is discarded once the bytecode is known.  The bytecode is
+// left empty if the source doesn't compile so that the error is reported
+// when the source is loaded by the main thread.
+//
+// @param lua_state
+//  The lua_State to compile in or null to only find stored bytecode; the
+//  stack is left unchanged.
+//
+// @param filename
+//  The path to the file.
+//
+// @param chunk
+//  The Chunk to prepare (assumed not null).
+*/
+void ChunkCache::prepare( lua_State* lua_state, const std::string& filename, Chunk* chunk ) const
+{
+    SWEET_ASSERT( chunk );
+
+    chunk->read_ = read_file( filename, &chunk->source_ );
+    if ( !chunk->read_ )
+    {
+        return;
+    }
+
+    Hasher hasher;
+    hasher.append( filename.c_str(), filename.size() + 1 );
+    hasher.append( chunk->source_.data(), chunk->source_.size() );
+    uint64_t key = hasher.value();
+
+    string chunk_filename = ChunkCache::chunk_filename( key );
+    if ( read_file(chunk_filename, &chunk->bytecode_) )
+    {
+        boost::system::error_code error;
+        boost::filesystem::last_write_time( chunk_filename, std::time(nullptr), error );
+        ++hits_;
+    }
+    else
+    {
+        chunk->bytecode_.clear();
+        ++misses_;
+        if ( lua_state )
+        {
+            if ( load_source(lua_state, filename, chunk->source_) == LUA_OK )
+            {
+                lua_dump( lua_state, &ChunkCache::write_bytecode, &chunk->bytecode_, 0 );
+                store( key, chunk->bytecode_ );
+            }
+            lua_pop( lua_state, 1 );
+        }
+    }
+
+    if ( !chunk->bytecode_.empty() )
+    {
+        string().swap( chunk->source_ );
+    }
+}
+
+/**
+// Get the path to the file that stores the bytecode with \e key.
+*/
+std::string ChunkCache::chunk_filename( uint64_t key ) const
+{
+    char name [32];
+    snprintf( name, sizeof(name), "/%016llx.luac", (unsigned long long) key );
+    return directory_ + name;
+}
+
+/**
+// Store compiled bytecode.
+//
+// The bytecode is written to a temporary file and renamed into place so
+// that other forge processes never read partially written bytecode.
+// Failing to store bytecode is ignored; the file is compiled again next
+// time.
+*/
+void ChunkCache::store( uint64_t key, const std::string& bytecode ) const
+{
+    if ( bytecode.empty() )
+    {
+        return;
+    }
+
+    boost::system::error_code error;
+    string filename = chunk_filename( key );
+    boost::filesystem::path temporary = filename + "." + boost::filesystem::unique_path().string();
+    {
+        std::ofstream file( temporary.string().c_str(), std::ios::binary );
+        file.write( bytecode.data(), std::streamsize(bytecode.size()) );
+        if ( !file )
+        {
+            file.close();
+            boost::filesystem::remove( temporary, error );
+            return;
+        }
+    }
+    boost::filesystem::rename( temporary, filename, error );
+    if ( error )
+    {
+        boost::filesystem::remove( temporary, error );
+    }
+}
+
+/**
+// Load Lua source as a chunk named after the file it was read from.
+//
+// Skips a leading byte order mark and replaces a leading line starting
+// with '#' with an empty line in the same way as `luaL_loadfile()`.
+*/
+int ChunkCache::load_source( lua_State* lua_state, const std::string& filename, const std::string& source )
+{
+    SWEET_ASSERT( lua_state );
+
+    const char* data = source.data();
+    size_t size = source.size();
+    if ( size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0 )
+    {
+        data += 3;
+        size -= 3;
+    }
+
+    string chunkname = "@" + filename;
+    if ( size > 0 && *data == '#' )
+    {
+        const char* newline = static_cast<const char*>( memchr(data, '\n', size) );
+        string buffer = newline ? "\n" + string( newline + 1, data + size ) : string( "\n" );
+        return luaL_loadbufferx( lua_state, buffer.data(), buffer.size(), chunkname.c_str(), nullptr );
+    }
+    return luaL_loadbufferx( lua_state, data, size, chunkname.c_str(), nullptr );
+}
+
+/**
+// Append bytecode written by `lua_dump()` to a string.
+*/
+int ChunkCache::write_bytecode( lua_State* /*lua_state*/, const void* data, size_t size, void* context )
+{
+    SWEET_ASSERT( context );
+    string* bytecode = reinterpret_cast<string*>( context );
+    bytecode->append( reinterpret_cast<const char*>(data), size );
+    return 0;
+}
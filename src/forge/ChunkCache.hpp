@@ -0,0 +1,107 @@
+#ifndef FORGE_CHUNKCACHE_HPP_INCLUDED
+#define FORGE_CHUNKCACHE_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <stdint.h>
+
+struct lua_State;
+
+namespace sweet
+{
+
+namespace forge
+{
+
+class Forge;
+
+/**
+// Cache compiled Lua chunks for buildfiles and modules.
+//
+// Chunks are stored as Lua bytecode in files in a directory named by a hash
+// of the path and source of the file that they're compiled from.  Loading
+// a file whose path and source haven't changed since it was last compiled
+// reads its source to compute the hash and then loads the stored bytecode
+// instead of parsing the source again.
+//
+// Buildfiles known from the previous run can be preloaded, i.e. read,
+// hashed, and, if they aren't already stored, compiled, on worker threads
+// ahead of their execution so that the main thread only has to load the
+// bytecode when each buildfile is executed.
+//
+// Stored chunks are touched each time they're used and the least recently
+// used chunks are removed when the directory is set, i.e. on startup, once
+// more than `ChunkCache::MAXIMUM_CHUNKS` are stored.
+*/
+class ChunkCache
+{
+    /**
+    // The states of a preloaded chunk.
+    */
+    enum ChunkState
+    {
+        CHUNK_PENDING, ///< The chunk hasn't been picked up by a worker yet.
+        CHUNK_LOADING, ///< The chunk is being loaded by a worker or the main thread.
+        CHUNK_READY ///< The chunk has been loaded.
+    };
+
+    /**
+    // A chunk read and, if possible, compiled ahead of being loaded.
+    */
+    struct Chunk
+    {
+        int state_; ///< The state of this chunk (see `ChunkState`).
+        bool read_; ///< True if the source was read.
+        std::string source_; ///< The source of the file.
+        std::string bytecode_; ///< The compiled bytecode or empty if the source didn't compile.
+    };
+
+    Forge* forge_; ///< The Forge that this ChunkCache is part of.
+    std::string directory_; ///< The directory that compiled chunks are stored in or empty if this ChunkCache is disabled.
+    std::mutex mutex_; ///< Guards the preloaded chunks and the filenames waiting to be preloaded.
+    std::condition_variable condition_; ///< Signalled when a preloaded chunk is ready.
+    std::unordered_map<std::string, std::shared_ptr<Chunk>> chunks_; ///< The preloaded chunks by filename.
+    std::deque<std::string> pending_; ///< The filenames waiting to be preloaded.
+    std::vector<std::thread> threads_; ///< The worker threads preloading chunks.
+    bool stopping_; ///< True when workers should stop preloading.
+    std::unordered_set<std::string> filenames_; ///< The files that have been loaded.
+    mutable std::atomic<int> hits_; ///< The number of files loaded from stored bytecode.
+    mutable std::atomic<int> misses_; ///< The number of files compiled because no bytecode was stored.
+
+public:
+    static const size_t MAXIMUM_CHUNKS = 4096;
+
+    ChunkCache( Forge* forge );
+    ~ChunkCache();
+    void set_directory( const std::string& directory );
+    const std::string& directory() const;
+    void preload( const std::vector<std::string>& filenames );
+    int load( lua_State* lua_state, const std::string& filename );
+    const std::unordered_set<std::string>& filenames() const;
+    int hits() const;
+    int misses() const;
+    void trim( size_t maximum_chunks );
+
+private:
+    void stop();
+    void work();
+    void prepare( lua_State* lua_state, const std::string& filename, Chunk* chunk ) const;
+    std::string chunk_filename( uint64_t key ) const;
+    void store( uint64_t key, const std::string& bytecode ) const;
+    static int load_source( lua_State* lua_state, const std::string& filename, const std::string& source );
+    static int write_bytecode( lua_State* lua_state, const void* data, size_t size, void* context );
+};
+
+}
+
+}
+
+#endif
@@ -7,6 +7,8 @@
 #include "Forge.hpp"
 #include "Target.hpp"
 #include "Context.hpp"
+#include "Job.hpp"
+#include "ArtifactCache.hpp"
 #include "Reader.hpp"
 #include "Scheduler.hpp"
 #include <process/Process.hpp>
@@ -137,22 +139,25 @@ void Executor::thread_execute( const std::string& command, const std::string& co
         inject_build_hooks_windows( &process, write_dependencies_pipe );
         process.resume();
 
+        // Output is tagged with the Target being built so that it can be
+        // captured by the ArtifactCache and replayed later.
         Scheduler* scheduler = forge_->scheduler();
+        Target* target = context->job() ? context->job()->target() : nullptr;
         if ( dependencies_filter && !forge_hooks_library_.empty() )
         {
-            scheduler->read( read_dependencies_pipe, dependencies_filter, arguments, working_directory );
+            scheduler->read( read_dependencies_pipe, dependencies_filter, arguments, working_directory, target, OUTPUT_DEPENDENCIES );
         }
-        scheduler->read( stdout_pipe, stdout_filter, arguments, working_directory );
-        scheduler->read( stderr_pipe, stderr_filter, arguments, working_directory );
+        scheduler->read( stdout_pipe, stdout_filter, arguments, working_directory, target, OUTPUT_STDOUT );
+        scheduler->read( stderr_pipe, stderr_filter, arguments, working_directory, target, OUTPUT_STDERR );
         process.wait();
-        scheduler->push_execute_finished( process.exit_code(), context, environment );
+        scheduler->push_execute_finished( process.exit_code(), context, environment, dependencies_filter && !forge_hooks_library_.empty() );
     }
 
     catch ( const std::exception& exception )
     {
         Scheduler* scheduler = forge_->scheduler();
         scheduler->push_errorf( "%s", exception.what() );
-        scheduler->push_execute_finished( EXIT_FAILURE, context, environment );
+        scheduler->push_execute_finished( EXIT_FAILURE, context, environment, false );
     }
 }
 
@@ -8,6 +8,9 @@
 #include "System.hpp"
 #include "Scheduler.hpp"
 #include "Executor.hpp"
+#include "ArtifactCache.hpp"
+#include "Watcher.hpp"
+#include "ChunkCache.hpp"
 #include "Reader.hpp"
 #include "Graph.hpp"
 #include "Toolset.hpp"
@@ -47,11 +50,19 @@ Forge::Forge( const std::string& initial_directory, error::ErrorPolicy& error_po
   graph_( NULL ),
   scheduler_( NULL ),
   executor_( NULL ),
+  artifact_cache_( NULL ),
+  watcher_( NULL ),
+  chunk_cache_( NULL ),
   root_directory_(),
   initial_directory_(),
   home_directory_(),
   executable_directory_(),
-  stack_trace_enabled_( false )
+  stack_trace_enabled_( false ),
+  memory_statistics_enabled_( false ),
+  reload_requested_( false ),
+  loaded_( false ),
+  assignments_(),
+  command_()
 {
     SWEET_ASSERT( boost::filesystem::path(initial_directory).is_absolute() );
 
@@ -66,6 +77,13 @@ Forge::Forge( const std::string& initial_directory, error::ErrorPolicy& error_po
     graph_ = new Graph( this );
     scheduler_ = new Scheduler( this );
     executor_ = new Executor( this );
+    artifact_cache_ = new ArtifactCache( this );
+    watcher_ = new Watcher( this );
+    chunk_cache_ = new ChunkCache( this );
+    if ( !home_directory_.empty() )
+    {
+        chunk_cache_->set_directory( home(".forge/chunks").generic_string() );
+    }
 
 #if defined BUILD_OS_WINDOWS
     set_forge_hooks_library( executable("forge_hooks.dll").generic_string() );
@@ -87,6 +105,9 @@ Forge::Forge( const std::string& initial_directory, error::ErrorPolicy& error_po
 */
 Forge::~Forge()
 {
+    delete chunk_cache_;
+    delete watcher_;
+    delete artifact_cache_;
     delete executor_;
     delete scheduler_;
     delete graph_;
@@ -166,6 +187,42 @@ Executor* Forge::executor() const
     return executor_;
 }
 
+/**
+// Get the ArtifactCache for this Forge.
+//
+// @return
+//  The ArtifactCache.
+*/
+ArtifactCache* Forge::artifact_cache() const
+{
+    SWEET_ASSERT( artifact_cache_ );
+    return artifact_cache_;
+}
+
+/**
+// Get the ChunkCache.
+//
+// @return
+//  The ChunkCache.
+*/
+ChunkCache* Forge::chunk_cache() const
+{
+    SWEET_ASSERT( chunk_cache_ );
+    return chunk_cache_;
+}
+
+/**
+// Get the Watcher for this Forge.
+//
+// @return
+//  The Watcher.
+*/
+Watcher* Forge::watcher() const
+{
+    SWEET_ASSERT( watcher_ );
+    return watcher_;
+}
+
 /**
 // Get the currently active Context for this Forge.
 //
@@ -289,6 +346,28 @@ bool Forge::stack_trace_enabled() const
     return stack_trace_enabled_;
 }
 
+/**
+// Set whether or not the memory used by Lua is reported on exit.
+//
+// @param
+//  True to report memory statistics or false to not report them.
+*/
+void Forge::set_memory_statistics_enabled( bool memory_statistics_enabled )
+{
+    memory_statistics_enabled_ = memory_statistics_enabled;
+}
+
+/**
+// Is the memory used by Lua reported on exit?
+//
+// @return
+//  True if memory statistics are reported on exit otherwise false.
+*/
+bool Forge::memory_statistics_enabled() const
+{
+    return memory_statistics_enabled_;
+}
+
 /**
 // Set the maximum number of parallel jobs.
 //
@@ -338,6 +417,44 @@ const std::string& Forge::forge_hooks_library() const
     return executor_->forge_hooks_library();
 }
 
+/**
+// Request that buildfiles are reloaded.
+//
+// Set by the `watch` command when buildfiles change so that the application
+// discards this Forge and executes the command again with a new Forge that
+// loads the changed buildfiles from scratch.
+//
+// @param reload_requested
+//  True to request that buildfiles are reloaded.
+*/
+void Forge::set_reload_requested( bool reload_requested )
+{
+    reload_requested_ = reload_requested;
+}
+
+/**
+// Has reloading buildfiles been requested?
+//
+// @return
+//  True if reloading buildfiles has been requested otherwise false.
+*/
+bool Forge::reload_requested() const
+{
+    return reload_requested_;
+}
+
+/**
+// Have the root build script and buildfiles been loaded?
+//
+// @return
+//  True if the most recent call to `Forge::execute()` loaded the root build
+//  script without errors otherwise false.
+*/
+bool Forge::loaded() const
+{
+    return loaded_;
+}
+
 /**
 // Set the root directory to *root_directory*.
 //
@@ -364,9 +481,22 @@ void Forge::set_root_directory( const std::string& root_directory )
 void Forge::assign_global_variables( const std::vector<std::string>& assignments )
 {
     SWEET_ASSERT( lua_ );
+    assignments_ = assignments;
     lua_->assign_global_variables( assignments );
 }
 
+/**
+// Get the variables assigned on the command line.
+//
+// @return
+//  The assignments passed to the most recent call to 
+//  `Forge::assign_global_variables()`.
+*/
+const std::vector<std::string>& Forge::assignments() const
+{
+    return assignments_;
+}
+
 /**
 // Set the Lua module search path in `package.path`.
 //
@@ -391,15 +521,49 @@ void Forge::set_package_path( const std::string& path )
 void Forge::execute( const std::string& filename, const std::string& command )
 {
     error_policy_.push_errors();
+    command_ = command;
     boost::filesystem::path path( root_directory_ / filename );    
+    watcher_->add_buildfile( path.generic_string() );
     scheduler_->load( path );
     int errors = error_policy_.pop_errors();
+    loaded_ = errors == 0;
     if ( errors == 0 )
     {
         scheduler_->command( path, command );
     }
 }
 
+/**
+// Execute *command* without loading *filename* again.
+//
+// Used by the build server to execute commands in a Forge that has already
+// loaded *filename* and its buildfiles for an earlier command.
+//
+// @param filename
+//  The name of the root build script that has already been loaded.
+//
+// @param command
+//  The function to call.
+*/
+void Forge::command( const std::string& filename, const std::string& command )
+{
+    command_ = command;
+    boost::filesystem::path path( root_directory_ / filename );    
+    scheduler_->command( path, command );
+}
+
+/**
+// Get the command being executed.
+//
+// @return
+//  The command being executed or most recently executed or the empty 
+//  string if no command has been executed.
+*/
+const std::string& Forge::command() const
+{
+    return command_;
+}
+
 /**
 // Load and execute *filename* and execute *command*.
 //
@@ -24,6 +24,9 @@ class Context;
 class ForgeEventSink;
 class Reader;
 class Executor;
+class ArtifactCache;
+class Watcher;
+class ChunkCache;
 class Scheduler;
 class System;
 class TargetPrototype;
@@ -46,11 +49,19 @@ class Forge
     Graph* graph_; ///< The dependency graph of targets used to determine which targets are outdated.
     Scheduler* scheduler_; ///< The scheduler that schedules environments to process jobs in the dependency graph.
     Executor* executor_; ///< The executor that schedules threads to process commands.
+    ArtifactCache* artifact_cache_; ///< The cache of files built by executing commands.
+    Watcher* watcher_; ///< The watcher that waits for source files and buildfiles to change.
+    ChunkCache* chunk_cache_; ///< The cache of compiled buildfiles and modules.
     boost::filesystem::path root_directory_; ///< The full path to the root directory.
     boost::filesystem::path initial_directory_; ///< The full path to the initial directory.
     boost::filesystem::path home_directory_; ///< The full path to the user's home directory.
     boost::filesystem::path executable_directory_; ///< The full path to the build executable directory.
     bool stack_trace_enabled_; ///< Print stack traces on error when true.
+    bool memory_statistics_enabled_; ///< Report the memory used by Lua on exit when true.
+    bool reload_requested_; ///< True when buildfiles have changed and need to be reloaded by a new Forge.
+    bool loaded_; ///< True when the root build script and buildfiles have been loaded without errors.
+    std::vector<std::string> assignments_; ///< The variables assigned on the command line.
+    std::string command_; ///< The command being executed or most recently executed.
 
     public:
         Forge( const std::string& initial_directory, error::ErrorPolicy& error_policy, ForgeEventSink* event_sink );
@@ -62,6 +73,9 @@ class Forge
         Graph* graph() const;
         Scheduler* scheduler() const;
         Executor* executor() const;
+        ArtifactCache* artifact_cache() const;
+        Watcher* watcher() const;
+        ChunkCache* chunk_cache() const;
         Context* context() const;
         lua_State* lua_state() const;
 
@@ -78,15 +92,23 @@ class Forge
 
         void set_stack_trace_enabled( bool stack_trace_enabled );
         bool stack_trace_enabled() const;
+        void set_memory_statistics_enabled( bool memory_statistics_enabled );
+        bool memory_statistics_enabled() const;
         void set_maximum_parallel_jobs( int maximum_parallel_jobs );
         int maximum_parallel_jobs() const;
         void set_forge_hooks_library( const std::string& forge_hooks_library );
         const std::string& forge_hooks_library() const;
+        void set_reload_requested( bool reload_requested );
+        bool reload_requested() const;
+        bool loaded() const;
 
         void set_root_directory( const std::string& root_directory );
         void assign_global_variables( const std::vector<std::string>& assignments_and_commands );
+        const std::vector<std::string>& assignments() const;
         void set_package_path( const std::string& path );
         void execute( const std::string& filename, const std::string& command );
+        void command( const std::string& filename, const std::string& command );
+        const std::string& command() const;
         void file( const std::string& filename );
         void script( const std::string& script );
 
@@ -14,20 +14,77 @@
 #include "path_functions.hpp"
 #include "GraphReader.hpp"
 #include "GraphWriter.hpp"
+#include "GraphJournal.hpp"
+#include "GraphEvaluation.hpp"
+#include "GraphSnapshot.hpp"
 #include <assert/assert.hpp>
+#include <boost/filesystem/operations.hpp>
 #include <memory>
 #include <fstream>
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
 using std::list;
+using std::pair;
 using std::vector;
 using std::string;
 using std::unique_ptr;
 using std::transform;
+using std::make_pair;
+using std::unordered_map;
 using namespace sweet;
 using namespace sweet::forge;
 
+/**
+// Is \e character a path separator?
+*/
+static inline bool is_separator( char character )
+{
+#if defined(BUILD_OS_WINDOWS)
+    return character == '/' || character == '\\';
+#else
+    return character == '/';
+#endif
+}
+
+/**
+// Find the next element of a path without allocating.
+//
+// @param position
+//  The position to start searching from; updated to one past the end of the
+//  element found.
+//
+// @param end
+//  The end of the path.
+//
+// @param element_begin
+//  Set to the first character of the element found.
+//
+// @param element_end
+//  Set to one past the last character of the element found.
+//
+// @return
+//  True if an element was found otherwise false if there are no more 
+//  elements in the path.
+*/
+static inline bool next_element( const char** position, const char* end, const char** element_begin, const char** element_end )
+{
+    const char* i = *position;
+    while ( i != end && is_separator(*i) )
+    {
+        ++i;
+    }
+
+    *element_begin = i;
+    while ( i != end && !is_separator(*i) )
+    {
+        ++i;
+    }
+    *element_end = i;
+    *position = i;
+    return *element_begin != *element_end;
+}
+
 /**
 // Constructor.
 */
@@ -41,7 +98,13 @@ Graph::Graph()
   cache_target_( nullptr ),
   traversal_in_progress_( false ),
   visited_revision_( 0 ),
-  successful_revision_( 0 )
+  successful_revision_( 0 ),
+  targets_by_path_(),
+  normalized_path_(),
+  journal_(),
+  racy_timestamp_( 0 ),
+  loaded_timestamp_( 0 ),
+  evaluation_restored_( false )
 {
 }
 
@@ -61,7 +124,13 @@ Graph::Graph( Forge* forge )
   cache_target_(),
   traversal_in_progress_( false ),
   visited_revision_( 0 ),
-  successful_revision_( 0 )
+  successful_revision_( 0 ),
+  targets_by_path_(),
+  normalized_path_(),
+  journal_(),
+  racy_timestamp_( 0 ),
+  loaded_timestamp_( 0 ),
+  evaluation_restored_( false )
 {
     SWEET_ASSERT( forge_ );
     root_target_.reset( new Target("$$root", this) );
@@ -207,6 +276,28 @@ int Graph::successful_revision() const
     return successful_revision_;
 }
 
+/**
+// Get the time after which file writes may be racy.
+//
+// File system timestamps have limited precision so a Target and one of its
+// dependencies written within the same tick of the file system clock have
+// the same timestamp even if the dependency was written after the Target.
+// This can only happen for files written since the build that saved the 
+// loaded Graph started; Targets with exactly the same timestamp as one of
+// their dependencies at or after this time are treated as outdated (see 
+// `Target::bind_to_dependencies()`).  Without a loaded Graph there is no 
+// previous build to have raced with and no writes are treated as racy.
+//
+// @return
+//  The time that the build that saved the loaded Graph started, less a 
+//  second to allow for coarse file system clocks, in nanoseconds since the
+//  epoch or 0 if no Graph was loaded.
+*/
+int64_t Graph::racy_timestamp() const
+{
+    return racy_timestamp_;
+}
+
 /**
 // Create a new toolset prototype.
 //
@@ -303,31 +394,33 @@ Target* Graph::target( const std::string& id )
 */
 Target* Graph::add_or_find_target( const std::string& id, Target* working_directory )
 {
-    boost::filesystem::path path( id );
-    Target* target = working_directory && path.is_relative() ? working_directory : root_target_.get();
-    SWEET_ASSERT( target );
-
-    boost::filesystem::path::const_iterator i = path.begin();
-
-    if ( path.has_root_name() )
+    if ( !normalize_path(id, working_directory, &normalized_path_) )
     {
-        string element = i->generic_string();
-        transform( element.begin(), element.end(), element.begin(), toupper );
-        target = find_or_create_target_by_element( target, element );
-        ++i;
+        return add_or_find_target_by_path( id, working_directory );
     }
 
-    if ( path.is_absolute() )
+    unordered_map<string, Target*>::const_iterator i = targets_by_path_.find( normalized_path_ );
+    if ( i != targets_by_path_.end() )
     {
-        SWEET_ASSERT( i->generic_string() == "/" );
-        ++i;
+        return i->second;
     }
 
-    while ( i != path.end() )
+    Target* target = root_target_.get();
+    SWEET_ASSERT( target );
+    const char* position = normalized_path_.c_str();
+    const char* end = position + normalized_path_.size();
+    const char* element_begin = nullptr;
+    const char* element_end = nullptr;
+    while ( next_element(&position, end, &element_begin, &element_end) )
     {
-        target = find_or_create_target_by_element( target, i->generic_string() );
-        ++i;
+        Target* child_target = target->find_target_by_id( element_begin, element_end - element_begin );
+        if ( !child_target )
+        {
+            child_target = find_or_create_target_by_element( target, string(element_begin, element_end) );
+        }
+        target = child_target;
     }
+    targets_by_path_.insert( make_pair(normalized_path_, target) );
     return target;
 }
 
@@ -350,33 +443,35 @@ Target* Graph::add_or_find_target( const std::string& id, Target* working_direct
 */
 Target* Graph::find_target( const std::string& id, Target* working_directory )
 {
-    Target* target = NULL;
-    if ( !id.empty() )
+    if ( id.empty() )
     {
-        boost::filesystem::path path( id );
-        target = working_directory && path.is_relative() ? working_directory : root_target_.get();
-        boost::filesystem::path::const_iterator i = path.begin();
-        SWEET_ASSERT( target );
+        return NULL;
+    }
 
-        if ( path.has_root_name() )
-        {
-            string element = i->generic_string();
-            transform( element.begin(), element.end(), element.begin(), toupper );
-            target = find_or_create_target_by_element( target, element );
-            ++i;
-        }
+    if ( !normalize_path(id, working_directory, &normalized_path_) )
+    {
+        return find_target_by_path( id, working_directory );
+    }
 
-        if ( path.is_absolute() )
-        {
-            SWEET_ASSERT( i->generic_string() == "/" );
-            ++i;
-        }
+    unordered_map<string, Target*>::const_iterator i = targets_by_path_.find( normalized_path_ );
+    if ( i != targets_by_path_.end() )
+    {
+        return i->second;
+    }
 
-        while ( i != path.end() && target )
-        {
-            target = find_target_by_element( target, i->generic_string() );
-            ++i;
-        }    
+    Target* target = root_target_.get();
+    SWEET_ASSERT( target );
+    const char* position = normalized_path_.c_str();
+    const char* end = position + normalized_path_.size();
+    const char* element_begin = nullptr;
+    const char* element_end = nullptr;
+    while ( target && next_element(&position, end, &element_begin, &element_end) )
+    {
+        target = target->find_target_by_id( element_begin, element_end - element_begin );
+    }
+    if ( target )
+    {
+        targets_by_path_.insert( make_pair(normalized_path_, target) );
     }
     return target;
 }
@@ -458,12 +553,200 @@ Target* Graph::find_or_create_target_by_element( Target* target, const std::stri
     return found_target;
 }
 
+/**
+// Normalize \e id into an absolute path that can be used to look up Targets.
+//
+// The normalized path has a '/' before each element, '.' elements and 
+// empty elements removed, '..' elements applied lexically, and, on Windows,
+// the drive forced to uppercase.  Relative identifiers are made absolute by
+// prepending the path of \e working_directory.
+//
+// Identifiers that can't be normalized this way (network paths and, on 
+// Windows, drive relative paths) or that step above the root Target return
+// false and are left to `Graph::add_or_find_target_by_path()` and 
+// `Graph::find_target_by_path()`.
+//
+// @param id
+//  The identifier to normalize.
+//
+// @param working_directory
+//  The Target that the identifier is relative to or null if the identifier
+//  is relative to the root Target.
+//
+// @param normalized_path
+//  The string to write the normalized path to (assumed not null).
+//
+// @return
+//  True if \e id was normalized otherwise false.
+*/
+bool Graph::normalize_path( const std::string& id, Target* working_directory, std::string* normalized_path ) const
+{
+    SWEET_ASSERT( normalized_path );
+
+    const char* position = id.c_str();
+    const char* end = position + id.size();
+    if ( id.size() >= 2 && is_separator(position[0]) && is_separator(position[1]) )
+    {
+        return false;
+    }
+
+    normalized_path->clear();
+
+#if defined(BUILD_OS_WINDOWS)
+    bool has_drive = id.size() >= 2 && position[1] == ':';
+    bool absolute = has_drive && id.size() >= 3 && is_separator( position[2] );
+    if ( (has_drive && !absolute) || (!has_drive && !id.empty() && is_separator(position[0])) )
+    {
+        return false;
+    }
+    if ( absolute )
+    {
+        normalized_path->push_back( char(toupper(position[0])) );
+        normalized_path->push_back( ':' );
+        position += 2;
+    }
+#else
+    bool absolute = !id.empty() && is_separator( position[0] );
+#endif
+
+    if ( !absolute && working_directory && working_directory != root_target_.get() )
+    {
+        normalized_path->append( working_directory->path() );
+    }
+
+    const char* element_begin = nullptr;
+    const char* element_end = nullptr;
+    while ( next_element(&position, end, &element_begin, &element_end) )
+    {
+        size_t length = element_end - element_begin;
+        if ( length == 1 && element_begin[0] == '.' )
+        {
+            continue;
+        }
+        else if ( length == 2 && element_begin[0] == '.' && element_begin[1] == '.' )
+        {
+            size_t separator = normalized_path->find_last_of( '/' );
+            if ( normalized_path->empty() || separator == string::npos )
+            {
+                return false;
+            }
+            normalized_path->erase( separator );
+        }
+        else
+        {
+            normalized_path->push_back( '/' );
+            normalized_path->append( element_begin, length );
+        }
+    }
+    return true;
+}
+
+/**
+// Add or find a Target by iterating over the elements of \e id as a
+// `boost::filesystem::path`.
+//
+// This is the general case for `Graph::add_or_find_target()` used for 
+// identifiers that `Graph::normalize_path()` doesn't handle.
+//
+// @param id
+//  The identifier of the Target to find or create.
+//
+// @param working_directory
+//  The Target that the identifier is relative to or null if the identifier
+//  is relative to the root Target.
+//
+// @return
+//  The Target.
+*/
+Target* Graph::add_or_find_target_by_path( const std::string& id, Target* working_directory )
+{
+    boost::filesystem::path path( id );
+    Target* target = working_directory && path.is_relative() ? working_directory : root_target_.get();
+    SWEET_ASSERT( target );
+
+    boost::filesystem::path::const_iterator i = path.begin();
+
+    if ( path.has_root_name() )
+    {
+        string element = i->generic_string();
+        transform( element.begin(), element.end(), element.begin(), toupper );
+        target = find_or_create_target_by_element( target, element );
+        ++i;
+    }
+
+    if ( path.is_absolute() )
+    {
+        SWEET_ASSERT( i->generic_string() == "/" );
+        ++i;
+    }
+
+    while ( i != path.end() )
+    {
+        target = find_or_create_target_by_element( target, i->generic_string() );
+        ++i;
+    }
+    return target;
+}
+
+/**
+// Find a Target by iterating over the elements of \e id as a 
+// `boost::filesystem::path`.
+//
+// This is the general case for `Graph::find_target()` used for identifiers
+// that `Graph::normalize_path()` doesn't handle.
+//
+// @param id
+//  The id of the Target to find.
+//
+// @param working_directory
+//  The Target that the identifier is relative to or null if the identifier
+//  is relative to the root Target.
+//
+// @return
+//  The Target or null if no matching Target was found.
+*/
+Target* Graph::find_target_by_path( const std::string& id, Target* working_directory )
+{
+    Target* target = NULL;
+    if ( !id.empty() )
+    {
+        boost::filesystem::path path( id );
+        target = working_directory && path.is_relative() ? working_directory : root_target_.get();
+        boost::filesystem::path::const_iterator i = path.begin();
+        SWEET_ASSERT( target );
+
+        if ( path.has_root_name() )
+        {
+            string element = i->generic_string();
+            transform( element.begin(), element.end(), element.begin(), toupper );
+            target = find_or_create_target_by_element( target, element );
+            ++i;
+        }
+
+        if ( path.is_absolute() )
+        {
+            SWEET_ASSERT( i->generic_string() == "/" );
+            ++i;
+        }
+
+        while ( i != path.end() && target )
+        {
+            target = find_target_by_element( target, i->generic_string() );
+            ++i;
+        }    
+    }
+    return target;
+}
+
 /**
 // Load a buildfile into this Graph.
 //
 // @param filename
 //  The name of the buildfile to load.
 //
+// Buildfiles aren't executed when evaluated buildfiles have been restored
+// from a snapshot (see `Graph::restore_evaluation()`).
+//
 // @return 
 //  The number of errors that occured while loading and executing the 
 //  buildfile or -1 if the buildfile yields (0 indicates successful
@@ -473,6 +756,10 @@ int Graph::buildfile( const std::string& filename )
 {
     SWEET_ASSERT( forge_ );
     SWEET_ASSERT( root_target_ );     
+    if ( evaluation_restored_ )
+    {
+        return 0;
+    }
     boost::filesystem::path path( forge_->absolute(filename) );
     SWEET_ASSERT( path.is_absolute() );   
     Target* buildfile_target = Graph::target( path.generic_string() );
@@ -484,34 +771,15 @@ int Graph::buildfile( const std::string& filename )
     return forge_->scheduler()->buildfile( path );
 }
 
-struct ScopedVisit
-{
-    Target* target_;
-
-    ScopedVisit( Target* target )
-    : target_( target )
-    {
-        SWEET_ASSERT( target_ );
-        SWEET_ASSERT( target_->visiting() == false );
-        target_->set_visited( true );
-        target_->set_visiting( true );
-    }
-
-    ~ScopedVisit()
-    {
-        SWEET_ASSERT( target_ );
-        SWEET_ASSERT( target_->visiting() == true );
-        target_->set_visiting( false );
-    }
-};
-
 struct Bind
 {
     Forge* forge_;
+    GraphSnapshot snapshot_;
     int failures_;
     
     Bind( Forge* forge )
     : forge_( forge ),
+      snapshot_( forge->graph() ),
       failures_( 0 )
     {
         SWEET_ASSERT( forge_ );
@@ -527,31 +795,19 @@ struct Bind
     {
         SWEET_ASSERT( target );
 
-        if ( !target->visited() )
-        {
-            ScopedVisit visit( target );
-
-            int i = 0;
-            Target* dependency = target->any_dependency( i );
-            while ( dependency )
-            {
-                if ( !dependency->visiting() )
-                {
-                    Bind::visit( dependency );
-                }
-                else
-                {
-                    forge_->errorf( "Cyclic dependency from %s to %s in bind", target->error_identifier().c_str(), dependency->error_identifier().c_str() );
-                    dependency->set_successful( true );
-                    ++failures_;
-                }
-                ++i;
-                dependency = target->any_dependency( i );
-            }
+        snapshot_.build( target );
 
-            target->bind();
-            target->set_successful( true );
+        const vector<pair<Target*, Target*>>& cyclic_dependencies = snapshot_.cyclic_dependencies();
+        for ( vector<pair<Target*, Target*>>::const_iterator i = cyclic_dependencies.begin(); i != cyclic_dependencies.end(); ++i )
+        {
+            Target* target = i->first;
+            Target* dependency = i->second;
+            forge_->errorf( "Cyclic dependency from %s to %s in bind", target->error_identifier().c_str(), dependency->error_identifier().c_str() );
+            dependency->set_successful( true );
+            ++failures_;
         }
+
+        snapshot_.bind();
     }
 };
 
@@ -582,6 +838,89 @@ int Graph::bind( Target* target )
     return bind.failures_;
 }
 
+/**
+// Unbind all of the Targets in this Graph.
+//
+// Targets stay bound after a traversal so this is needed before building
+// again in the same Forge, e.g. from *watch*, for Targets to see files that
+// have changed or been built since they were last bound.  Only the files
+// invalidated in the System's cache are stat'd again by the next bind.
+*/
+void Graph::unbind()
+{
+    struct RecursiveUnbind
+    {
+        static void unbind( Target* target )
+        {
+            SWEET_ASSERT( target );
+            target->unbind();
+
+            const vector<Target*>& targets = target->targets();
+            for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+            {
+                RecursiveUnbind::unbind( *i );
+            }
+        }
+    };
+
+    RecursiveUnbind::unbind( root_target_.get() );
+}
+
+/**
+// Find the Targets affected by changes to \e filenames.
+//
+// The Targets bound to each file are found by identifier and then the 
+// Targets that depend on them, directly or indirectly, are found by 
+// following reverse dependencies (see `Target::dependents()`).  Only the 
+// Targets that are affected are visited rather than the whole Graph.
+//
+// Filenames that don't identify a Target in this Graph are ignored.
+//
+// @param filenames
+//  The names of the changed files.
+//
+// @param working_directory
+//  The Target that relative filenames are relative to or null if they are
+//  relative to the root Target.
+//
+// @param targets
+//  A vector to receive the affected Targets, in breadth first order from 
+//  the Targets bound to \e filenames, starting with those Targets 
+//  (assumed not null).
+*/
+void Graph::affected_targets( const std::vector<std::string>& filenames, Target* working_directory, std::vector<Target*>* targets )
+{
+    SWEET_ASSERT( targets );
+    SWEET_ASSERT( !traversal_in_progress_ );
+
+    begin_traversal();
+    size_t start = targets->size();
+    for ( vector<string>::const_iterator filename = filenames.begin(); filename != filenames.end(); ++filename )
+    {
+        Target* target = find_target( *filename, working_directory );
+        if ( target && !target->visited() )
+        {
+            target->set_visited( true );
+            targets->push_back( target );
+        }
+    }
+
+    for ( size_t i = start; i < targets->size(); ++i )
+    {
+        const std::unordered_set<Target*>& dependents = (*targets)[i]->dependents();
+        for ( std::unordered_set<Target*>::const_iterator j = dependents.begin(); j != dependents.end(); ++j )
+        {
+            Target* dependent = *j;
+            if ( !dependent->visited() )
+            {
+                dependent->set_visited( true );
+                targets->push_back( dependent );
+            }
+        }
+    }
+    end_traversal();
+}
+
 /**
 // Swap this Graph with \e graph.
 //
@@ -591,6 +930,8 @@ int Graph::bind( Target* target )
 void Graph::swap( Graph& graph )
 {
     std::swap( root_target_, graph.root_target_ );
+    targets_by_path_.clear();
+    graph.targets_by_path_.clear();
 }
 
 /**
@@ -631,7 +972,9 @@ void Graph::clear()
         }
     };
 
+    targets_by_path_.clear();
     RecursiveClear::clear( root_target_.get() );
+    evaluation_restored_ = false;
 }
 
 /**
@@ -653,6 +996,12 @@ void Graph::recover()
 /**
 // Load this Graph from a binary file.
 //
+// Any journal left next to the file by a build that was interrupted before
+// the Graph was saved is replayed after the file is loaded so that Targets
+// completed by that build aren't built again (see `Graph::checkpoint()`).
+// The journal is replayed even if the file itself doesn't exist or can't 
+// be loaded.
+//
 // @param filename
 //  The name of the file to load this Graph from.
 //
@@ -666,28 +1015,47 @@ Target* Graph::load_binary( const std::string& filename )
     SWEET_ASSERT( boost::filesystem::path(filename).is_absolute() );
     SWEET_ASSERT( forge_ );
     
+    journal_.reset();
     filename_ = filename;
     cache_target_ = NULL;
+    evaluation_restored_ = false;
+    racy_timestamp_ = 0;
+    loaded_timestamp_ = forge_->system()->now() - 1000000000LL;
 
+    bool loaded = false;
     if ( forge_->system()->exists(filename) )
     {
-        std::ifstream ifstream( filename, std::ios::binary );
-        GraphReader graph_reader( &ifstream, &forge_->error_policy() );
+        GraphReader graph_reader( &forge_->error_policy() );
         unique_ptr<Target> root_target = graph_reader.read( filename );
         if ( root_target )
         {
+            targets_by_path_.clear();
             root_target_.swap( root_target );
-            recover();
-            return cache_target_;
+            racy_timestamp_ = graph_reader.racy_timestamp();
+            loaded = true;
         }
     }
     
     recover();
-    return nullptr;
+
+    if ( forge_->system()->exists(journal_filename()) )
+    {
+        GraphJournal journal( &forge_->error_policy() );
+        journal.replay( journal_filename(), this );
+    }
+
+    return loaded ? cache_target_ : nullptr;
 }
 
 /**
 // Save this Graph to a binary file.
+//
+// The Graph is written to a temporary file that then replaces the file 
+// that this Graph was loaded from so that the saved Graph is never left 
+// partially written.  The journal is removed before the temporary file
+// replaces the previously saved Graph; a build interrupted between the two
+// starts from the previously saved Graph without the journal and rebuilds
+// rather than replaying entries onto a Graph that already contains them.
 */
 void Graph::save_binary()
 {
@@ -695,9 +1063,38 @@ void Graph::save_binary()
 
     if ( !filename_.empty() )
     {
-        std::ofstream ofstream( filename_, std::ios::binary );
-        GraphWriter graph_writer( &ofstream );
-        graph_writer.write( root_target_.get() );
+        string temporary_filename = filename_ + ".tmp";
+        bool written = false;
+        {
+            std::ofstream ofstream( temporary_filename, std::ios::binary | std::ios::trunc );
+            GraphWriter graph_writer( &ofstream );
+            graph_writer.write( root_target_.get(), loaded_timestamp_ );
+            ofstream.close();
+            written = !ofstream.fail();
+        }
+
+        if ( !written )
+        {
+            boost::system::error_code error;
+            boost::filesystem::remove( temporary_filename, error );
+            forge_->errorf( "Writing the dependency graph to '%s' failed", temporary_filename.c_str() );
+            return;
+        }
+
+        journal_.reset();
+        boost::system::error_code error;
+        boost::filesystem::remove( journal_filename(), error );
+        boost::filesystem::rename( temporary_filename, filename_, error );
+        if ( error )
+        {
+            forge_->errorf( "Replacing the dependency graph '%s' failed - %s", filename_.c_str(), error.message().c_str() );
+        }
+        forge_->system()->invalidate( journal_filename() );
+        forge_->system()->invalidate( filename_ );
+
+        // Builds that follow in the same run, e.g. in watch mode, start 
+        // after this save.
+        loaded_timestamp_ = forge_->system()->now() - 1000000000LL;
     }
     else
     {
@@ -706,42 +1103,208 @@ void Graph::save_binary()
 }
 
 /**
-// Print the dependency graph of Targets in this Graph.
+// Restore evaluated buildfiles from the snapshot next to the file that this
+// Graph was loaded from.
+//
+// The explicit and ordering dependencies, cleanable flags, and hashes that
+// buildfiles set are restored if nothing that evaluating the buildfiles 
+// depended on has changed since the snapshot was saved (see
+// `GraphEvaluation::restore()`).  Calls to `Graph::buildfile()` then return
+// without executing buildfiles.
+//
+// @return
+//  True if evaluated buildfiles were restored otherwise false.
+*/
+bool Graph::restore_evaluation()
+{
+    SWEET_ASSERT( forge_ );
+    if ( !filename_.empty() && !evaluation_restored_ )
+    {
+        GraphEvaluation evaluation( forge_ );
+        evaluation_restored_ = evaluation.restore( evaluation_filename(), this );
+    }
+    return evaluation_restored_;
+}
+
+/**
+// Save a snapshot of evaluated buildfiles next to the file that this Graph
+// was loaded from.
+//
+// Nothing is saved when evaluated buildfiles were restored as the snapshot
+// that they were restored from is still valid.
+//
+// @return
+//  True if the snapshot was saved otherwise false.
+*/
+bool Graph::save_evaluation()
+{
+    SWEET_ASSERT( forge_ );
+    if ( filename_.empty() || evaluation_restored_ )
+    {
+        return false;
+    }
+    GraphEvaluation evaluation( forge_ );
+    bool saved = evaluation.save( evaluation_filename(), this );
+    forge_->system()->invalidate( evaluation_filename() );
+    return saved;
+}
+
+/**
+// Remove the snapshot of evaluated buildfiles next to the file that this 
+// Graph was loaded from so that buildfiles are executed by the next run.
+*/
+void Graph::remove_evaluation()
+{
+    if ( !filename_.empty() )
+    {
+        boost::system::error_code error;
+        boost::filesystem::remove( evaluation_filename(), error );
+        forge_->system()->invalidate( evaluation_filename() );
+    }
+}
+
+/**
+// Have evaluated buildfiles been restored from a snapshot?
+//
+// @return
+//  True if evaluated buildfiles were restored otherwise false.
+*/
+bool Graph::evaluation_restored() const
+{
+    return evaluation_restored_;
+}
+
+/**
+// Bind \e target and check that neither it nor any of the Targets that it
+// depends on, directly or indirectly, are outdated.
 //
 // @param target
-//  The Target to begin printing from or null to print from the root Target of
-//  this Graph.
+//  The Target to check or null to check from the root of this Graph.
 //
-// @param directory
-//  The path to display filenames relative to.
+// @return
+//  True if \e target and its dependencies bound and are up to date 
+//  otherwise false.
 */
-void Graph::print_dependencies( Target* target, const std::string& directory )
+bool Graph::up_to_date( Target* target )
 {
-    struct ScopedVisit
+    SWEET_ASSERT( !target || target->graph() == this );
+
+    if ( traversal_in_progress_ || bind(target) > 0 )
+    {
+        return false;
+    }
+
+    bool up_to_date = true;
+    vector<Target*> targets;
+    begin_traversal();
+    targets.push_back( target ? target : root_target_.get() );
+    targets.back()->set_visited( true );
+    while ( up_to_date && !targets.empty() )
     {
-        Target* target_;
+        Target* target = targets.back();
+        targets.pop_back();
+        up_to_date = !target->outdated();
 
-        ScopedVisit( Target* target )
-        : target_( target )
+        int i = 0;
+        Target* dependency = target->any_dependency( i );
+        while ( dependency )
         {
-            SWEET_ASSERT( target_ );
-            SWEET_ASSERT( target_->visiting() == false );
-            target_->set_visiting( true );
+            if ( !dependency->visited() )
+            {
+                dependency->set_visited( true );
+                targets.push_back( dependency );
+            }
+            ++i;
+            dependency = target->any_dependency( i );
         }
+    }
+    end_traversal();
+    return up_to_date;
+}
 
-        ~ScopedVisit()
+/**
+// Checkpoint the state of \e target to the journal next to the file that
+// this Graph was loaded from.
+//
+// Called as each Target's job in a postorder traversal completes so that 
+// the built flag, hash, and implicit dependencies of Targets that have been
+// built survive an interrupted build (see `Graph::load_binary()`).  Only 
+// Targets that were outdated are checkpointed as other Targets aren't 
+// changed by building them.  Anonymous Targets aren't checkpointed as they
+// can't be found again by path.
+//
+// The journal is opened the first time that a Target is checkpointed; 
+// checkpoints are ignored if this Graph hasn't been loaded or the journal 
+// couldn't be opened.
+//
+// @param target
+//  The Target to checkpoint (assumed not null).
+*/
+void Graph::checkpoint( Target* target )
+{
+    SWEET_ASSERT( target );
+    SWEET_ASSERT( forge_ );
+
+    if ( !filename_.empty() && target->outdated() && !target->anonymous() )
+    {
+        if ( !journal_ )
         {
-            SWEET_ASSERT( target_->visiting() );
-            target_->set_visiting( false );
+            journal_.reset( new GraphJournal(&forge_->error_policy()) );
+            journal_->open( journal_filename() );
+            forge_->system()->invalidate( journal_filename() );
         }
-    };
+        journal_->write( target );
+    }
+}
+
+/**
+// Get the name of the journal that Targets are checkpointed to.
+//
+// @return
+//  The name of the file that this Graph was loaded from with ".journal"
+//  appended.
+*/
+std::string Graph::journal_filename() const
+{
+    return filename_ + ".journal";
+}
+
+/**
+// Get the name of the snapshot of evaluated buildfiles.
+//
+// @return
+//  The name of the file that this Graph was loaded from with ".evaluation"
+//  appended.
+*/
+std::string Graph::evaluation_filename() const
+{
+    return filename_ + ".evaluation";
+}
 
+/**
+// Print the dependency graph of Targets in this Graph.
+//
+// @param target
+//  The Target to begin printing from or null to print from the root Target of
+//  this Graph.
+//
+// @param directory
+//  The path to display filenames relative to.
+*/
+void Graph::print_dependencies( Target* target, const std::string& directory )
+{
     struct RecursivePrinter
     {
         Graph* graph_;
+        GraphSnapshot snapshot_;
+        vector<char> visiting_;
+        vector<char> visited_;
         
         RecursivePrinter( Graph* graph )
-        : graph_( graph )
+        : graph_( graph ),
+          snapshot_( graph ),
+          visiting_(),
+          visited_()
         {
             SWEET_ASSERT( graph_ );
             graph_->begin_traversal();
@@ -790,7 +1353,7 @@ void Graph::print_dependencies( Target* target, const std::string& directory )
                 printf( "%s ", target->prototype()->id().c_str() );
             }
 
-            std::time_t timestamp = target->timestamp();
+            std::time_t timestamp = std::time_t(target->timestamp() / 1000000000LL);
             struct tm* time = ::localtime( &timestamp );
             printf( "'%s' %c%c%c%c%c%c %04d-%02d-%02d %02d:%02d:%02d %" PRIx64 " %s", 
                 id(target),
@@ -812,7 +1375,7 @@ void Graph::print_dependencies( Target* target, const std::string& directory )
 
             if ( !target->filenames().empty() )
             {
-                timestamp = target->last_write_time();
+                timestamp = std::time_t(target->last_write_time() / 1000000000LL);
                 time = ::localtime( &timestamp );
                 printf( "%04d-%02d-%02d %02d:%02d:%02d", 
                     time->tm_year + 1900, 
@@ -833,47 +1396,54 @@ void Graph::print_dependencies( Target* target, const std::string& directory )
             }
         }
 
-        void print_recursively( Target* target, const boost::filesystem::path& directory, int level )
+        void print( Target* target, const boost::filesystem::path& directory )
+        {
+            SWEET_ASSERT( target );
+            snapshot_.build( target );
+            visiting_.assign( snapshot_.size(), false );
+            visited_.assign( snapshot_.size(), false );
+            print_recursively( snapshot_.size() - 1, directory, 0 );
+        }
+
+        void print_recursively( int index, const boost::filesystem::path& directory, int level )
         {
-            ScopedVisit visit( target );
+            SWEET_ASSERT( !visiting_[index] );
+            visiting_[index] = true;
+            Target* target = snapshot_.target( index );
             print( target, directory, level, false );
-            if ( !target->visited() )
+            if ( !visited_[index] )
             {
-                target->set_visited( true );            
-            
-                int i = 0;
-                Target* dependency = target->binding_dependency( i );
-                while ( dependency )
+                visited_[index] = true;
+
+                const int* binding_dependencies_end = snapshot_.binding_dependencies_end( index );
+                for ( const int* i = snapshot_.dependencies_begin(index); i != binding_dependencies_end; ++i )
                 {
-                    if ( !dependency->visiting() )
+                    if ( !visiting_[*i] )
                     {
-                        print_recursively( dependency, directory, level + 1 );
+                        print_recursively( *i, directory, level + 1 );
                     }
                     else
                     {
+                        Target* dependency = snapshot_.target( *i );
                         Forge* forge = target->graph()->forge();
                         SWEET_ASSERT( forge );
                         forge->outputf( "Ignoring cyclic dependency from '%s' to '%s' while printing dependencies", target->id().c_str(), dependency->id().c_str() );
                     }
-                    ++i;
-                    dependency = target->binding_dependency( i );
                 }
 
-                i = 0;
-                dependency = target->ordering_dependency( i );
-                while ( dependency )
+                const int* dependencies_end = snapshot_.dependencies_end( index );
+                for ( const int* i = binding_dependencies_end; i != dependencies_end; ++i )
                 {
-                    print( dependency, directory, level + 1, true );
-                    ++i;
-                    dependency = target->ordering_dependency( i );
+                    print( snapshot_.target(*i), directory, level + 1, true );
                 }
             }
+            visiting_[index] = false;
         }
     };
 
     bind( target );
     RecursivePrinter recursive_printer( this );
-    recursive_printer.print_recursively( target ? target : root_target_.get(), boost::filesystem::path(directory), 0 );
+    recursive_printer.print( target ? target : root_target_.get(), boost::filesystem::path(directory) );
     printf( "\n\n" );
 }
 
@@ -5,6 +5,8 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <unordered_map>
+#include <stdint.h>
 
 namespace sweet
 {
@@ -18,6 +20,7 @@ class TargetPrototype;
 class Toolset;
 class Target;
 class Forge;
+class GraphJournal;
 
 /**
 // A dependency graph.
@@ -34,6 +37,12 @@ class Graph
     bool traversal_in_progress_; ///< True when a traversal is in progress otherwise false.
     int visited_revision_; ///< The current visit revision.
     int successful_revision_; ///< The current success revision.
+    std::unordered_map<std::string, Target*> targets_by_path_; ///< Targets that have been added or found by normalized absolute path.
+    std::string normalized_path_; ///< Buffer reused to normalize identifiers when adding and finding Targets.
+    std::unique_ptr<GraphJournal> journal_; ///< The journal that completed Targets are checkpointed to or null if it hasn't been opened yet.
+    int64_t racy_timestamp_; ///< The time that the build that saved the loaded Graph started.
+    int64_t loaded_timestamp_; ///< The time that this Graph was loaded.
+    bool evaluation_restored_; ///< True when evaluated buildfiles have been restored from a snapshot so buildfiles aren't executed.
 
     public:
         Graph();
@@ -50,6 +59,7 @@ class Graph
         bool traversal_in_progress() const;
         int visited_revision() const;
         int successful_revision() const;             
+        int64_t racy_timestamp() const;
 
         ToolsetPrototype* add_toolset_prototype( const std::string& id );
         TargetPrototype* add_target_prototype( const std::string& id );
@@ -62,13 +72,28 @@ class Graph
                 
         int buildfile( const std::string& filename );
         int bind( Target* target = NULL );        
+        void unbind();
+        void affected_targets( const std::vector<std::string>& filenames, Target* working_directory, std::vector<Target*>* targets );
         void swap( Graph& graph );
         void clear();
         void recover();
         Target* load_binary( const std::string& filename );
         void save_binary();
+        bool restore_evaluation();
+        bool save_evaluation();
+        void remove_evaluation();
+        bool evaluation_restored() const;
+        bool up_to_date( Target* target = nullptr );
+        void checkpoint( Target* target );
         void print_dependencies( Target* target, const std::string& directory );
         void print_namespace( Target* target );
+
+    private:
+        std::string journal_filename() const;
+        std::string evaluation_filename() const;
+        bool normalize_path( const std::string& id, Target* working_directory, std::string* normalized_path ) const;
+        Target* add_or_find_target_by_path( const std::string& id, Target* working_directory );
+        Target* find_target_by_path( const std::string& id, Target* working_directory );
 };
 
 }
@@ -0,0 +1,468 @@
+//
+// GraphEvaluation.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "GraphEvaluation.hpp"
+#include "GraphFormat.hpp"
+#include "Graph.hpp"
+#include "Target.hpp"
+#include "Forge.hpp"
+#include "System.hpp"
+#include "ChunkCache.hpp"
+#include "Hasher.hpp"
+#include <assert/assert.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <unordered_set>
+#include <stdio.h>
+#include <string.h>
+
+using std::map;
+using std::pair;
+using std::make_pair;
+using std::vector;
+using std::string;
+using std::ifstream;
+using std::ofstream;
+using std::istreambuf_iterator;
+using namespace sweet;
+using namespace sweet::forge;
+
+/**
+// The explicit and ordering dependencies, cleanable flag, and hash of a
+// Target read from a snapshot before they're applied to the Graph.
+*/
+struct EvaluatedTarget
+{
+    uint64_t index; ///< The index of the Target's path.
+    bool cleanable; ///< Whether or not the Target is cleanable.
+    uint64_t hash; ///< The hash set for the Target.
+    vector<uint64_t> explicit_dependencies; ///< The indices of the Target's explicit dependencies.
+    vector<uint64_t> ordering_dependencies; ///< The indices of the Target's ordering dependencies.
+};
+
+/**
+// Constructor.
+//
+// @param forge
+//  The Forge that this GraphEvaluation is part of (assumed not null).
+*/
+GraphEvaluation::GraphEvaluation( Forge* forge )
+: forge_( forge ),
+  payload_(),
+  indices_(),
+  paths_(),
+  position_( nullptr ),
+  end_( nullptr )
+{
+    SWEET_ASSERT( forge_ );
+}
+
+/**
+// Save a snapshot of the evaluated buildfiles in \e graph to \e filename.
+//
+// Only Targets that have explicit or ordering dependencies, are cleanable,
+// or have a hash set are recorded along with the Targets that they depend
+// on.  The snapshot is written to a temporary file that then replaces
+// \e filename so that a partially written snapshot is never restored.
+//
+// @param filename
+//  The name of the file to save the snapshot to.
+//
+// @param graph
+//  The Graph to save a snapshot of (assumed not null).
+//
+// @return
+//  True if the snapshot was saved otherwise false.
+*/
+bool GraphEvaluation::save( const std::string& filename, Graph* graph )
+{
+    SWEET_ASSERT( graph );
+
+    payload_.clear();
+    indices_.clear();
+    paths_.clear();
+
+    uint64_t records = 0;
+    vector<Target*> remaining( graph->root_target()->targets() );
+    while ( !remaining.empty() )
+    {
+        Target* target = remaining.back();
+        remaining.pop_back();
+        size_t size = payload_.size();
+        target->write( *this );
+        records += payload_.size() != size ? 1 : 0;
+        remaining.insert( remaining.end(), target->targets().begin(), target->targets().end() );
+    }
+    string targets;
+    payload_.swap( targets );
+
+    vector<pair<string, int64_t>> inputs;
+    GraphEvaluation::inputs( graph, &inputs );
+    value( uint64_t(inputs.size()) );
+    for ( vector<pair<string, int64_t>>::const_iterator input = inputs.begin(); input != inputs.end(); ++input )
+    {
+        value( input->first );
+        value( uint64_t(input->second) );
+    }
+    value( records );
+    payload_.append( targets );
+    value( uint64_t(paths_.size()) );
+    for ( vector<string>::const_iterator path = paths_.begin(); path != paths_.end(); ++path )
+    {
+        value( *path );
+    }
+
+    GraphEvaluationHeader header;
+    memset( &header, 0, sizeof(header) );
+    strncpy( header.format, GRAPH_EVALUATION_FORMAT, sizeof(header.format) );
+    header.version = GRAPH_VERSION;
+    header.key = key();
+    header.size = payload_.size();
+    header.checksum = Hasher::hash( payload_.data(), payload_.size() );
+
+    string temporary_filename = filename + ".tmp";
+    bool written = false;
+    {
+        ofstream ofstream( temporary_filename, std::ios::binary | std::ios::trunc );
+        ofstream.write( reinterpret_cast<const char*>(&header), sizeof(header) );
+        ofstream.write( payload_.data(), payload_.size() );
+        ofstream.close();
+        written = !ofstream.fail();
+    }
+    string().swap( payload_ );
+    indices_.clear();
+    paths_.clear();
+
+    boost::system::error_code error;
+    if ( written )
+    {
+        boost::filesystem::rename( temporary_filename, filename, error );
+    }
+    if ( !written || error )
+    {
+        boost::filesystem::remove( temporary_filename, error );
+        boost::filesystem::remove( filename, error );
+        return false;
+    }
+    return true;
+}
+
+/**
+// Restore the snapshot in \e filename onto \e graph.
+//
+// The snapshot is only restored if it is from the same version, was taken
+// with the same variables assigned on the command line, all of the files
+// and directories that it depends on have the same last write times, and
+// it depends on every Lua file loaded so far, e.g. the root build script
+// and modules.  Otherwise \e graph is left unchanged.
+//
+// @param filename
+//  The name of the file to restore the snapshot from.
+//
+// @param graph
+//  The Graph to restore the snapshot onto (assumed not null).
+//
+// @return
+//  True if the snapshot was restored otherwise false.
+*/
+bool GraphEvaluation::restore( const std::string& filename, Graph* graph )
+{
+    SWEET_ASSERT( graph );
+
+    string data;
+    {
+        ifstream ifstream( filename, std::ios::binary );
+        if ( !ifstream.is_open() )
+        {
+            return false;
+        }
+        data.assign( istreambuf_iterator<char>(ifstream), istreambuf_iterator<char>() );
+    }
+
+    GraphEvaluationHeader header;
+    if ( data.size() < sizeof(header) )
+    {
+        return false;
+    }
+    memcpy( &header, data.data(), sizeof(header) );
+    const char* payload = data.data() + sizeof(header);
+    bool valid =
+        strncmp( header.format, GRAPH_EVALUATION_FORMAT, sizeof(header.format) ) == 0 &&
+        header.version == GRAPH_VERSION &&
+        header.key == key() &&
+        header.size == data.size() - sizeof(header) &&
+        header.checksum == Hasher::hash( payload, size_t(header.size) )
+    ;
+    if ( !valid )
+    {
+        return false;
+    }
+
+    position_ = payload;
+    end_ = payload + header.size;
+
+    uint64_t size = 0;
+    valid = value( &size ) && size <= uint64_t(end_ - position_);
+    std::unordered_set<string> inputs;
+    for ( uint64_t i = 0; valid && i < size; ++i )
+    {
+        string path;
+        uint64_t last_write_time = 0;
+        valid = value( &path ) && value( &last_write_time ) && int64_t(last_write_time) == GraphEvaluation::last_write_time( path );
+        inputs.insert( path );
+    }
+
+    const std::unordered_set<string>& filenames = forge_->chunk_cache()->filenames();
+    for ( std::unordered_set<string>::const_iterator i = filenames.begin(); valid && i != filenames.end(); ++i )
+    {
+        valid = inputs.count( *i ) != 0;
+    }
+
+    vector<EvaluatedTarget> targets;
+    valid = valid && value( &size ) && size <= uint64_t(end_ - position_);
+    if ( valid )
+    {
+        targets.resize( size_t(size) );
+    }
+    for ( vector<EvaluatedTarget>::iterator target = targets.begin(); valid && target != targets.end(); ++target )
+    {
+        uint64_t cleanable = 0;
+        valid = value( &target->index ) && value( &cleanable ) && value( &target->hash ) && value( &size ) && size <= uint64_t(end_ - position_);
+        target->cleanable = cleanable != 0;
+        target->explicit_dependencies.resize( valid ? size_t(size) : 0 );
+        for ( vector<uint64_t>::iterator i = target->explicit_dependencies.begin(); valid && i != target->explicit_dependencies.end(); ++i )
+        {
+            valid = value( &(*i) );
+        }
+        valid = valid && value( &size ) && size <= uint64_t(end_ - position_);
+        target->ordering_dependencies.resize( valid ? size_t(size) : 0 );
+        for ( vector<uint64_t>::iterator i = target->ordering_dependencies.begin(); valid && i != target->ordering_dependencies.end(); ++i )
+        {
+            valid = value( &(*i) );
+        }
+    }
+
+    vector<string> paths;
+    valid = valid && value( &size ) && size <= uint64_t(end_ - position_);
+    if ( valid )
+    {
+        paths.resize( size_t(size) );
+    }
+    for ( vector<string>::iterator path = paths.begin(); valid && path != paths.end(); ++path )
+    {
+        valid = value( &(*path) );
+    }
+    valid = valid && position_ == end_;
+
+    for ( vector<EvaluatedTarget>::const_iterator target = targets.begin(); valid && target != targets.end(); ++target )
+    {
+        valid = target->index < paths.size();
+        for ( vector<uint64_t>::const_iterator i = target->explicit_dependencies.begin(); valid && i != target->explicit_dependencies.end(); ++i )
+        {
+            valid = *i < paths.size();
+        }
+        for ( vector<uint64_t>::const_iterator i = target->ordering_dependencies.begin(); valid && i != target->ordering_dependencies.end(); ++i )
+        {
+            valid = *i < paths.size();
+        }
+    }
+
+    position_ = nullptr;
+    end_ = nullptr;
+    if ( !valid )
+    {
+        return false;
+    }
+
+    vector<Target*> targets_by_index;
+    targets_by_index.reserve( paths.size() );
+    for ( vector<string>::const_iterator path = paths.begin(); path != paths.end(); ++path )
+    {
+        targets_by_index.push_back( graph->add_or_find_target(*path, nullptr) );
+    }
+    for ( vector<EvaluatedTarget>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+    {
+        Target* target = targets_by_index[i->index];
+        target->set_cleanable( i->cleanable );
+        target->set_hash( i->hash );
+        for ( vector<uint64_t>::const_iterator j = i->explicit_dependencies.begin(); j != i->explicit_dependencies.end(); ++j )
+        {
+            target->add_explicit_dependency( targets_by_index[*j] );
+        }
+        for ( vector<uint64_t>::const_iterator j = i->ordering_dependencies.begin(); j != i->ordering_dependencies.end(); ++j )
+        {
+            target->add_ordering_dependency( targets_by_index[*j] );
+        }
+    }
+    return true;
+}
+
+/**
+// Record the evaluated state of a Target in the payload being written.
+//
+// Targets without explicit or ordering dependencies, that aren't cleanable,
+// and that don't have a hash set aren't recorded unless another recorded
+// Target depends on them.
+*/
+void GraphEvaluation::target( Target* target, bool cleanable, uint64_t hash, const std::vector<Target*>& explicit_dependencies, const std::vector<Target*>& ordering_dependencies )
+{
+    SWEET_ASSERT( target );
+    if ( cleanable || hash != 0 || !explicit_dependencies.empty() || !ordering_dependencies.empty() )
+    {
+        value( index(target) );
+        value( uint64_t(cleanable ? 1 : 0) );
+        value( hash );
+        value( uint64_t(explicit_dependencies.size()) );
+        for ( vector<Target*>::const_iterator i = explicit_dependencies.begin(); i != explicit_dependencies.end(); ++i )
+        {
+            value( index(*i) );
+        }
+        value( uint64_t(ordering_dependencies.size()) );
+        for ( vector<Target*>::const_iterator i = ordering_dependencies.begin(); i != ordering_dependencies.end(); ++i )
+        {
+            value( index(*i) );
+        }
+    }
+}
+
+/**
+// Calculate the hash of the variables assigned on the command line.
+//
+// The `goal` variable is ignored as it selects which Targets to build
+// rather than changing how buildfiles are evaluated.
+*/
+uint64_t GraphEvaluation::key() const
+{
+    Hasher hasher;
+    const vector<string>& assignments = forge_->assignments();
+    for ( vector<string>::const_iterator assignment = assignments.begin(); assignment != assignments.end(); ++assignment )
+    {
+        if ( assignment->compare(0, 5, "goal=") != 0 )
+        {
+            hasher.append( assignment->c_str(), assignment->size() + 1 );
+        }
+    }
+    return hasher.value();
+}
+
+/**
+// Get the files and directories that evaluating buildfiles depended on and
+// their last write times.
+//
+// These are the Lua files loaded, including the root build script,
+// modules, and buildfiles, the local settings, and the directories walked
+// by `glob()`.
+//
+// @param graph
+//  The Graph whose buildfiles have been evaluated (assumed not null).
+//
+// @param inputs
+//  A vector to receive the path and last write time of each file and
+//  directory (assumed not null).
+*/
+void GraphEvaluation::inputs( Graph* graph, std::vector<std::pair<std::string, int64_t>>* inputs ) const
+{
+    SWEET_ASSERT( graph );
+    SWEET_ASSERT( inputs );
+
+    map<string, int64_t> paths;
+    const std::unordered_set<string>& filenames = forge_->chunk_cache()->filenames();
+    for ( std::unordered_set<string>::const_iterator filename = filenames.begin(); filename != filenames.end(); ++filename )
+    {
+        paths.insert( make_pair(*filename, last_write_time(*filename)) );
+    }
+
+    Target* cache_target = graph->cache_target();
+    if ( cache_target )
+    {
+        int index = 0;
+        Target* buildfile = cache_target->explicit_dependency( index );
+        while ( buildfile )
+        {
+            const vector<string>& filenames = buildfile->filenames();
+            for ( vector<string>::const_iterator filename = filenames.begin(); filename != filenames.end(); ++filename )
+            {
+                paths.insert( make_pair(*filename, last_write_time(*filename)) );
+            }
+            ++index;
+            buildfile = cache_target->explicit_dependency( index );
+        }
+    }
+
+    string local_settings = forge_->root( "local_settings.lua" ).generic_string();
+    paths.insert( make_pair(local_settings, last_write_time(local_settings)) );
+
+    vector<pair<string, int64_t>> directories;
+    forge_->system()->globbed_directories( &directories );
+    paths.insert( directories.begin(), directories.end() );
+
+    inputs->insert( inputs->end(), paths.begin(), paths.end() );
+}
+
+/**
+// Get the last write time of a file or directory.
+//
+// @return
+//  The last write time of \e path or 0 if it doesn't exist.
+*/
+int64_t GraphEvaluation::last_write_time( const std::string& path ) const
+{
+    System* system = forge_->system();
+    return system->exists( path ) ? system->last_write_time( path ) : 0;
+}
+
+/**
+// Get the index of \e target in the payload being written, recording its
+// path the first time that it is indexed.
+*/
+uint64_t GraphEvaluation::index( Target* target )
+{
+    SWEET_ASSERT( target );
+    std::unordered_map<Target*, uint64_t>::const_iterator i = indices_.find( target );
+    if ( i != indices_.end() )
+    {
+        return i->second;
+    }
+    uint64_t index = uint64_t(paths_.size());
+    indices_.insert( make_pair(target, index) );
+    paths_.push_back( target->path() );
+    return index;
+}
+
+void GraphEvaluation::value( uint64_t value )
+{
+    payload_.append( reinterpret_cast<const char*>(&value), sizeof(value) );
+}
+
+void GraphEvaluation::value( const std::string& value )
+{
+    this->value( uint64_t(value.size()) );
+    payload_.append( value );
+}
+
+bool GraphEvaluation::value( uint64_t* value )
+{
+    if ( uint64_t(end_ - position_) < sizeof(*value) )
+    {
+        return false;
+    }
+    memcpy( value, position_, sizeof(*value) );
+    position_ += sizeof(*value);
+    return true;
+}
+
+bool GraphEvaluation::value( std::string* value )
+{
+    uint64_t size = 0;
+    if ( !this->value(&size) || size > uint64_t(end_ - position_) )
+    {
+        return false;
+    }
+    value->assign( position_, size_t(size) );
+    position_ += size;
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef FORGE_GRAPHEVALUATION_HPP_INCLUDED
+#define FORGE_GRAPHEVALUATION_HPP_INCLUDED
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <stdint.h>
+
+namespace sweet
+{
+
+namespace forge
+{
+
+class Target;
+class Graph;
+class Forge;
+
+/**
+// Snapshot the parts of a dependency graph that are created by evaluating
+// buildfiles and restore them instead of evaluating buildfiles again when
+// nothing that the evaluation depended on has changed.
+//
+// See `GraphEvaluationHeader` for the layout of the file.  The dependency
+// graph cache file already records the state of each Target from the last
+// build along with its implicit dependencies.  A snapshot adds the explicit
+// and ordering dependencies, cleanable flags, and hashes that buildfiles set
+// so that whether or not anything is outdated can be determined without
+// evaluating buildfiles.
+//
+// Snapshots are only valid while the buildfiles and other Lua files loaded,
+// the local settings, the directories walked by `glob()`, and the variables
+// assigned on the command line are unchanged.  The attributes that
+// buildfiles set on Targets' Lua tables aren't part of a snapshot so a
+// restored Graph can only be checked for outdated Targets and not built.
+*/
+class GraphEvaluation
+{
+    Forge* forge_; ///< The Forge that this GraphEvaluation is part of.
+    std::string payload_; ///< The payload being written.
+    std::unordered_map<Target*, uint64_t> indices_; ///< The index of each Target recorded in the payload being written.
+    std::vector<std::string> paths_; ///< The path of each Target recorded in the payload being written.
+    const char* position_; ///< The position of the next value to read in the payload being restored.
+    const char* end_; ///< One past the end of the payload being restored.
+
+public:
+    GraphEvaluation( Forge* forge );
+    bool save( const std::string& filename, Graph* graph );
+    bool restore( const std::string& filename, Graph* graph );
+    void target( Target* target, bool cleanable, uint64_t hash, const std::vector<Target*>& explicit_dependencies, const std::vector<Target*>& ordering_dependencies );
+
+private:
+    uint64_t key() const;
+    void inputs( Graph* graph, std::vector<std::pair<std::string, int64_t>>* inputs ) const;
+    int64_t last_write_time( const std::string& path ) const;
+    uint64_t index( Target* target );
+    void value( uint64_t value );
+    void value( const std::string& value );
+    bool value( uint64_t* value );
+    bool value( std::string* value );
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef FORGE_GRAPHFORMAT_HPP_INCLUDED
+#define FORGE_GRAPHFORMAT_HPP_INCLUDED
+
+#include <stdint.h>
+
+namespace sweet
+{
+
+namespace forge
+{
+
+/**
+// The header at the start of a dependency graph cache file.
+//
+// The header is followed by, in order and each starting at an 8 byte
+// aligned offset, an array of GraphTargetRecords in preorder with the root
+// Target first, arrays of indices for filenames (into the string table),
+// children (into the target records), and implicit dependencies (into the
+// target records), an array of GraphStringRecords making up the string
+// table, and finally the characters of all of the strings.
+//
+// All references are indices rather than addresses so that the file can be
+// memory mapped and read in a single pass without translating pointers.
+*/
+struct GraphHeader
+{
+    char format [24]; ///< The null terminated format identifier "Sweet Build Graph".
+    uint32_t version; ///< The version of the format.
+    uint32_t targets; ///< The number of target records.
+    uint32_t filenames; ///< The number of filename indices.
+    uint32_t children; ///< The number of child target indices.
+    uint32_t references; ///< The number of implicit dependency target indices.
+    uint32_t strings; ///< The number of string records.
+    uint64_t characters; ///< The number of characters in all strings.
+    int64_t racy_timestamp; ///< The time, in nanoseconds since the epoch, that the build that saved the graph started; files written since may have been written racily.
+};
+
+/**
+// A Target in a dependency graph cache file.
+*/
+struct GraphTargetRecord
+{
+    int64_t last_write_time; ///< The last write time of the Target in nanoseconds since the epoch.
+    uint64_t hash; ///< The hash of the Target.
+    int64_t content_timestamp; ///< The last write time of the Target when the contents of its files last changed.
+    uint64_t content_hash; ///< The hash of the contents of the Target's files or 0 if not hashed.
+    uint64_t signature; ///< The signature of the last command executed to build the Target or 0 if none.
+    uint32_t id; ///< The index of the Target's identifier in the string table.
+    uint32_t built; ///< Non-zero if the Target has been built.
+    uint32_t cutoff; ///< Non-zero if the Target has content cutoff enabled.
+    uint32_t reserved; ///< Reserved; always zero.
+    uint32_t filenames; ///< The index of the Target's first filename index.
+    uint32_t filenames_size; ///< The number of filenames.
+    uint32_t children; ///< The index of the Target's first child index.
+    uint32_t children_size; ///< The number of children.
+    uint32_t references; ///< The index of the Target's first implicit dependency index.
+    uint32_t references_size; ///< The number of implicit dependencies.
+};
+
+/**
+// A string in the string table of a dependency graph cache file.
+*/
+struct GraphStringRecord
+{
+    uint64_t offset; ///< The offset of the string's first character from the start of the characters.
+    uint64_t length; ///< The number of characters in the string.
+};
+
+/**
+// The header at the start of a dependency graph journal file.
+//
+// The header is followed by any number of entries each made up of a 
+// GraphJournalEntry followed by the entry's payload.  The payload records
+// the path, last write time, hash, content timestamp and hash, command
+// signature, built and cutoff flags, filenames, and paths of implicit dependencies of a Target as
+// it was when the Target's job in a postorder traversal completed.
+*/
+struct GraphJournalHeader
+{
+    char format [24]; ///< The null terminated format identifier "Sweet Build Journal".
+    uint32_t version; ///< The version of the format (matches GRAPH_VERSION).
+    uint32_t reserved; ///< Reserved; always zero.
+};
+
+/**
+// An entry in a dependency graph journal file.
+*/
+struct GraphJournalEntry
+{
+    uint64_t size; ///< The size of the entry's payload in bytes.
+    uint64_t checksum; ///< The FNV-1a hash of the entry's payload.
+};
+
+/**
+// The header at the start of a snapshot of an evaluated dependency graph.
+//
+// The header is followed by a payload that records the path and last write
+// time of each file and directory that evaluating the buildfiles depended 
+// on and then the path, cleanable flag, hash, and indices of explicit and
+// ordering dependencies of each Target.  Dependencies are indices into the
+// Targets in the order that they're recorded.
+*/
+struct GraphEvaluationHeader
+{
+    char format [24]; ///< The null terminated format identifier "Sweet Build Evaluation".
+    uint32_t version; ///< The version of the format (matches GRAPH_VERSION).
+    uint32_t reserved; ///< Reserved; always zero.
+    uint64_t key; ///< The hash of the variables assigned on the command line when the snapshot was taken.
+    uint64_t size; ///< The size of the payload in bytes.
+    uint64_t checksum; ///< The hash of the payload (see `Hasher::hash()`).
+};
+
+static const char GRAPH_FORMAT [] = "Sweet Build Graph";
+static const char GRAPH_JOURNAL_FORMAT [] = "Sweet Build Journal";
+static const char GRAPH_EVALUATION_FORMAT [] = "Sweet Build Evaluation";
+static const uint32_t GRAPH_VERSION = 37;
+
+}
+
+}
+
+#endif
@@ -0,0 +1,354 @@
+//
+// GraphJournal.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "GraphJournal.hpp"
+#include "GraphFormat.hpp"
+#include "Graph.hpp"
+#include "Target.hpp"
+#include <error/ErrorPolicy.hpp>
+#include <assert/assert.hpp>
+#include <iterator>
+#include <stdio.h>
+#include <string.h>
+
+using std::vector;
+using std::string;
+using std::ifstream;
+using std::ofstream;
+using std::istreambuf_iterator;
+using namespace sweet;
+using namespace sweet::forge;
+
+/**
+// Calculate the 64 bit FNV-1a hash of \e size bytes at \e data.
+*/
+static uint64_t checksum( const char* data, size_t size )
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for ( size_t i = 0; i < size; ++i )
+    {
+        hash ^= uint64_t(static_cast<unsigned char>(data[i]));
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+// Constructor.
+//
+// @param error_policy
+//  The ErrorPolicy to report errors to (assumed not null).
+*/
+GraphJournal::GraphJournal( error::ErrorPolicy* error_policy )
+: error_policy_( error_policy ),
+  ofstream_(),
+  entry_(),
+  position_( nullptr ),
+  end_( nullptr )
+{
+    SWEET_ASSERT( error_policy_ );
+}
+
+/**
+// Destructor.
+*/
+GraphJournal::~GraphJournal()
+{
+    close();
+}
+
+/**
+// Open \e filename to append entries to.
+//
+// The header is written if the journal is new or empty.  Existing entries
+// are expected to have already been replayed (see `GraphJournal::replay()`)
+// so that any partially written entry at the end of the file has been
+// removed before new entries are appended.
+//
+// @param filename
+//  The name of the journal file to open.
+//
+// @return
+//  True if the journal was opened otherwise false.
+*/
+bool GraphJournal::open( const std::string& filename )
+{
+    close();
+    ofstream_.open( filename, std::ios::binary | std::ios::app );
+    if ( !ofstream_.is_open() )
+    {
+        error_policy_->print( "Opening the journal '%s' failed", filename.c_str() );
+        return false;
+    }
+
+    ofstream_.seekp( 0, std::ios::end );
+    if ( ofstream_.tellp() == std::streampos(0) )
+    {
+        GraphJournalHeader header;
+        memset( &header, 0, sizeof(header) );
+        strncpy( header.format, GRAPH_JOURNAL_FORMAT, sizeof(header.format) );
+        header.version = GRAPH_VERSION;
+        ofstream_.write( reinterpret_cast<const char*>(&header), sizeof(header) );
+        ofstream_.flush();
+    }
+    return ofstream_.good();
+}
+
+/**
+// Close the journal if it is open.
+*/
+void GraphJournal::close()
+{
+    if ( ofstream_.is_open() )
+    {
+        ofstream_.close();
+    }
+}
+
+/**
+// Is the journal open for appending?
+//
+// @return
+//  True if the journal is open otherwise false.
+*/
+bool GraphJournal::is_open() const
+{
+    return ofstream_.is_open();
+}
+
+/**
+// Append an entry recording the state of \e target.
+//
+// The entry is flushed to the operating system before returning so that it
+// survives the build being interrupted or killed.
+//
+// @param target
+//  The Target to record (assumed not null).
+*/
+void GraphJournal::write( Target* target )
+{
+    SWEET_ASSERT( target );
+    if ( ofstream_.is_open() )
+    {
+        entry_.clear();
+        target->write( *this );
+
+        GraphJournalEntry entry;
+        entry.size = entry_.size();
+        entry.checksum = checksum( entry_.data(), entry_.size() );
+        ofstream_.write( reinterpret_cast<const char*>(&entry), sizeof(entry) );
+        ofstream_.write( entry_.data(), entry_.size() );
+        ofstream_.flush();
+    }
+}
+
+/**
+// Replay the entries in \e filename onto \e graph.
+//
+// Entries are replayed in the order that they were written so that later
+// entries for the same Target override earlier ones.  Replay stops at the 
+// first entry that is truncated or fails its checksum, as happens when the
+// build is killed part way through appending an entry, and the journal is
+// rewritten without that entry and anything after it.  Journals that aren't
+// valid or are from a different version are removed.
+//
+// @param filename
+//  The name of the journal file to replay.
+//
+// @param graph
+//  The Graph to replay entries onto (assumed not null).
+//
+// @return
+//  The number of entries replayed.
+*/
+int GraphJournal::replay( const std::string& filename, Graph* graph )
+{
+    SWEET_ASSERT( graph );
+
+    string data;
+    {
+        ifstream ifstream( filename, std::ios::binary );
+        if ( !ifstream.is_open() )
+        {
+            return 0;
+        }
+        data.assign( istreambuf_iterator<char>(ifstream), istreambuf_iterator<char>() );
+    }
+
+    GraphJournalHeader header;
+    if ( data.size() < sizeof(header) )
+    {
+        ::remove( filename.c_str() );
+        return 0;
+    }
+
+    memcpy( &header, data.data(), sizeof(header) );
+    if ( strncmp(header.format, GRAPH_JOURNAL_FORMAT, sizeof(header.format)) != 0 || header.version != GRAPH_VERSION )
+    {
+        error_policy_->print( "The journal '%s' is not valid or from a different version and has been ignored", filename.c_str() );
+        ::remove( filename.c_str() );
+        return 0;
+    }
+
+    int entries = 0;
+    size_t offset = sizeof(header);
+    while ( data.size() - offset >= sizeof(GraphJournalEntry) )
+    {
+        GraphJournalEntry entry;
+        memcpy( &entry, data.data() + offset, sizeof(entry) );
+        const char* payload = data.data() + offset + sizeof(entry);
+        if ( entry.size > data.size() - offset - sizeof(entry) || entry.checksum != checksum(payload, size_t(entry.size)) )
+        {
+            break;
+        }
+
+        position_ = payload;
+        end_ = payload + entry.size;
+        string path;
+        if ( !value(&path) )
+        {
+            break;
+        }
+
+        Target* target = graph->add_or_find_target( path, nullptr );
+        if ( !target || !target->read(*this) )
+        {
+            break;
+        }
+
+        ++entries;
+        offset += sizeof(entry) + size_t(entry.size);
+    }
+
+    position_ = nullptr;
+    end_ = nullptr;
+
+    if ( offset != data.size() )
+    {
+        ofstream ofstream( filename, std::ios::binary | std::ios::trunc );
+        ofstream.write( data.data(), offset );
+    }
+    return entries;
+}
+
+/**
+// Write the payload of an entry for a Target.
+//
+// Implicit dependencies on anonymous Targets are skipped as anonymous 
+// Targets can't be found again by path.
+*/
+void GraphJournal::target( const std::string& path, int64_t last_write_time, uint64_t hash, int64_t content_timestamp, uint64_t content_hash, uint64_t signature, bool built, bool cutoff, const std::vector<std::string>& filenames, const std::vector<Target*>& implicit_dependencies )
+{
+    value( path );
+    value( uint64_t(last_write_time) );
+    value( hash );
+    value( uint64_t(content_timestamp) );
+    value( content_hash );
+    value( signature );
+    value( uint64_t(built ? 1 : 0) );
+    value( uint64_t(cutoff ? 1 : 0) );
+    value( uint64_t(filenames.size()) );
+    for ( vector<string>::const_iterator i = filenames.begin(); i != filenames.end(); ++i )
+    {
+        value( *i );
+    }
+
+    uint64_t dependencies = 0;
+    for ( vector<Target*>::const_iterator i = implicit_dependencies.begin(); i != implicit_dependencies.end(); ++i )
+    {
+        dependencies += (*i)->anonymous() ? 0 : 1;
+    }
+    value( dependencies );
+    for ( vector<Target*>::const_iterator i = implicit_dependencies.begin(); i != implicit_dependencies.end(); ++i )
+    {
+        Target* target = *i;
+        if ( !target->anonymous() )
+        {
+            value( target->path() );
+        }
+    }
+}
+
+/**
+// Read the remaining payload of the entry being replayed.
+//
+// @return
+//  True if the payload was read successfully otherwise false.
+*/
+bool GraphJournal::target( int64_t* last_write_time, uint64_t* hash, int64_t* content_timestamp, uint64_t* content_hash, uint64_t* signature, bool* built, bool* cutoff, std::vector<std::string>* filenames, std::vector<std::string>* implicit_dependencies )
+{
+    SWEET_ASSERT( last_write_time && hash && content_timestamp && content_hash && signature && built && cutoff && filenames && implicit_dependencies );
+
+    uint64_t time = 0;
+    uint64_t content_time = 0;
+    uint64_t built_flag = 0;
+    uint64_t cutoff_flag = 0;
+    uint64_t size = 0;
+    if ( !value(&time) || !value(hash) || !value(&content_time) || !value(content_hash) || !value(signature) || !value(&built_flag) || !value(&cutoff_flag) || !value(&size) || size > uint64_t(end_ - position_) )
+    {
+        return false;
+    }
+    *last_write_time = int64_t(time);
+    *content_timestamp = int64_t(content_time);
+    *built = built_flag != 0;
+    *cutoff = cutoff_flag != 0;
+
+    filenames->resize( size_t(size) );
+    for ( vector<string>::iterator i = filenames->begin(); i != filenames->end(); ++i )
+    {
+        if ( !value(&(*i)) )
+        {
+            return false;
+        }
+    }
+
+    if ( !value(&size) || size > uint64_t(end_ - position_) )
+    {
+        return false;
+    }
+    implicit_dependencies->resize( size_t(size) );
+    for ( vector<string>::iterator i = implicit_dependencies->begin(); i != implicit_dependencies->end(); ++i )
+    {
+        if ( !value(&(*i)) )
+        {
+            return false;
+        }
+    }
+    return position_ == end_;
+}
+
+void GraphJournal::value( uint64_t value )
+{
+    entry_.append( reinterpret_cast<const char*>(&value), sizeof(value) );
+}
+
+void GraphJournal::value( const std::string& value )
+{
+    this->value( uint64_t(value.size()) );
+    entry_.append( value );
+}
+
+bool GraphJournal::value( uint64_t* value )
+{
+    if ( uint64_t(end_ - position_) < sizeof(*value) )
+    {
+        return false;
+    }
+    memcpy( value, position_, sizeof(*value) );
+    position_ += sizeof(*value);
+    return true;
+}
+
+bool GraphJournal::value( std::string* value )
+{
+    uint64_t size = 0;
+    if ( !this->value(&size) || size > uint64_t(end_ - position_) )
+    {
+        return false;
+    }
+    value->assign( position_, size_t(size) );
+    position_ += size;
+    return true;
+}
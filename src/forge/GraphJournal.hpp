@@ -0,0 +1,66 @@
+#ifndef FORGE_GRAPHJOURNAL_HPP_INCLUDED
+#define FORGE_GRAPHJOURNAL_HPP_INCLUDED
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdint.h>
+
+namespace sweet
+{
+
+namespace error
+{
+
+class ErrorPolicy;
+
+}
+
+namespace forge
+{
+
+class Target;
+class Graph;
+
+/**
+// Checkpoint changes to Targets to a journal next to a dependency graph
+// cache file and replay them when the cache is loaded.
+//
+// See `GraphJournalHeader` for the layout of the file.  Entries are appended
+// and flushed as Targets complete so that the work done by a build that is
+// interrupted before the dependency graph is saved isn't lost.  Entries 
+// refer to Targets by path so that they can be replayed onto the Graph 
+// loaded from the last complete snapshot, or onto an empty Graph if there
+// isn't one, creating Targets as needed.
+*/
+class GraphJournal
+{
+    error::ErrorPolicy* error_policy_; ///< The error policy to report errors to.
+    std::ofstream ofstream_; ///< The stream that entries are appended to.
+    std::string entry_; ///< The payload of the entry being written.
+    const char* position_; ///< The position of the next value to read in the entry being replayed.
+    const char* end_; ///< One past the end of the entry being replayed.
+
+public:
+    GraphJournal( error::ErrorPolicy* error_policy );
+    ~GraphJournal();
+    bool open( const std::string& filename );
+    void close();
+    bool is_open() const;
+    void write( Target* target );
+    int replay( const std::string& filename, Graph* graph );
+    void target( const std::string& path, int64_t last_write_time, uint64_t hash, int64_t content_timestamp, uint64_t content_hash, uint64_t signature, bool built, bool cutoff, const std::vector<std::string>& filenames, const std::vector<Target*>& implicit_dependencies );
+    bool target( int64_t* last_write_time, uint64_t* hash, int64_t* content_timestamp, uint64_t* content_hash, uint64_t* signature, bool* built, bool* cutoff, std::vector<std::string>* filenames, std::vector<std::string>* implicit_dependencies );
+
+private:
+    void value( uint64_t value );
+    void value( const std::string& value );
+    bool value( uint64_t* value );
+    bool value( std::string* value );
+};
+
+}
+
+}
+
+#endif
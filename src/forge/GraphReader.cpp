@@ -4,135 +4,483 @@
 //
 
 #include "GraphReader.hpp"
+#include "GraphFormat.hpp"
 #include "Target.hpp"
 #include <error/ErrorPolicy.hpp>
 #include <assert/assert.hpp>
 #include <memory>
 #include <string.h>
 
-using std::map;
+#if defined(BUILD_OS_WINDOWS)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 using std::vector;
 using std::string;
 using std::unique_ptr;
-using std::make_pair;
 using namespace sweet;
 using namespace sweet::forge;
 
-GraphReader::GraphReader( std::istream* istream, error::ErrorPolicy* error_policy  )
-: istream_( istream ),
-  error_policy_( error_policy ),
-  address_by_old_address_()
+/**
+// Constructor.
+//
+// @param error_policy
+//  The ErrorPolicy to report invalid files to (assumed not null).
+*/
+GraphReader::GraphReader( error::ErrorPolicy* error_policy  )
+: error_policy_( error_policy ),
+  data_( nullptr ),
+  size_( 0 ),
+  target_records_( nullptr ),
+  filenames_( nullptr ),
+  children_( nullptr ),
+  references_( nullptr ),
+  string_records_( nullptr ),
+  characters_( nullptr ),
+  strings_( 0 ),
+  characters_size_( 0 ),
+  targets_(),
+  index_( 0 ),
+  racy_timestamp_( 0 )
 {
-    SWEET_ASSERT( istream_ );
     SWEET_ASSERT( error_policy_ );
 }
 
-void* GraphReader::find_address_by_old_address( const void* old_address ) const
+/**
+// Destructor.
+//
+// Unmaps any file still mapped.
+*/
+GraphReader::~GraphReader()
 {
-    map<const void*, void*>::const_iterator i = address_by_old_address_.find( old_address );
-    return i != address_by_old_address_.end() ? i->second : nullptr;
+    unmap();
 }
 
+/**
+// Read a Graph from \e filename.
+//
+// @param filename
+//  The name of the file to read.
+//
+// @return
+//  The root Target of the Graph read or null if the file couldn't be read
+//  or wasn't a valid dependency graph.
+*/
 std::unique_ptr<Target> GraphReader::read( const std::string& filename )
 {
-    const char FORMAT [] = "Sweet Build Graph";
-    char format [sizeof(FORMAT)];
-    value( &format[0], sizeof(format) );
-    if ( strncmp(format, FORMAT, sizeof(FORMAT)) != 0 )
+    if ( !map(filename) )
+    {
+        error_policy_->print( "The file '%s' could not be mapped into memory", filename.c_str() );
+        return unique_ptr<Target>();
+    }
+
+    GraphHeader header;
+    if ( size_ < sizeof(header) )
     {
         error_policy_->print( "The file '%s' is not a valid dependency graph", filename.c_str() );
+        unmap();
+        return unique_ptr<Target>();
+    }
+
+    memcpy( &header, data_, sizeof(header) );
+    if ( strncmp(header.format, GRAPH_FORMAT, sizeof(header.format)) != 0 )
+    {
+        error_policy_->print( "The file '%s' is not a valid dependency graph", filename.c_str() );
+        unmap();
+        return unique_ptr<Target>();
+    }
+
+    if ( header.version != GRAPH_VERSION )
+    {
+        error_policy_->print( "The file '%s' is version %d not version %d as expected", filename.c_str(), int(header.version), int(GRAPH_VERSION) );
+        unmap();
         return unique_ptr<Target>();
     }
 
-    const int VERSION = 32;
-    int version = 0;
-    value( &version );
-    if ( version != VERSION )
+    if ( !layout(filename) || !valid(filename) )
     {
-        error_policy_->print( "The file '%s' is version %d not version %d as expected", filename.c_str(), version, VERSION );
+        unmap();
         return unique_ptr<Target>();
     }
 
-    unique_ptr<Target> root_target;
-    root_target.reset( new Target );
-    root_target->read( *this );
-    root_target->resolve( *this );
+    // Create all of the Targets up front so that children and implicit
+    // dependencies can be looked up by index as each record is read.  The
+    // root Target owns every other Target through its children once the 
+    // records are read.
+    targets_.reserve( header.targets );
+    for ( uint32_t i = 0; i < header.targets; ++i )
+    {
+        targets_.push_back( new Target );
+    }
+
+    unique_ptr<Target> root_target( targets_.front() );
+    index_ = 0;
+    for ( vector<Target*>::const_iterator i = targets_.begin(); i != targets_.end(); ++i )
+    {
+        Target* target = *i;
+        target->read( *this );
+    }
+    root_target->resolve();
+    racy_timestamp_ = header.racy_timestamp;
+
+    targets_.clear();
+    unmap();
     return root_target;
 }
 
-void GraphReader::object_address( void* address )
+/**
+// Get the time that the build that wrote the most recently read Graph 
+// started.
+//
+// @return
+//  The time in nanoseconds since the epoch or 0 if no Graph has been read.
+*/
+int64_t GraphReader::racy_timestamp() const
 {
-    const void* old_address = nullptr;
-    istream_->read( reinterpret_cast<char*>(&old_address), sizeof(old_address) );
-    address_by_old_address_.insert( make_pair(old_address, address) );
+    return racy_timestamp_;
 }
 
-void GraphReader::value( bool* value )
+/**
+// Read the next target record.
+//
+// @param id
+//  Receives the Target's identifier.
+//
+// @param last_write_time
+//  Receives the Target's last write time.
+//
+// @param hash
+//  Receives the Target's hash.
+//
+// @param content_timestamp
+//  Receives the Target's last write time when its contents last changed.
+//
+// @param content_hash
+//  Receives the hash of the contents of the Target's files.
+//
+// @param signature
+//  Receives the signature of the last command executed to build the Target.
+//
+// @param built
+//  Receives whether or not the Target has been built.
+//
+// @param cutoff
+//  Receives whether or not the Target has content cutoff enabled.
+//
+// @param filenames
+//  Receives the Target's filenames.
+//
+// @param targets
+//  Receives the Target's children.
+//
+// @param implicit_dependencies
+//  Receives the Target's implicit dependencies.
+*/
+void GraphReader::target( std::string* id, int64_t* last_write_time, uint64_t* hash, int64_t* content_timestamp, uint64_t* content_hash, uint64_t* signature, bool* built, bool* cutoff, std::vector<std::string>* filenames, std::vector<Target*>* targets, std::vector<Target*>* implicit_dependencies )
 {
-    istream_->read( reinterpret_cast<char*>(value), sizeof(*value) );
-}
+    SWEET_ASSERT( index_ < targets_.size() );
 
-void GraphReader::value( int* value )
-{
-    istream_->read( reinterpret_cast<char*>(value), sizeof(*value) );
-}
+    GraphTargetRecord record;
+    memcpy( &record, target_records_ + index_ * sizeof(GraphTargetRecord), sizeof(record) );
+    ++index_;
 
-void GraphReader::value( uint64_t* value )
-{
-    istream_->read( reinterpret_cast<char*>(value), sizeof(*value) );
-}
+    read_string( record.id, id );
+    *last_write_time = record.last_write_time;
+    *hash = record.hash;
+    *content_timestamp = record.content_timestamp;
+    *content_hash = record.content_hash;
+    *signature = record.signature;
+    *built = record.built != 0;
+    *cutoff = record.cutoff != 0;
 
-void GraphReader::value( std::time_t* value )
-{
-    istream_->read( reinterpret_cast<char*>(value), sizeof(*value) );
-}
+    filenames->resize( record.filenames_size );
+    for ( uint32_t i = 0; i < record.filenames_size; ++i )
+    {
+        read_string( index(filenames_, record.filenames + i), &(*filenames)[i] );
+    }
 
-void GraphReader::value( std::string* value )
-{
-    size_t size = 0;
-    istream_->read( reinterpret_cast<char*>(&size), sizeof(size) );
-    value->resize( size );
-    istream_->read( reinterpret_cast<char*>(&(*value)[0]), size );
+    targets->resize( record.children_size );
+    for ( uint32_t i = 0; i < record.children_size; ++i )
+    {
+        (*targets)[i] = targets_[index(children_, record.children + i)];
+    }
+
+    implicit_dependencies->resize( record.references_size );
+    for ( uint32_t i = 0; i < record.references_size; ++i )
+    {
+        (*implicit_dependencies)[i] = targets_[index(references_, record.references + i)];
+    }
 }
 
-void GraphReader::value( char* value, size_t size )
+/**
+// Map \e filename into memory for reading.
+//
+// @param filename
+//  The name of the file to map.
+//
+// @return
+//  True if the file was mapped otherwise false.
+*/
+bool GraphReader::map( const std::string& filename )
 {
-    istream_->read( value, size );
+    unmap();
+
+#if defined(BUILD_OS_WINDOWS)
+    HANDLE file = ::CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+    if ( file == INVALID_HANDLE_VALUE )
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if ( !::GetFileSizeEx(file, &size) || size.QuadPart == 0 )
+    {
+        ::CloseHandle( file );
+        return false;
+    }
+
+    HANDLE mapping = ::CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+    ::CloseHandle( file );
+    if ( !mapping )
+    {
+        return false;
+    }
+
+    const void* data = ::MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+    ::CloseHandle( mapping );
+    if ( !data )
+    {
+        return false;
+    }
+
+    data_ = reinterpret_cast<const char*>( data );
+    size_ = size_t(size.QuadPart);
+#else
+    int fd = ::open( filename.c_str(), O_RDONLY );
+    if ( fd == -1 )
+    {
+        return false;
+    }
+
+    struct stat stat;
+    if ( ::fstat(fd, &stat) != 0 || stat.st_size == 0 )
+    {
+        ::close( fd );
+        return false;
+    }
+
+    void* data = ::mmap( nullptr, size_t(stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if ( data == MAP_FAILED )
+    {
+        return false;
+    }
+
+    data_ = reinterpret_cast<const char*>( data );
+    size_ = size_t(stat.st_size);
+#endif
+
+    return true;
 }
 
-void GraphReader::value( std::vector<std::string>* values )
+/**
+// Unmap the currently mapped file if there is one.
+*/
+void GraphReader::unmap()
 {
-    size_t length = 0;
-    istream_->read( reinterpret_cast<char*>(&length), sizeof(length) );
-    values->resize( length );
-    for ( vector<string>::iterator i = values->begin(); i != values->end(); ++i )
+    if ( data_ )
     {
-        value( &(*i) );
+#if defined(BUILD_OS_WINDOWS)
+        ::UnmapViewOfFile( data_ );
+#else
+        ::munmap( const_cast<char*>(data_), size_ );
+#endif
+        data_ = nullptr;
+        size_ = 0;
     }
 }
 
-void GraphReader::value( std::vector<Target*>* values )
+/**
+// Find the start of each array in the mapped file.
+//
+// @param filename
+//  The name of the mapped file (for reporting errors).
+//
+// @return
+//  True if the arrays described by the header fit in the mapped file
+//  otherwise false.
+*/
+bool GraphReader::layout( const std::string& filename )
 {
-    size_t length = 0;
-    istream_->read( reinterpret_cast<char*>(&length), sizeof(length) );
-    values->resize( length );
-    for ( vector<Target*>::iterator i = values->begin(); i != values->end(); ++i )
+    SWEET_ASSERT( data_ );
+
+    GraphHeader header;
+    memcpy( &header, data_, sizeof(header) );
+
+    struct Array
     {
-        unique_ptr<Target> target( new Target );
-        target->read( *this );
-        *i = target.release();
+        const char** start;
+        uint64_t size;
+    };
+
+    const Array arrays [] =
+    {
+        { &target_records_, uint64_t(header.targets) * sizeof(GraphTargetRecord) },
+        { &filenames_, uint64_t(header.filenames) * sizeof(uint32_t) },
+        { &children_, uint64_t(header.children) * sizeof(uint32_t) },
+        { &references_, uint64_t(header.references) * sizeof(uint32_t) },
+        { &string_records_, uint64_t(header.strings) * sizeof(GraphStringRecord) },
+        { &characters_, header.characters }
+    };
+
+    uint64_t offset = (sizeof(header) + 7) & ~uint64_t(7);
+    for ( size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); ++i )
+    {
+        const Array& array = arrays[i];
+        if ( array.size > uint64_t(size_) || offset > uint64_t(size_) - array.size )
+        {
+            error_policy_->print( "The file '%s' is truncated", filename.c_str() );
+            return false;
+        }
+        *array.start = data_ + offset;
+        offset = (offset + array.size + 7) & ~uint64_t(7);
+    }
+
+    strings_ = header.strings;
+    characters_size_ = header.characters;
+    if ( header.targets == 0 )
+    {
+        error_policy_->print( "The file '%s' has no root target", filename.c_str() );
+        return false;
     }
+    return true;
 }
 
-void GraphReader::refer( std::vector<Target*>* values )
+/**
+// Check that every index in the mapped file is in range and that children
+// form a tree rooted at the first target record.
+//
+// Every target record other than the first must be the child of exactly one
+// target record that precedes it.  This guarantees that each Target is 
+// owned by exactly one parent once the records are read.
+//
+// @param filename
+//  The name of the mapped file (for reporting errors).
+//
+// @return
+//  True if the mapped file is valid otherwise false.
+*/
+bool GraphReader::valid( const std::string& filename ) const
 {
-    size_t length = 0;
-    istream_->read( reinterpret_cast<char*>(&length), sizeof(length) );
-    values->resize( length );
-    for ( vector<Target*>::iterator i = values->begin(); i != values->end(); ++i )
+    GraphHeader header;
+    memcpy( &header, data_, sizeof(header) );
+
+    for ( uint32_t i = 0; i < header.strings; ++i )
+    {
+        GraphStringRecord record;
+        memcpy( &record, string_records_ + i * sizeof(GraphStringRecord), sizeof(record) );
+        if ( record.length > characters_size_ || record.offset > characters_size_ - record.length )
+        {
+            error_policy_->print( "The file '%s' has an invalid string", filename.c_str() );
+            return false;
+        }
+    }
+
+    for ( uint32_t i = 0; i < header.filenames; ++i )
     {
-        Target* target = nullptr;
-        istream_->read( reinterpret_cast<char*>(&target), sizeof(target) );
-        *i = target;
+        if ( index(filenames_, i) >= header.strings )
+        {
+            error_policy_->print( "The file '%s' has an invalid filename", filename.c_str() );
+            return false;
+        }
     }
+
+    for ( uint32_t i = 0; i < header.references; ++i )
+    {
+        if ( index(references_, i) >= header.targets )
+        {
+            error_policy_->print( "The file '%s' has an invalid implicit dependency", filename.c_str() );
+            return false;
+        }
+    }
+
+    vector<char> parented( header.targets, false );
+    for ( uint32_t i = 0; i < header.targets; ++i )
+    {
+        GraphTargetRecord record;
+        memcpy( &record, target_records_ + i * sizeof(GraphTargetRecord), sizeof(record) );
+        bool valid =
+            record.id < header.strings &&
+            record.filenames <= header.filenames && record.filenames_size <= header.filenames - record.filenames &&
+            record.children <= header.children && record.children_size <= header.children - record.children &&
+            record.references <= header.references && record.references_size <= header.references - record.references
+        ;
+        for ( uint32_t j = 0; valid && j < record.children_size; ++j )
+        {
+            uint32_t child = index( children_, record.children + j );
+            valid = child > i && child < header.targets && !parented[child];
+            if ( valid )
+            {
+                parented[child] = true;
+            }
+        }
+        if ( !valid )
+        {
+            error_policy_->print( "The file '%s' has an invalid target", filename.c_str() );
+            return false;
+        }
+    }
+
+    for ( uint32_t i = 1; i < header.targets; ++i )
+    {
+        if ( !parented[i] )
+        {
+            error_policy_->print( "The file '%s' has an unreachable target", filename.c_str() );
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+// Get the \e nth index from an array of indices.
+//
+// @param indices
+//  The start of the array of indices.
+//
+// @param n
+//  The position of the index to get (assumed to be in range).
+//
+// @return
+//  The index.
+*/
+uint32_t GraphReader::index( const char* indices, uint32_t n ) const
+{
+    uint32_t value = 0;
+    memcpy( &value, indices + n * sizeof(uint32_t), sizeof(value) );
+    return value;
+}
+
+/**
+// Read the string at \e index in the string table.
+//
+// @param index
+//  The index of the string to read (assumed to be in range).
+//
+// @param value
+//  Receives the string.
+*/
+void GraphReader::read_string( uint32_t index, std::string* value ) const
+{
+    SWEET_ASSERT( index < strings_ );
+    SWEET_ASSERT( value );
+    GraphStringRecord record;
+    memcpy( &record, string_records_ + index * sizeof(GraphStringRecord), sizeof(record) );
+    value->assign( characters_ + record.offset, size_t(record.length) );
 }
@@ -1,12 +1,9 @@
 #ifndef FORGE_GRAPHREADER_HPP_INCLUDED
 #define FORGE_GRAPHREADER_HPP_INCLUDED
 
-#include <map>
 #include <vector>
 #include <string>
-#include <istream>
 #include <memory>
-#include <ctime>
 #include <stdint.h>
 
 namespace sweet
@@ -24,26 +21,50 @@ namespace forge
 
 class Target;
 
+/**
+// Read a dependency graph from a memory mapped cache file.
+//
+// See `GraphHeader` for the layout of the file.  Targets are created up
+// front, one for each target record, so that children and implicit
+// dependencies can be resolved directly from their indices as each record
+// is read.
+//
+// Every Target is materialized when the file is read rather than lazily on
+// first use.  Binding and postorder traversals visit every reachable Target
+// on each build and the rest of Forge works on the Target tree so loading
+// still costs time proportional to the size of the Graph.
+*/
 class GraphReader
 {
-    std::istream* istream_;
-    error::ErrorPolicy* error_policy_;
-    std::map<const void*, void*> address_by_old_address_;
+    error::ErrorPolicy* error_policy_; ///< The error policy to report invalid files to.
+    const char* data_; ///< The start of the memory mapped file or null if no file is mapped.
+    size_t size_; ///< The size of the memory mapped file in bytes.
+    const char* target_records_; ///< The start of the target records.
+    const char* filenames_; ///< The start of the filename indices.
+    const char* children_; ///< The start of the child target indices.
+    const char* references_; ///< The start of the implicit dependency target indices.
+    const char* string_records_; ///< The start of the string records.
+    const char* characters_; ///< The start of the characters of all strings.
+    uint32_t strings_; ///< The number of strings in the string table.
+    uint64_t characters_size_; ///< The number of characters in all strings.
+    std::vector<Target*> targets_; ///< The Targets created for each target record.
+    uint32_t index_; ///< The index of the next target record to read.
+    int64_t racy_timestamp_; ///< The time that the build that wrote the Graph started.
 
 public:
-    GraphReader( std::istream* ostream, error::ErrorPolicy* error_policy );
-    void* find_address_by_old_address( const void* old_address ) const;
+    GraphReader( error::ErrorPolicy* error_policy );
+    ~GraphReader();
     std::unique_ptr<Target> read( const std::string& filename );
-    void object_address( void* address );
-    void value( bool* value );
-    void value( int* value );
-    void value( uint64_t* value );
-    void value( std::time_t* value );
-    void value( std::string* value );
-    void value( char* value, size_t size );
-    void value( std::vector<std::string>* values );
-    void value( std::vector<Target*>* values );
-    void refer( std::vector<Target*>* references );
+    int64_t racy_timestamp() const;
+    void target( std::string* id, int64_t* last_write_time, uint64_t* hash, int64_t* content_timestamp, uint64_t* content_hash, uint64_t* signature, bool* built, bool* cutoff, std::vector<std::string>* filenames, std::vector<Target*>* targets, std::vector<Target*>* implicit_dependencies );
+
+private:
+    bool map( const std::string& filename );
+    void unmap();
+    bool layout( const std::string& filename );
+    bool valid( const std::string& filename ) const;
+    uint32_t index( const char* indices, uint32_t n ) const;
+    void read_string( uint32_t index, std::string* value ) const;
 };
 
 }
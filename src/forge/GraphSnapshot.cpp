@@ -0,0 +1,361 @@
+//
+// GraphSnapshot.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "GraphSnapshot.hpp"
+#include "Graph.hpp"
+#include "Target.hpp"
+#include "Forge.hpp"
+#include "System.hpp"
+#include <assert/assert.hpp>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <exception>
+
+using std::min;
+using std::max;
+using std::pair;
+using std::vector;
+using std::make_pair;
+using std::thread;
+using std::exception_ptr;
+using namespace sweet;
+using namespace sweet::forge;
+
+/**
+// The number of Targets that each thread binds to files at a time and the
+// minimum number of Targets per thread worth starting threads for.
+*/
+static const int BIND_TO_FILES_BATCH = 64;
+
+/**
+// Constructor.
+//
+// @param graph
+//  The Graph to take snapshots of.
+*/
+GraphSnapshot::GraphSnapshot( Graph* graph )
+: graph_( graph ),
+  targets_(),
+  edge_offsets_(),
+  binding_edge_ends_(),
+  edges_(),
+  timestamps_(),
+  outdated_(),
+  cyclic_dependencies_()
+{
+    SWEET_ASSERT( graph_ );
+}
+
+/**
+// Build this snapshot from the Targets reachable from \e target.
+//
+// Makes an iterative depth first traversal from \e target marking each
+// Target as visited in the current traversal of the Graph and numbering
+// Targets in postorder.  Dependencies on Targets that are still being
+// visited create cycles and are recorded for the caller to report (see
+// `GraphSnapshot::cyclic_dependencies()`).  A dependency from a Target to a
+// Target with a higher index is always one of these cyclic dependencies.
+//
+// Assumes that the Graph is being traversed so that visited revisions are
+// unique to this snapshot (see `Graph::begin_traversal()`).
+//
+// @param target
+//  The Target to build the snapshot from (assumed not null).
+*/
+void GraphSnapshot::build( Target* target )
+{
+    SWEET_ASSERT( target );
+    SWEET_ASSERT( graph_->traversal_in_progress() );
+
+    struct Frame
+    {
+        Target* target_;
+        int dependency_;
+    };
+
+    targets_.clear();
+    edge_offsets_.clear();
+    binding_edge_ends_.clear();
+    edges_.clear();
+    cyclic_dependencies_.clear();
+
+    // Visit Targets depth first, recording each Target's discovery index
+    // in its snapshot index while the Target is on the stack and appending
+    // Targets to `targets_` in postorder as they finish.
+    vector<Frame> stack;
+    vector<char> on_stack;
+    if ( !target->visited() )
+    {
+        target->set_visited( true );
+        target->set_snapshot_index( int(on_stack.size()) );
+        on_stack.push_back( true );
+        Frame frame = { target, 0 };
+        stack.push_back( frame );
+    }
+
+    while ( !stack.empty() )
+    {
+        Frame& frame = stack.back();
+        Target* dependency = frame.target_->any_dependency( frame.dependency_ );
+        if ( dependency )
+        {
+            ++frame.dependency_;
+            if ( !dependency->visited() )
+            {
+                dependency->set_visited( true );
+                dependency->set_snapshot_index( int(on_stack.size()) );
+                on_stack.push_back( true );
+                Frame dependency_frame = { dependency, 0 };
+                stack.push_back( dependency_frame );
+            }
+            else if ( on_stack[dependency->snapshot_index()] )
+            {
+                cyclic_dependencies_.push_back( make_pair(frame.target_, dependency) );
+            }
+        }
+        else
+        {
+            on_stack[frame.target_->snapshot_index()] = false;
+            targets_.push_back( frame.target_ );
+            stack.pop_back();
+        }
+    }
+
+    // Renumber Targets by their position in postorder.
+    int size = int(targets_.size());
+    for ( int index = 0; index < size; ++index )
+    {
+        targets_[index]->set_snapshot_index( index );
+    }
+
+    // Gather dependencies into contiguous rows and the state used by
+    // binding into contiguous columns.
+    edge_offsets_.reserve( size + 1 );
+    binding_edge_ends_.reserve( size );
+    timestamps_.resize( size );
+    outdated_.resize( size );
+    for ( int index = 0; index < size; ++index )
+    {
+        Target* target = targets_[index];
+        edge_offsets_.push_back( int(edges_.size()) );
+
+        int i = 0;
+        Target* dependency = target->binding_dependency( i );
+        while ( dependency )
+        {
+            edges_.push_back( dependency->snapshot_index() );
+            ++i;
+            dependency = target->binding_dependency( i );
+        }
+        binding_edge_ends_.push_back( int(edges_.size()) );
+
+        i = 0;
+        dependency = target->ordering_dependency( i );
+        while ( dependency )
+        {
+            edges_.push_back( dependency->snapshot_index() );
+            ++i;
+            dependency = target->ordering_dependency( i );
+        }
+
+        timestamps_[index] = target->timestamp();
+        outdated_[index] = target->outdated();
+    }
+    edge_offsets_.push_back( int(edges_.size()) );
+}
+
+/**
+// Bind the Targets in this snapshot.
+//
+// Targets are bound in postorder so that each Target's binding dependencies
+// have already been bound, with the exception of cyclic dependencies, and
+// the latest timestamp and outdated state of those dependencies is gathered
+// from this snapshot rather than from the dependencies themselves.  Each
+// Target is also marked as successful in the current traversal.
+//
+// All Targets are bound to their files first (see 
+// `GraphSnapshot::bind_to_files()`).
+*/
+void GraphSnapshot::bind()
+{
+    bind_to_files();
+
+    int size = int(targets_.size());
+    for ( int index = 0; index < size; ++index )
+    {
+        Target* target = targets_[index];
+        int64_t timestamp = 0;
+        bool outdated = false;
+        const int* end = binding_dependencies_end( index );
+        for ( const int* dependency = dependencies_begin(index); dependency != end; ++dependency )
+        {
+            timestamp = max( timestamp, timestamps_[*dependency] );
+            outdated = outdated || outdated_[*dependency];
+        }
+
+        target->bind_to_dependencies( timestamp, outdated );
+        target->set_successful( true );
+        timestamps_[index] = target->timestamp();
+        outdated_[index] = target->outdated();
+    }
+}
+
+/**
+// Bind the Targets in this snapshot to their files.
+//
+// Binding a Target to its files only reads the file system and updates that
+// Target so Targets are bound independently of each other.  Large snapshots
+// are split into batches bound by a thread per logical processor so that the
+// file system is queried, and files of Targets with content cutoff are 
+// hashed, in parallel.  The first exception thrown by any thread is 
+// rethrown once all threads have finished.
+*/
+void GraphSnapshot::bind_to_files()
+{
+    int size = int(targets_.size());
+    int threads = min( graph_->forge()->system()->number_of_logical_processors(), size / BIND_TO_FILES_BATCH );
+    if ( threads <= 1 )
+    {
+        for ( int index = 0; index < size; ++index )
+        {
+            targets_[index]->bind_to_file();
+        }
+        return;
+    }
+
+    std::atomic<int> next( 0 );
+    std::atomic<bool> failed( false );
+    exception_ptr exception;
+    auto bind_batches = [&]()
+    {
+        try
+        {
+            int begin = next.fetch_add( BIND_TO_FILES_BATCH );
+            while ( begin < size && !failed )
+            {
+                int end = min( begin + BIND_TO_FILES_BATCH, size );
+                for ( int index = begin; index < end; ++index )
+                {
+                    targets_[index]->bind_to_file();
+                }
+                begin = next.fetch_add( BIND_TO_FILES_BATCH );
+            }
+        }
+        catch ( ... )
+        {
+            if ( !failed.exchange(true) )
+            {
+                exception = std::current_exception();
+            }
+        }
+    };
+
+    vector<thread> workers;
+    workers.reserve( threads - 1 );
+    for ( int i = 1; i < threads; ++i )
+    {
+        workers.push_back( thread(bind_batches) );
+    }
+    bind_batches();
+    for ( vector<thread>::iterator worker = workers.begin(); worker != workers.end(); ++worker )
+    {
+        worker->join();
+    }
+
+    if ( exception )
+    {
+        std::rethrow_exception( exception );
+    }
+}
+
+/**
+// Get the number of Targets in this snapshot.
+//
+// @return
+//  The number of Targets.
+*/
+int GraphSnapshot::size() const
+{
+    return int(targets_.size());
+}
+
+/**
+// Get the Target at \e index in this snapshot.
+//
+// @param index
+//  The index of the Target to get (assumed to be in the range [0, size)).
+//
+// @return
+//  The Target.
+*/
+Target* GraphSnapshot::target( int index ) const
+{
+    SWEET_ASSERT( index >= 0 && index < int(targets_.size()) );
+    return targets_[index];
+}
+
+/**
+// Get the first dependency of the Target at \e index.
+//
+// The dependencies of a Target are its binding (explicit and implicit)
+// dependencies in [dependencies_begin, binding_dependencies_end) followed
+// by its ordering dependencies in [binding_dependencies_end,
+// dependencies_end).
+//
+// @param index
+//  The index of the Target to get the dependencies of.
+//
+// @return
+//  A pointer to the index of the first dependency.
+*/
+const int* GraphSnapshot::dependencies_begin( int index ) const
+{
+    SWEET_ASSERT( index >= 0 && index < int(targets_.size()) );
+    return edges_.data() + edge_offsets_[index];
+}
+
+/**
+// Get one past the last binding dependency of the Target at \e index.
+//
+// @param index
+//  The index of the Target to get the dependencies of.
+//
+// @return
+//  A pointer one past the index of the last binding dependency.
+*/
+const int* GraphSnapshot::binding_dependencies_end( int index ) const
+{
+    SWEET_ASSERT( index >= 0 && index < int(targets_.size()) );
+    return edges_.data() + binding_edge_ends_[index];
+}
+
+/**
+// Get one past the last dependency of the Target at \e index.
+//
+// @param index
+//  The index of the Target to get the dependencies of.
+//
+// @return
+//  A pointer one past the index of the last dependency.
+*/
+const int* GraphSnapshot::dependencies_end( int index ) const
+{
+    SWEET_ASSERT( index >= 0 && index < int(targets_.size()) );
+    return edges_.data() + edge_offsets_[index + 1];
+}
+
+/**
+// Get the dependencies that were found to create cycles when this snapshot
+// was built.
+//
+// @return
+//  The cyclic dependencies as pairs of the depending Target and the
+//  Target depended on.
+*/
+const std::vector<std::pair<Target*, Target*>>& GraphSnapshot::cyclic_dependencies() const
+{
+    return cyclic_dependencies_;
+}
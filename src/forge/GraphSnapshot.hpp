@@ -0,0 +1,57 @@
+#ifndef FORGE_GRAPHSNAPSHOT_HPP_INCLUDED
+#define FORGE_GRAPHSNAPSHOT_HPP_INCLUDED
+
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+namespace sweet
+{
+
+namespace forge
+{
+
+class Target;
+class Graph;
+
+/**
+// A compact, integer indexed snapshot of the part of a Graph reachable from
+// a Target.
+//
+// Targets are given dense indices in postorder so that every dependency
+// that isn't part of a cycle has a lower index than the Targets that depend
+// on it.  Dependencies are stored in compressed sparse row form; each
+// Target's explicit and implicit (binding) dependencies followed by its
+// ordering dependencies in one contiguous array.  The timestamp and outdated
+// state used while binding are kept in separate arrays indexed the same way.
+*/
+class GraphSnapshot
+{
+    Graph* graph_; ///< The Graph that this snapshot was taken from.
+    std::vector<Target*> targets_; ///< The Targets in this snapshot in postorder.
+    std::vector<int> edge_offsets_; ///< The offset of each Target's first dependency in `edges_` plus a final offset for the end.
+    std::vector<int> binding_edge_ends_; ///< The offset one past each Target's last binding dependency in `edges_`.
+    std::vector<int> edges_; ///< The indices of each Target's dependencies.
+    std::vector<int64_t> timestamps_; ///< The timestamp of each Target.
+    std::vector<char> outdated_; ///< Whether or not each Target is outdated.
+    std::vector<std::pair<Target*, Target*>> cyclic_dependencies_; ///< The dependencies found to create cycles.
+
+    public:
+        GraphSnapshot( Graph* graph );
+        void build( Target* target );
+        void bind();
+        void bind_to_files();
+
+        int size() const;
+        Target* target( int index ) const;
+        const int* dependencies_begin( int index ) const;
+        const int* binding_dependencies_end( int index ) const;
+        const int* dependencies_end( int index ) const;
+        const std::vector<std::pair<Target*, Target*>>& cyclic_dependencies() const;
+};
+
+}
+
+}
+
+#endif
@@ -6,94 +6,183 @@
 #include "GraphWriter.hpp"
 #include "Target.hpp"
 #include <assert/assert.hpp>
+#include <string.h>
 
 using std::string;
 using std::vector;
+using std::unordered_map;
+using std::make_pair;
 using namespace sweet::forge;
 
+/**
+// Constructor.
+//
+// @param ostream
+//  The stream to write to (assumed not null).
+*/
 GraphWriter::GraphWriter( std::ostream* ostream )
-: ostream_( ostream )
+: ostream_( ostream ),
+  index_by_target_(),
+  index_by_string_(),
+  target_records_(),
+  filenames_(),
+  children_(),
+  references_(),
+  string_records_(),
+  characters_()
 {
     SWEET_ASSERT( ostream_ );
 }
 
-void GraphWriter::write( Target* root_target )
+/**
+// Write the Graph rooted at \e root_target.
+//
+// Targets are numbered in preorder before any records are written so that
+// children and implicit dependencies can be written as indices.
+//
+// @param root_target
+//  The root Target of the Graph to write (assumed not null).
+//
+// @param racy_timestamp
+//  The time that the build writing the Graph started (see 
+//  `Graph::racy_timestamp()`).
+*/
+void GraphWriter::write( Target* root_target, int64_t racy_timestamp )
 {
     SWEET_ASSERT( root_target );
-    const char FORMAT [] = "Sweet Build Graph";
-    value( &FORMAT[0], sizeof(FORMAT) );
-    const int VERSION = 32;
-    value( VERSION );
-    root_target->write( *this );
-}
 
-void GraphWriter::object_address( const void* address )
-{
-    ostream_->write( reinterpret_cast<const char*>(&address), sizeof(address) );
-}
+    vector<Target*> targets;
+    vector<Target*> stack;
+    stack.push_back( root_target );
+    while ( !stack.empty() )
+    {
+        Target* target = stack.back();
+        stack.pop_back();
+        index_by_target_.insert( make_pair(target, uint32_t(targets.size())) );
+        targets.push_back( target );
+        const vector<Target*>& children = target->targets();
+        stack.insert( stack.end(), children.rbegin(), children.rend() );
+    }
 
-void GraphWriter::value( bool value )
-{
-    ostream_->write( reinterpret_cast<const char*>(&value), sizeof(value) );
-}
+    target_records_.reserve( targets.size() );
+    for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+    {
+        Target* target = *i;
+        SWEET_ASSERT( target );
+        target->write( *this );
+    }
 
-void GraphWriter::value( int value )
-{
-    ostream_->write( reinterpret_cast<const char*>(&value), sizeof(value) );
-}
+    GraphHeader header;
+    memset( &header, 0, sizeof(header) );
+    strncpy( header.format, GRAPH_FORMAT, sizeof(header.format) );
+    header.version = GRAPH_VERSION;
+    header.targets = uint32_t(target_records_.size());
+    header.filenames = uint32_t(filenames_.size());
+    header.children = uint32_t(children_.size());
+    header.references = uint32_t(references_.size());
+    header.strings = uint32_t(string_records_.size());
+    header.characters = characters_.size();
+    header.racy_timestamp = racy_timestamp;
 
-void GraphWriter::value( uint64_t value )
-{
-    ostream_->write( reinterpret_cast<const char*>(&value), sizeof(value) );
+    array( &header, sizeof(header) );
+    array( target_records_.data(), target_records_.size() * sizeof(GraphTargetRecord) );
+    array( filenames_.data(), filenames_.size() * sizeof(uint32_t) );
+    array( children_.data(), children_.size() * sizeof(uint32_t) );
+    array( references_.data(), references_.size() * sizeof(uint32_t) );
+    array( string_records_.data(), string_records_.size() * sizeof(GraphStringRecord) );
+    array( characters_.data(), characters_.size() );
 }
 
-void GraphWriter::value( std::time_t value )
+/**
+// Write the record for the next Target in preorder.
+//
+// Implicit dependencies on Targets that aren't part of the Graph being
+// written are dropped.
+*/
+void GraphWriter::target( const std::string& id, int64_t last_write_time, uint64_t hash, int64_t content_timestamp, uint64_t content_hash, uint64_t signature, bool built, bool cutoff, const std::vector<std::string>& filenames, const std::vector<Target*>& targets, const std::vector<Target*>& implicit_dependencies )
 {
-    ostream_->write( reinterpret_cast<const char*>(&value), sizeof(value) );
-}
+    GraphTargetRecord record;
+    memset( &record, 0, sizeof(record) );
+    record.last_write_time = last_write_time;
+    record.hash = hash;
+    record.content_timestamp = content_timestamp;
+    record.content_hash = content_hash;
+    record.signature = signature;
+    record.id = intern( id );
+    record.built = built ? 1 : 0;
+    record.cutoff = cutoff ? 1 : 0;
 
-void GraphWriter::value( const std::string& value )
-{
-    size_t size = value.size();
-    ostream_->write( reinterpret_cast<const char*>(&size), sizeof(size) );
-    ostream_->write( reinterpret_cast<const char*>(value.c_str()), size );
-}
+    record.filenames = uint32_t(filenames_.size());
+    for ( vector<string>::const_iterator i = filenames.begin(); i != filenames.end(); ++i )
+    {
+        filenames_.push_back( intern(*i) );
+    }
+    record.filenames_size = uint32_t(filenames_.size()) - record.filenames;
 
-void GraphWriter::value( const char* value, size_t size )
-{
-    ostream_->write( value, size );
-}
+    record.children = uint32_t(children_.size());
+    for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+    {
+        unordered_map<const Target*, uint32_t>::const_iterator index = index_by_target_.find( *i );
+        SWEET_ASSERT( index != index_by_target_.end() );
+        children_.push_back( index->second );
+    }
+    record.children_size = uint32_t(children_.size()) - record.children;
 
-void GraphWriter::value( const std::vector<std::string>& values )
-{
-    size_t length = values.size();
-    ostream_->write( reinterpret_cast<const char*>(&length), sizeof(length) );
-    for ( vector<string>::const_iterator i = values.begin(); i != values.end(); ++i )
+    record.references = uint32_t(references_.size());
+    for ( vector<Target*>::const_iterator i = implicit_dependencies.begin(); i != implicit_dependencies.end(); ++i )
     {
-        value( *i );
+        unordered_map<const Target*, uint32_t>::const_iterator index = index_by_target_.find( *i );
+        if ( index != index_by_target_.end() )
+        {
+            references_.push_back( index->second );
+        }
     }
+    record.references_size = uint32_t(references_.size()) - record.references;
+
+    target_records_.push_back( record );
 }
 
-void GraphWriter::value( const std::vector<Target*>& values )
+/**
+// Add \e value to the string table.
+//
+// Strings that are already in the string table aren't added again.
+//
+// @param value
+//  The string to add.
+//
+// @return
+//  The index of the string in the string table.
+*/
+uint32_t GraphWriter::intern( const std::string& value )
 {
-    size_t length = values.size();
-    ostream_->write( reinterpret_cast<const char*>(&length), sizeof(length) );
-    for ( vector<Target*>::const_iterator i = values.begin(); i != values.end(); ++i )
+    unordered_map<std::string, uint32_t>::const_iterator i = index_by_string_.find( value );
+    if ( i != index_by_string_.end() )
     {
-        Target* target = *i;
-        SWEET_ASSERT( target );
-        target->write( *this );
+        return i->second;
     }
+
+    uint32_t index = uint32_t(string_records_.size());
+    GraphStringRecord record;
+    record.offset = characters_.size();
+    record.length = value.size();
+    string_records_.push_back( record );
+    characters_.append( value );
+    index_by_string_.insert( make_pair(value, index) );
+    return index;
 }
 
-void GraphWriter::refer( const std::vector<Target*>& values )
+/**
+// Write an array of \e size bytes padded to the next 8 byte boundary.
+//
+// @param data
+//  The array to write.
+//
+// @param size
+//  The size of the array in bytes.
+*/
+void GraphWriter::array( const void* data, size_t size )
 {
-    size_t length = values.size();
-    ostream_->write( reinterpret_cast<const char*>(&length), sizeof(length) );
-    for ( vector<Target*>::const_iterator i = values.begin(); i != values.end(); ++i )
-    {
-        Target* target = *i;
-        SWEET_ASSERT( target );
-        ostream_->write( reinterpret_cast<const char*>(&target), sizeof(target) );
-    }
+    const char PADDING [8] = { 0 };
+    ostream_->write( reinterpret_cast<const char*>(data), size );
+    ostream_->write( PADDING, (8 - size % 8) % 8 );
 }
@@ -1,11 +1,11 @@
 #ifndef FORGE_GRAPHWRITER_HPP_INCLUDED
 #define FORGE_GRAPHWRITER_HPP_INCLUDED
 
+#include "GraphFormat.hpp"
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <ostream>
-#include <memory>
-#include <ctime>
 #include <stdint.h>
 
 namespace sweet
@@ -16,23 +16,33 @@ namespace forge
 
 class Target;
 
+/**
+// Write a dependency graph to a cache file.
+//
+// See `GraphHeader` for the layout of the file.  Records, indices, and the
+// string table are gathered in memory and then written out as a handful of
+// contiguous arrays.
+*/
 class GraphWriter
 {
-    std::ostream* ostream_;
+    std::ostream* ostream_; ///< The stream to write to.
+    std::unordered_map<const Target*, uint32_t> index_by_target_; ///< The index of each Target's record.
+    std::unordered_map<std::string, uint32_t> index_by_string_; ///< The index of each string in the string table.
+    std::vector<GraphTargetRecord> target_records_; ///< The target records in preorder.
+    std::vector<uint32_t> filenames_; ///< The filename indices of all Targets.
+    std::vector<uint32_t> children_; ///< The child target indices of all Targets.
+    std::vector<uint32_t> references_; ///< The implicit dependency target indices of all Targets.
+    std::vector<GraphStringRecord> string_records_; ///< The string records of the string table.
+    std::string characters_; ///< The characters of all strings.
 
 public:
     GraphWriter( std::ostream* ostream );
-    void write( Target* root_target );
-    void object_address( const void* address );
-    void value( bool value );
-    void value( int value );
-    void value( uint64_t value );
-    void value( std::time_t value );
-    void value( const std::string& value );
-    void value( const char* value, size_t size );
-    void value( const std::vector<std::string>& values );
-    void value( const std::vector<Target*>& values );
-    void refer( const std::vector<Target*>& references );
+    void write( Target* root_target, int64_t racy_timestamp );
+    void target( const std::string& id, int64_t last_write_time, uint64_t hash, int64_t content_timestamp, uint64_t content_hash, uint64_t signature, bool built, bool cutoff, const std::vector<std::string>& filenames, const std::vector<Target*>& targets, const std::vector<Target*>& implicit_dependencies );
+
+private:
+    uint32_t intern( const std::string& value );
+    void array( const void* data, size_t size );
 };
 
 }
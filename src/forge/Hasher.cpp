@@ -0,0 +1,226 @@
+//
+// Hasher.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "Hasher.hpp"
+#include <assert/assert.hpp>
+#include <string.h>
+
+using namespace sweet;
+using namespace sweet::forge;
+
+static const uint64_t PRIME1 = 0x9e3779b185ebca87ULL;
+static const uint64_t PRIME2 = 0xc2b2ae3d27d4eb4fULL;
+static const uint64_t PRIME3 = 0x165667b19e3779f9ULL;
+static const uint64_t PRIME4 = 0x85ebca77c2b2ae63ULL;
+static const uint64_t PRIME5 = 0x27d4eb2f165667c5ULL;
+
+static inline uint64_t rotate_left( uint64_t value, int bits )
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t read64( const unsigned char* data )
+{
+    uint64_t value;
+    memcpy( &value, data, sizeof(value) );
+    return value;
+}
+
+static inline uint32_t read32( const unsigned char* data )
+{
+    uint32_t value;
+    memcpy( &value, data, sizeof(value) );
+    return value;
+}
+
+static inline uint64_t accumulate( uint64_t accumulator, uint64_t input )
+{
+    accumulator += input * PRIME2;
+    accumulator = rotate_left( accumulator, 31 );
+    return accumulator * PRIME1;
+}
+
+static inline uint64_t merge( uint64_t hash, uint64_t accumulator )
+{
+    hash ^= accumulate( 0, accumulator );
+    return hash * PRIME1 + PRIME4;
+}
+
+static inline uint64_t converge( const uint64_t* accumulators )
+{
+    uint64_t hash =
+        rotate_left( accumulators[0], 1 ) +
+        rotate_left( accumulators[1], 7 ) +
+        rotate_left( accumulators[2], 12 ) +
+        rotate_left( accumulators[3], 18 )
+    ;
+    hash = merge( hash, accumulators[0] );
+    hash = merge( hash, accumulators[1] );
+    hash = merge( hash, accumulators[2] );
+    hash = merge( hash, accumulators[3] );
+    return hash;
+}
+
+static inline uint64_t finish( uint64_t hash, const unsigned char* position, const unsigned char* end )
+{
+    while ( end - position >= 8 )
+    {
+        hash ^= accumulate( 0, read64(position) );
+        hash = rotate_left( hash, 27 ) * PRIME1 + PRIME4;
+        position += 8;
+    }
+    if ( end - position >= 4 )
+    {
+        hash ^= uint64_t(read32(position)) * PRIME1;
+        hash = rotate_left( hash, 23 ) * PRIME2 + PRIME3;
+        position += 4;
+    }
+    while ( position < end )
+    {
+        hash ^= uint64_t(*position) * PRIME5;
+        hash = rotate_left( hash, 11 ) * PRIME1;
+        ++position;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/**
+// Constructor.
+//
+// @param seed
+//  The value to seed the hash with.
+*/
+Hasher::Hasher( uint64_t seed )
+: seed_( seed ),
+  buffered_( 0 ),
+  length_( 0 )
+{
+    accumulators_[0] = seed + PRIME1 + PRIME2;
+    accumulators_[1] = seed + PRIME2;
+    accumulators_[2] = seed;
+    accumulators_[3] = seed - PRIME1;
+}
+
+/**
+// Append \e size bytes at \e data to the data being hashed.
+//
+// @param data
+//  The first byte to append (may be null only if \e size is 0).
+//
+// @param size
+//  The number of bytes to append.
+*/
+void Hasher::append( const void* data, size_t size )
+{
+    SWEET_ASSERT( data || size == 0 );
+
+    const unsigned char* position = static_cast<const unsigned char*>( data );
+    const unsigned char* end = position + size;
+    length_ += size;
+
+    if ( buffered_ > 0 )
+    {
+        size_t available = sizeof(buffer_) - buffered_;
+        if ( size < available )
+        {
+            memcpy( buffer_ + buffered_, position, size );
+            buffered_ += size;
+            return;
+        }
+        memcpy( buffer_ + buffered_, position, available );
+        consume( buffer_ );
+        position += available;
+        buffered_ = 0;
+    }
+
+    while ( end - position >= ptrdiff_t(sizeof(buffer_)) )
+    {
+        consume( position );
+        position += sizeof(buffer_);
+    }
+
+    buffered_ = size_t(end - position);
+    if ( buffered_ > 0 )
+    {
+        memcpy( buffer_, position, buffered_ );
+    }
+}
+
+/**
+// Get the hash of the data appended so far.
+//
+// @return
+//  The hash value.
+*/
+uint64_t Hasher::value() const
+{
+    uint64_t hash = length_ >= sizeof(buffer_) ? converge( accumulators_ ) : seed_ + PRIME5;
+    hash += length_;
+    return finish( hash, buffer_, buffer_ + buffered_ );
+}
+
+/**
+// Calculate the hash of \e size bytes at \e data.
+//
+// Reads stripes directly from \e data rather than through the buffer used
+// by `append()` so that many short values, like the strings in settings
+// tables, hash quickly.  The hash is the same as that calculated by
+// appending the same bytes to a Hasher.
+//
+// @param data
+//  The first byte to hash (may be null only if \e size is 0).
+//
+// @param size
+//  The number of bytes to hash.
+//
+// @param seed
+//  The value to seed the hash with.
+//
+// @return
+//  The hash value.
+*/
+uint64_t Hasher::hash( const void* data, size_t size, uint64_t seed )
+{
+    SWEET_ASSERT( data || size == 0 );
+
+    const unsigned char* position = static_cast<const unsigned char*>( data );
+    const unsigned char* end = position + size;
+    uint64_t hash = seed + PRIME5;
+    if ( size >= 32 )
+    {
+        uint64_t accumulators [4] = { seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1 };
+        while ( end - position >= 32 )
+        {
+            accumulators[0] = accumulate( accumulators[0], read64(position) );
+            accumulators[1] = accumulate( accumulators[1], read64(position + 8) );
+            accumulators[2] = accumulate( accumulators[2], read64(position + 16) );
+            accumulators[3] = accumulate( accumulators[3], read64(position + 24) );
+            position += 32;
+        }
+        hash = converge( accumulators );
+    }
+    hash += size;
+    return finish( hash, position, end );
+}
+
+/**
+// Consume a whole 32 byte stripe into the accumulators.
+//
+// @param stripe
+//  The first byte of the stripe.
+*/
+void Hasher::consume( const unsigned char* stripe )
+{
+    accumulators_[0] = accumulate( accumulators_[0], read64(stripe) );
+    accumulators_[1] = accumulate( accumulators_[1], read64(stripe + 8) );
+    accumulators_[2] = accumulate( accumulators_[2], read64(stripe + 16) );
+    accumulators_[3] = accumulate( accumulators_[3], read64(stripe + 24) );
+}
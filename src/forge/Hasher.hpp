@@ -0,0 +1,43 @@
+#ifndef FORGE_HASHER_HPP_INCLUDED
+#define FORGE_HASHER_HPP_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace sweet
+{
+
+namespace forge
+{
+
+/**
+// Calculate a 64 bit hash of data appended in any number of pieces.
+//
+// The hash is XXH64; four independent accumulators each consume 8 bytes of
+// every 32 byte stripe so that large inputs, like the contents of files,
+// hash at close to memory bandwidth.  The value depends only on the bytes
+// appended and not on how they were split between calls to `append()`.
+*/
+class Hasher
+{
+    uint64_t seed_; ///< The seed that the hash was started with.
+    uint64_t accumulators_ [4]; ///< The accumulators for each 8 byte lane of a stripe.
+    unsigned char buffer_ [32]; ///< Bytes appended that don't yet make up a whole stripe.
+    size_t buffered_; ///< The number of bytes in `buffer_`.
+    uint64_t length_; ///< The total number of bytes appended.
+
+    public:
+        Hasher( uint64_t seed = 0 );
+        void append( const void* data, size_t size );
+        uint64_t value() const;
+        static uint64_t hash( const void* data, size_t size, uint64_t seed = 0 );
+
+    private:
+        void consume( const unsigned char* stripe );
+};
+
+}
+
+}
+
+#endif
@@ -44,10 +44,10 @@ Reader::~Reader()
     stop();
 }
 
-void Reader::read( intptr_t fd_or_handle, Filter* filter, Arguments* arguments, Target* working_directory )
+void Reader::read( intptr_t fd_or_handle, Filter* filter, Arguments* arguments, Target* working_directory, Target* target, int stream )
 {
     std::unique_lock<std::mutex> lock( jobs_mutex_ );
-    jobs_.push_back( std::bind(&Reader::thread_read, this, fd_or_handle, filter, arguments, working_directory) );
+    jobs_.push_back( std::bind(&Reader::thread_read, this, fd_or_handle, filter, arguments, working_directory, target, stream) );
     ++active_jobs_;
     while ( active_jobs_ > int(threads_.size()) )
     {
@@ -88,7 +88,7 @@ void Reader::thread_process()
     }
 }
 
-void Reader::thread_read( intptr_t fd_or_handle, Filter* filter, Arguments* arguments, Target* working_directory )
+void Reader::thread_read( intptr_t fd_or_handle, Filter* filter, Arguments* arguments, Target* working_directory, Target* target, int stream )
 {
     SWEET_ASSERT( forge_ );
     
@@ -106,7 +106,7 @@ void Reader::thread_read( intptr_t fd_or_handle, Filter* filter, Arguments* argu
         while ( pos != finish )
         {
             *pos = 0;
-            forge_->scheduler()->push_output( string(start, pos), filter, arguments, working_directory );
+            forge_->scheduler()->push_output( string(start, pos), filter, arguments, working_directory, target, stream );
             start = pos + 1;
             pos = std::find( start, finish, '\n' );
         }
@@ -118,7 +118,7 @@ void Reader::thread_read( intptr_t fd_or_handle, Filter* filter, Arguments* argu
         else if ( finish >= end )
         {
             *finish = 0;
-            forge_->scheduler()->push_output( string(start, finish), filter, arguments, working_directory );
+            forge_->scheduler()->push_output( string(start, finish), filter, arguments, working_directory, target, stream );
             start = buffer;
             finish = buffer;
         }
@@ -130,7 +130,7 @@ void Reader::thread_read( intptr_t fd_or_handle, Filter* filter, Arguments* argu
     if ( pos > buffer )
     {
         *pos = 0;
-        forge_->scheduler()->push_output( string(buffer, pos), filter, arguments, working_directory );
+        forge_->scheduler()->push_output( string(buffer, pos), filter, arguments, working_directory, target, stream );
     }
 
     Reader::close( fd_or_handle );
@@ -33,12 +33,12 @@ class Reader
 public:
     Reader( Forge* forge );
     ~Reader();
-    void read( intptr_t fd_or_handle, Filter* filter, Arguments* arguments, Target* working_directory );
+    void read( intptr_t fd_or_handle, Filter* filter, Arguments* arguments, Target* working_directory, Target* target, int stream );
 
 private:
     static int thread_main( void* context );
     void thread_process();
-    void thread_read( intptr_t fd_or_handle, Filter* filter, Arguments* arguments, Target* working_directory );
+    void thread_read( intptr_t fd_or_handle, Filter* filter, Arguments* arguments, Target* working_directory, Target* target, int stream );
     void stop();
     size_t read( intptr_t fd_or_handle, void* buffer, size_t length ) const;
     void close( intptr_t fd_or_handle ) const;
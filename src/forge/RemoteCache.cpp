@@ -0,0 +1,503 @@
+//
+// RemoteCache.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "RemoteCache.hpp"
+#include <assert/assert.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(BUILD_OS_WINDOWS)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+
+using std::min;
+using std::string;
+using std::vector;
+using std::thread;
+using namespace sweet;
+using namespace sweet::forge;
+
+#if defined(BUILD_OS_WINDOWS)
+typedef SOCKET Socket;
+static const Socket NO_SOCKET = INVALID_SOCKET;
+static void close_socket( Socket socket ) { ::closesocket( socket ); }
+#else
+typedef int Socket;
+static const Socket NO_SOCKET = -1;
+static void close_socket( Socket socket ) { ::close( socket ); }
+#endif
+
+#if defined(MSG_NOSIGNAL)
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+/**
+// The number of seconds to wait for a remote cache to send or receive data
+// before failing a request.
+*/
+static const int TIMEOUT = 30;
+
+/**
+// The number of consecutive requests that fail to connect before the remote
+// cache is disabled for the rest of the run.
+*/
+static const int MAXIMUM_CONNECTION_FAILURES = 3;
+
+/**
+// Constructor.
+*/
+RemoteCache::RemoteCache()
+: url_(),
+  host_(),
+  port_(),
+  prefix_(),
+  maximum_downloads_( 8 ),
+  connection_failures_( 0 ),
+  downloads_( 0 ),
+  uploads_( 0 ),
+  failures_( 0 ),
+  uploads_mutex_(),
+  uploads_condition_(),
+  queued_uploads_(),
+  uploader_(),
+  stopping_( false )
+{
+}
+
+/**
+// Destructor.
+//
+// Waits for queued uploads to finish.
+*/
+RemoteCache::~RemoteCache()
+{
+    if ( uploader_.joinable() )
+    {
+        std::unique_lock<std::mutex> lock( uploads_mutex_ );
+        stopping_ = true;
+        uploads_condition_.notify_all();
+        lock.unlock();
+        uploader_.join();
+    }
+}
+
+/**
+// Set the URL of the remote cache.
+//
+// Only plain HTTP URLs of the form `http://host[:port][/path]` are
+// supported.
+//
+// @param url
+//  The URL of the remote cache or the empty string to disable it.
+*/
+void RemoteCache::set_url( const std::string& url )
+{
+    url_.clear();
+    host_.clear();
+    port_.clear();
+    prefix_.clear();
+    connection_failures_ = 0;
+    if ( url.empty() )
+    {
+        return;
+    }
+
+    const string SCHEME = "http://";
+    if ( url.compare(0, SCHEME.size(), SCHEME) != 0 )
+    {
+        throw std::runtime_error( "Remote artifact cache URL '" + url + "' isn't an http:// URL" );
+    }
+
+    string::size_type authority = SCHEME.size();
+    string::size_type path = url.find( '/', authority );
+    if ( path == string::npos )
+    {
+        path = url.size();
+    }
+    string::size_type colon = url.find( ':', authority );
+    if ( colon != string::npos && colon < path )
+    {
+        host_ = url.substr( authority, colon - authority );
+        port_ = url.substr( colon + 1, path - colon - 1 );
+    }
+    else
+    {
+        host_ = url.substr( authority, path - authority );
+        port_ = "80";
+    }
+    prefix_ = path < url.size() ? url.substr( path ) : string( "/" );
+    if ( prefix_.back() != '/' )
+    {
+        prefix_ += '/';
+    }
+
+    if ( host_.empty() || port_.empty() || port_.find_first_not_of("0123456789") != string::npos )
+    {
+        host_.clear();
+        port_.clear();
+        prefix_.clear();
+        throw std::runtime_error( "Remote artifact cache URL '" + url + "' is malformed" );
+    }
+
+#if defined(BUILD_OS_WINDOWS)
+    static WSADATA wsa_data;
+    static int startup = ::WSAStartup( MAKEWORD(2, 2), &wsa_data );
+    (void) startup;
+#endif
+    url_ = url;
+}
+
+/**
+// Get the URL of the remote cache.
+//
+// @return
+//  The URL or the empty string if the remote cache is disabled.
+*/
+const std::string& RemoteCache::url() const
+{
+    return url_;
+}
+
+/**
+// Is the remote cache enabled?
+//
+// @return
+//  True if a URL has been set and too many requests haven't failed to
+//  connect otherwise false.
+*/
+bool RemoteCache::enabled() const
+{
+    return !url_.empty() && connection_failures_ < MAXIMUM_CONNECTION_FAILURES;
+}
+
+/**
+// Set the maximum number of blobs downloaded at once.
+//
+// @param maximum_downloads
+//  The maximum number of concurrent downloads (values less than one are
+//  treated as one).
+*/
+void RemoteCache::set_maximum_downloads( int maximum_downloads )
+{
+    maximum_downloads_ = std::max( maximum_downloads, 1 );
+}
+
+/**
+// Get the maximum number of blobs downloaded at once.
+*/
+int RemoteCache::maximum_downloads() const
+{
+    return maximum_downloads_;
+}
+
+/**
+// Get the number of records and blobs downloaded in this run.
+*/
+int RemoteCache::downloads() const
+{
+    return downloads_;
+}
+
+/**
+// Get the number of records and blobs uploaded in this run.
+*/
+int RemoteCache::uploads() const
+{
+    return uploads_;
+}
+
+/**
+// Get the number of requests that failed in this run.
+//
+// Requests for paths that aren't in the remote cache aren't failures.
+*/
+int RemoteCache::failures() const
+{
+    return failures_;
+}
+
+/**
+// Get the content at \e path in the remote cache.
+//
+// @param path
+//  The path to get relative to the URL of the remote cache.
+//
+// @param content
+//  Receives the content (assumed not null).
+//
+// @return
+//  True if the remote cache returned the content otherwise false.
+*/
+bool RemoteCache::get( const std::string& path, std::string* content )
+{
+    SWEET_ASSERT( content );
+    if ( enabled() && request("GET", path, nullptr, content) )
+    {
+        ++downloads_;
+        return true;
+    }
+    return false;
+}
+
+/**
+// Get the content at each of \e paths in the remote cache.
+//
+// The contents are downloaded by up to `maximum_downloads()` threads at
+// once.  Downloading stops at the first path that isn't returned.
+//
+// @param paths
+//  The paths to get relative to the URL of the remote cache.
+//
+// @param contents
+//  Receives the content of each path in the same order (assumed not null).
+//
+// @return
+//  True if the remote cache returned the content of all of \e paths
+//  otherwise false.
+*/
+bool RemoteCache::get( const std::vector<std::string>& paths, std::vector<std::string>* contents )
+{
+    SWEET_ASSERT( contents );
+
+    contents->clear();
+    contents->resize( paths.size() );
+    std::atomic<int> next( 0 );
+    std::atomic<bool> failed( false );
+    auto download = [&]()
+    {
+        int index = next++;
+        while ( index < int(paths.size()) && !failed )
+        {
+            if ( !get(paths[index], &(*contents)[index]) )
+            {
+                failed = true;
+            }
+            index = next++;
+        }
+    };
+
+    int threads = min( maximum_downloads_, int(paths.size()) );
+    vector<thread> downloaders;
+    downloaders.reserve( std::max(threads - 1, 0) );
+    for ( int i = 1; i < threads; ++i )
+    {
+        downloaders.push_back( thread(download) );
+    }
+    download();
+    for ( vector<thread>::iterator downloader = downloaders.begin(); downloader != downloaders.end(); ++downloader )
+    {
+        downloader->join();
+    }
+    return !failed;
+}
+
+/**
+// Queue \e content to be put at \e path in the remote cache.
+//
+// @param path
+//  The path to put the content at relative to the URL of the remote cache.
+//
+// @param content
+//  The content to put.
+*/
+void RemoteCache::put( const std::string& path, std::string&& content )
+{
+    if ( enabled() )
+    {
+        std::unique_lock<std::mutex> lock( uploads_mutex_ );
+        Upload upload;
+        upload.path_ = path;
+        upload.content_ = std::move( content );
+        queued_uploads_.push_back( std::move(upload) );
+        if ( !uploader_.joinable() )
+        {
+            uploader_ = thread( &RemoteCache::thread_upload, this );
+        }
+        uploads_condition_.notify_all();
+    }
+}
+
+/**
+// Wait for all queued uploads to finish.
+*/
+void RemoteCache::flush()
+{
+    std::unique_lock<std::mutex> lock( uploads_mutex_ );
+    while ( !queued_uploads_.empty() )
+    {
+        uploads_condition_.wait( lock );
+    }
+}
+
+/**
+// Make queued uploads until stopped.
+//
+// Each upload is removed from the queue only once it has finished so that
+// `flush()` doesn't return while an upload is still being made.
+*/
+void RemoteCache::thread_upload()
+{
+    std::unique_lock<std::mutex> lock( uploads_mutex_ );
+    while ( !stopping_ || !queued_uploads_.empty() )
+    {
+        if ( queued_uploads_.empty() )
+        {
+            uploads_condition_.wait( lock );
+            continue;
+        }
+
+        const Upload& upload = queued_uploads_.front();
+        lock.unlock();
+        if ( enabled() && request("PUT", upload.path_, &upload.content_, nullptr) )
+        {
+            ++uploads_;
+        }
+        lock.lock();
+        queued_uploads_.pop_front();
+        uploads_condition_.notify_all();
+    }
+}
+
+/**
+// Make a single HTTP/1.1 request to the remote cache.
+//
+// Each request is made on its own connection that is closed by the server
+// once it has responded.  Only responses with 2xx status codes succeed.
+//
+// @param method
+//  The HTTP method ("GET" or "PUT").
+//
+// @param path
+//  The path relative to the URL of the remote cache.
+//
+// @param content
+//  The body to send or null to send no body.
+//
+// @param response
+//  Receives the body of the response or null to ignore it.
+//
+// @return
+//  True if the request succeeded otherwise false.
+*/
+bool RemoteCache::request( const char* method, const std::string& path, const std::string* content, std::string* response )
+{
+    struct addrinfo hints;
+    memset( &hints, 0, sizeof(hints) );
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* addresses = nullptr;
+    Socket socket = NO_SOCKET;
+    if ( ::getaddrinfo(host_.c_str(), port_.c_str(), &hints, &addresses) == 0 )
+    {
+        for ( struct addrinfo* address = addresses; address && socket == NO_SOCKET; address = address->ai_next )
+        {
+            socket = ::socket( address->ai_family, address->ai_socktype, address->ai_protocol );
+            if ( socket != NO_SOCKET && ::connect(socket, address->ai_addr, int(address->ai_addrlen)) != 0 )
+            {
+                close_socket( socket );
+                socket = NO_SOCKET;
+            }
+        }
+        ::freeaddrinfo( addresses );
+    }
+    if ( socket == NO_SOCKET )
+    {
+        ++connection_failures_;
+        ++failures_;
+        return false;
+    }
+    connection_failures_ = 0;
+
+#if defined(BUILD_OS_WINDOWS)
+    DWORD timeout = TIMEOUT * 1000;
+#else
+    struct timeval timeout = { TIMEOUT, 0 };
+#endif
+    ::setsockopt( socket, SOL_SOCKET, SO_RCVTIMEO, (const char*) &timeout, sizeof(timeout) );
+    ::setsockopt( socket, SOL_SOCKET, SO_SNDTIMEO, (const char*) &timeout, sizeof(timeout) );
+#if defined(SO_NOSIGPIPE)
+    int no_sigpipe = 1;
+    ::setsockopt( socket, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe) );
+#endif
+
+    string request = string( method ) + " " + prefix_ + path + " HTTP/1.1\r\n";
+    request += "Host: " + host_ + ":" + port_ + "\r\n";
+    request += "Content-Length: " + std::to_string( content ? content->size() : 0 ) + "\r\n";
+    request += "Connection: close\r\n\r\n";
+    if ( content )
+    {
+        request += *content;
+    }
+
+    bool sent = true;
+    size_t offset = 0;
+    while ( sent && offset < request.size() )
+    {
+        int bytes = int(::send( socket, request.data() + offset, int(min(request.size() - offset, size_t(1 << 20))), SEND_FLAGS ));
+        sent = bytes > 0;
+        offset += sent ? size_t(bytes) : 0;
+    }
+
+    string received;
+    if ( sent )
+    {
+        char buffer [65536];
+        int bytes = int(::recv( socket, buffer, int(sizeof(buffer)), 0 ));
+        while ( bytes > 0 )
+        {
+            received.append( buffer, size_t(bytes) );
+            bytes = int(::recv( socket, buffer, int(sizeof(buffer)), 0 ));
+        }
+    }
+    close_socket( socket );
+
+    // Parse the status line and the Content-Length header, if any, and
+    // treat everything after the headers as the body.
+    string::size_type headers_end = received.find( "\r\n\r\n" );
+    if ( !sent || headers_end == string::npos || received.compare(0, 5, "HTTP/") != 0 )
+    {
+        ++failures_;
+        return false;
+    }
+    string::size_type space = received.find( ' ' );
+    int status = space < headers_end ? atoi( received.c_str() + space + 1 ) : 0;
+    if ( status < 200 || status >= 300 )
+    {
+        failures_ += status != 404 ? 1 : 0;
+        return false;
+    }
+
+    size_t length = received.size() - headers_end - 4;
+    string headers = received.substr( 0, headers_end );
+    std::transform( headers.begin(), headers.end(), headers.begin(), ::tolower );
+    string::size_type content_length = headers.find( "\r\ncontent-length:" );
+    if ( content_length != string::npos )
+    {
+        size_t expected = size_t(strtoull( headers.c_str() + content_length + 17, nullptr, 10 ));
+        if ( expected > length )
+        {
+            ++failures_;
+            return false;
+        }
+        length = expected;
+    }
+    if ( response )
+    {
+        response->assign( received, headers_end + 4, length );
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef FORGE_REMOTECACHE_HPP_INCLUDED
+#define FORGE_REMOTECACHE_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace sweet
+{
+
+namespace forge
+{
+
+/**
+// Get and put records and blobs in a remote artifact cache over HTTP.
+//
+// The remote cache is a plain HTTP/1.1 server that stores the bodies of PUT
+// requests and returns them from GET requests for the same path.  Paths
+// under `ac/` hold manifests and action results keyed by the keys that the
+// ArtifactCache calculates and paths under `cas/` hold the contents of files
+// keyed by the hash of those contents.  The `forge_cache` executable is a
+// minimal server suitable for local testing and small teams.
+//
+// Gets are made synchronously with the blobs for a single action result
+// downloaded by at most `maximum_downloads()` threads at once.  Puts are
+// queued and made by a background thread so that the build isn't held up
+// waiting for uploads; queued puts are finished before the RemoteCache is
+// destroyed.  The remote cache is disabled for the rest of the run after
+// several consecutive requests fail to connect.
+*/
+class RemoteCache
+{
+    /**
+    // A queued put of a record or blob.
+    */
+    struct Upload
+    {
+        std::string path_; ///< The path to put the content at relative to the URL.
+        std::string content_; ///< The content to put.
+    };
+
+    std::string url_; ///< The URL of the remote cache or empty if disabled.
+    std::string host_; ///< The host name parsed from the URL.
+    std::string port_; ///< The port parsed from the URL.
+    std::string prefix_; ///< The path parsed from the URL with a trailing slash.
+    int maximum_downloads_; ///< The maximum number of concurrent downloads.
+    std::atomic<int> connection_failures_; ///< The number of consecutive requests that failed to connect.
+    std::atomic<int> downloads_; ///< The number of blobs and records downloaded.
+    std::atomic<int> uploads_; ///< The number of blobs and records uploaded.
+    std::atomic<int> failures_; ///< The number of requests that failed.
+    std::mutex uploads_mutex_; ///< Guards the queue of uploads.
+    std::condition_variable uploads_condition_; ///< Signals the uploader when uploads are queued or it is stopping.
+    std::deque<Upload> queued_uploads_; ///< The queued uploads.
+    std::thread uploader_; ///< The thread that makes queued uploads.
+    bool stopping_; ///< True when the uploader should exit once its queue is empty.
+
+public:
+    RemoteCache();
+    ~RemoteCache();
+    void set_url( const std::string& url );
+    const std::string& url() const;
+    bool enabled() const;
+    void set_maximum_downloads( int maximum_downloads );
+    int maximum_downloads() const;
+    int downloads() const;
+    int uploads() const;
+    int failures() const;
+    bool get( const std::string& path, std::string* content );
+    bool get( const std::vector<std::string>& paths, std::vector<std::string>* contents );
+    void put( const std::string& path, std::string&& content );
+    void flush();
+
+private:
+    void thread_upload();
+    bool request( const char* method, const std::string& path, const std::string* content, std::string* response );
+};
+
+}
+
+}
+
+#endif
@@ -13,6 +13,10 @@
 #include "Reader.hpp"
 #include "Filter.hpp"
 #include "Arguments.hpp"
+#include "GraphSnapshot.hpp"
+#include "ArtifactCache.hpp"
+#include "System.hpp"
+#include "ChunkCache.hpp"
 #include <process/Environment.hpp>
 #include <luaxx/luaxx.hpp>
 #include <error/ErrorPolicy.hpp>
@@ -24,6 +28,7 @@
 
 using std::sort;
 using std::list;
+using std::pair;
 using std::vector;
 using std::string;
 using std::unique_ptr;
@@ -120,6 +125,12 @@ void Scheduler::postorder_visit( int function, Job* job )
 {
     SWEET_ASSERT( job );
 
+    // Dependencies visited earlier in this traversal may have changed the
+    // timestamps they were bound with; they may have been rebuilt without
+    // changing the contents of their files or outdated by a changed command
+    // signature.
+    job->target()->rebind_to_dependencies();
+
     if ( job->target()->buildable() )
     {
         Context* context = allocate_context( job->working_directory(), job );
@@ -147,10 +158,18 @@ void Scheduler::postorder_visit( int function, Job* job )
     }    
 }
 
-void Scheduler::execute_finished( int exit_code, Context* context, process::Environment* environment )
+void Scheduler::execute_finished( int exit_code, Context* context, process::Environment* environment, bool writes_reported )
 {
     SWEET_ASSERT( context );
 
+    // Files written by the command are invalidated in the System's cache 
+    // as their writes are reported on the dependencies stream.  Without 
+    // those reports any cached status may be stale so they're all discarded.
+    if ( !writes_reported )
+    {
+        forge_->system()->invalidate_all();
+    }
+
     process_begin( context );
     lua_State* lua_state = context->lua_state();
     lua_pushinteger( lua_state, exit_code );
@@ -185,9 +204,19 @@ void Scheduler::buildfile_finished( Context* context, bool success )
     }
 }
 
-void Scheduler::output( const std::string& output, Filter* filter, Arguments* arguments, Target* working_directory )
+void Scheduler::output( const std::string& output, Filter* filter, Arguments* arguments, Target* working_directory, Target* target, int stream )
 {
     SWEET_ASSERT( forge_ );
+    if ( target )
+    {
+        forge_->artifact_cache()->capture( target, stream, output );
+    }
+
+    if ( stream == OUTPUT_DEPENDENCIES )
+    {
+        invalidate_written_file( output, working_directory );
+    }
+
     if ( filter )
     {
         Context* context = allocate_context( working_directory );
@@ -209,16 +238,32 @@ void Scheduler::output( const std::string& output, Filter* filter, Arguments* ar
     }
 }
 
+void Scheduler::invalidate_written_file( const std::string& output, Target* working_directory )
+{
+    const char* WRITE = "== write '";
+    const size_t WRITE_LENGTH = 10;
+    if ( output.compare(0, WRITE_LENGTH, WRITE) == 0 && output.size() > WRITE_LENGTH + 1 )
+    {
+        string::size_type quote = output.find( '\'', WRITE_LENGTH );
+        boost::filesystem::path path( output.substr(WRITE_LENGTH, quote - WRITE_LENGTH) );
+        if ( !path.is_absolute() && working_directory )
+        {
+            path = boost::filesystem::path( working_directory->path() ) / path;
+        }
+        forge_->system()->invalidate( path.string() );
+    }
+}
+
 void Scheduler::error( const std::string& what )
 {
     SWEET_ASSERT( forge_ );
     forge_->error( what.c_str() );
 }
 
-void Scheduler::push_output( const std::string& output, Filter* filter, Arguments* arguments, Target* working_directory )
+void Scheduler::push_output( const std::string& output, Filter* filter, Arguments* arguments, Target* working_directory, Target* target, int stream )
 {
     std::unique_lock<std::mutex> lock( results_mutex_ );
-    results_.push_back( std::bind(&Scheduler::output, this, output, filter, arguments, working_directory) );
+    results_.push_back( std::bind(&Scheduler::output, this, output, filter, arguments, working_directory, target, stream) );
     results_condition_.notify_all();
 }
 
@@ -235,11 +280,11 @@ void Scheduler::push_errorf( const char* format, ... )
     results_condition_.notify_all();
 }
 
-void Scheduler::push_execute_finished( int exit_code, Context* context, process::Environment* environment )
+void Scheduler::push_execute_finished( int exit_code, Context* context, process::Environment* environment, bool writes_reported )
 {
     std::unique_lock<std::mutex> lock( results_mutex_ );
     --execute_jobs_;
-    results_.push_back( std::bind(&Scheduler::execute_finished, this, exit_code, context, environment) );
+    results_.push_back( std::bind(&Scheduler::execute_finished, this, exit_code, context, environment, writes_reported) );
     results_condition_.notify_all();
 }
 
@@ -259,10 +304,10 @@ void Scheduler::execute( const std::string& command, const std::string& command_
     ++execute_jobs_;
 }
 
-void Scheduler::read( intptr_t fd_or_handle, Filter* filter, Arguments* arguments, Target* working_directory )
+void Scheduler::read( intptr_t fd_or_handle, Filter* filter, Arguments* arguments, Target* working_directory, Target* target, int stream )
 {
     std::unique_lock<std::mutex> lock( results_mutex_ );
-    forge_->reader()->read( fd_or_handle, filter, arguments, working_directory );
+    forge_->reader()->read( fd_or_handle, filter, arguments, working_directory, target, stream );
     ++read_jobs_;
 }
 
@@ -275,34 +320,18 @@ void Scheduler::wait()
 
 int Scheduler::postorder( Target* target, int function )
 {
-    struct ScopedVisit
-    {
-        Target* target_;
-
-        ScopedVisit( Target* target )
-        : target_( target )
-        {
-            SWEET_ASSERT( target_ );
-            SWEET_ASSERT( !target_->visiting() );
-            target_->set_visited( true );
-            target_->set_visiting( true );
-        }
-
-        ~ScopedVisit()
-        {
-            SWEET_ASSERT( target_->visiting() );
-            target_->set_visiting( false );
-        }
-    };
-
     struct Postorder
     {
         Forge* forge_;
+        GraphSnapshot snapshot_;
+        vector<int> heights_;
         list<Job> jobs_;
         int failures_;
         
         Postorder( Forge* forge )
         : forge_( forge ),
+          snapshot_( forge->graph() ),
+          heights_(),
           jobs_(),
           failures_( 0 )
         {
@@ -365,33 +394,38 @@ int Scheduler::postorder( Target* target, int function )
         {
             SWEET_ASSERT( target );
 
-            if ( !target->visited() )
+            snapshot_.build( target );
+
+            const vector<pair<Target*, Target*>>& cyclic_dependencies = snapshot_.cyclic_dependencies();
+            for ( vector<pair<Target*, Target*>>::const_iterator i = cyclic_dependencies.begin(); i != cyclic_dependencies.end(); ++i )
             {
-                ScopedVisit visit( target );
+                Target* target = i->first;
+                Target* dependency = i->second;
+                forge_->errorf( "Cyclic dependency from %s to %s in postorder traversal", target->error_identifier().c_str(), dependency->error_identifier().c_str() );
+                dependency->set_successful( true );
+                ++failures_;
+            }
 
+            // Dependencies with higher indices than the Targets that depend
+            // on them are cyclic and don't contribute to height.
+            int size = snapshot_.size();
+            heights_.assign( size, -1 );
+            for ( int index = 0; index < size; ++index )
+            {
                 int height = 0;
-                int i = 0;
-                Target* dependency = target->any_dependency( i );
-                while ( dependency )
+                const int* end = snapshot_.dependencies_end( index );
+                for ( const int* dependency = snapshot_.dependencies_begin(index); dependency != end; ++dependency )
                 {
-                    if ( !dependency->visiting() )
-                    {
-                        Postorder::visit( dependency );
-                        height = std::max( height, dependency->postorder_height() + 1 );
-                    }
-                    else
+                    if ( *dependency < index )
                     {
-                        forge_->errorf( "Cyclic dependency from %s to %s in postorder traversal", target->error_identifier().c_str(), dependency->error_identifier().c_str() );
-                        dependency->set_successful( true );
-                        ++failures_;
+                        height = std::max( height, heights_[*dependency] + 1 );
                     }
-
-                    ++i;
-                    dependency = target->any_dependency( i );
                 }
 
+                Target* target = snapshot_.target( index );
                 if ( target->referenced_by_script() && target->working_directory() )
                 {
+                    heights_[index] = height;
                     target->set_postorder_height( height );
                     jobs_.push_back( Job(target, height) );
                 }
@@ -430,6 +464,7 @@ int Scheduler::postorder( Target* target, int function )
             dispatch_results();
         }
         wait();
+        forge_->artifact_cache()->store();
     }
     return failures_;
 }
@@ -457,6 +492,13 @@ void Scheduler::free_context( Context* context )
     if ( job )
     {
         job->set_state( JOB_COMPLETE );
+        const vector<string>& filenames = job->target()->filenames();
+        for ( vector<string>::const_iterator filename = filenames.begin(); filename != filenames.end(); ++filename )
+        {
+            forge_->system()->invalidate( *filename );
+        }
+        job->target()->bind_to_content();
+        forge_->graph()->checkpoint( job->target() );
     }
 
     delete context;
@@ -539,7 +581,7 @@ void Scheduler::dofile( lua_State* lua_state, const char* filename )
 {
     SWEET_ASSERT( lua_state );
     SWEET_ASSERT( filename );
-    int result = luaL_loadfile( lua_state, filename );
+    int result = forge_->chunk_cache()->load( lua_state, filename );
     switch ( result )
     {
         case LUA_OK:
@@ -57,19 +57,20 @@ class Scheduler
         int buildfile( const boost::filesystem::path& path );
         void call( const boost::filesystem::path& path, const std::string& function );
         void postorder_visit( int function, Job* job );
-        void execute_finished( int exit_code, Context* context, process::Environment* environment );
+        void execute_finished( int exit_code, Context* context, process::Environment* environment, bool writes_reported );
         void read_finished( Filter* filter, Arguments* arguments );
         void buildfile_finished( Context* context, bool success );
-        void output( const std::string& output, Filter* filter, Arguments* arguments, Target* working_directory );
+        void output( const std::string& output, Filter* filter, Arguments* arguments, Target* working_directory, Target* target, int stream );
+        void invalidate_written_file( const std::string& output, Target* working_directory );
         void error( const std::string& what );
 
-        void push_output( const std::string& output, Filter* filter, Arguments* arguments, Target* working_directory );
+        void push_output( const std::string& output, Filter* filter, Arguments* arguments, Target* working_directory, Target* target, int stream );
         void push_errorf( const char* format, ... );
-        void push_execute_finished( int exit_code, Context* context, process::Environment* environment );
+        void push_execute_finished( int exit_code, Context* context, process::Environment* environment, bool writes_reported );
         void push_read_finished( Filter* filter, Arguments* arguments );
 
         void execute( const std::string& command, const std::string& command_line, process::Environment* environment, Filter* dependencies_filter, Filter* stdout_filter, Filter* stderr_filter, Arguments* arguments, Context* context );
-        void read( intptr_t fd_or_handle, Filter* filter, Arguments* arguments, Target* working_directory );
+        void read( intptr_t fd_or_handle, Filter* filter, Arguments* arguments, Target* working_directory, Target* target, int stream );
         void wait();
         
         int postorder( Target* target, int function );        
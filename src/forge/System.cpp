@@ -4,26 +4,101 @@
 //
 
 #include "System.hpp"
+#include "Hasher.hpp"
 #include <assert/assert.hpp>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <string.h>
+#include <exception>
 
 #if defined(BUILD_OS_WINDOWS)
 #include <windows.h>
+#include <errno.h>
 #elif defined(BUILD_OS_MACOS)
 #include <unistd.h>
 #include <time.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <mach-o/dyld.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/sysctl.h>
+#include <sys/clonefile.h>
+#include <dirent.h>
 #elif defined(BUILD_OS_LINUX)
 #include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <linux/limits.h>
+#include <linux/fs.h>
+#include <sys/stat.h>
 #include <sys/sysinfo.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <dirent.h>
 #endif
 
 using std::string;
+using std::vector;
+using std::pair;
+using std::make_pair;
 using namespace sweet;
 using namespace sweet::forge;
 
+/**
+// The most threads used to walk directories in `System::glob()`.
+*/
+static const int MAXIMUM_GLOB_THREADS = 8;
+
+/**
+// Does a path match any of several glob patterns?
+//
+// Patterns that contain a slash are matched against \e path and patterns 
+// that don't are matched against \e name.
+*/
+static bool glob_match_any( const vector<string>& patterns, const string& path, const char* name )
+{
+    for ( vector<string>::const_iterator pattern = patterns.begin(); pattern != patterns.end(); ++pattern )
+    {
+        bool slash = pattern->find( '/' ) != string::npos;
+        if ( System::glob_match(pattern->c_str(), slash ? path.c_str() : name) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+#if defined(BUILD_OS_LINUX)
+/**
+// The layout of the entries returned by the `getdents64` system call.
+*/
+struct LinuxDirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name [1];
+};
+#endif
+
+#if defined(BUILD_OS_WINDOWS)
+/**
+// Convert a Windows file time, in 100 nanosecond intervals since January 
+// 1st, 1601, to nanoseconds since the epoch (January 1st, 1970).
+*/
+static int64_t nanoseconds_since_epoch( const FILETIME& file_time )
+{
+    const int64_t EPOCH = 116444736000000000LL;
+    int64_t intervals = (int64_t(file_time.dwHighDateTime) << 32) | int64_t(file_time.dwLowDateTime);
+    return (intervals - EPOCH) * 100;
+}
+#endif
+
 /**
 // Constructor.
 */
@@ -44,7 +119,7 @@ System::System()
 */
 bool System::exists( const std::string& path ) const
 {
-    return boost::filesystem::exists( path );
+    return status( path ).type_ != STATUS_MISSING;
 }
 
 /**
@@ -58,7 +133,7 @@ bool System::exists( const std::string& path ) const
 */
 bool System::is_file( const std::string& path ) const
 {
-    return boost::filesystem::is_regular( path );
+    return status( path ).type_ == STATUS_FILE;
 }
 
 /**
@@ -72,7 +147,7 @@ bool System::is_file( const std::string& path ) const
 */
 bool System::is_directory( const std::string& path ) const
 {
-    return boost::filesystem::is_directory( path );
+    return status( path ).type_ == STATUS_DIRECTORY;
 }
 
 /**
@@ -86,7 +161,7 @@ bool System::is_directory( const std::string& path ) const
 */
 bool System::is_regular( const std::string& path ) const
 {
-    return boost::filesystem::is_regular( path );
+    return status( path ).type_ == STATUS_FILE;
 }
 
 /**
@@ -96,11 +171,110 @@ bool System::is_regular( const std::string& path ) const
 //  The path to the file system entry to get the last write time of.
 //
 // @return
-//  The last write time of the file system entry \e path.
+//  The last write time of the file system entry \e path in nanoseconds 
+//  since the epoch (January 1st, 1970, 00:00 GMT).
 */
-std::time_t System::last_write_time( const std::string& path ) const
+int64_t System::last_write_time( const std::string& path ) const
 {
-    return boost::filesystem::last_write_time( path );
+    Status status = System::status( path );
+    if ( status.type_ == STATUS_MISSING )
+    {
+        throw boost::filesystem::filesystem_error( "last_write_time", path, boost::system::error_code(status.error_, boost::system::system_category()) );
+    }
+    return status.last_write_time_;
+}
+
+/**
+// Set the last write time of the file system entry \e path to the current
+// time.
+//
+// The full precision of the file system is used so that touched files are
+// newer than files written earlier in the same second.
+//
+// @param path
+//  The path to the file system entry to touch.
+*/
+void System::touch( const std::string& path ) const
+{
+    invalidate( path );
+#if defined(BUILD_OS_WINDOWS)
+    HANDLE file = ::CreateFileA( path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr );
+    if ( file == INVALID_HANDLE_VALUE )
+    {
+        throw boost::filesystem::filesystem_error( "touch", path, boost::system::error_code(::GetLastError(), boost::system::system_category()) );
+    }
+    FILETIME now;
+    ::GetSystemTimeAsFileTime( &now );
+    BOOL result = ::SetFileTime( file, nullptr, nullptr, &now );
+    DWORD error = ::GetLastError();
+    ::CloseHandle( file );
+    if ( !result )
+    {
+        throw boost::filesystem::filesystem_error( "touch", path, boost::system::error_code(error, boost::system::system_category()) );
+    }
+#else
+    if ( ::utimensat(AT_FDCWD, path.c_str(), nullptr, 0) != 0 )
+    {
+        throw boost::filesystem::filesystem_error( "touch", path, boost::system::error_code(errno, boost::system::system_category()) );
+    }
+#endif
+}
+
+/**
+// Calculate the hash of the contents of the file \e path.
+//
+// @param path
+//  The path to the file to hash.
+//
+// @return
+//  The 64 bit hash of the contents of the file (see `Hasher`).
+*/
+uint64_t System::content_hash( const std::string& path ) const
+{
+    Hasher hasher;
+    char buffer [65536];
+#if defined(BUILD_OS_WINDOWS)
+    HANDLE file = ::CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+    if ( file == INVALID_HANDLE_VALUE )
+    {
+        throw boost::filesystem::filesystem_error( "content_hash", path, boost::system::error_code(::GetLastError(), boost::system::system_category()) );
+    }
+    DWORD bytes = 0;
+    BOOL result = ::ReadFile( file, buffer, sizeof(buffer), &bytes, nullptr );
+    while ( result && bytes > 0 )
+    {
+        hasher.append( buffer, bytes );
+        result = ::ReadFile( file, buffer, sizeof(buffer), &bytes, nullptr );
+    }
+    DWORD error = ::GetLastError();
+    ::CloseHandle( file );
+    if ( !result )
+    {
+        throw boost::filesystem::filesystem_error( "content_hash", path, boost::system::error_code(error, boost::system::system_category()) );
+    }
+#else
+    int file = ::open( path.c_str(), O_RDONLY );
+    if ( file < 0 )
+    {
+        throw boost::filesystem::filesystem_error( "content_hash", path, boost::system::error_code(errno, boost::system::system_category()) );
+    }
+    ssize_t bytes = ::read( file, buffer, sizeof(buffer) );
+    while ( bytes > 0 || (bytes < 0 && errno == EINTR) )
+    {
+        if ( bytes > 0 )
+        {
+            hasher.append( buffer, size_t(bytes) );
+        }
+        bytes = ::read( file, buffer, sizeof(buffer) );
+    }
+    int error = errno;
+    ::close( file );
+    if ( bytes < 0 )
+    {
+        throw boost::filesystem::filesystem_error( "content_hash", path, boost::system::error_code(error, boost::system::system_category()) );
+    }
+#endif
+    return hasher.value();
 }
 
 /**
@@ -139,6 +313,258 @@ boost::filesystem::recursive_directory_iterator System::find( const std::string&
     ;
 }
 
+/**
+// Recursively find the files in a directory that match glob patterns.
+//
+// Directories are walked in parallel and the entries of each directory are
+// cached with its last write time so that globbing the same directories
+// again, e.g. from several buildfiles, only lists directories that have
+// changed.
+//
+// Patterns are matched against the path of each file relative to
+// \e directory using forward slashes.  Patterns without a slash are 
+// matched against the file's name only.  See `glob_match()` for the syntax
+// of patterns.  Directories matching any exclude pattern aren't descended
+// into.  Symbolic links to directories aren't followed.
+//
+// @param directory
+//  The directory to find files in; no files are found if it doesn't exist.
+//
+// @param includes
+//  The patterns that files must match at least one of or empty to match all
+//  files.
+//
+// @param excludes
+//  The patterns that files and directories must not match any of.
+//
+// @param matches
+//  The vector to append the paths of matching files to in sorted order
+//  (assumed not null).
+*/
+void System::glob( const std::string& directory, const std::vector<std::string>& includes, const std::vector<std::string>& excludes, std::vector<std::string>* matches ) const
+{
+    SWEET_ASSERT( matches );
+
+    string root = directory;
+    while ( root.size() > 1 && (root[root.size() - 1] == '/' || root[root.size() - 1] == '\\') )
+    {
+        root.erase( root.size() - 1 );
+    }
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    vector<string> pending( 1, string() );
+    int walking = 0;
+    vector<string> found;
+
+    auto walk = [&]()
+    {
+        vector<string> local_matches;
+        vector<string> children;
+        std::unique_lock<std::mutex> lock( mutex );
+        for ( ;; )
+        {
+            condition.wait( lock, [&]() { return !pending.empty() || walking == 0; } );
+            if ( pending.empty() )
+            {
+                break;
+            }
+            string relative = std::move( pending.back() );
+            pending.pop_back();
+            ++walking;
+            lock.unlock();
+
+            std::shared_ptr<const Directory> entries = directory_entries( relative.empty() ? root : root + "/" + relative );
+            if ( entries )
+            {
+                for ( vector<pair<string, int>>::const_iterator entry = entries->entries_.begin(); entry != entries->entries_.end(); ++entry )
+                {
+                    string path = relative.empty() ? entry->first : relative + "/" + entry->first;
+                    const char* name = entry->first.c_str();
+                    if ( entry->second == STATUS_DIRECTORY )
+                    {
+                        if ( !glob_match_any(excludes, path, name) )
+                        {
+                            children.push_back( std::move(path) );
+                        }
+                    }
+                    else if ( entry->second == STATUS_FILE )
+                    {
+                        if ( (includes.empty() || glob_match_any(includes, path, name)) && !glob_match_any(excludes, path, name) )
+                        {
+                            local_matches.push_back( std::move(path) );
+                        }
+                    }
+                }
+            }
+
+            lock.lock();
+            --walking;
+            pending.insert( pending.end(), std::make_move_iterator(children.begin()), std::make_move_iterator(children.end()) );
+            children.clear();
+            condition.notify_all();
+        }
+        found.insert( found.end(), std::make_move_iterator(local_matches.begin()), std::make_move_iterator(local_matches.end()) );
+    };
+
+    vector<std::thread> threads;
+    int maximum_threads = std::max( 1, std::min(number_of_logical_processors(), MAXIMUM_GLOB_THREADS) );
+    for ( int i = 1; i < maximum_threads; ++i )
+    {
+        threads.push_back( std::thread(walk) );
+    }
+    walk();
+    for ( vector<std::thread>::iterator thread = threads.begin(); thread != threads.end(); ++thread )
+    {
+        thread->join();
+    }
+
+    std::sort( found.begin(), found.end() );
+    string prefix = root == "/" ? root : root + "/";
+    matches->reserve( matches->size() + found.size() );
+    for ( vector<string>::const_iterator path = found.begin(); path != found.end(); ++path )
+    {
+        matches->push_back( prefix + *path );
+    }
+}
+
+/**
+// Match a path against a glob pattern.
+//
+// The pattern `*` matches any characters other than a slash, `?` matches
+// any single character other than a slash, `[abc]`, `[a-z]`, and `[!a-z]`
+// match any single character in or not in a set, and any other character
+// matches itself.  A `**` segment matches zero or more directories and a
+// trailing `**` segment matches a directory and everything beneath it.
+//
+// @param pattern
+//  The pattern to match.
+//
+// @param path
+//  The path to match against \e pattern.
+//
+// @return
+//  True if \e path matches \e pattern otherwise false.
+*/
+bool System::glob_match( const char* pattern, const char* path )
+{
+    SWEET_ASSERT( pattern );
+    SWEET_ASSERT( path );
+
+    while ( *pattern )
+    {
+        if ( pattern[0] == '*' && pattern[1] == '*' )
+        {
+            pattern += 2;
+            if ( *pattern == 0 )
+            {
+                return true;
+            }
+            if ( *pattern == '/' )
+            {
+                ++pattern;
+                while ( !glob_match(pattern, path) )
+                {
+                    path = strchr( path, '/' );
+                    if ( !path )
+                    {
+                        return false;
+                    }
+                    ++path;
+                }
+                return true;
+            }
+            while ( !glob_match(pattern, path) )
+            {
+                if ( *path == 0 )
+                {
+                    return false;
+                }
+                ++path;
+            }
+            return true;
+        }
+
+        if ( *pattern == '*' )
+        {
+            ++pattern;
+            while ( !glob_match(pattern, path) )
+            {
+                if ( *path == 0 || *path == '/' )
+                {
+                    return false;
+                }
+                ++path;
+            }
+            return true;
+        }
+
+        if ( *path == 0 )
+        {
+            return strcmp( pattern, "/**" ) == 0;
+        }
+
+        if ( *pattern == '?' )
+        {
+            if ( *path == '/' )
+            {
+                return false;
+            }
+        }
+        else if ( *pattern == '[' && strchr(pattern + 1, ']') )
+        {
+            const char* position = pattern + 1;
+            bool negated = *position == '!' || *position == '^';
+            position += negated ? 1 : 0;
+            bool matched = false;
+            while ( *position != ']' && *position != 0 )
+            {
+                if ( position[1] == '-' && position[2] != ']' && position[2] != 0 )
+                {
+                    matched = matched || (*path >= position[0] && *path <= position[2]);
+                    position += 3;
+                }
+                else
+                {
+                    matched = matched || *path == *position;
+                    ++position;
+                }
+            }
+            if ( matched == negated || *path == '/' || *position == 0 )
+            {
+                return false;
+            }
+            pattern = position;
+        }
+        else if ( *pattern != *path )
+        {
+            return false;
+        }
+        ++pattern;
+        ++path;
+    }
+    return *path == 0;
+}
+
+/**
+// Get the directories walked by `glob()`.
+//
+// Directories are recorded the first time that they're walked and aren't
+// forgotten when the cache is invalidated so that they can be checked for
+// changes that would change the results of the globs that walked them.
+//
+// @param directories
+//  A vector to receive the path and last write time, or 0 if the directory
+//  didn't exist, of each directory when it was first walked (assumed not
+//  null).
+*/
+void System::globbed_directories( std::vector<std::pair<std::string, int64_t>>* directories ) const
+{
+    SWEET_ASSERT( directories );
+    std::lock_guard<std::mutex> lock( statuses_mutex_ );
+    directories->insert( directories->end(), globbed_directories_.begin(), globbed_directories_.end() );
+}
+
 /**
 // Get the full path to the build executable.
 //
@@ -227,6 +653,7 @@ std::string System::home() const
 */
 void System::mkdir( const std::string& path ) const
 {
+    invalidate( path );
     boost::filesystem::create_directories( path );
 }
 
@@ -238,21 +665,248 @@ void System::mkdir( const std::string& path ) const
 */
 void System::rmdir( const std::string& path ) const
 {
+    invalidate_all();
     boost::filesystem::remove_all( path );
 }
 
 /**
-// Copy a file or directory.
+// Copy a file replacing the destination if it exists.
+//
+// The fastest available method is used.  On file systems that support it
+// the copy is a reflink (a clone on macOS) that shares storage with the
+// original until either is modified.  Otherwise the copy is a hard link, if
+// \e link is true, and finally the file's contents are copied; in the 
+// kernel with `copy_file_range()` on Linux and in user space elsewhere.
+//
+// Hard links share their contents with the original so that changes to 
+// either are seen in both.  Only pass true for \e link when neither file is
+// rewritten in place.
 //
 // @param from
 //  The file to copy.
 //
 // @param to
 //  The destination to copy the file to.
+//
+// @param link
+//  True to hard link \e to to \e from when a reflink isn't possible.
+*/
+void System::cp( const std::string& from, const std::string& to, bool link ) const
+{
+    invalidate( to );
+    boost::system::error_code error;
+    boost::filesystem::remove( to, error );
+
+#if defined(BUILD_OS_LINUX)
+    int source = ::open( from.c_str(), O_RDONLY | O_CLOEXEC );
+    struct stat status;
+    if ( source < 0 || ::fstat(source, &status) != 0 )
+    {
+        int error_number = errno;
+        if ( source >= 0 )
+        {
+            ::close( source );
+        }
+        throw boost::filesystem::filesystem_error( "cp", from, to, boost::system::error_code(error_number, boost::system::system_category()) );
+    }
+
+    int destination = ::open( to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, status.st_mode & 07777 );
+    bool copied = false;
+#if defined(FICLONE)
+    copied = destination >= 0 && ::ioctl( destination, FICLONE, source ) == 0;
+#endif
+    if ( destination >= 0 && !copied && link )
+    {
+        ::close( destination );
+        ::unlink( to.c_str() );
+        if ( ::link(from.c_str(), to.c_str()) == 0 )
+        {
+            ::close( source );
+            return;
+        }
+        destination = ::open( to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, status.st_mode & 07777 );
+    }
+
+    // Copy in the kernel with `copy_file_range()` falling back to copying
+    // through a buffer when the source and destination are on file systems
+    // that don't support it.
+    int result = destination >= 0 ? 0 : -1;
+    off_t copied_bytes = 0;
+#if defined(__NR_copy_file_range)
+    while ( !copied && result == 0 )
+    {
+        ssize_t bytes = ::syscall( __NR_copy_file_range, source, nullptr, destination, nullptr, size_t(1) << 30, 0 );
+        if ( bytes > 0 )
+        {
+            copied_bytes += off_t(bytes);
+        }
+        else if ( bytes == 0 )
+        {
+            copied = true;
+        }
+        else if ( errno != EINTR )
+        {
+            bool unsupported = errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP || errno == EPERM;
+            result = unsupported && copied_bytes == 0 ? 1 : -1;
+        }
+    }
+#endif
+    if ( !copied && result >= 0 )
+    {
+        char buffer [65536];
+        ssize_t bytes = ::read( source, buffer, sizeof(buffer) );
+        while ( bytes != 0 && result >= 0 )
+        {
+            ssize_t written = 0;
+            while ( bytes > 0 && written < bytes && result >= 0 )
+            {
+                ssize_t write_bytes = ::write( destination, buffer + written, size_t(bytes - written) );
+                written += write_bytes > 0 ? write_bytes : 0;
+                result = write_bytes >= 0 || errno == EINTR ? result : -1;
+            }
+            result = bytes >= 0 || errno == EINTR ? result : -1;
+            bytes = result >= 0 ? ::read( source, buffer, sizeof(buffer) ) : 0;
+        }
+    }
+    if ( result >= 0 )
+    {
+        ::fchmod( destination, status.st_mode & 07777 );
+    }
+
+    int error_number = errno;
+    ::close( source );
+    if ( destination >= 0 && ::close(destination) != 0 && result >= 0 )
+    {
+        error_number = errno;
+        result = -1;
+    }
+    if ( result < 0 )
+    {
+        ::unlink( to.c_str() );
+        throw boost::filesystem::filesystem_error( "cp", from, to, boost::system::error_code(error_number, boost::system::system_category()) );
+    }
+#else
+#if defined(BUILD_OS_MACOS)
+    if ( ::clonefile(from.c_str(), to.c_str(), 0) == 0 )
+    {
+        return;
+    }
+#endif
+    if ( link )
+    {
+        boost::filesystem::create_hard_link( from, to, error );
+        if ( !error )
+        {
+            return;
+        }
+    }
+    boost::filesystem::copy_file( from, to, boost::filesystem::copy_option::overwrite_if_exists );
+#endif
+}
+
+/**
+// Recursively copy the files in a directory.
+//
+// Directories are created first and then files are copied by a thread per
+// logical processor (see `System::cp()`).  The first exception thrown by 
+// any thread is rethrown once all threads have finished.
+//
+// @param from
+//  The directory to copy.
+//
+// @param to
+//  The directory to copy into; created if it doesn't exist.
+//
+// @param link
+//  True to hard link files when a reflink isn't possible.
+//
+// @return
+//  The number of files copied.
 */
-void System::cp( const std::string& from, const std::string& to ) const
+int System::cpdir( const std::string& from, const std::string& to, bool link ) const
 {
-    boost::filesystem::copy_file( from, to );
+    invalidate_all();
+    boost::filesystem::create_directories( to );
+    vector<pair<string, string>> files;
+    boost::filesystem::path source( from );
+    string root = source.generic_string();
+    size_t prefix = root.size();
+    while ( prefix > 1 && root[prefix - 1] == '/' )
+    {
+        --prefix;
+    }
+    for ( boost::filesystem::recursive_directory_iterator i(source), end; i != end; ++i )
+    {
+        string relative = i->path().generic_string().substr( prefix );
+        boost::filesystem::file_status status = i->status();
+        if ( boost::filesystem::is_directory(status) )
+        {
+            boost::filesystem::create_directories( to + relative );
+        }
+        else if ( boost::filesystem::is_regular_file(status) )
+        {
+            files.push_back( make_pair(i->path().string(), to + relative) );
+        }
+    }
+    cp( files, link );
+    return int(files.size());
+}
+
+/**
+// Copy files in parallel.
+//
+// Files are copied by a thread per logical processor (see `System::cp()`).
+// The first exception thrown by any thread is rethrown once all threads 
+// have finished.
+//
+// @param files
+//  The pairs of files to copy from and to.
+//
+// @param link
+//  True to hard link files when a reflink isn't possible.
+*/
+void System::cp( const std::vector<std::pair<std::string, std::string>>& files, bool link ) const
+{
+    int size = int(files.size());
+    int threads = std::min( number_of_logical_processors(), size );
+    std::atomic<int> next( 0 );
+    std::atomic<bool> failed( false );
+    std::exception_ptr exception;
+    auto copy_files = [&]()
+    {
+        try
+        {
+            int index = next++;
+            while ( index < size && !failed )
+            {
+                cp( files[index].first, files[index].second, link );
+                index = next++;
+            }
+        }
+        catch ( ... )
+        {
+            if ( !failed.exchange(true) )
+            {
+                exception = std::current_exception();
+            }
+        }
+    };
+
+    vector<std::thread> workers;
+    for ( int i = 1; i < threads; ++i )
+    {
+        workers.push_back( std::thread(copy_files) );
+    }
+    copy_files();
+    for ( vector<std::thread>::iterator worker = workers.begin(); worker != workers.end(); ++worker )
+    {
+        worker->join();
+    }
+
+    if ( exception )
+    {
+        std::rethrow_exception( exception );
+    }
 }
 
 /**
@@ -263,6 +917,7 @@ void System::cp( const std::string& from, const std::string& to ) const
 */
 void System::rm( const std::string& path ) const
 {
+    invalidate( path );
     boost::filesystem::remove( path );
 }
 
@@ -347,6 +1002,26 @@ void System::sleep( float milliseconds ) const
 #endif
 }
 
+/**
+// Get the current time.
+//
+// @return
+//  The current time in nanoseconds since the epoch (January 1st, 1970, 
+//  00:00 GMT) to compare with file last write times.
+*/
+int64_t System::now() const
+{
+#if defined(BUILD_OS_WINDOWS)
+    FILETIME now;
+    ::GetSystemTimeAsFileTime( &now );
+    return nanoseconds_since_epoch( now );
+#else
+    struct timespec now;
+    ::clock_gettime( CLOCK_REALTIME, &now );
+    return int64_t(now.tv_sec) * 1000000000LL + int64_t(now.tv_nsec);
+#endif
+}
+
 /**
 // Get the number of milliseconds elapsed since the start of the system.
 //
@@ -365,3 +1040,360 @@ float System::ticks() const
 #error "System::ticks() is not implemented for this platform"
 #endif
 }
+
+/**
+// Invalidate the cached status of a path.
+//
+// The cached statuses and listings of the path and all of its ancestors 
+// are discarded as creating or removing a file system entry may create 
+// directories and changes the names listed in its parent.
+//
+// @param path
+//  The path to the file system entry that has been created, changed, or
+//  removed.
+*/
+void System::invalidate( const std::string& path ) const
+{
+    std::lock_guard<std::mutex> lock( statuses_mutex_ );
+    string::size_type end = path.size();
+    while ( end != string::npos && end > 0 )
+    {
+        string ancestor = path.substr( 0, end );
+        statuses_.erase( ancestor );
+        listings_.erase( ancestor );
+        directories_.erase( ancestor );
+        end = path.find_last_of( "/\\", end - 1 );
+    }
+    listings_.erase( string() );
+    listings_.erase( string(".") );
+}
+
+/**
+// Invalidate the cached statuses of all paths.
+//
+// Called when the file system may have changed in ways that aren't known,
+// e.g. after executing a command whose writes aren't reported.
+*/
+void System::invalidate_all() const
+{
+    std::lock_guard<std::mutex> lock( statuses_mutex_ );
+    statuses_.clear();
+    listings_.clear();
+    directories_.clear();
+}
+
+/**
+// Get the status of a path from the cache stating the path and caching its
+// status if it isn't already cached.
+//
+// When the path is missing the names in its parent directory are listed 
+// and cached.  Paths whose parent directory has a cached listing that 
+// doesn't contain their name are then known to be missing without calling
+// into the operating system.
+//
+// @param path
+//  The path to get the status of.
+//
+// @return
+//  The status of \e path.
+*/
+System::Status System::status( const std::string& path ) const
+{
+    string::size_type slash = path.find_last_of( "/\\" );
+    string directory = slash != string::npos ? path.substr( 0, slash ) : string( "." );
+    string name = slash != string::npos ? path.substr( slash + 1 ) : path;
+#if defined(BUILD_OS_WINDOWS)
+    std::transform( name.begin(), name.end(), name.begin(), ::tolower );
+#endif
+    bool listable = !name.empty() && name != "." && name != "..";
+
+    {
+        std::lock_guard<std::mutex> lock( statuses_mutex_ );
+        std::unordered_map<string, Status>::const_iterator i = statuses_.find( path );
+        if ( i != statuses_.end() )
+        {
+            return i->second;
+        }
+
+        if ( listable )
+        {
+            std::unordered_map<string, std::unordered_set<string>>::const_iterator listing = listings_.find( directory );
+            if ( listing != listings_.end() && listing->second.count(name) == 0 )
+            {
+                Status missing = { STATUS_MISSING, ENOENT, 0 };
+                statuses_.insert( make_pair(path, missing) );
+                return missing;
+            }
+        }
+    }
+
+    Status status = read_status( path );
+    std::unordered_set<string> names;
+    bool listed = listable && status.type_ == STATUS_MISSING && status.error_ == ENOENT && read_directory( directory, &names );
+
+    std::lock_guard<std::mutex> lock( statuses_mutex_ );
+    statuses_.insert( make_pair(path, status) );
+    if ( listed )
+    {
+        listings_.insert( make_pair(directory, std::move(names)) );
+    }
+    return status;
+}
+
+/**
+// Stat a path bypassing the cache.
+//
+// Uses `statx()` requesting only the type and last write time where it is 
+// available.
+//
+// @param path
+//  The path to stat.
+//
+// @return
+//  The status of \e path; missing with the error that occured if \e path 
+//  couldn't be stat'd.
+*/
+System::Status System::read_status( const std::string& path )
+{
+    Status status = { STATUS_MISSING, 0, 0 };
+#if defined(BUILD_OS_WINDOWS)
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if ( !::GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data) )
+    {
+        DWORD error = ::GetLastError();
+        status.error_ = error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND ? ENOENT : int(error);
+        return status;
+    }
+    status.type_ = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? STATUS_DIRECTORY : STATUS_FILE;
+    status.last_write_time_ = nanoseconds_since_epoch( data.ftLastWriteTime );
+#elif defined(BUILD_OS_LINUX) && defined(STATX_TYPE)
+    struct statx buffer;
+    if ( ::statx(AT_FDCWD, path.c_str(), 0, STATX_TYPE | STATX_MTIME, &buffer) != 0 )
+    {
+        status.error_ = errno;
+        return status;
+    }
+    status.type_ = S_ISREG(buffer.stx_mode) ? STATUS_FILE : S_ISDIR(buffer.stx_mode) ? STATUS_DIRECTORY : STATUS_OTHER;
+    status.last_write_time_ = int64_t(buffer.stx_mtime.tv_sec) * 1000000000LL + int64_t(buffer.stx_mtime.tv_nsec);
+#else
+    struct stat buffer;
+    if ( ::stat(path.c_str(), &buffer) != 0 )
+    {
+        status.error_ = errno;
+        return status;
+    }
+    status.type_ = S_ISREG(buffer.st_mode) ? STATUS_FILE : S_ISDIR(buffer.st_mode) ? STATUS_DIRECTORY : STATUS_OTHER;
+#if defined(BUILD_OS_MACOS)
+    status.last_write_time_ = int64_t(buffer.st_mtimespec.tv_sec) * 1000000000LL + int64_t(buffer.st_mtimespec.tv_nsec);
+#else
+    status.last_write_time_ = int64_t(buffer.st_mtim.tv_sec) * 1000000000LL + int64_t(buffer.st_mtim.tv_nsec);
+#endif
+#endif
+    return status;
+}
+
+/**
+// List the names in a directory.
+//
+// @param directory
+//  The directory to list the names in; the root directory if empty.
+//
+// @param names
+//  The set to insert names into (assumed not null); names are converted
+//  to lower case on Windows where file names are case insensitive.
+//
+// @return
+//  True if the directory was listed or is missing, in which case it has no
+//  names, otherwise false.
+*/
+bool System::read_directory( const std::string& directory, std::unordered_set<std::string>* names )
+{
+    SWEET_ASSERT( names );
+    string path = directory.empty() ? string( "/" ) : directory + "/";
+#if defined(BUILD_OS_WINDOWS)
+    WIN32_FIND_DATAA data;
+    HANDLE find = ::FindFirstFileA( (path + "*").c_str(), &data );
+    if ( find == INVALID_HANDLE_VALUE )
+    {
+        DWORD error = ::GetLastError();
+        return error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND;
+    }
+    do
+    {
+        string name( data.cFileName );
+        std::transform( name.begin(), name.end(), name.begin(), ::tolower );
+        names->insert( name );
+    }
+    while ( ::FindNextFileA(find, &data) );
+    ::FindClose( find );
+    return true;
+#else
+    DIR* entries = ::opendir( path.c_str() );
+    if ( !entries )
+    {
+        return errno == ENOENT || errno == ENOTDIR;
+    }
+    struct dirent* entry = ::readdir( entries );
+    while ( entry )
+    {
+        names->insert( string(entry->d_name) );
+        entry = ::readdir( entries );
+    }
+    ::closedir( entries );
+    return true;
+#endif
+}
+
+/**
+// Get the entries of a directory from the cache listing the directory and
+// caching its entries if they aren't cached or the directory has been
+// written to since they were.
+//
+// @param path
+//  The directory to get the entries of.
+//
+// @return
+//  The entries of \e path or null if \e path isn't a directory or can't 
+//  be listed.
+*/
+std::shared_ptr<const System::Directory> System::directory_entries( const std::string& path ) const
+{
+    Status status = read_status( path );
+    if ( status.type_ == STATUS_MISSING || status.type_ == STATUS_DIRECTORY )
+    {
+        std::lock_guard<std::mutex> lock( statuses_mutex_ );
+        globbed_directories_.insert( make_pair(path, status.last_write_time_) );
+    }
+    if ( status.type_ != STATUS_DIRECTORY )
+    {
+        return std::shared_ptr<const Directory>();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock( statuses_mutex_ );
+        std::unordered_map<string, std::shared_ptr<const Directory>>::const_iterator i = directories_.find( path );
+        if ( i != directories_.end() && i->second->last_write_time_ == status.last_write_time_ )
+        {
+            return i->second;
+        }
+    }
+
+    std::shared_ptr<Directory> directory = std::make_shared<Directory>();
+    directory->last_write_time_ = status.last_write_time_;
+    if ( !read_entries(path, &directory->entries_) )
+    {
+        return std::shared_ptr<const Directory>();
+    }
+
+    std::lock_guard<std::mutex> lock( statuses_mutex_ );
+    directories_[path] = directory;
+    return directory;
+}
+
+/**
+// List the names and types of the entries in a directory.
+//
+// Uses the `getdents64` system call directly on Linux to read entries in
+// large batches.  Entries whose type isn't reported by the directory, e.g.
+// symbolic links, are stat'd; symbolic links to directories are listed as
+// other entries so that they aren't descended into.
+//
+// @param directory
+//  The directory to list.
+//
+// @param entries
+//  The vector to append the name and type (see `StatusType`) of each entry
+//  other than "." and ".." to (assumed not null).
+//
+// @return
+//  True if the directory was listed otherwise false.
+*/
+bool System::read_entries( const std::string& directory, std::vector<std::pair<std::string, int>>* entries )
+{
+    SWEET_ASSERT( entries );
+
+    auto stat_type = []( const string& path, bool link )
+    {
+        Status status = read_status( path );
+        return status.type_ == STATUS_MISSING || (status.type_ == STATUS_DIRECTORY && link) ? int(STATUS_OTHER) : status.type_;
+    };
+
+#if defined(BUILD_OS_WINDOWS)
+    WIN32_FIND_DATAA data;
+    HANDLE find = ::FindFirstFileA( (directory + "/*").c_str(), &data );
+    if ( find == INVALID_HANDLE_VALUE )
+    {
+        return false;
+    }
+    do
+    {
+        if ( strcmp(data.cFileName, ".") != 0 && strcmp(data.cFileName, "..") != 0 )
+        {
+            int type = 
+                (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) ? stat_type( directory + "/" + data.cFileName, true ) :
+                (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? STATUS_DIRECTORY : 
+                STATUS_FILE
+            ;
+            entries->push_back( make_pair(string(data.cFileName), type) );
+        }
+    }
+    while ( ::FindNextFileA(find, &data) );
+    ::FindClose( find );
+    return true;
+#elif defined(BUILD_OS_LINUX)
+    int descriptor = ::open( directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+    if ( descriptor < 0 )
+    {
+        return false;
+    }
+    alignas(LinuxDirent64) char buffer [32768];
+    long bytes = ::syscall( SYS_getdents64, descriptor, buffer, sizeof(buffer) );
+    while ( bytes > 0 )
+    {
+        long offset = 0;
+        while ( offset < bytes )
+        {
+            const LinuxDirent64* entry = reinterpret_cast<const LinuxDirent64*>( buffer + offset );
+            offset += entry->d_reclen;
+            const char* name = entry->d_name;
+            if ( strcmp(name, ".") != 0 && strcmp(name, "..") != 0 )
+            {
+                int type = 
+                    entry->d_type == DT_REG ? STATUS_FILE :
+                    entry->d_type == DT_DIR ? STATUS_DIRECTORY :
+                    entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN ? stat_type( directory + "/" + name, entry->d_type == DT_LNK ) :
+                    STATUS_OTHER
+                ;
+                entries->push_back( make_pair(string(name), type) );
+            }
+        }
+        bytes = ::syscall( SYS_getdents64, descriptor, buffer, sizeof(buffer) );
+    }
+    ::close( descriptor );
+    return bytes == 0;
+#else
+    DIR* handle = ::opendir( directory.c_str() );
+    if ( !handle )
+    {
+        return false;
+    }
+    struct dirent* entry = ::readdir( handle );
+    while ( entry )
+    {
+        const char* name = entry->d_name;
+        if ( strcmp(name, ".") != 0 && strcmp(name, "..") != 0 )
+        {
+            int type = 
+                entry->d_type == DT_REG ? STATUS_FILE :
+                entry->d_type == DT_DIR ? STATUS_DIRECTORY :
+                entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN ? stat_type( directory + "/" + name, entry->d_type == DT_LNK ) :
+                STATUS_OTHER
+            ;
+            entries->push_back( make_pair(string(name), type) );
+        }
+        entry = ::readdir( handle );
+    }
+    ::closedir( handle );
+    return true;
+#endif
+}
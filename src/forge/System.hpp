@@ -4,7 +4,13 @@
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/convenience.hpp>
 #include <string>
-#include <ctime>
+#include <vector>
+#include <utility>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <stdint.h>
 
 namespace sweet
 {
@@ -14,10 +20,60 @@ namespace forge
 
 /**
 // The interface from the %build tool library to the operating system.
+//
+// The status of each path queried through `exists()`, `is_file()`,
+// `is_directory()`, `is_regular()`, and `last_write_time()` is cached so 
+// that each path is only stat'd once per run.  When a path is found to be 
+// missing the names in its parent directory are listed and cached so that 
+// later lookups of other missing paths in the same directory, typically 
+// header search paths, are answered without a system call.
+//
+// Changes made through `System` invalidate the cache.  Changes made by 
+// anything else, typically commands executed by the build, must be reported
+// by calling `invalidate()`.
+//
+// The entries of directories walked by `glob()` are cached along with the
+// last write time of the directory so that later globs only list
+// directories that have changed since.
 */
 class System
 {
+    /**
+    // The cached status of a path.
+    */
+    struct Status
+    {
+        int type_; ///< The type of the file system entry (see `StatusType`).
+        int error_; ///< The error from the stat or zero if it succeeded.
+        int64_t last_write_time_; ///< The last write time in nanoseconds since the epoch.
+    };
+
+    /**
+    // The types of file system entries in the cache.
+    */
+    enum StatusType
+    {
+        STATUS_MISSING, ///< No file system entry exists at the path.
+        STATUS_FILE, ///< The path is a regular file.
+        STATUS_DIRECTORY, ///< The path is a directory.
+        STATUS_OTHER ///< The path is some other file system entry.
+    };
+
+    /**
+    // The cached entries of a directory walked by `glob()`.
+    */
+    struct Directory
+    {
+        int64_t last_write_time_; ///< The last write time of the directory when it was listed.
+        std::vector<std::pair<std::string, int>> entries_; ///< The name and type (see `StatusType`) of each entry.
+    };
+
     float initial_tick_count_; ///< The tick count when this System object was created.
+    mutable std::mutex statuses_mutex_; ///< Guards the cached statuses and listings.
+    mutable std::unordered_map<std::string, Status> statuses_; ///< The cached statuses by path.
+    mutable std::unordered_map<std::string, std::unordered_set<std::string>> listings_; ///< The cached names in directories by directory.
+    mutable std::unordered_map<std::string, std::shared_ptr<const Directory>> directories_; ///< The cached entries of directories walked by `glob()` by directory.
+    mutable std::unordered_map<std::string, int64_t> globbed_directories_; ///< The last write time of each directory walked by `glob()` when it was first walked.
 
     public:
         System();
@@ -26,20 +82,37 @@ class System
         bool is_file( const std::string& path ) const;
         bool is_directory( const std::string& path ) const;
         bool is_regular( const std::string& path ) const;
-        std::time_t last_write_time( const std::string& path ) const;
+        int64_t last_write_time( const std::string& path ) const;
+        void touch( const std::string& path ) const;
+        uint64_t content_hash( const std::string& path ) const;
+        int64_t now() const;
         boost::filesystem::directory_iterator ls( const std::string& path ) const;
         boost::filesystem::recursive_directory_iterator find( const std::string& path ) const;
+        void glob( const std::string& directory, const std::vector<std::string>& includes, const std::vector<std::string>& excludes, std::vector<std::string>* matches ) const;
+        static bool glob_match( const char* pattern, const char* path );
+        void globbed_directories( std::vector<std::pair<std::string, int64_t>>* directories ) const;
         std::string executable() const;
         std::string home() const;
         void mkdir( const std::string& path ) const;
         void rmdir( const std::string& path ) const;
-        void cp( const std::string& from, const std::string& to ) const;
+        void cp( const std::string& from, const std::string& to, bool link = false ) const;
+        void cp( const std::vector<std::pair<std::string, std::string>>& files, bool link = false ) const;
+        int cpdir( const std::string& from, const std::string& to, bool link = false ) const;
         void rm( const std::string& path ) const;
         const char* operating_system() const;
         const char* getenv( const char* name ) const;
         int number_of_logical_processors() const;
         void sleep( float milliseconds ) const;
         float ticks() const;
+        void invalidate( const std::string& path ) const;
+        void invalidate_all() const;
+        static Status read_status( const std::string& path );
+
+    private:
+        Status status( const std::string& path ) const;
+        static bool read_directory( const std::string& directory, std::unordered_set<std::string>* names );
+        std::shared_ptr<const Directory> directory_entries( const std::string& path ) const;
+        static bool read_entries( const std::string& directory, std::vector<std::pair<std::string, int>>* entries );
 };
 
 }
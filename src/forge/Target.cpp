@@ -8,10 +8,14 @@
 #include "Graph.hpp"
 #include "GraphWriter.hpp"
 #include "GraphReader.hpp"
+#include "GraphJournal.hpp"
+#include "GraphEvaluation.hpp"
 #include "Forge.hpp"
 #include "System.hpp"
+#include "Hasher.hpp"
 #include <assert/assert.hpp>
 #include <algorithm>
+#include <limits>
 
 using std::min;
 using std::max;
@@ -19,10 +23,15 @@ using std::swap;
 using std::remove;
 using std::vector;
 using std::string;
-using std::time_t;
 using namespace sweet;
 using namespace sweet::forge;
 
+/**
+// The number of dependencies at which a Target starts indexing its
+// dependencies in a hash table; below this a linear search is faster.
+*/
+static const size_t DEPENDENCY_INDEX_THRESHOLD = 16;
+
 /**
 // Constructor.
 */
@@ -36,6 +45,11 @@ Target::Target()
   last_write_time_( 0 ),
   hash_( 0 ),
   pending_hash_( 0 ),
+  content_timestamp_( 0 ),
+  content_hash_( 0 ),
+  signature_( 0 ),
+  file_timestamp_( 0 ),
+  file_outdated_( false ),
   outdated_( false ),
   changed_( false ),
   bound_to_file_( false ),
@@ -43,17 +57,22 @@ Target::Target()
   referenced_by_script_( false ),
   cleanable_( false ),
   built_( false ),
+  cutoff_( false ),
   working_directory_( NULL ),
   parent_( NULL ),
   targets_(),
   dependencies_(),
   implicit_dependencies_(),
   ordering_dependencies_(),
+  dependency_types_(),
+  dependencies_indexed_( false ),
+  dependents_(),
   filenames_(),
   visiting_( false ),
   visited_revision_( 0 ),
   successful_revision_( 0 ),
   postorder_height_( -1 ),
+  snapshot_index_( -1 ),
   anonymous_( 0 )
 {
 }
@@ -77,6 +96,11 @@ Target::Target( const std::string& id, Graph* graph )
   last_write_time_( 0 ),
   hash_( 0 ),
   pending_hash_( 0 ),
+  content_timestamp_( 0 ),
+  content_hash_( 0 ),
+  signature_( 0 ),
+  file_timestamp_( 0 ),
+  file_outdated_( false ),
   outdated_( false ),
   changed_( false ),
   bound_to_file_( false ),
@@ -84,17 +108,22 @@ Target::Target( const std::string& id, Graph* graph )
   referenced_by_script_( false ),
   cleanable_( false ),
   built_( false ),
+  cutoff_( false ),
   working_directory_( NULL ),
   parent_( NULL ),
   targets_(),
   dependencies_(),
   implicit_dependencies_(),
   ordering_dependencies_(),
+  dependency_types_(),
+  dependencies_indexed_( false ),
+  dependents_(),
   filenames_(),
   visiting_( false ),
   visited_revision_( 0 ),
   successful_revision_( 0 ),
   postorder_height_( -1 ),
+  snapshot_index_( -1 ),
   anonymous_( 0 )
 {
     SWEET_ASSERT( !id_.empty() );
@@ -305,6 +334,11 @@ void Target::bind()
 // outdated if they are older than this Target.  Additionally if the last 
 // write time of the file or directory is different to the last write time 
 // already stored in this Target then this Target is marked as having changed.
+//
+// If this Target has content cutoff enabled (see `Target::set_cutoff()`) 
+// and its files exist then its timestamp is the time that the contents of 
+// its files last changed rather than the time that they were last written.
+// The files are only hashed again if their last write time has changed.
 */
 void Target::bind_to_file()
 {
@@ -312,8 +346,8 @@ void Target::bind_to_file()
     {
         if ( !filenames_.empty() )
         {
-            time_t latest_last_write_time = 0;
-            time_t earliest_last_write_time = std::numeric_limits<time_t>::max();
+            int64_t latest_last_write_time = 0;
+            int64_t earliest_last_write_time = std::numeric_limits<int64_t>::max();
             bool outdated = false;
 
             for ( vector<string>::const_iterator filename = filenames_.begin(); filename != filenames_.end(); ++filename )
@@ -321,13 +355,13 @@ void Target::bind_to_file()
                 System* system = graph_->forge()->system();
                 if ( system->exists(*filename) )
                 {
-                    time_t last_write_time = system->last_write_time( *filename );
+                    int64_t last_write_time = system->last_write_time( *filename );
                     latest_last_write_time = max( last_write_time, latest_last_write_time );
                     earliest_last_write_time = min( last_write_time, earliest_last_write_time );
                 }
                 else
                 {
-                    latest_last_write_time = std::numeric_limits<time_t>::max();
+                    latest_last_write_time = std::numeric_limits<int64_t>::max();
                     earliest_last_write_time = 0;
                     outdated = true;
                 }
@@ -338,6 +372,15 @@ void Target::bind_to_file()
             last_write_time_ = earliest_last_write_time;
             outdated_ = outdated || hash_ != pending_hash_;
             hash_ = pending_hash_;
+
+            if ( cutoff_ && !outdated )
+            {
+                if ( changed_ || content_timestamp_ == 0 )
+                {
+                    hash_content( latest_last_write_time );
+                }
+                timestamp_ = content_timestamp_;
+            }
         }
         else
         {
@@ -348,6 +391,8 @@ void Target::bind_to_file()
             hash_ = pending_hash_;
         }
         
+        file_timestamp_ = timestamp_;
+        file_outdated_ = outdated_;
         bound_to_file_ = true;
     }
 }
@@ -364,6 +409,14 @@ void Target::bind_to_file()
 // Target is not bound to any files then it is outdated if any of its
 // dependencies are outdated.
 //
+// Timestamps are compared with the full precision of the file system.  A
+// dependency with exactly the same timestamp as this Target's file may have
+// been written just after this Target within the same tick of the file
+// system clock (a "racy" write) if both were written since the previous 
+// build started (see `Graph::racy_timestamp()`).  This Target is then 
+// conservatively treated as outdated; building it again writes its file 
+// with a later timestamp so at most one extra build results.
+//
 // Cleanable Targets that haven't been built are always outdated whether they
 // are bound to files or not.
 */
@@ -371,8 +424,8 @@ void Target::bind_to_dependencies()
 {
     if ( !bound_to_dependencies_ )
     {
-        time_t timestamp = timestamp_;
-        bool outdated = outdated_;
+        int64_t timestamp = 0;
+        bool outdated = false;
 
         int i = 0;
         Target* target = binding_dependency( i );
@@ -384,19 +437,166 @@ void Target::bind_to_dependencies()
             target = binding_dependency( i );
         }
 
+        bind_to_dependencies( timestamp, outdated );
+    }
+}
+
+/**
+// Bind this Target to its dependencies given the latest timestamp of its 
+// binding dependencies and whether or not any of them are outdated.
+//
+// This allows traversals that have already gathered the timestamps and 
+// outdated state of dependencies (see `GraphSnapshot::bind()`) to bind a 
+// Target without visiting its dependencies again.  See 
+// `Target::bind_to_dependencies()` for how the timestamp and outdated state 
+// of this Target are determined.
+//
+// @param dependencies_timestamp
+//  The latest timestamp of any of this Target's binding dependencies.
+//
+// @param dependencies_outdated
+//  Whether or not any of this Target's binding dependencies are outdated.
+*/
+void Target::bind_to_dependencies( int64_t dependencies_timestamp, bool dependencies_outdated )
+{
+    if ( !bound_to_dependencies_ )
+    {
+        int64_t timestamp = std::max( timestamp_, dependencies_timestamp );
+        bool outdated = outdated_ || dependencies_outdated;
+
         if ( !filenames_.empty() )
         {
-            outdated = outdated_ || timestamp > last_write_time();
+            int64_t racy_timestamp = graph_->racy_timestamp();
+            bool racy = racy_timestamp > 0 && dependencies_timestamp == last_write_time_ && last_write_time_ >= racy_timestamp;
+            outdated = outdated_ || dependencies_timestamp > last_write_time_ || racy;
         }
 
         outdated = outdated || (cleanable_ && !built_);
 
+        // Up to date Targets with content cutoff keep the time that their
+        // contents last changed rather than inheriting later timestamps 
+        // from their dependencies.
+        if ( cutoff_ && !outdated && !filenames_.empty() )
+        {
+            timestamp = timestamp_;
+        }
+
         set_outdated( outdated );
         set_timestamp( timestamp );
         bound_to_dependencies_ = true;
     }
 }
 
+/**
+// Bind this Target to its dependencies again.
+//
+// Restores the timestamp and outdated state of this Target to those from 
+// when it was bound to its files and binds it to the current timestamp and
+// outdated state of its dependencies.  This is used in postorder traversals
+// once dependencies have been built because dependencies with content 
+// cutoff that were rebuilt without changing the contents of their files 
+// revert to their earlier timestamps (see `Target::bind_to_content()`) and
+// Targets that were only outdated because of them no longer are while 
+// dependencies outdated by a changed command signature advance to the 
+// latest timestamp (see `Target::bind_to_signature()`).
+*/
+void Target::rebind_to_dependencies()
+{
+    if ( bound_to_file_ && bound_to_dependencies_ )
+    {
+        timestamp_ = file_timestamp_;
+        outdated_ = file_outdated_;
+        bound_to_dependencies_ = false;
+        bind_to_dependencies();
+    }
+}
+
+/**
+// Unbind this Target from its files and dependencies.
+//
+// The next bind of this Target checks the last write times of its files
+// and the timestamps of its dependencies again.  This is used between builds
+// in the same Forge (see `Graph::unbind()`) after files have changed.
+*/
+void Target::unbind()
+{
+    bound_to_file_ = false;
+    bound_to_dependencies_ = false;
+}
+
+/**
+// Bind this Target to the contents of its files after it has been built.
+//
+// Only outdated Targets with content cutoff enabled that are bound to files
+// and have been built successfully are considered.  Their files are hashed
+// and if the contents haven't changed since they were last hashed then the
+// timestamp of this Target reverts to the time that the contents last 
+// changed so that Targets depending on it aren't outdated by this build.
+//
+// @return
+//  True if this Target was rebuilt without changing the contents of its 
+//  files otherwise false.
+*/
+bool Target::bind_to_content()
+{
+    if ( cutoff_ && outdated_ && built_ && !filenames_.empty() )
+    {
+        int64_t latest_last_write_time = 0;
+        System* system = graph_->forge()->system();
+        for ( vector<string>::const_iterator filename = filenames_.begin(); filename != filenames_.end(); ++filename )
+        {
+            if ( !system->exists(*filename) )
+            {
+                content_timestamp_ = 0;
+                return false;
+            }
+            latest_last_write_time = max( system->last_write_time(*filename), latest_last_write_time );
+        }
+
+        int64_t content_timestamp = content_timestamp_;
+        uint64_t content_hash = content_hash_;
+        hash_content( latest_last_write_time );
+        if ( content_timestamp != 0 && content_hash != 0 && content_hash_ == content_hash )
+        {
+            timestamp_ = content_timestamp_;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+// Bind this Target to the signature of the command that builds it.
+//
+// Targets whose prototypes describe the command that builds them are bound
+// to the signature of that command in postorder traversals once they have
+// been bound to their files and dependencies (see `build_visit()`).  An up
+// to date Target is outdated when the signature differs from the signature
+// recorded when the Target was last built.  Its timestamp is then the 
+// latest possible, as if its files were missing, so that Targets depending
+// on it are outdated when they are bound to their dependencies again (see 
+// `Target::rebind_to_dependencies()`).
+//
+// @param signature
+//  The signature of the command that would be executed to build this 
+//  Target.
+//
+// @return
+//  True if this Target was outdated by a changed signature otherwise false.
+*/
+bool Target::bind_to_signature( uint64_t signature )
+{
+    if ( !outdated_ && signature != signature_ )
+    {
+        file_timestamp_ = std::numeric_limits<int64_t>::max();
+        file_outdated_ = true;
+        timestamp_ = file_timestamp_;
+        outdated_ = true;
+        return true;
+    }
+    return false;
+}
+
 /**
 // Set the settings hash for this Target.
 //
@@ -481,6 +681,56 @@ bool Target::built() const
     return built_;
 }
 
+/**
+// Set whether or not this Target's timestamp only advances when the contents
+// of its files change.
+//
+// Targets with content cutoff have their files hashed when they are built 
+// and when their files are written outside of a build.  Rewriting files with
+// identical contents doesn't outdate the Targets that depend on them.
+//
+// @param cutoff
+//  True to enable content cutoff for this Target otherwise false.
+*/
+void Target::set_cutoff( bool cutoff )
+{
+    cutoff_ = cutoff;
+}
+
+/**
+// Does this Target's timestamp only advance when the contents of its files
+// change?
+//
+// @return
+//  True if this Target has content cutoff enabled otherwise false.
+*/
+bool Target::cutoff() const
+{
+    return cutoff_;
+}
+
+/**
+// Set the signature of the last command executed to build this Target.
+//
+// @param signature
+//  The signature of the command (see `LuaSystem::signature()`).
+*/
+void Target::set_signature( uint64_t signature )
+{
+    signature_ = signature;
+}
+
+/**
+// Get the signature of the last command executed to build this Target.
+//
+// @return
+//  The signature or 0 if no command has been executed to build this Target.
+*/
+uint64_t Target::signature() const
+{
+    return signature_;
+}
+
 /**
 // Set the timestamp for this Target.
 //
@@ -492,7 +742,7 @@ bool Target::built() const
 // @param timestamp
 //  The value to set the timestamp of this Target to.
 */
-void Target::set_timestamp( std::time_t timestamp )
+void Target::set_timestamp( int64_t timestamp )
 {
     timestamp_ = timestamp;
 }
@@ -508,7 +758,7 @@ void Target::set_timestamp( std::time_t timestamp )
 // @return
 //  The timestamp.
 */
-std::time_t Target::timestamp() const
+int64_t Target::timestamp() const
 {
     return timestamp_;
 }
@@ -524,7 +774,7 @@ std::time_t Target::timestamp() const
 // @return
 //  The last write time of the file that this Target is bound to.
 */
-std::time_t Target::last_write_time() const
+int64_t Target::last_write_time() const
 {
     return last_write_time_;
 }
@@ -752,6 +1002,7 @@ void Target::destroy_anonymous_targets()
         Target* target = *i;
         if ( target->anonymous() )
         {
+            target->detach();
             delete target;
             *i = NULL;
         }
@@ -759,6 +1010,35 @@ void Target::destroy_anonymous_targets()
     targets_.erase( remove(targets_.begin(), targets_.end(), (Target*) NULL), targets_.end() );
 }
 
+/**
+// Detach this Target and its children from the Targets that they depend on
+// and the Targets that depend on them.
+//
+// This is called before a Target is destroyed so that other Targets aren't
+// left referring to it through their dependencies or dependents.
+*/
+void Target::detach()
+{
+    for ( vector<Target*>::const_iterator i = targets_.begin(); i != targets_.end(); ++i )
+    {
+        Target* target = *i;
+        SWEET_ASSERT( target );
+        target->detach();
+    }
+
+    vector<Target*> dependents( dependents_.begin(), dependents_.end() );
+    for ( vector<Target*>::const_iterator i = dependents.begin(); i != dependents.end(); ++i )
+    {
+        Target* dependent = *i;
+        SWEET_ASSERT( dependent );
+        dependent->remove_dependency( this );
+    }
+
+    clear_explicit_dependencies();
+    clear_implicit_dependencies();
+    clear_ordering_dependencies();
+}
+
 /**
 // Find a Target by id.
 //
@@ -778,6 +1058,28 @@ Target* Target::find_target_by_id( const std::string& id ) const
     return i != targets_.end() ? *i : NULL;
 }
 
+/**
+// Find a Target by an identifier that isn't necessarily null terminated.
+//
+// @param id
+//  The first character of the identifier of the Target to find.
+//
+// @param length
+//  The number of characters in the identifier.
+//
+// @return
+//  The Target or null if no matching Target could be found.
+*/
+Target* Target::find_target_by_id( const char* id, size_t length ) const
+{
+    vector<Target*>::const_iterator i = targets_.begin();
+    while ( i != targets_.end() && (*i)->id().compare(0, string::npos, id, length) != 0 )
+    {
+        ++i;
+    }
+    return i != targets_.end() ? *i : NULL;
+}
+
 /**
 // Get the Targets that are part of this Target.
 //
@@ -823,6 +1125,8 @@ void Target::add_explicit_dependency( Target* target )
         SWEET_ASSERT( target->graph() == graph() );
         remove_dependency( target );
         dependencies_.push_back( target );
+        index_dependency( target, DEPENDENCY_EXPLICIT );
+        target->dependents_.insert( this );
         bound_to_dependencies_ = false;
     }
 }
@@ -835,6 +1139,8 @@ void Target::add_explicit_dependency( Target* target )
 */
 void Target::clear_explicit_dependencies()
 {
+    unindex_dependencies( dependencies_ );
+    remove_from_dependents( dependencies_ );
     dependencies_.clear();
     bound_to_dependencies_ = false;
 }
@@ -863,6 +1169,8 @@ void Target::add_implicit_dependency( Target* target )
     {
         remove_dependency( target );
         implicit_dependencies_.push_back( target );
+        index_dependency( target, DEPENDENCY_IMPLICIT );
+        target->dependents_.insert( this );
         bound_to_dependencies_ = false;
     }
 }
@@ -879,15 +1187,15 @@ void Target::add_implicit_dependency( Target* target )
 */
 void Target::remove_implicit_dependency( Target* target )
 {
-    if ( target && target != this )
+    if ( target && target != this && is_implicit_dependency(target) )
     {
         SWEET_ASSERT( target->graph() == graph() );
         vector<Target*>::iterator i = find( implicit_dependencies_.begin(), implicit_dependencies_.end(), target );
-        if ( i != implicit_dependencies_.end() )
-        {
-            implicit_dependencies_.erase( i );
-            bound_to_dependencies_ = false;
-        }
+        SWEET_ASSERT( i != implicit_dependencies_.end() );
+        implicit_dependencies_.erase( i );
+        unindex_dependency( target );
+        target->dependents_.erase( this );
+        bound_to_dependencies_ = false;
     }
 }
 
@@ -899,6 +1207,8 @@ void Target::remove_implicit_dependency( Target* target )
 */
 void Target::clear_implicit_dependencies()
 {
+    unindex_dependencies( implicit_dependencies_ );
+    remove_from_dependents( implicit_dependencies_ );
     implicit_dependencies_.clear();
     bound_to_dependencies_ = false;
 }
@@ -920,6 +1230,8 @@ void Target::add_ordering_dependency( Target* target )
     {
         remove_dependency( target );
         ordering_dependencies_.push_back( target );
+        index_dependency( target, DEPENDENCY_ORDERING );
+        target->dependents_.insert( this );
     }
 }
 
@@ -928,6 +1240,8 @@ void Target::add_ordering_dependency( Target* target )
 */
 void Target::clear_ordering_dependencies()
 {
+    unindex_dependencies( ordering_dependencies_ );
+    remove_from_dependents( ordering_dependencies_ );
     ordering_dependencies_.clear();
 }
 
@@ -952,29 +1266,27 @@ void Target::remove_dependency( Target* target )
     if ( target && target != this )
     {
         SWEET_ASSERT( target->graph() == graph() );
-        vector<Target*>::iterator i = find( dependencies_.begin(), dependencies_.end(), target );
-        if ( i != dependencies_.end() )
+        switch ( dependency_type(target) )
         {
-            dependencies_.erase( i );
-            bound_to_dependencies_ = false;
-        }
-        else 
-        {
-            i = find( implicit_dependencies_.begin(), implicit_dependencies_.end(), target );
-            if ( i != implicit_dependencies_.end() )
-            {
-                implicit_dependencies_.erase( i );
+            case DEPENDENCY_EXPLICIT:
+                dependencies_.erase( find(dependencies_.begin(), dependencies_.end(), target) );
                 bound_to_dependencies_ = false;
-            }
-            else 
-            {
-                i = find( ordering_dependencies_.begin(), ordering_dependencies_.end(), target );
-                if ( i != ordering_dependencies_.end() )
-                {
-                    ordering_dependencies_.erase( i );
-                }
-            }
+                break;
+
+            case DEPENDENCY_IMPLICIT:
+                implicit_dependencies_.erase( find(implicit_dependencies_.begin(), implicit_dependencies_.end(), target) );
+                bound_to_dependencies_ = false;
+                break;
+
+            case DEPENDENCY_ORDERING:
+                ordering_dependencies_.erase( find(ordering_dependencies_.begin(), ordering_dependencies_.end(), target) );
+                break;
+
+            default:
+                return;
         }
+        unindex_dependency( target );
+        target->dependents_.erase( this );
     }
 }
 
@@ -989,7 +1301,7 @@ void Target::remove_dependency( Target* target )
 */
 bool Target::is_explicit_dependency( Target* target ) const
 {
-    return find( dependencies_.begin(), dependencies_.end(), target ) != dependencies_.end();
+    return dependency_type( target ) == DEPENDENCY_EXPLICIT;
 }
 
 /**
@@ -1003,7 +1315,7 @@ bool Target::is_explicit_dependency( Target* target ) const
 */
 bool Target::is_implicit_dependency( Target* target ) const
 {
-    return find( implicit_dependencies_.begin(), implicit_dependencies_.end(), target ) != implicit_dependencies_.end();
+    return dependency_type( target ) == DEPENDENCY_IMPLICIT;
 }
 
 /**
@@ -1017,7 +1329,7 @@ bool Target::is_implicit_dependency( Target* target ) const
 */
 bool Target::is_ordering_dependency( Target* target ) const
 {
-    return find( ordering_dependencies_.begin(), ordering_dependencies_.end(), target ) != ordering_dependencies_.end();
+    return dependency_type( target ) == DEPENDENCY_ORDERING;
 }
 
 /**
@@ -1027,16 +1339,49 @@ bool Target::is_ordering_dependency( Target* target ) const
 //  The Target to check for being a dependency of this Target.
 //
 // @return
-//  True if 'target' is an explicit or implicit dependency of this Target 
-//  otherwise false.
+//  True if 'target' is an explicit, implicit, or ordering dependency of this
+//  Target otherwise false.
 */
 bool Target::is_dependency( Target* target ) const
 {
-    return 
-        is_explicit_dependency( target ) ||
-        is_implicit_dependency( target ) ||
-        is_ordering_dependency( target )
-    ;
+    return dependency_type( target ) != DEPENDENCY_NULL;
+}
+
+/**
+// Get the kind of dependency that this Target has on *target*.
+//
+// Once this Target has more than a handful of dependencies the lookup is 
+// made in constant time using the dependency index otherwise the explicit, 
+// implicit, and ordering dependencies are searched linearly.
+//
+// @param target
+//  The Target to get the DependencyType of.
+//
+// @return
+//  The DependencyType of *target* or `DEPENDENCY_NULL` if *target* is not a
+//  dependency of this Target.
+*/
+DependencyType Target::dependency_type( Target* target ) const
+{
+    if ( dependencies_indexed_ )
+    {
+        std::unordered_map<Target*, DependencyType>::const_iterator i = dependency_types_.find( target );
+        return i != dependency_types_.end() ? i->second : DEPENDENCY_NULL;
+    }
+
+    if ( find(dependencies_.begin(), dependencies_.end(), target) != dependencies_.end() )
+    {
+        return DEPENDENCY_EXPLICIT;
+    }
+    if ( find(implicit_dependencies_.begin(), implicit_dependencies_.end(), target) != implicit_dependencies_.end() )
+    {
+        return DEPENDENCY_IMPLICIT;
+    }
+    if ( find(ordering_dependencies_.begin(), ordering_dependencies_.end(), target) != ordering_dependencies_.end() )
+    {
+        return DEPENDENCY_ORDERING;
+    }
+    return DEPENDENCY_NULL;
 }
 
 /**
@@ -1180,6 +1525,22 @@ Target* Target::any_dependency( int n ) const
     return NULL;
 }
 
+/**
+// Get the Targets that depend on this Target.
+//
+// The dependents of a Target are maintained as dependencies are added and 
+// removed so that the Targets affected by a change to this Target can be 
+// found without searching the whole Graph (see `Graph::affected_targets()`).
+//
+// @return
+//  The Targets that have this Target as an explicit, implicit, or ordering
+//  dependency.
+*/
+const std::unordered_set<Target*>& Target::dependents() const
+{
+    return dependents_;
+}
+
 /**
 // Are all of the dependencies of this Target built successfully?
 //
@@ -1414,6 +1775,33 @@ int Target::postorder_height() const
     return postorder_height_;
 }
 
+/**
+// Set the index of this Target in the GraphSnapshot for the current 
+// traversal.
+//
+// @param index
+//  The value to set the snapshot index of this Target to.
+*/
+void Target::set_snapshot_index( int index )
+{
+    snapshot_index_ = index;
+}
+
+/**
+// Get the index of this Target in the GraphSnapshot for the current or most
+// recent traversal.
+//
+// The index is only valid while this Target is marked as visited in the 
+// current traversal.
+//
+// @return
+//  The snapshot index of this Target.
+*/
+int Target::snapshot_index() const
+{
+    return snapshot_index_;
+}
+
 /**
 // Get the next anonymous index from this Target.
 //
@@ -1431,19 +1819,15 @@ int Target::next_anonymous_index()
 /**
 // Write this Target to \e writer.
 //
+// Only this Target's record is written; the GraphWriter writes each Target
+// in the Graph in preorder.
+//
 // @param writer
 //  The GraphWriter to use to serialize this Target to.
 */
 void Target::write( GraphWriter& writer )
 {
-    writer.object_address( this );
-    writer.value( id_ );
-    writer.value( last_write_time_ );
-    writer.value( hash_ );
-    writer.value( built_ );
-    writer.value( filenames_ );
-    writer.value( targets_ );
-    writer.refer( implicit_dependencies_ );    
+    writer.target( id_, last_write_time_, hash_, content_timestamp_, content_hash_, signature_, built_, cutoff_, filenames_, targets_, implicit_dependencies_ );
 }
 
 /**
@@ -1454,38 +1838,239 @@ void Target::write( GraphWriter& writer )
 */
 void Target::read( GraphReader& reader )
 {
-    reader.object_address( this );
-    reader.value( &id_ );
-    reader.value( &last_write_time_ );
-    reader.value( &hash_ );
-    reader.value( &built_ );
-    reader.value( &filenames_ );
-    reader.value( &targets_ );
-    reader.refer( &implicit_dependencies_ );    
+    reader.target( &id_, &last_write_time_, &hash_, &content_timestamp_, &content_hash_, &signature_, &built_, &cutoff_, &filenames_, &targets_, &implicit_dependencies_ );
+}
+
+/**
+// Write this Target's state to \e journal.
+//
+// @param journal
+//  The GraphJournal to checkpoint this Target to.
+*/
+void Target::write( GraphJournal& journal )
+{
+    journal.target( path(), last_write_time_, hash_, content_timestamp_, content_hash_, signature_, built_, cutoff_, filenames_, implicit_dependencies_ );
+}
+
+/**
+// Read this Target's state from the entry being replayed from \e journal.
+//
+// Implicit dependencies are found or created by path and replace any 
+// implicit dependencies this Target already has.  This Target is left 
+// unchanged if the entry can't be read.
+//
+// @param journal
+//  The GraphJournal to read this Target's state from.
+//
+// @return
+//  True if this Target's state was read otherwise false.
+*/
+bool Target::read( GraphJournal& journal )
+{
+    SWEET_ASSERT( graph_ );
+
+    int64_t last_write_time = 0;
+    uint64_t hash = 0;
+    int64_t content_timestamp = 0;
+    uint64_t content_hash = 0;
+    uint64_t signature = 0;
+    bool built = false;
+    bool cutoff = false;
+    vector<string> filenames;
+    vector<string> implicit_dependencies;
+    if ( !journal.target(&last_write_time, &hash, &content_timestamp, &content_hash, &signature, &built, &cutoff, &filenames, &implicit_dependencies) )
+    {
+        return false;
+    }
+
+    last_write_time_ = last_write_time;
+    hash_ = hash;
+    content_timestamp_ = content_timestamp;
+    content_hash_ = content_hash;
+    signature_ = signature;
+    built_ = built;
+    cutoff_ = cutoff;
+    filenames_.swap( filenames );
+    clear_implicit_dependencies();
+    for ( vector<string>::const_iterator i = implicit_dependencies.begin(); i != implicit_dependencies.end(); ++i )
+    {
+        add_implicit_dependency( graph_->add_or_find_target(*i, nullptr) );
+    }
+    return true;
 }
 
 /**
-// Resolve this Target's implicit dependencies to their new addresses.
+// Write the state that evaluating buildfiles set on this Target to 
+// \e evaluation.
 //
-// Recursively updates the addresses of this Target and its ancestors implicit
-// dependencies from their old addresses when the Graph was written out to 
-// their new addresses now that the Graph has been read back in.
+// @param evaluation
+//  The GraphEvaluation to snapshot this Target to.
+*/
+void Target::write( GraphEvaluation& evaluation )
+{
+    evaluation.target( this, cleanable_, pending_hash_, dependencies_, ordering_dependencies_ );
+}
+
+/**
+// Resolve this Target's implicit dependencies after it has been read.
 //
-// @param reader
-//  The GraphReader just read in the Graph.
+// Recursively rebuilds the dependency index and adds this Target and its
+// descendants as dependents of their implicit dependencies now that the 
+// Graph has been read back in.
 */
-void Target::resolve( const GraphReader& reader )
+void Target::resolve()
 {
-    for ( vector<Target*>::iterator i = implicit_dependencies_.begin(); i != implicit_dependencies_.end(); ++i )
+    index_dependencies();
+    for ( vector<Target*>::const_iterator i = implicit_dependencies_.begin(); i != implicit_dependencies_.end(); ++i )
     {
-        *i = reinterpret_cast<Target*>( reader.find_address_by_old_address(*i) );
+        Target* target = *i;
+        target->dependents_.insert( this );
     }
-    implicit_dependencies_.erase( remove(implicit_dependencies_.begin(), implicit_dependencies_.end(), nullptr), implicit_dependencies_.end() );
 
     for ( vector<Target*>::const_iterator i = targets_.begin(); i != targets_.end(); ++i )
     {
         Target* target = *i;
         SWEET_ASSERT( target );
-        target->resolve( reader );
+        target->resolve();
+    }
+}
+
+/**
+// Hash the contents of the files that this Target is bound to.
+//
+// If the contents have changed since they were last hashed, or they 
+// haven't been hashed before, then the content timestamp is updated to
+// \e latest_last_write_time.  If any file can't be read then the content
+// timestamp is set to \e latest_last_write_time and the content hash is 
+// cleared so that the files are hashed again next time.
+//
+// @param latest_last_write_time
+//  The latest last write time of the files that this Target is bound to.
+*/
+void Target::hash_content( int64_t latest_last_write_time )
+{
+    try
+    {
+        Hasher hasher;
+        System* system = graph_->forge()->system();
+        for ( vector<string>::const_iterator filename = filenames_.begin(); filename != filenames_.end(); ++filename )
+        {
+            uint64_t content_hash = system->content_hash( *filename );
+            hasher.append( &content_hash, sizeof(content_hash) );
+        }
+
+        uint64_t content_hash = hasher.value();
+        if ( content_timestamp_ == 0 || content_hash != content_hash_ )
+        {
+            content_timestamp_ = latest_last_write_time;
+            content_hash_ = content_hash;
+        }
+    }
+    catch ( const boost::filesystem::filesystem_error& )
+    {
+        content_timestamp_ = latest_last_write_time;
+        content_hash_ = 0;
+    }
+}
+
+/**
+// Record *target* as a dependency of kind *type* in the dependency index.
+//
+// If the dependency index isn't in use yet and this Target now has enough
+// dependencies to make linear searches expensive then the index is built
+// from scratch instead.
+//
+// @param target
+//  The Target that has just been added as a dependency.
+//
+// @param type
+//  The kind of dependency that *target* was added as.
+*/
+void Target::index_dependency( Target* target, DependencyType type )
+{
+    if ( dependencies_indexed_ )
+    {
+        dependency_types_[target] = type;
+    }
+    else if ( dependencies_.size() + implicit_dependencies_.size() + ordering_dependencies_.size() >= DEPENDENCY_INDEX_THRESHOLD )
+    {
+        index_dependencies();
+    }
+}
+
+/**
+// Remove *target* from the dependency index.
+//
+// @param target
+//  The Target that has just been removed as a dependency.
+*/
+void Target::unindex_dependency( Target* target )
+{
+    if ( dependencies_indexed_ )
+    {
+        dependency_types_.erase( target );
+    }
+}
+
+/**
+// Remove *dependencies* from the dependency index.
+//
+// @param dependencies
+//  The dependencies that are about to be cleared from this Target.
+*/
+void Target::unindex_dependencies( const std::vector<Target*>& dependencies )
+{
+    if ( dependencies_indexed_ )
+    {
+        for ( vector<Target*>::const_iterator i = dependencies.begin(); i != dependencies.end(); ++i )
+        {
+            dependency_types_.erase( *i );
+        }
+    }
+}
+
+/**
+// Rebuild the dependency index from the explicit, implicit, and ordering
+// dependencies of this Target.
+//
+// The index is only built when this Target has at least 
+// `DEPENDENCY_INDEX_THRESHOLD` dependencies; Targets with fewer dependencies
+// are searched linearly.
+*/
+void Target::index_dependencies()
+{
+    size_t dependencies = dependencies_.size() + implicit_dependencies_.size() + ordering_dependencies_.size();
+    dependencies_indexed_ = dependencies >= DEPENDENCY_INDEX_THRESHOLD;
+    dependency_types_.clear();
+    if ( dependencies_indexed_ )
+    {
+        dependency_types_.reserve( dependencies );
+        for ( vector<Target*>::const_iterator i = dependencies_.begin(); i != dependencies_.end(); ++i )
+        {
+            dependency_types_[*i] = DEPENDENCY_EXPLICIT;
+        }
+        for ( vector<Target*>::const_iterator i = implicit_dependencies_.begin(); i != implicit_dependencies_.end(); ++i )
+        {
+            dependency_types_[*i] = DEPENDENCY_IMPLICIT;
+        }
+        for ( vector<Target*>::const_iterator i = ordering_dependencies_.begin(); i != ordering_dependencies_.end(); ++i )
+        {
+            dependency_types_[*i] = DEPENDENCY_ORDERING;
+        }
+    }
+}
+
+/**
+// Remove this Target from the dependents of *dependencies*.
+//
+// @param dependencies
+//  The dependencies that are about to be cleared from this Target.
+*/
+void Target::remove_from_dependents( const std::vector<Target*>& dependencies )
+{
+    for ( vector<Target*>::const_iterator i = dependencies.begin(); i != dependencies.end(); ++i )
+    {
+        Target* target = *i;
+        target->dependents_.erase( this );
     }
 }
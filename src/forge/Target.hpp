@@ -4,6 +4,8 @@
 #include <ctime>
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
 #include <stdint.h>
 
 namespace sweet
@@ -14,10 +16,23 @@ namespace forge
 
 class GraphWriter;
 class GraphReader;
+class GraphJournal;
+class GraphEvaluation;
 class TargetPrototype;
 class Graph;
 class Forge;
 
+/**
+// The kind of dependency that one Target has on another.
+*/
+enum DependencyType
+{
+    DEPENDENCY_NULL, ///< The Target is not a dependency.
+    DEPENDENCY_EXPLICIT, ///< The Target is an explicit dependency.
+    DEPENDENCY_IMPLICIT, ///< The Target is an implicit dependency.
+    DEPENDENCY_ORDERING ///< The Target is an ordering dependency.
+};
+
 /**
 // A Target.
 */
@@ -28,10 +43,15 @@ class Target
     mutable std::string branch_; ///< The branch path to this Target in the Target namespace.
     Graph* graph_; ///< The Graph that this Target is part of.
     TargetPrototype* prototype_; ///< The TargetPrototype for this Target or null if this Target has no TargetPrototype.
-    std::time_t timestamp_; ///< The timestamp for this Target.
-    std::time_t last_write_time_; ///< The last write time of the file that this Target is bound to.
+    int64_t timestamp_; ///< The timestamp for this Target in nanoseconds since the epoch.
+    int64_t last_write_time_; ///< The last write time of the file that this Target is bound to in nanoseconds since the epoch.
     uint64_t hash_; ///< The hash for this Target the last time that it was built.
     uint64_t pending_hash_; ///< The hash for this Target when it was created in the current run.
+    int64_t content_timestamp_; ///< The latest last write time of this Target's files when their contents last changed or 0 if they haven't been hashed.
+    uint64_t content_hash_; ///< The hash of the contents of this Target's files when they were last hashed.
+    uint64_t signature_; ///< The signature of the last command executed to build this Target or 0 if no command has been executed.
+    int64_t file_timestamp_; ///< The timestamp of this Target when it was bound to its files and before it was bound to its dependencies.
+    bool file_outdated_; ///< Whether or not this Target was outdated when it was bound to its files and before it was bound to its dependencies.
     bool outdated_; ///< Whether or not this Target is out of date.
     bool changed_; ///< Whether or not this Target's timestamp has changed since the last time it was bound to a file.
     bool bound_to_file_; ///< Whether or not this Target is bound to a file.
@@ -39,17 +59,22 @@ class Target
     bool referenced_by_script_; ///< Whether or not this Target is referenced by a scripting object.  
     bool cleanable_; ///< Whether or not this Target is able to be cleaned.
     bool built_; ///< Whether or not this Target has had `Target::clear_implicit_dependencies()` called on it.
+    bool cutoff_; ///< Whether or not this Target's timestamp only advances when the contents of its files change.
     Target* working_directory_; ///< The Target that relative paths expressed when this Target is visited are relative to.
     Target* parent_; ///< The parent of this Target in the Target namespace or null if this Target has no parent.
     std::vector<Target*> targets_; ///< The children of this Target in the Target namespace.
     std::vector<Target*> dependencies_; ///< The Targets that this Target depends on.
     std::vector<Target*> implicit_dependencies_; ///< The Targets that this Target implicitly depends on.
     std::vector<Target*> ordering_dependencies_; ///< The Targets that must build before this Target is built.
+    std::unordered_map<Target*, DependencyType> dependency_types_; ///< The DependencyType of each dependency of this Target once there are enough dependencies to index.
+    bool dependencies_indexed_; ///< Whether or not dependencies are indexed in `dependency_types_`.
+    std::unordered_set<Target*> dependents_; ///< The Targets that have this Target as an explicit, implicit, or ordering dependency.
     std::vector<std::string> filenames_; ///< The filenames of this Target.
     bool visiting_; ///< Whether or not this Target is in the process of being visited.
     int visited_revision_; ///< The visited revision the last time this Target was visited.
     int successful_revision_; ///< The successful revision the last time this Target was successfully visited.
     int postorder_height_; ///< The height of this Target in the current or most recent dependency graph traversal.
+    int snapshot_index_; ///< The index of this Target in the GraphSnapshot for the current or most recent dependency graph traversal.
     int anonymous_; ///< The anonymous index for this Target that will generate the next anonymous identifier requested from this Target.
 
     public:
@@ -71,6 +96,11 @@ class Target
         void bind();
         void bind_to_file();
         void bind_to_dependencies();
+        void bind_to_dependencies( int64_t dependencies_timestamp, bool dependencies_outdated );
+        void rebind_to_dependencies();
+        void unbind();
+        bool bind_to_content();
+        bool bind_to_signature( uint64_t signature );
         void bind_to_hash();
         void set_hash( uint64_t hash );
 
@@ -83,9 +113,15 @@ class Target
         void set_built( bool built );
         bool built() const;
 
-        void set_timestamp( std::time_t timestamp );
-        std::time_t timestamp() const;
-        std::time_t last_write_time() const;
+        void set_cutoff( bool cutoff );
+        bool cutoff() const;
+
+        void set_signature( uint64_t signature );
+        uint64_t signature() const;
+
+        void set_timestamp( int64_t timestamp );
+        int64_t timestamp() const;
+        int64_t last_write_time() const;
 
         void set_outdated( bool outdated );
         bool outdated() const;
@@ -107,7 +143,9 @@ class Target
 
         void add_target( Target* target, Target* this_target );
         void destroy_anonymous_targets();
+        void detach();
         Target* find_target_by_id( const std::string& id ) const;
+        Target* find_target_by_id( const char* id, size_t length ) const;
         const std::vector<Target*>& targets() const;
 
         void add_explicit_dependency( Target* target );
@@ -122,11 +160,13 @@ class Target
         bool is_implicit_dependency( Target* target ) const;
         bool is_ordering_dependency( Target* target ) const;
         bool is_dependency( Target* target ) const;
+        DependencyType dependency_type( Target* target ) const;
         Target* explicit_dependency( int n ) const;
         Target* implicit_dependency( int n ) const;
         Target* ordering_dependency( int n ) const;
         Target* binding_dependency( int n ) const;
         Target* any_dependency( int n ) const;
+        const std::unordered_set<Target*>& dependents() const;
 
         bool buildable() const;
         std::string error_identifier() const;
@@ -143,13 +183,27 @@ class Target
 
         void set_postorder_height( int height );
         int postorder_height() const;
+
+        void set_snapshot_index( int index );
+        int snapshot_index() const;
         
         int next_anonymous_index();
 
         void write( GraphWriter& writer );
         void read( GraphReader& reader );
-        void resolve( const GraphReader& reader );
+        void write( GraphJournal& journal );
+        bool read( GraphJournal& journal );
+        void write( GraphEvaluation& evaluation );
+        void resolve();
         template <class Archive> void persist( Archive& archive );
+
+    private:
+        void hash_content( int64_t latest_last_write_time );
+        void index_dependency( Target* target, DependencyType type );
+        void unindex_dependency( Target* target );
+        void unindex_dependencies( const std::vector<Target*>& dependencies );
+        void remove_from_dependents( const std::vector<Target*>& dependencies );
+        void index_dependencies();
 };
 
 }
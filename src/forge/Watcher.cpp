@@ -0,0 +1,391 @@
+//
+// Watcher.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "Watcher.hpp"
+#include "Forge.hpp"
+#include "Graph.hpp"
+#include "Target.hpp"
+#include "System.hpp"
+#include <assert/assert.hpp>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#if defined(BUILD_OS_LINUX)
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+using std::string;
+using std::vector;
+using std::make_pair;
+using namespace sweet;
+using namespace sweet::forge;
+
+/**
+// The number of milliseconds without changes before a wait returns so that
+// a burst of changes, e.g. saving several files at once or switching
+// branches, is reported by a single wait.
+*/
+static const int QUIET_MILLISECONDS = 100;
+
+/**
+// The number of milliseconds between polls of last write times when
+// changes can't be watched with inotify.
+*/
+static const int POLL_MILLISECONDS = 250;
+
+/**
+// Get the directory part of \e filename.
+*/
+static string directory_of( const string& filename )
+{
+    string::size_type slash = filename.find_last_of( "/\\" );
+    return slash == string::npos ? string( "." ) : slash == 0 ? string( "/" ) : filename.substr( 0, slash );
+}
+
+/**
+// Constructor.
+//
+// @param forge
+//  The Forge that this Watcher is part of.
+*/
+Watcher::Watcher( Forge* forge )
+: forge_( forge ),
+  inotify_( -1 ),
+  directories_(),
+  watched_directories_(),
+  files_(),
+  buildfiles_()
+{
+    SWEET_ASSERT( forge_ );
+}
+
+/**
+// Destructor.
+*/
+Watcher::~Watcher()
+{
+#if defined(BUILD_OS_LINUX)
+    if ( inotify_ >= 0 )
+    {
+        ::close( inotify_ );
+        inotify_ = -1;
+    }
+#endif
+}
+
+/**
+// Add a buildfile that isn't loaded through `buildfile()`, i.e. the root
+// build script.
+//
+// @param filename
+//  The absolute path to the buildfile.
+*/
+void Watcher::add_buildfile( const std::string& filename )
+{
+    buildfiles_.insert( filename );
+}
+
+/**
+// Watch the files of the source file and buildfile Targets in \e graph.
+//
+// Files already watched stay watched so this is cheap to call before each
+// wait to pick up source files, e.g. headers, discovered by the last build.
+//
+// @param graph
+//  The Graph to watch the source files and buildfiles of.
+*/
+void Watcher::watch( Graph* graph )
+{
+    SWEET_ASSERT( graph );
+
+#if defined(BUILD_OS_LINUX)
+    if ( inotify_ < 0 && watched_directories_.empty() )
+    {
+        inotify_ = ::inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    }
+#endif
+
+    Target* cache_target = graph->cache_target();
+    if ( cache_target )
+    {
+        int index = 0;
+        Target* buildfile = cache_target->explicit_dependency( index );
+        while ( buildfile )
+        {
+            const vector<string>& filenames = buildfile->filenames();
+            buildfiles_.insert( filenames.begin(), filenames.end() );
+            ++index;
+            buildfile = cache_target->explicit_dependency( index );
+        }
+    }
+
+    vector<Target*> targets;
+    targets.push_back( graph->root_target() );
+    while ( !targets.empty() )
+    {
+        Target* target = targets.back();
+        targets.pop_back();
+        if ( target != cache_target && !target->cleanable() && !target->prototype() )
+        {
+            const vector<string>& filenames = target->filenames();
+            for ( vector<string>::const_iterator filename = filenames.begin(); filename != filenames.end(); ++filename )
+            {
+                if ( !filename->empty() )
+                {
+                    watch_file( *filename );
+                }
+            }
+        }
+        const vector<Target*>& children = target->targets();
+        targets.insert( targets.end(), children.begin(), children.end() );
+    }
+}
+
+/**
+// Wait for watched files to change.
+//
+// Blocks until at least one watched file changes and then until no more
+// changes are seen for a short time.
+//
+// @param filenames
+//  The vector to append the paths of changed files to (assumed not null).
+//
+// @return
+//  True if any of the changed files are buildfiles otherwise false.
+*/
+bool Watcher::wait( std::vector<std::string>* filenames )
+{
+    SWEET_ASSERT( filenames );
+
+    size_t start = filenames->size();
+    if ( inotify_ >= 0 )
+    {
+        while ( filenames->size() == start )
+        {
+            read_events( -1, filenames );
+        }
+        while ( read_events(QUIET_MILLISECONDS, filenames) )
+        {
+        }
+    }
+    else
+    {
+        while ( !poll(filenames) )
+        {
+        }
+        while ( poll(filenames) )
+        {
+        }
+    }
+
+    std::sort( filenames->begin() + start, filenames->end() );
+    filenames->erase( std::unique(filenames->begin() + start, filenames->end()), filenames->end() );
+
+    bool buildfiles_changed = false;
+    for ( vector<string>::const_iterator filename = filenames->begin() + start; filename != filenames->end(); ++filename )
+    {
+        buildfiles_changed = buildfiles_changed || buildfiles_.count( *filename ) != 0;
+    }
+    return buildfiles_changed;
+}
+
+/**
+// Watch a file.
+//
+// @param filename
+//  The absolute path to the file to watch.
+*/
+void Watcher::watch_file( const std::string& filename )
+{
+    if ( !files_.insert(make_pair(filename, inotify_ >= 0 ? 0 : last_write_time(filename))).second )
+    {
+        return;
+    }
+
+    string directory = directory_of( filename );
+    if ( !watched_directories_.insert(directory).second )
+    {
+        return;
+    }
+
+#if defined(BUILD_OS_LINUX)
+    if ( inotify_ >= 0 )
+    {
+        const uint32_t MASK = IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+        int descriptor = ::inotify_add_watch( inotify_, directory.c_str(), MASK );
+        if ( descriptor >= 0 )
+        {
+            directories_[descriptor] = directory;
+        }
+        else if ( errno == ENOENT || errno == ENOTDIR )
+        {
+            // Try again on the next call to `watch()` in case the directory
+            // is created by then.
+            watched_directories_.erase( directory );
+            files_.erase( filename );
+        }
+        else if ( errno == ENOSPC || errno == ENOMEM )
+        {
+            // Fall back to polling all files when the limit on the number of
+            // inotify watches is reached.
+            forge_->outputf( "forge: Watching '%s' failed, polling instead (see fs.inotify.max_user_watches)", directory.c_str() );
+            ::close( inotify_ );
+            inotify_ = -1;
+            directories_.clear();
+            for ( std::unordered_map<string, int64_t>::iterator file = files_.begin(); file != files_.end(); ++file )
+            {
+                file->second = last_write_time( file->first );
+            }
+        }
+    }
+#endif
+}
+
+/**
+// Read queued inotify events.
+//
+// @param timeout
+//  The number of milliseconds to wait for events or -1 to wait forever.
+//
+// @param filenames
+//  The vector to append the paths of changed files to (assumed not null).
+//
+// @return
+//  True if any events were read otherwise false.
+*/
+bool Watcher::read_events( int timeout, std::vector<std::string>* filenames )
+{
+    SWEET_ASSERT( filenames );
+
+    bool events = false;
+#if defined(BUILD_OS_LINUX)
+    struct pollfd descriptor;
+    descriptor.fd = inotify_;
+    descriptor.events = POLLIN;
+    descriptor.revents = 0;
+    if ( ::poll(&descriptor, 1, timeout) <= 0 )
+    {
+        return false;
+    }
+
+    System* system = forge_->system();
+    alignas(struct inotify_event) char buffer [65536];
+    ssize_t bytes = ::read( inotify_, buffer, sizeof(buffer) );
+    while ( bytes > 0 )
+    {
+        events = true;
+        const char* position = buffer;
+        while ( position < buffer + bytes )
+        {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>( position );
+            position += sizeof(struct inotify_event) + event->len;
+
+            if ( event->mask & IN_Q_OVERFLOW )
+            {
+                system->invalidate_all();
+                for ( std::unordered_map<string, int64_t>::const_iterator file = files_.begin(); file != files_.end(); ++file )
+                {
+                    filenames->push_back( file->first );
+                }
+                continue;
+            }
+
+            std::unordered_map<int, string>::iterator directory = directories_.find( event->wd );
+            if ( directory == directories_.end() )
+            {
+                continue;
+            }
+
+            // The directory has been removed so its files are reported as
+            // changed and forgotten to be watched again by the next call to
+            // `watch()` if the directory is recreated.
+            if ( event->mask & IN_IGNORED )
+            {
+                std::unordered_map<string, int64_t>::iterator file = files_.begin();
+                while ( file != files_.end() )
+                {
+                    if ( directory_of(file->first) == directory->second )
+                    {
+                        system->invalidate( file->first );
+                        filenames->push_back( file->first );
+                        file = files_.erase( file );
+                    }
+                    else
+                    {
+                        ++file;
+                    }
+                }
+                watched_directories_.erase( directory->second );
+                directories_.erase( directory );
+                continue;
+            }
+
+            if ( event->len > 0 )
+            {
+                string path = directory->second == "/" ? string( "/" ) + event->name : directory->second + "/" + event->name;
+                system->invalidate( path );
+                if ( files_.count(path) )
+                {
+                    filenames->push_back( path );
+                }
+            }
+        }
+        bytes = ::read( inotify_, buffer, sizeof(buffer) );
+    }
+#else
+    (void) timeout;
+#endif
+    return events;
+}
+
+/**
+// Poll the last write times of watched files.
+//
+// @param filenames
+//  The vector to append the paths of changed files to (assumed not null).
+//
+// @return
+//  True if any files changed otherwise false.
+*/
+bool Watcher::poll( std::vector<std::string>* filenames )
+{
+    SWEET_ASSERT( filenames );
+
+    std::this_thread::sleep_for( std::chrono::milliseconds(POLL_MILLISECONDS) );
+
+    bool changed = false;
+    System* system = forge_->system();
+    for ( std::unordered_map<string, int64_t>::iterator file = files_.begin(); file != files_.end(); ++file )
+    {
+        int64_t timestamp = last_write_time( file->first );
+        if ( timestamp != file->second )
+        {
+            file->second = timestamp;
+            system->invalidate( file->first );
+            filenames->push_back( file->first );
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/**
+// Get the last write time of a file bypassing the System's cache.
+//
+// Polling compares nanosecond timestamps so that a file saved again within
+// the same second as its last recorded write is still seen to change.
+//
+// @return
+//  The last write time of \e filename in nanoseconds since the epoch or 0 
+//  if it doesn't exist.
+*/
+int64_t Watcher::last_write_time( const std::string& filename )
+{
+    return System::read_status( filename ).last_write_time_;
+}
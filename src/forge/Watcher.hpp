@@ -0,0 +1,60 @@
+#ifndef FORGE_WATCHER_HPP_INCLUDED
+#define FORGE_WATCHER_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <stdint.h>
+
+namespace sweet
+{
+
+namespace forge
+{
+
+class Forge;
+class Graph;
+
+/**
+// Wait for source files and buildfiles to change between builds.
+//
+// The files watched are those of the Targets in a Graph that aren't
+// cleanable and don't have a prototype, i.e. source files and buildfiles,
+// as these are the files that change outside of the build.  On Linux the
+// directories containing those files are watched with inotify so that
+// changes made while the build runs are queued and reported by the next
+// wait.  Elsewhere the last write times of the files are polled.
+//
+// Every change seen, whether to a watched file or not, is invalidated in
+// the System's cache of file system status so that the next bind only
+// stats the paths that have changed.
+*/
+class Watcher
+{
+    Forge* forge_; ///< The Forge that this Watcher is part of.
+    int inotify_; ///< The inotify instance or -1 if changes are polled.
+    std::unordered_map<int, std::string> directories_; ///< The watched directories by inotify watch descriptor.
+    std::unordered_set<std::string> watched_directories_; ///< The directories that have been watched or failed to be watched.
+    std::unordered_map<std::string, int64_t> files_; ///< The last write times, in nanoseconds, of watched files by path.
+    std::unordered_set<std::string> buildfiles_; ///< The watched files that are buildfiles.
+
+public:
+    Watcher( Forge* forge );
+    ~Watcher();
+    void add_buildfile( const std::string& filename );
+    void watch( Graph* graph );
+    bool wait( std::vector<std::string>* filenames );
+
+private:
+    void watch_file( const std::string& filename );
+    bool read_events( int timeout, std::vector<std::string>* filenames );
+    bool poll( std::vector<std::string>* filenames );
+    static int64_t last_write_time( const std::string& filename );
+};
+
+}
+
+}
+
+#endif
@@ -5,7 +5,11 @@
 
 #include "stdafx.hpp"
 #include "Application.hpp"
+#include "Connection.hpp"
 #include <forge/Forge.hpp>
+#include <forge/Graph.hpp>
+#include <forge/Target.hpp>
+#include <forge/System.hpp>
 #include <forge/path_functions.hpp>
 #include <cmdline/Parser.hpp>
 #include <error/ErrorPolicy.hpp>
@@ -13,20 +17,172 @@
 #include <boost/filesystem/operations.hpp>
 #include <string>
 #include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
 #include <iostream>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #ifdef BUILD_OS_WINDOWS
 #include <io.h>
 #include <fcntl.h>
+#else
+#include <unistd.h>
 #endif
 
 using std::string;
 using std::vector;
+using std::map;
+using namespace sweet;
 using namespace sweet::forge;
 
+#if defined(BUILD_OS_MACOS)
+extern char** environ;
+#endif
+
+/**
+// The commands that leave a resident Forge able to run later commands
+// without reloading buildfiles.
+//
+// Other commands, e.g. `clean` and `reconfigure`, change or discard the
+// state of the Graph so the next request loads buildfiles again.
+*/
+static const char* REUSABLE_COMMANDS[] =
+{
+    "default",
+    "build",
+    "dependencies",
+    "affected",
+    "namespace",
+    "help"
+};
+
+/**
+// Is \e command one of the commands that leave a resident Forge reusable?
+*/
+static bool reusable_command( const string& command )
+{
+    const char** begin = REUSABLE_COMMANDS;
+    const char** end = REUSABLE_COMMANDS + sizeof(REUSABLE_COMMANDS) / sizeof(REUSABLE_COMMANDS[0]);
+    return std::find_if( begin, end, [&command]( const char* reusable ) { return command == reusable; } ) != end;
+}
+
+/**
+// Get the last write time of a file or 0 if it doesn't exist.
+*/
+static int64_t last_write_time( const string& filename )
+{
+    boost::system::error_code error;
+    std::time_t timestamp = boost::filesystem::last_write_time( filename, error );
+    return error ? 0 : int64_t(timestamp);
+}
+
+/**
+// Record the last write times of the buildfiles loaded by \e forge.
+//
+// @param forge
+//  The Forge to record the buildfiles of (assumed not null).
+//
+// @param filename
+//  The root build script filename relative to the root directory.
+//
+// @param buildfiles
+//  The map to record last write times by path in (assumed not null).
+*/
+static void record_buildfiles( Forge* forge, const string& filename, map<string, int64_t>* buildfiles )
+{
+    SWEET_ASSERT( forge );
+    SWEET_ASSERT( buildfiles );
+
+    buildfiles->clear();
+    string root_script = forge->root( filename ).generic_string();
+    buildfiles->insert( std::make_pair(root_script, last_write_time(root_script)) );
+
+    Target* cache_target = forge->graph()->cache_target();
+    if ( cache_target )
+    {
+        int index = 0;
+        Target* buildfile = cache_target->explicit_dependency( index );
+        while ( buildfile )
+        {
+            const vector<string>& filenames = buildfile->filenames();
+            for ( vector<string>::const_iterator i = filenames.begin(); i != filenames.end(); ++i )
+            {
+                buildfiles->insert( std::make_pair(*i, last_write_time(*i)) );
+            }
+            ++index;
+            buildfile = cache_target->explicit_dependency( index );
+        }
+    }
+}
+
+/**
+// Get the environment of this process as "name=value" strings.
+*/
+static vector<string> environment()
+{
+    vector<string> environment;
+#if !defined(BUILD_OS_WINDOWS)
+    for ( char** variable = environ; variable && *variable; ++variable )
+    {
+        environment.push_back( *variable );
+    }
+#endif
+    return environment;
+}
+
+/**
+// Replace the environment of this process with \e environment.
+//
+// Commands executed while serving a request inherit the environment of the
+// client rather than that of the build server and buildfiles see the same
+// environment variables as a local build would.
+//
+// @param environment
+//  The "name=value" strings to set the environment to.
+*/
+static void set_environment( const vector<string>& environment )
+{
+#if !defined(BUILD_OS_WINDOWS)
+    vector<string> current = ::environment();
+    for ( vector<string>::const_iterator i = current.begin(); i != current.end(); ++i )
+    {
+        ::unsetenv( i->substr(0, i->find('=')).c_str() );
+    }
+    for ( vector<string>::const_iterator i = environment.begin(); i != environment.end(); ++i )
+    {
+        string::size_type equals = i->find( '=' );
+        if ( equals != string::npos && equals > 0 )
+        {
+            ::setenv( i->substr(0, equals).c_str(), i->c_str() + equals + 1, 1 );
+        }
+    }
+#else
+    (void) environment;
+#endif
+}
+
+/**
+// Have any of the buildfiles recorded by `record_buildfiles()` changed?
+*/
+static bool buildfiles_changed( const map<string, int64_t>& buildfiles )
+{
+    for ( map<string, int64_t>::const_iterator i = buildfiles.begin(); i != buildfiles.end(); ++i )
+    {
+        if ( last_write_time(i->first) != i->second )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 Application::Application( int argc, char** argv )
 : ForgeEventSink(),
-  result_( EXIT_SUCCESS )
+  result_( EXIT_SUCCESS ),
+  connection_( nullptr )
 {
 #ifdef BUILD_OS_WINDOWS
     _setmode( _fileno(stdout), _O_BINARY );
@@ -39,6 +195,9 @@ Application::Application( int argc, char** argv )
     std::string root_directory;
     std::string filename = "forge.lua";
     bool stack_trace_enabled = false;    
+    bool memory_statistics = false;
+    bool server = false;
+    bool local = false;
     std::vector<std::string> assignments_and_commands;
 
     error::ErrorPolicy error_policy;
@@ -49,6 +208,9 @@ Application::Application( int argc, char** argv )
         ( "root", "r", "Set root directory", &root_directory )
         ( "file", "f", "Set root build script filename", &filename )
         ( "stack-trace", "s", "Stack traces on error", &stack_trace_enabled )
+        ( "memory-statistics", "m", "Report Lua memory use on exit", &memory_statistics )
+        ( "server", "", "Serve build requests for the root directory", &server )
+        ( "local", "l", "Build without forwarding to a build server", &local )
         ( &assignments_and_commands )
     ;
     command_line_parser.parse( argc, argv );
@@ -95,14 +257,50 @@ Application::Application( int argc, char** argv )
         error_policy.error( root_directory.empty(), "The file '%s' could not be found to identify the root directory", filename.c_str() );
     }
 
+    if ( error_policy.errors() == 0 )
+    {
+        root_directory = boost::filesystem::absolute( root_directory, directory ).generic_string();
+    }
+
+    if ( server )
+    {
+        if ( error_policy.errors() == 0 )
+        {
+            serve( root_directory, error_policy );
+        }
+        result_ = error_policy.errors() == 0 ? result_ : EXIT_FAILURE;
+        return;
+    }
+
+    // Commands are forwarded to a build server for the root directory when
+    // one is running.  The `watch` command, printing help or the version, and
+    // reporting memory statistics always run locally.
+    bool forwardable = 
+        !local && !help && !version && !memory_statistics &&
+        std::find( commands.begin(), commands.end(), string("watch") ) == commands.end()
+    ;
+    if ( error_policy.errors() == 0 && forwardable && forward(root_directory, directory, filename, stack_trace_enabled, assignments, commands) )
+    {
+        return;
+    }
+
+    // Commands are executed again with a new Forge when they request that
+    // buildfiles are reloaded, e.g. the `watch` command when buildfiles
+    // change.
     vector<string>::const_iterator command = commands.begin(); 
     while ( error_policy.errors() == 0 && command != commands.end() )
     {
-        Forge forge( directory, error_policy, this );
-        forge.set_stack_trace_enabled( stack_trace_enabled );
-        forge.set_root_directory( root_directory );
-        forge.assign_global_variables( assignments );
-        forge.execute( filename, *command );
+        bool reload_requested = true;
+        while ( reload_requested )
+        {
+            Forge forge( directory, error_policy, this );
+            forge.set_stack_trace_enabled( stack_trace_enabled );
+            forge.set_memory_statistics_enabled( memory_statistics );
+            forge.set_root_directory( root_directory );
+            forge.assign_global_variables( assignments );
+            forge.execute( filename, *command );
+            reload_requested = forge.reload_requested();
+        }
         ++command;
     }
 }
@@ -112,10 +310,241 @@ int Application::get_result() const
     return result_;
 }
 
+/**
+// Forward commands to the build server for a root directory.
+//
+// The environment of this process is sent along with the commands so that
+// the server executes them in the same environment.  Output, warnings, and
+// errors sent back by the server are printed as if the commands had run in
+// this process.
+//
+// @return
+//  True if the commands were forwarded or false if there is no build server
+//  running for \e root_directory and the commands need to run locally.
+*/
+bool Application::forward( const std::string& root_directory, const std::string& directory, const std::string& filename, bool stack_trace_enabled, const std::vector<std::string>& assignments, const std::vector<std::string>& commands )
+{
+    Connection connection;
+    if ( !connection.connect(Connection::socket_path(root_directory)) )
+    {
+        return false;
+    }
+
+    bool sent = 
+        connection.send( FRAME_DIRECTORY, directory ) &&
+        connection.send( FRAME_FILE, filename ) &&
+        connection.send( FRAME_STACK_TRACE, stack_trace_enabled ? "1" : "0" )
+    ;
+    for ( vector<string>::const_iterator i = assignments.begin(); sent && i != assignments.end(); ++i )
+    {
+        sent = connection.send( FRAME_ASSIGNMENT, *i );
+    }
+    vector<string> environment = ::environment();
+    for ( vector<string>::const_iterator i = environment.begin(); sent && i != environment.end(); ++i )
+    {
+        sent = connection.send( FRAME_ENVIRONMENT, *i );
+    }
+    for ( vector<string>::const_iterator i = commands.begin(); sent && i != commands.end(); ++i )
+    {
+        sent = connection.send( FRAME_COMMAND, *i );
+    }
+    if ( !sent || !connection.send(FRAME_EXECUTE, string()) )
+    {
+        return false;
+    }
+
+    char type = 0;
+    string data;
+    while ( connection.receive(&type, &data) )
+    {
+        switch ( type )
+        {
+            case FRAME_OUTPUT:
+                forge_output( nullptr, data.c_str() );
+                break;
+
+            case FRAME_WARNING:
+                forge_warning( nullptr, data.c_str() );
+                break;
+
+            case FRAME_ERROR:
+                forge_error( nullptr, data.c_str() );
+                break;
+
+            case FRAME_EXIT:
+                result_ = result_ != EXIT_SUCCESS ? result_ : atoi( data.c_str() );
+                return true;
+
+            default:
+                break;
+        }
+    }
+
+    forge_error( nullptr, "Lost connection to the build server" );
+    return true;
+}
+
+/**
+// Serve build requests for a root directory until killed.
+//
+// Requests are served one at a time in the environment sent by the client.
+// The Forge that served the last command is kept resident and runs the 
+// next command without loading buildfiles again when the request and its
+// environment match, the last command loaded buildfiles successfully and 
+// left the Graph intact, and none of the buildfiles have changed since they
+// were loaded.  Otherwise a new Forge loads buildfiles as usual.  Builds 
+// that fail leave the Graph intact; the targets that failed are built again
+// by the next build.
+//
+// @param root_directory
+//  The absolute path to the root directory to serve.
+//
+// @param error_policy
+//  The ErrorPolicy to report errors to.
+*/
+void Application::serve( const std::string& root_directory, error::ErrorPolicy& error_policy )
+{
+    string path = Connection::socket_path( root_directory );
+    int listener = Connection::listen( path );
+    if ( listener < 0 )
+    {
+        error_policy.error( path.empty(), "Build servers are not supported on this platform" );
+        error_policy.error( !path.empty(), "Listening on '%s' failed - %s", path.c_str(), strerror(errno) );
+        return;
+    }
+
+    printf( "forge: Serving '%s' on '%s'\n", root_directory.c_str(), path.c_str() );
+    fflush( stdout );
+
+    std::unique_ptr<Forge> forge;
+    string key;
+    map<string, int64_t> buildfiles;
+    for ( ;; )
+    {
+        Connection connection( Connection::accept(listener) );
+        if ( !connection.connected() )
+        {
+            continue;
+        }
+
+        string directory;
+        string filename = "forge.lua";
+        bool stack_trace_enabled = false;
+        vector<string> assignments;
+        vector<string> environment;
+        vector<string> commands;
+        char type = 0;
+        string data;
+        bool received = connection.receive( &type, &data );
+        while ( received && type != FRAME_EXECUTE )
+        {
+            switch ( type )
+            {
+                case FRAME_DIRECTORY:
+                    directory = data;
+                    break;
+
+                case FRAME_FILE:
+                    filename = data;
+                    break;
+
+                case FRAME_STACK_TRACE:
+                    stack_trace_enabled = data == "1";
+                    break;
+
+                case FRAME_ASSIGNMENT:
+                    assignments.push_back( data );
+                    break;
+
+                case FRAME_ENVIRONMENT:
+                    environment.push_back( data );
+                    break;
+
+                case FRAME_COMMAND:
+                    commands.push_back( data );
+                    break;
+
+                default:
+                    break;
+            }
+            received = connection.receive( &type, &data );
+        }
+        if ( !received || directory.empty() )
+        {
+            continue;
+        }
+
+        string request_key = directory + "\n" + filename + "\n" + (stack_trace_enabled ? "1" : "0");
+        for ( vector<string>::const_iterator i = assignments.begin(); i != assignments.end(); ++i )
+        {
+            request_key += "\n" + *i;
+        }
+        request_key += "\n";
+        for ( vector<string>::const_iterator i = environment.begin(); i != environment.end(); ++i )
+        {
+            request_key += "\n" + *i;
+        }
+        set_environment( environment );
+
+        connection_ = &connection;
+        result_ = EXIT_SUCCESS;
+        error_policy.push_errors();
+        vector<string>::const_iterator command = commands.begin(); 
+        while ( error_policy.errors() == 0 && command != commands.end() )
+        {
+            error_policy.push_errors();
+            bool reload_requested = true;
+            if ( forge && request_key == key && !buildfiles_changed(buildfiles) )
+            {
+                // Files may have been changed by anything since the last
+                // request so nothing cached about them, nor any Target 
+                // bound to them, can be trusted.
+                forge->system()->invalidate_all();
+                forge->graph()->unbind();
+                forge->command( filename, *command );
+                reload_requested = forge->reload_requested();
+            }
+
+            // Commands are executed again with a new Forge when they 
+            // request that buildfiles are reloaded, e.g. a build that finds
+            // outdated targets after restoring evaluated buildfiles.
+            while ( reload_requested )
+            {
+                forge.reset();
+                forge.reset( new Forge(directory, error_policy, this) );
+                forge->set_stack_trace_enabled( stack_trace_enabled );
+                forge->set_root_directory( root_directory );
+                forge->assign_global_variables( assignments );
+                forge->execute( filename, *command );
+                record_buildfiles( forge.get(), filename, &buildfiles );
+                key = request_key;
+                reload_requested = forge->reload_requested();
+            }
+            error_policy.pop_errors();
+            bool reusable = forge->loaded() && reusable_command( *command ) && !forge->reload_requested();
+            if ( !reusable )
+            {
+                forge.reset();
+            }
+            ++command;
+        }
+        error_policy.pop_errors();
+
+        connection.send( FRAME_EXIT, std::to_string(result_) );
+        connection_ = nullptr;
+    }
+}
+
 void Application::forge_output( Forge* /*forge*/, const char* message )
 {
     SWEET_ASSERT( message );
 
+    if ( connection_ )
+    {
+        connection_->send( FRAME_OUTPUT, message );
+        return;
+    }
+
     fputs( message, stdout );
     fputs( "\n", stdout );
     fflush( stdout );
@@ -124,6 +553,12 @@ void Application::forge_output( Forge* /*forge*/, const char* message )
 void Application::forge_warning( Forge* /*forge*/, const char* message )
 {
     SWEET_ASSERT( message );
+
+    if ( connection_ )
+    {
+        connection_->send( FRAME_WARNING, message );
+        return;
+    }
     
     fputs( "forge: ", stderr );
     fputs( message, stderr );
@@ -134,6 +569,13 @@ void Application::forge_warning( Forge* /*forge*/, const char* message )
 void Application::forge_error( Forge* /*forge*/, const char* message )
 {
     SWEET_ASSERT( message );
+
+    if ( connection_ )
+    {
+        connection_->send( FRAME_ERROR, message );
+        result_ = EXIT_FAILURE;
+        return;
+    }
     
     fputs( "forge: ", stderr );
     fputs( message, stderr );
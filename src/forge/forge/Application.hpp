@@ -2,24 +2,37 @@
 #define APPLICATION_HPP_INCLUDED
 
 #include <forge/ForgeEventSink.hpp>
+#include <string>
+#include <vector>
 
 namespace sweet
 {
 
+namespace error
+{
+
+class ErrorPolicy;
+
+}
+
 namespace forge
 {
 
 class Forge;
+class Connection;
 
 class Application : public ForgeEventSink
 {
     int result_;
+    Connection* connection_; ///< The client connection that output is sent to while serving a request or null.
 
     public:
         Application( int argc, char** argv );
         int get_result() const;
 
     private:
+        bool forward( const std::string& root_directory, const std::string& directory, const std::string& filename, bool stack_trace_enabled, const std::vector<std::string>& assignments, const std::vector<std::string>& commands );
+        void serve( const std::string& root_directory, error::ErrorPolicy& error_policy );
         void forge_output( Forge* forge, const char* message );
         void forge_warning( Forge* forge, const char* message );
         void forge_error( Forge* forge, const char* message );
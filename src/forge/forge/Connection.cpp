@@ -0,0 +1,443 @@
+//
+// Connection.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "Connection.hpp"
+#include <forge/Hasher.hpp>
+#include <assert/assert.hpp>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if !defined(BUILD_OS_WINDOWS)
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+using std::string;
+using namespace sweet::forge;
+
+/**
+// The largest frame accepted.
+*/
+static const size_t MAXIMUM_FRAME = size_t(64) << 20;
+
+#if !defined(BUILD_OS_WINDOWS)
+/**
+// Fill in the address of the Unix domain socket at \e path.
+//
+// @return
+//  True if \e path fits in the address otherwise false.
+*/
+static bool socket_address( const string& path, struct sockaddr_un* address )
+{
+    SWEET_ASSERT( address );
+    memset( address, 0, sizeof(*address) );
+    address->sun_family = AF_UNIX;
+    if ( path.size() >= sizeof(address->sun_path) )
+    {
+        return false;
+    }
+    memcpy( address->sun_path, path.c_str(), path.size() + 1 );
+    return true;
+}
+
+/**
+// Is \e directory private to the current user?
+//
+// The directory is created, only accessible by the current user, if it
+// doesn't exist and \e create is true.  It must be a directory rather than
+// a symbolic link, owned by the current user, and not accessible by group or
+// others so that no other user is able to create or replace sockets in it.
+*/
+static bool private_directory( const string& directory, bool create )
+{
+    if ( create && ::mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST )
+    {
+        return false;
+    }
+    struct stat status;
+    bool directory_private = 
+        ::lstat( directory.c_str(), &status ) == 0 &&
+        S_ISDIR( status.st_mode ) &&
+        status.st_uid == ::getuid() &&
+        (status.st_mode & 077) == 0
+    ;
+    if ( !directory_private )
+    {
+        errno = EACCES;
+    }
+    return directory_private;
+}
+
+/**
+// Is the process at the other end of \e socket run by the current user?
+*/
+static bool peer_is_current_user( int socket )
+{
+#if defined(BUILD_OS_LINUX) || defined(BUILD_OS_ANDROID)
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+    return ::getsockopt( socket, SOL_SOCKET, SO_PEERCRED, &credentials, &length ) == 0 && credentials.uid == ::getuid();
+#else
+    uid_t uid = 0;
+    gid_t gid = 0;
+    return ::getpeereid( socket, &uid, &gid ) == 0 && uid == ::getuid();
+#endif
+}
+
+/**
+// Get the directory that contains the socket at \e path.
+*/
+static string socket_directory( const string& path )
+{
+    string::size_type slash = path.rfind( '/' );
+    return slash != string::npos && slash > 0 ? path.substr( 0, slash ) : string( "/" );
+}
+#endif
+
+/**
+// Constructor.
+*/
+Connection::Connection()
+: socket_( -1 )
+{
+}
+
+/**
+// Constructor.
+//
+// @param socket
+//  The accepted socket to take ownership of.
+*/
+Connection::Connection( int socket )
+: socket_( socket )
+{
+}
+
+/**
+// Destructor.
+*/
+Connection::~Connection()
+{
+    close();
+}
+
+/**
+// Get the path to the socket that the build server for a root directory
+// listens on.
+//
+// The socket is created in the per-user runtime directory named by 
+// `XDG_RUNTIME_DIR` or, when that isn't set, a directory named for the user
+// id in the temporary directory.  Either stays within the length limit on 
+// socket paths, which the root directory might not, and is only accessible
+// by the current user (see `Connection::listen()`).  A hash of the root
+// directory makes the path unique per project.
+//
+// @param root_directory
+//  The absolute path to the root directory.
+//
+// @return
+//  The path to the socket or the empty string if build servers aren't
+//  supported on this platform.
+*/
+std::string Connection::socket_path( const std::string& root_directory )
+{
+#if defined(BUILD_OS_WINDOWS)
+    (void) root_directory;
+    return string();
+#else
+    const char* runtime_directory = ::getenv( "XDG_RUNTIME_DIR" );
+    bool runtime_directory_set = runtime_directory && *runtime_directory == '/';
+    const char* temporary_directory = ::getenv( "TMPDIR" );
+    string path = 
+        runtime_directory_set ? string( runtime_directory ) : 
+        temporary_directory && *temporary_directory ? string( temporary_directory ) : 
+        string( "/tmp" )
+    ;
+    while ( path.size() > 1 && path[path.size() - 1] == '/' )
+    {
+        path.erase( path.size() - 1 );
+    }
+    char name [64];
+    if ( !runtime_directory_set )
+    {
+        snprintf( name, sizeof(name), "/forge-%u", unsigned(::getuid()) );
+        path += name;
+    }
+    snprintf( name, sizeof(name), "/forge-%016llx.sock", (unsigned long long) Hasher::hash(root_directory.c_str(), root_directory.size()) );
+    return path + name;
+#endif
+}
+
+/**
+// Listen on a Unix domain socket.
+//
+// A socket left behind by a build server that didn't exit cleanly is
+// removed but one that is still accepting connections isn't.  The socket
+// is only accessible by the current user and listening fails if the 
+// directory containing it, created if it doesn't exist, is accessible by
+// anyone else.
+//
+// @param path
+//  The path to the socket to listen on.
+//
+// @return
+//  The listening socket or -1 if listening failed.
+*/
+int Connection::listen( const std::string& path )
+{
+#if defined(BUILD_OS_WINDOWS)
+    (void) path;
+    return -1;
+#else
+    struct sockaddr_un address;
+    if ( !socket_address(path, &address) || !private_directory(socket_directory(path), true) )
+    {
+        return -1;
+    }
+
+    Connection existing;
+    if ( existing.connect(path) )
+    {
+        errno = EADDRINUSE;
+        return -1;
+    }
+    ::unlink( path.c_str() );
+
+    ::signal( SIGPIPE, SIG_IGN );
+    int listener = ::socket( AF_UNIX, SOCK_STREAM, 0 );
+    mode_t mask = ::umask( 077 );
+    bool bound = listener >= 0 && ::bind( listener, (const struct sockaddr*) &address, sizeof(address) ) == 0;
+    ::umask( mask );
+    if ( !bound || ::listen(listener, 16) != 0 )
+    {
+        int error = errno;
+        if ( listener >= 0 )
+        {
+            ::close( listener );
+        }
+        errno = error;
+        return -1;
+    }
+    return listener;
+#endif
+}
+
+/**
+// Accept a connection on a listening socket.
+//
+// Connections from processes run by other users are closed rather than
+// relying only on the permissions of the socket.
+//
+// @param listener
+//  The socket returned from `Connection::listen()`.
+//
+// @return
+//  The accepted socket or -1 if accepting failed.
+*/
+int Connection::accept( int listener )
+{
+#if defined(BUILD_OS_WINDOWS)
+    (void) listener;
+    return -1;
+#else
+    int socket = ::accept( listener, nullptr, nullptr );
+    while ( socket < 0 && errno == EINTR )
+    {
+        socket = ::accept( listener, nullptr, nullptr );
+    }
+    if ( socket >= 0 && !peer_is_current_user(socket) )
+    {
+        ::close( socket );
+        socket = -1;
+    }
+    return socket;
+#endif
+}
+
+/**
+// Connect to the build server listening at \e path.
+//
+// No connection is made when the directory containing \e path is 
+// accessible by other users or the server is run by another user so that
+// requests are never sent to, nor output accepted from, anyone else.
+//
+// @return
+//  True if the connection was made otherwise false.
+*/
+bool Connection::connect( const std::string& path )
+{
+    close();
+#if !defined(BUILD_OS_WINDOWS)
+    struct sockaddr_un address;
+    if ( !path.empty() && socket_address(path, &address) && private_directory(socket_directory(path), false) )
+    {
+        ::signal( SIGPIPE, SIG_IGN );
+        socket_ = ::socket( AF_UNIX, SOCK_STREAM, 0 );
+        if ( socket_ >= 0 && ::connect(socket_, (const struct sockaddr*) &address, sizeof(address)) != 0 )
+        {
+            close();
+        }
+        if ( socket_ >= 0 && !peer_is_current_user(socket_) )
+        {
+            close();
+        }
+    }
+#else
+    (void) path;
+#endif
+    return socket_ >= 0;
+}
+
+/**
+// Is this Connection connected?
+*/
+bool Connection::connected() const
+{
+    return socket_ >= 0;
+}
+
+/**
+// Send a frame.
+//
+// The connection is closed if sending fails, e.g. because the other end
+// has gone away, so that later sends fail quickly.
+//
+// @param type
+//  The type of the frame (see `FrameType`).
+//
+// @param data
+//  The data to send in the frame.
+//
+// @return
+//  True if the frame was sent otherwise false.
+*/
+bool Connection::send( char type, const std::string& data )
+{
+#if !defined(BUILD_OS_WINDOWS)
+    if ( socket_ >= 0 )
+    {
+        uint32_t length = uint32_t(data.size());
+        string frame;
+        frame.reserve( data.size() + 5 );
+        frame.push_back( type );
+        for ( int i = 0; i < 4; ++i )
+        {
+            frame.push_back( char((length >> (i * 8)) & 0xff) );
+        }
+        frame.append( data );
+
+        size_t offset = 0;
+        while ( offset < frame.size() )
+        {
+            ssize_t bytes = ::send( socket_, frame.data() + offset, frame.size() - offset, 0 );
+            if ( bytes < 0 && errno == EINTR )
+            {
+                continue;
+            }
+            if ( bytes <= 0 )
+            {
+                close();
+                return false;
+            }
+            offset += size_t(bytes);
+        }
+        return true;
+    }
+#else
+    (void) type;
+    (void) data;
+#endif
+    return false;
+}
+
+/**
+// Receive a frame.
+//
+// @param type
+//  Set to the type of the received frame (assumed not null).
+//
+// @param data
+//  Set to the data received in the frame (assumed not null).
+//
+// @return
+//  True if a frame was received otherwise false.
+*/
+bool Connection::receive( char* type, std::string* data )
+{
+    SWEET_ASSERT( type );
+    SWEET_ASSERT( data );
+
+#if !defined(BUILD_OS_WINDOWS)
+    unsigned char header [5];
+    size_t received = 0;
+    while ( socket_ >= 0 && received < sizeof(header) )
+    {
+        ssize_t bytes = ::recv( socket_, header + received, sizeof(header) - received, 0 );
+        if ( bytes < 0 && errno == EINTR )
+        {
+            continue;
+        }
+        if ( bytes <= 0 )
+        {
+            close();
+            return false;
+        }
+        received += size_t(bytes);
+    }
+
+    size_t length = size_t(header[1]) | (size_t(header[2]) << 8) | (size_t(header[3]) << 16) | (size_t(header[4]) << 24);
+    if ( socket_ < 0 || length > MAXIMUM_FRAME )
+    {
+        close();
+        return false;
+    }
+
+    *type = char(header[0]);
+    data->resize( length );
+    received = 0;
+    while ( received < length )
+    {
+        ssize_t bytes = ::recv( socket_, &(*data)[received], length - received, 0 );
+        if ( bytes < 0 && errno == EINTR )
+        {
+            continue;
+        }
+        if ( bytes <= 0 )
+        {
+            close();
+            return false;
+        }
+        received += size_t(bytes);
+    }
+    return true;
+#else
+    (void) type;
+    (void) data;
+    return false;
+#endif
+}
+
+/**
+// Close this Connection.
+*/
+void Connection::close()
+{
+#if !defined(BUILD_OS_WINDOWS)
+    if ( socket_ >= 0 )
+    {
+        ::close( socket_ );
+        socket_ = -1;
+    }
+#endif
+}
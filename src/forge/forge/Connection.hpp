@@ -0,0 +1,63 @@
+#ifndef CONNECTION_HPP_INCLUDED
+#define CONNECTION_HPP_INCLUDED
+
+#include <string>
+
+namespace sweet
+{
+
+namespace forge
+{
+
+/**
+// The types of the frames sent between the forge client and build server.
+*/
+enum FrameType
+{
+    FRAME_DIRECTORY = 'd', ///< The initial directory of a request.
+    FRAME_FILE = 'f', ///< The root build script filename of a request.
+    FRAME_STACK_TRACE = 's', ///< Whether stack traces are enabled for a request ("1" or "0").
+    FRAME_ASSIGNMENT = 'a', ///< A variable assignment of a request.
+    FRAME_ENVIRONMENT = 'n', ///< An environment variable of a request ("name=value").
+    FRAME_COMMAND = 'c', ///< A command of a request.
+    FRAME_EXECUTE = 'g', ///< Ends a request and starts executing it.
+    FRAME_OUTPUT = 'o', ///< Output from executing a request.
+    FRAME_WARNING = 'w', ///< A warning from executing a request.
+    FRAME_ERROR = 'e', ///< An error from executing a request.
+    FRAME_EXIT = 'x' ///< Ends a response with the exit code of the request.
+};
+
+/**
+// A connection between the forge client and a build server over a Unix
+// domain socket.
+//
+// Each frame is a type byte, a four byte little endian length, and that
+// many bytes of data.
+*/
+class Connection
+{
+    int socket_; ///< The connected socket or -1 if not connected.
+
+    public:
+        Connection();
+        explicit Connection( int socket );
+        ~Connection();
+        static std::string socket_path( const std::string& root_directory );
+        static int listen( const std::string& path );
+        static int accept( int listener );
+        bool connect( const std::string& path );
+        bool connected() const;
+        bool send( char type, const std::string& data );
+        bool receive( char* type, std::string* data );
+        void close();
+
+    private:
+        Connection( const Connection& );
+        Connection& operator=( const Connection& );
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,37 @@
+
+-- Time hashing settings tables that haven't been hashed before and settings
+-- tables that inherit from a settings table that has.
+
+local include_directories = {};
+local defines = {};
+for i = 1, 300 do
+    table.insert( include_directories, ('/usr/local/include/project/module_%d/include'):format(i) );
+    table.insert( defines, ('DEFINE_%d=%d'):format(i, i) );
+end
+
+local function copy( values )
+    local copied = {};
+    for key, value in pairs(values) do 
+        copied[key] = value;
+    end
+    return copied;
+end
+
+local settings = {};
+for i = 1, 1000 do
+    settings[i] = { include_directories = copy(include_directories); defines = copy(defines); };
+end
+
+local start = os.clock();
+for i = 1, #settings do 
+    hash( settings[i] );
+end
+local unsealed = os.clock() - start;
+
+start = os.clock();
+for i = 1, 50000 do 
+    hash( setmetatable({}, {__index = settings[1]}) );
+end
+local sealed = os.clock() - start;
+
+print( ('hash: %d unsealed settings in %.3fs, %d inheriting sealed settings in %.3fs'):format(#settings, unsealed, 50000, sealed) );
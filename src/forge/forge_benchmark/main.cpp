@@ -0,0 +1,67 @@
+//
+// main.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include <forge/Forge.hpp>
+#include <forge/ForgeEventSink.hpp>
+#include <error/ErrorPolicy.hpp>
+#include <assert/assert.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+
+using std::string;
+using namespace sweet;
+using namespace sweet::forge;
+
+/**
+// Print output, warnings, and errors from benchmark scripts.
+*/
+struct BenchmarkEventSink : public ForgeEventSink
+{
+    void forge_output( Forge* /*forge*/, const char* message )
+    {
+        SWEET_ASSERT( message );
+        fputs( message, stdout );
+        fputs( "\n", stdout );
+    }
+
+    void forge_warning( Forge* /*forge*/, const char* message )
+    {
+        SWEET_ASSERT( message );
+        fprintf( stderr, "forge_benchmark: %s.\n", message );
+    }
+
+    void forge_error( Forge* /*forge*/, const char* message )
+    {
+        SWEET_ASSERT( message );
+        fprintf( stderr, "forge_benchmark: %s.\n", message );
+    }
+};
+
+/**
+// Run each of the benchmark scripts passed on the command line, e.g. 
+// `forge_benchmark hash.lua`, and print the timings that they report.
+*/
+int main( int argc, char** argv )
+{
+    if ( argc < 2 )
+    {
+        fputs( "Usage: forge_benchmark script.lua ...\n", stderr );
+        return EXIT_FAILURE;
+    }
+
+    error::ErrorPolicy error_policy;
+    BenchmarkEventSink event_sink;
+    boost::filesystem::path path = boost::filesystem::initial_path<boost::filesystem::path>();
+    Forge forge( path.string(), error_policy, &event_sink );
+    forge.set_root_directory( path.generic_string() );
+    for ( int i = 1; i < argc; ++i )
+    {
+        forge.file( argv[i] );
+    }
+    return error_policy.errors() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,303 @@
+//
+// main.cpp
+// Copyright (c) Charles Baker.  All rights reserved.
+//
+
+#include <cmdline/Parser.hpp>
+#include <assert/assert.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <iostream>
+#include <exception>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(BUILD_OS_WINDOWS)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET Socket;
+static const Socket NO_SOCKET = INVALID_SOCKET;
+static void close_socket( Socket socket ) { ::closesocket( socket ); }
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <signal.h>
+#include <unistd.h>
+typedef int Socket;
+static const Socket NO_SOCKET = -1;
+static void close_socket( Socket socket ) { ::close( socket ); }
+#endif
+
+using std::string;
+using namespace sweet;
+
+/**
+// The largest request headers and body accepted.
+*/
+static const size_t MAXIMUM_HEADERS = 65536;
+static const size_t MAXIMUM_CONTENT = size_t(1) << 30;
+
+/**
+// Send all of \e data to \e socket.
+*/
+static bool send_all( Socket socket, const string& data )
+{
+    size_t offset = 0;
+    while ( offset < data.size() )
+    {
+        int bytes = int(::send( socket, data.data() + offset, int(data.size() - offset), 0 ));
+        if ( bytes <= 0 )
+        {
+            return false;
+        }
+        offset += size_t(bytes);
+    }
+    return true;
+}
+
+/**
+// Send a response with \e status and \e content to \e socket.
+*/
+static void respond( Socket socket, const char* status, const string& content, bool head = false )
+{
+    string response = string( "HTTP/1.1 " ) + status + "\r\n";
+    response += "Content-Length: " + std::to_string( content.size() ) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    if ( !head )
+    {
+        response += content;
+    }
+    send_all( socket, response );
+}
+
+/**
+// Map the path of a request onto a file in the cache directory.
+//
+// Only paths whose last two segments are `ac` or `cas` followed by a key
+// made up of hexadecimal digits are accepted; anything before those two
+// segments is ignored so that clients can use any prefix in their URL.
+//
+// @return
+//  The file or the empty string if the path isn't accepted.
+*/
+static string filename_for( const string& directory, const string& path )
+{
+    string::size_type slash = path.rfind( '/' );
+    if ( slash == string::npos || slash == 0 )
+    {
+        return string();
+    }
+    string key = path.substr( slash + 1 );
+    string::size_type previous = path.rfind( '/', slash - 1 );
+    string kind = path.substr( previous == string::npos ? 0 : previous + 1, slash - (previous == string::npos ? 0 : previous + 1) );
+    if ( (kind != "ac" && kind != "cas") || key.empty() || key.size() > 64 || key.find_first_not_of("0123456789abcdef") != string::npos )
+    {
+        return string();
+    }
+    return directory + "/" + kind + "/" + key;
+}
+
+/**
+// Handle a single request on \e socket and close it.
+*/
+static void serve( Socket socket, string directory )
+{
+    string received;
+    string::size_type headers_end = string::npos;
+    char buffer [65536];
+    while ( headers_end == string::npos && received.size() < MAXIMUM_HEADERS )
+    {
+        int bytes = int(::recv( socket, buffer, int(sizeof(buffer)), 0 ));
+        if ( bytes <= 0 )
+        {
+            close_socket( socket );
+            return;
+        }
+        received.append( buffer, size_t(bytes) );
+        headers_end = received.find( "\r\n\r\n" );
+    }
+    if ( headers_end == string::npos )
+    {
+        respond( socket, "431 Request Header Fields Too Large", string() );
+        close_socket( socket );
+        return;
+    }
+
+    std::istringstream request_line( received.substr(0, received.find("\r\n")) );
+    string method;
+    string path;
+    request_line >> method >> path;
+
+    string headers = received.substr( 0, headers_end );
+    for ( string::iterator i = headers.begin(); i != headers.end(); ++i )
+    {
+        *i = char(tolower( *i ));
+    }
+    size_t content_length = 0;
+    string::size_type header = headers.find( "\r\ncontent-length:" );
+    if ( header != string::npos )
+    {
+        content_length = size_t(strtoull( headers.c_str() + header + 17, nullptr, 10 ));
+    }
+
+    string filename = filename_for( directory, path );
+    if ( filename.empty() )
+    {
+        respond( socket, "404 Not Found", string() );
+    }
+    else if ( method == "GET" || method == "HEAD" )
+    {
+        std::ifstream file( filename, std::ios::binary );
+        if ( file )
+        {
+            std::ostringstream content;
+            content << file.rdbuf();
+            respond( socket, "200 OK", content.str(), method == "HEAD" );
+        }
+        else
+        {
+            respond( socket, "404 Not Found", string() );
+        }
+    }
+    else if ( method == "PUT" && content_length <= MAXIMUM_CONTENT )
+    {
+        string content = received.substr( headers_end + 4 );
+        while ( content.size() < content_length )
+        {
+            int bytes = int(::recv( socket, buffer, int(sizeof(buffer)), 0 ));
+            if ( bytes <= 0 )
+            {
+                close_socket( socket );
+                return;
+            }
+            content.append( buffer, size_t(bytes) );
+        }
+        content.resize( content_length );
+
+        // Write to a temporary file and rename it into place so that
+        // concurrent gets never see partially written content.
+        boost::system::error_code error;
+        boost::filesystem::path temporary = boost::filesystem::path( directory ) / "tmp" / boost::filesystem::unique_path();
+        {
+            std::ofstream file( temporary.string(), std::ios::binary );
+            file.write( content.data(), std::streamsize(content.size()) );
+        }
+        boost::filesystem::rename( temporary, filename, error );
+        if ( !error )
+        {
+            respond( socket, "201 Created", string() );
+        }
+        else
+        {
+            boost::filesystem::remove( temporary, error );
+            respond( socket, "500 Internal Server Error", string() );
+        }
+    }
+    else if ( method == "PUT" )
+    {
+        respond( socket, "413 Payload Too Large", string() );
+    }
+    else
+    {
+        respond( socket, "405 Method Not Allowed", string() );
+    }
+    close_socket( socket );
+}
+
+/**
+// A minimal HTTP server for Forge's remote artifact cache.
+//
+// Stores the content of PUT requests to `.../ac/{key}` and `.../cas/{key}`
+// in files under a directory and returns them from GET requests.  Intended
+// for local testing and small trusted networks; there is no
+// authentication, no TLS, and no eviction.
+*/
+int main( int argc, char** argv )
+{
+    int result = EXIT_FAILURE;
+
+    try
+    {
+        bool help = false;
+        string address = "127.0.0.1";
+        int port = 8080;
+        string directory = "forge_cache";
+
+        cmdline::Parser command_line_parser;
+        command_line_parser.add_options()
+            ( "help", "h", "Print this message and exit", &help )
+            ( "address", "a", "Set the address to listen on", &address )
+            ( "port", "p", "Set the port to listen on", &port )
+            ( "directory", "d", "Set the directory to store content in", &directory )
+        ;
+        command_line_parser.parse( argc, argv );
+
+        if ( help )
+        {
+            std::cout << "Usage: forge_cache [options] \n";
+            std::cout << "Options: \n";
+            command_line_parser.print( stdout );
+            return EXIT_SUCCESS;
+        }
+
+        directory = boost::filesystem::absolute( directory ).generic_string();
+        boost::filesystem::create_directories( directory + "/ac" );
+        boost::filesystem::create_directories( directory + "/cas" );
+        boost::filesystem::create_directories( directory + "/tmp" );
+
+#if defined(BUILD_OS_WINDOWS)
+        WSADATA wsa_data;
+        ::WSAStartup( MAKEWORD(2, 2), &wsa_data );
+#else
+        ::signal( SIGPIPE, SIG_IGN );
+#endif
+
+        struct addrinfo hints;
+        memset( &hints, 0, sizeof(hints) );
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        struct addrinfo* addresses = nullptr;
+        if ( ::getaddrinfo(address.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0 || !addresses )
+        {
+            fprintf( stderr, "forge_cache: Resolving '%s' failed.\n", address.c_str() );
+            return EXIT_FAILURE;
+        }
+
+        Socket listener = ::socket( addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol );
+        int reuse = 1;
+        ::setsockopt( listener, SOL_SOCKET, SO_REUSEADDR, (const char*) &reuse, sizeof(reuse) );
+        if ( listener == NO_SOCKET || ::bind(listener, addresses->ai_addr, int(addresses->ai_addrlen)) != 0 || ::listen(listener, 64) != 0 )
+        {
+            ::freeaddrinfo( addresses );
+            fprintf( stderr, "forge_cache: Listening on %s:%d failed.\n", address.c_str(), port );
+            return EXIT_FAILURE;
+        }
+        ::freeaddrinfo( addresses );
+
+        printf( "forge_cache: Serving '%s' on http://%s:%d/\n", directory.c_str(), address.c_str(), port );
+        fflush( stdout );
+        for ( ;; )
+        {
+            Socket socket = ::accept( listener, nullptr, nullptr );
+            if ( socket != NO_SOCKET )
+            {
+                std::thread( serve, socket, directory ).detach();
+            }
+        }
+    }
+
+    catch ( const std::exception& exception )
+    {
+        fprintf( stderr, "forge_cache: %s.\n", exception.what() );
+        result = EXIT_FAILURE;
+    }
+
+    return result;
+}
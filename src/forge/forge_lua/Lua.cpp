@@ -4,6 +4,7 @@
 //
 
 #include "Lua.hpp"
+#include "LuaAllocator.hpp"
 #include "LuaFileSystem.hpp"
 #include "LuaSystem.hpp"
 #include "LuaContext.hpp"
@@ -14,6 +15,7 @@
 #include "LuaToolset.hpp"
 #include "types.hpp"
 #include <forge/Forge.hpp>
+#include <forge/ChunkCache.hpp>
 #include <luaxx/luaxx.hpp>
 #include <assert/assert.hpp>
 #include <string>
@@ -26,6 +28,7 @@ using namespace sweet::forge;
 
 Lua::Lua( Forge* forge )
 : forge_( nullptr ),
+  lua_allocator_( nullptr ),
   lua_state_( nullptr ),
   lua_file_system_( nullptr ),
   lua_context_( nullptr ),
@@ -81,7 +84,8 @@ void Lua::create( Forge* forge )
     destroy();
 
     forge_ = forge;
-    lua_state_ = luaxx_newstate();
+    lua_allocator_ = new LuaAllocator;
+    lua_state_ = luaxx_newstate( &LuaAllocator::allocate, lua_allocator_ );
     lua_file_system_ = new LuaFileSystem;
     lua_context_ = new LuaContext;
     lua_graph_ = new LuaGraph;
@@ -103,6 +107,7 @@ void Lua::create( Forge* forge )
     lua_file_system_->create( forge, lua_state_ );
     lua_graph_->create( forge, lua_state_ );
     lua_system_->create( forge, lua_state_ );
+    lua_allocator_->create( forge, lua_state_ );
 
     // Set `package.path` to load forge scripts stored in `../lua` relative 
     // to the `forge` executable.  The value of `package.path` may be 
@@ -111,6 +116,15 @@ void Lua::create( Forge* forge )
     path second_path = forge_->executable( "../lua/?/init.lua" );
     string path = first_path.generic_string() + ";" + second_path.generic_string();
     set_package_path( path );
+
+    // Replace the searcher that loads Lua modules found on `package.path`
+    // with one that loads them through the ChunkCache.
+    lua_getglobal( lua_state_, "package" );
+    lua_getfield( lua_state_, -1, "searchers" );
+    lua_pushlightuserdata( lua_state_, forge );
+    lua_pushcclosure( lua_state_, &Lua::searcher, 1 );
+    lua_rawseti( lua_state_, -2, 2 );
+    lua_pop( lua_state_, 2 );
 }
 
 void Lua::destroy()
@@ -141,10 +155,19 @@ void Lua::destroy()
 
     if ( lua_state_ )
     {
+        if ( forge_->memory_statistics_enabled() )
+        {
+            lua_allocator_->report( forge_ );
+        }
         luaxx_destroy( lua_state_, forge_ );
         lua_close( lua_state_ );
     }
 
+    // The allocator is deleted after the lua_State is closed as closing the
+    // lua_State frees the memory allocated through it.
+    delete lua_allocator_;
+    lua_allocator_ = nullptr;
+
     lua_state_ = nullptr;
     forge_ = nullptr;
 }
@@ -190,3 +213,36 @@ void Lua::set_package_path( const std::string& path )
     lua_setfield( lua_state_, -2, "path" );
     lua_pop( lua_state_, 1 );
 }
+
+/**
+// Find a Lua module on `package.path` and load it through the ChunkCache.
+//
+// Follows the protocol for searchers in `package.searchers`; returns the
+// loaded chunk and the path to the file it was loaded from if the module 
+// is found or a message describing the files tried if it isn't.
+*/
+int Lua::searcher( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int NAME = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    const char* name = luaL_checkstring( lua_state, NAME );
+    lua_getglobal( lua_state, "package" );
+    lua_getfield( lua_state, -1, "searchpath" );
+    lua_pushstring( lua_state, name );
+    lua_getfield( lua_state, -3, "path" );
+    lua_call( lua_state, 2, 2 );
+    if ( lua_isnil(lua_state, -2) )
+    {
+        return 1;
+    }
+
+    lua_pop( lua_state, 1 );
+    string filename = lua_tostring( lua_state, -1 );
+    if ( forge->chunk_cache()->load(lua_state, filename) != LUA_OK )
+    {
+        return luaL_error( lua_state, "error loading module '%s' from file '%s':\n\t%s", name, filename.c_str(), lua_tostring(lua_state, -1) );
+    }
+    lua_pushlstring( lua_state, filename.c_str(), filename.size() );
+    return 2;
+}
@@ -17,6 +17,7 @@ class Target;
 class TargetPrototype;
 class ToolsetPrototype;
 class Forge;
+class LuaAllocator;
 class LuaFileSystem;
 class LuaContext;
 class LuaGraph;
@@ -29,6 +30,7 @@ class LuaToolsetPrototype;
 class Lua
 {
     Forge* forge_;
+    LuaAllocator* lua_allocator_;
     lua_State* lua_state_;
     LuaFileSystem* lua_file_system_;
     LuaContext* lua_context_;
@@ -51,6 +53,9 @@ public:
     void destroy();
     void assign_global_variables( const std::vector<std::string>& assignments );
     void set_package_path( const std::string& path );
+
+private:
+    static int searcher( lua_State* lua_state );
 };
     
 }
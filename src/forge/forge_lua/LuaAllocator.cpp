@@ -0,0 +1,453 @@
+//
+// LuaAllocator.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "LuaAllocator.hpp"
+#include <forge/Forge.hpp>
+#include <assert/assert.hpp>
+#include <lua.hpp>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+using std::vector;
+using namespace sweet;
+using namespace sweet::forge;
+
+/**
+// The size classes are multiples of this size.
+*/
+static const size_t GRANULARITY = 16;
+
+/**
+// The largest allocation taken from a size class; larger allocations are
+// made with `realloc()`.
+*/
+static const size_t MAXIMUM_BLOCK_SIZE = 512;
+
+/**
+// The size of the chunks that blocks in size classes are carved from.
+*/
+static const size_t CHUNK_SIZE = 64 * 1024;
+
+/**
+// The garbage collector pause and step multiplier used to approximate
+// generational collection with the incremental collector in Lua versions
+// that don't have a generational collector.
+//
+// Starting collections sooner and collecting in larger steps frees the
+// many short lived strings and tables made while evaluating buildfiles
+// sooner after they become garbage.
+*/
+static const int GENERATIONAL_PAUSE = 150;
+static const int GENERATIONAL_STEP_MULTIPLIER = 400;
+
+/**
+// The default garbage collector pause and step multiplier.
+*/
+static const int INCREMENTAL_PAUSE = 200;
+static const int INCREMENTAL_STEP_MULTIPLIER = 200;
+
+/**
+// Get the index of the size class for allocations of \e size bytes.
+*/
+static size_t size_class_index( size_t size )
+{
+    SWEET_ASSERT( size > 0 && size <= MAXIMUM_BLOCK_SIZE );
+    return (size - 1) / GRANULARITY;
+}
+
+LuaAllocator::LuaAllocator()
+: thread_( std::this_thread::get_id() ),
+  size_classes_( MAXIMUM_BLOCK_SIZE / GRANULARITY ),
+  chunks_(),
+  live_bytes_( 0 ),
+  peak_bytes_( 0 ),
+  allocations_( 0 ),
+  large_allocations_( 0 ),
+  large_live_( 0 ),
+  generational_( false )
+{
+    for ( vector<SizeClass>::iterator size_class = size_classes_.begin(); size_class != size_classes_.end(); ++size_class )
+    {
+        size_class->free_ = nullptr;
+        size_class->allocations_ = 0;
+        size_class->live_ = 0;
+    }
+}
+
+/**
+// Destructor.
+//
+// Frees the chunks that blocks in size classes are carved from.  Assumes
+// that the Lua virtual machine that this LuaAllocator allocates for has
+// been closed.
+*/
+LuaAllocator::~LuaAllocator()
+{
+    for ( vector<void*>::iterator chunk = chunks_.begin(); chunk != chunks_.end(); ++chunk )
+    {
+        free( *chunk );
+    }
+}
+
+void LuaAllocator::create( Forge* forge, lua_State* lua_state )
+{
+    SWEET_ASSERT( forge );
+    SWEET_ASSERT( lua_state );
+
+    static const luaL_Reg functions[] = 
+    {
+        { "memory_statistics", &LuaAllocator::memory_statistics },
+        { "set_gc_mode", &LuaAllocator::set_gc_mode },
+        { "gc_mode", &LuaAllocator::gc_mode },
+        { nullptr, nullptr }
+    };
+    lua_pushglobaltable( lua_state );
+    lua_pushlightuserdata( lua_state, this );
+    luaL_setfuncs( lua_state, functions, 1 );
+    lua_pop( lua_state, 1 );
+}
+
+/**
+// Report the memory used by the Lua virtual machine.
+//
+// @param forge
+//  The Forge to report through (assumed not null).
+*/
+void LuaAllocator::report( Forge* forge ) const
+{
+    SWEET_ASSERT( forge );
+
+    uint64_t pooled = allocations_ - large_allocations_;
+    forge->outputf( "forge: Lua memory %llu KiB live, %llu KiB peak, %llu KiB pooled, %llu allocations (%.1f%% pooled)", 
+        (unsigned long long) (live_bytes_ / 1024),
+        (unsigned long long) (peak_bytes_ / 1024),
+        (unsigned long long) (chunks_.size() * CHUNK_SIZE / 1024),
+        (unsigned long long) allocations_,
+        allocations_ > 0 ? 100.0 * double(pooled) / double(allocations_) : 0.0
+    );
+    for ( size_t i = 0; i < size_classes_.size(); ++i )
+    {
+        const SizeClass& size_class = size_classes_[i];
+        if ( size_class.allocations_ > 0 )
+        {
+            forge->outputf( "forge:   %4d bytes %llu allocations, %llu live", 
+                int((i + 1) * GRANULARITY), 
+                (unsigned long long) size_class.allocations_, 
+                (unsigned long long) size_class.live_ 
+            );
+        }
+    }
+    if ( large_allocations_ > 0 )
+    {
+        forge->outputf( "forge:   large %llu allocations, %llu live", (unsigned long long) large_allocations_, (unsigned long long) large_live_ );
+    }
+}
+
+/**
+// Implement the lua_Alloc function for a LuaAllocator.
+//
+// @param context
+//  The LuaAllocator to allocate from.
+//
+// @param ptr
+//  The address of any existing allocation to be reallocated or freed or
+//  null to allocate a new block of memory.
+//
+// @param osize
+//  The size of the existing allocation or, when \e ptr is null, the type
+//  of object being allocated.
+//
+// @param nsize
+//  The size of the memory block to allocate or 0 to free \e ptr.
+//
+// @return
+//  A pointer to the newly allocated memory or null if \e nsize is 0 or the
+//  allocation failed.
+*/
+void* LuaAllocator::allocate( void* context, void* ptr, size_t osize, size_t nsize )
+{
+    LuaAllocator* allocator = reinterpret_cast<LuaAllocator*>( context );
+    SWEET_ASSERT( allocator );
+    SWEET_ASSERT( std::this_thread::get_id() == allocator->thread_ );
+
+    if ( !ptr )
+    {
+        return nsize > 0 ? allocator->allocate_block( nsize ) : nullptr;
+    }
+    if ( nsize == 0 )
+    {
+        allocator->free_block( ptr, osize );
+        return nullptr;
+    }
+    return allocator->reallocate_block( ptr, osize, nsize );
+}
+
+/**
+// Allocate a block of \e size bytes from its size class or with
+// `malloc()` if it is too large for any size class.
+*/
+void* LuaAllocator::allocate_block( size_t size )
+{
+    SWEET_ASSERT( size > 0 );
+
+    void* block = nullptr;
+    if ( size <= MAXIMUM_BLOCK_SIZE )
+    {
+        size_t index = size_class_index( size );
+        SizeClass* size_class = &size_classes_[index];
+        if ( !size_class->free_ && !refill(size_class, (index + 1) * GRANULARITY) )
+        {
+            return nullptr;
+        }
+        block = size_class->free_;
+        size_class->free_ = *reinterpret_cast<void**>( block );
+        ++size_class->allocations_;
+        ++size_class->live_;
+    }
+    else
+    {
+        block = malloc( size );
+        if ( !block )
+        {
+            return nullptr;
+        }
+        ++large_allocations_;
+        ++large_live_;
+    }
+
+    ++allocations_;
+    live_bytes_ += size;
+    peak_bytes_ = std::max( peak_bytes_, live_bytes_ );
+    return block;
+}
+
+/**
+// Return a block of \e size bytes to its size class or free it with
+// `free()` if it is too large for any size class.
+*/
+void LuaAllocator::free_block( void* ptr, size_t size )
+{
+    SWEET_ASSERT( ptr );
+    SWEET_ASSERT( size > 0 );
+    SWEET_ASSERT( live_bytes_ >= size );
+
+    if ( size <= MAXIMUM_BLOCK_SIZE )
+    {
+        SizeClass* size_class = &size_classes_[size_class_index(size)];
+        SWEET_ASSERT( size_class->live_ > 0 );
+        *reinterpret_cast<void**>( ptr ) = size_class->free_;
+        size_class->free_ = ptr;
+        --size_class->live_;
+    }
+    else
+    {
+        SWEET_ASSERT( large_live_ > 0 );
+        free( ptr );
+        --large_live_;
+    }
+    live_bytes_ -= size;
+}
+
+/**
+// Resize a block from \e osize to \e nsize bytes.
+//
+// Blocks that stay within the same size class are resized in place and
+// blocks that stay too large for any size class are resized with 
+// `realloc()`.  Otherwise the block is moved to a newly allocated block.
+*/
+void* LuaAllocator::reallocate_block( void* ptr, size_t osize, size_t nsize )
+{
+    SWEET_ASSERT( ptr );
+    SWEET_ASSERT( osize > 0 );
+    SWEET_ASSERT( nsize > 0 );
+
+    bool pooled = osize <= MAXIMUM_BLOCK_SIZE;
+    if ( pooled == (nsize <= MAXIMUM_BLOCK_SIZE) )
+    {
+        void* block = ptr;
+        if ( !pooled )
+        {
+            block = realloc( ptr, nsize );
+        }
+        else if ( size_class_index(osize) != size_class_index(nsize) )
+        {
+            block = nullptr;
+        }
+
+        if ( block )
+        {
+            live_bytes_ = live_bytes_ - osize + nsize;
+            peak_bytes_ = std::max( peak_bytes_, live_bytes_ );
+            return block;
+        }
+        if ( !pooled )
+        {
+            return nullptr;
+        }
+    }
+
+    void* block = allocate_block( nsize );
+    if ( block )
+    {
+        memcpy( block, ptr, std::min(osize, nsize) );
+        free_block( ptr, osize );
+    }
+    return block;
+}
+
+/**
+// Carve a new chunk into free blocks for a size class.
+//
+// @return
+//  True if the size class was refilled or false if allocating the chunk
+//  failed.
+*/
+bool LuaAllocator::refill( SizeClass* size_class, size_t block_size )
+{
+    SWEET_ASSERT( size_class );
+    SWEET_ASSERT( !size_class->free_ );
+    SWEET_ASSERT( block_size % GRANULARITY == 0 );
+
+    char* chunk = reinterpret_cast<char*>( malloc(CHUNK_SIZE) );
+    if ( !chunk )
+    {
+        return false;
+    }
+    chunks_.push_back( chunk );
+
+    void* first = nullptr;
+    for ( size_t offset = CHUNK_SIZE / block_size * block_size; offset > 0; offset -= block_size )
+    {
+        void* block = chunk + offset - block_size;
+        *reinterpret_cast<void**>( block ) = first;
+        first = block;
+    }
+    size_class->free_ = first;
+    return true;
+}
+
+/**
+// Get statistics about the memory used by the Lua virtual machine.
+//
+// ~~~lua
+// function memory_statistics()
+// ~~~
+//
+// @return
+//  A table with the bytes currently allocated in `live`, the most bytes
+//  allocated at any one time in `peak`, the bytes held in chunks for size
+//  classes in `pooled`, the number of allocations in `allocations`, and 
+//  the `size`, `allocations`, and `live` block counts of each size class,
+//  and allocations too large for a size class, in `size_classes` and 
+//  `large` respectively.
+*/
+int LuaAllocator::memory_statistics( lua_State* lua_state )
+{
+    const int ALLOCATOR = lua_upvalueindex( 1 );
+    LuaAllocator* allocator = reinterpret_cast<LuaAllocator*>( lua_touserdata(lua_state, ALLOCATOR) );
+    SWEET_ASSERT( allocator );
+
+    // Read the counts before creating the tables to return as creating 
+    // those tables allocates and changes them.
+    lua_Integer live = lua_Integer( allocator->live_bytes_ );
+    lua_Integer peak = lua_Integer( allocator->peak_bytes_ );
+    lua_Integer pooled = lua_Integer( allocator->chunks_.size() * CHUNK_SIZE );
+    lua_Integer allocations = lua_Integer( allocator->allocations_ );
+    vector<SizeClass> size_classes = allocator->size_classes_;
+    lua_Integer large_allocations = lua_Integer( allocator->large_allocations_ );
+    lua_Integer large_live = lua_Integer( allocator->large_live_ );
+
+    lua_createtable( lua_state, 0, 6 );
+    lua_pushinteger( lua_state, live );
+    lua_setfield( lua_state, -2, "live" );
+    lua_pushinteger( lua_state, peak );
+    lua_setfield( lua_state, -2, "peak" );
+    lua_pushinteger( lua_state, pooled );
+    lua_setfield( lua_state, -2, "pooled" );
+    lua_pushinteger( lua_state, allocations );
+    lua_setfield( lua_state, -2, "allocations" );
+
+    lua_createtable( lua_state, int(size_classes.size()), 0 );
+    for ( size_t i = 0; i < size_classes.size(); ++i )
+    {
+        lua_createtable( lua_state, 0, 3 );
+        lua_pushinteger( lua_state, lua_Integer((i + 1) * GRANULARITY) );
+        lua_setfield( lua_state, -2, "size" );
+        lua_pushinteger( lua_state, lua_Integer(size_classes[i].allocations_) );
+        lua_setfield( lua_state, -2, "allocations" );
+        lua_pushinteger( lua_state, lua_Integer(size_classes[i].live_) );
+        lua_setfield( lua_state, -2, "live" );
+        lua_rawseti( lua_state, -2, lua_Integer(i + 1) );
+    }
+    lua_setfield( lua_state, -2, "size_classes" );
+
+    lua_createtable( lua_state, 0, 2 );
+    lua_pushinteger( lua_state, large_allocations );
+    lua_setfield( lua_state, -2, "allocations" );
+    lua_pushinteger( lua_state, large_live );
+    lua_setfield( lua_state, -2, "live" );
+    lua_setfield( lua_state, -2, "large" );
+    return 1;
+}
+
+/**
+// Switch the garbage collector between incremental and generational modes.
+//
+// Lua versions without a generational collector approximate it by tuning
+// the incremental collector to start collections sooner and collect in
+// larger steps.
+//
+// ~~~lua
+// function set_gc_mode( mode )
+// ~~~
+//
+// @param mode
+//  The mode to switch to, either "incremental" or "generational".
+//
+// @return
+//  The previous mode.
+*/
+int LuaAllocator::set_gc_mode( lua_State* lua_state )
+{
+    const int ALLOCATOR = lua_upvalueindex( 1 );
+    const int MODE = 1;
+    static const char* modes[] = { "incremental", "generational", nullptr };
+
+    LuaAllocator* allocator = reinterpret_cast<LuaAllocator*>( lua_touserdata(lua_state, ALLOCATOR) );
+    SWEET_ASSERT( allocator );
+    bool generational = luaL_checkoption( lua_state, MODE, nullptr, modes ) == 1;
+    bool previous = allocator->generational_;
+    allocator->generational_ = generational;
+
+#if LUA_VERSION_NUM >= 504
+    lua_gc( lua_state, generational ? LUA_GCGEN : LUA_GCINC, 0, 0 );
+#else
+    lua_gc( lua_state, LUA_GCSETPAUSE, generational ? GENERATIONAL_PAUSE : INCREMENTAL_PAUSE );
+    lua_gc( lua_state, LUA_GCSETSTEPMUL, generational ? GENERATIONAL_STEP_MULTIPLIER : INCREMENTAL_STEP_MULTIPLIER );
+#endif
+
+    lua_pushstring( lua_state, modes[previous ? 1 : 0] );
+    return 1;
+}
+
+/**
+// Get the garbage collector mode.
+//
+// ~~~lua
+// function gc_mode()
+// ~~~
+//
+// @return
+//  The mode, either "incremental" or "generational".
+*/
+int LuaAllocator::gc_mode( lua_State* lua_state )
+{
+    const int ALLOCATOR = lua_upvalueindex( 1 );
+    LuaAllocator* allocator = reinterpret_cast<LuaAllocator*>( lua_touserdata(lua_state, ALLOCATOR) );
+    SWEET_ASSERT( allocator );
+    lua_pushstring( lua_state, allocator->generational_ ? "generational" : "incremental" );
+    return 1;
+}
@@ -0,0 +1,81 @@
+#ifndef FORGE_LUAALLOCATOR_HPP_INCLUDED
+#define FORGE_LUAALLOCATOR_HPP_INCLUDED
+
+#include <vector>
+#include <thread>
+#include <stddef.h>
+#include <stdint.h>
+
+struct lua_State;
+
+namespace sweet
+{
+
+namespace forge
+{
+
+class Forge;
+
+/**
+// Allocate memory for the Lua virtual machine from pools of fixed size
+// blocks.
+//
+// Small allocations, the strings, tables, closures, and upvalues that
+// make up most of the allocations made while evaluating buildfiles and
+// filtering output, are rounded up to one of a small number of size classes
+// and taken from and returned to a free list for that size class.  Free
+// lists are refilled from large chunks so that allocating a small block is
+// usually only a pointer swap.  Larger allocations are passed through to
+// `realloc()` and `free()`.
+//
+// Lua passes the size of each block back to the allocator when the block is
+// reallocated or freed so the size class of a block is known without
+// storing a header with each block.
+//
+// The allocator isn't thread safe; it is confined to the thread that runs
+// the Lua virtual machine that it allocates for.
+*/
+class LuaAllocator
+{
+    /**
+    // Allocation counts for a size class.
+    */
+    struct SizeClass
+    {
+        void* free_; ///< The first free block in this size class or null if there are none.
+        uint64_t allocations_; ///< The number of blocks allocated from this size class.
+        uint64_t live_; ///< The number of blocks currently allocated from this size class.
+    };
+
+    std::thread::id thread_; ///< The thread that this LuaAllocator is confined to.
+    std::vector<SizeClass> size_classes_; ///< The pools of blocks for each size class.
+    std::vector<void*> chunks_; ///< The chunks that blocks in size classes are carved from.
+    uint64_t live_bytes_; ///< The number of bytes currently allocated.
+    uint64_t peak_bytes_; ///< The most bytes allocated at any one time.
+    uint64_t allocations_; ///< The number of allocations made.
+    uint64_t large_allocations_; ///< The number of allocations too large for any size class.
+    uint64_t large_live_; ///< The number of allocations too large for any size class currently allocated.
+    bool generational_; ///< True if the garbage collector is in generational mode otherwise false.
+
+public:
+    LuaAllocator();
+    ~LuaAllocator();
+    void create( Forge* forge, lua_State* lua_state );
+    void report( Forge* forge ) const;
+    static void* allocate( void* context, void* ptr, size_t osize, size_t nsize );
+
+private:
+    void* allocate_block( size_t size );
+    void free_block( void* ptr, size_t size );
+    void* reallocate_block( void* ptr, size_t osize, size_t nsize );
+    bool refill( SizeClass* size_class, size_t block_size );
+    static int memory_statistics( lua_State* lua_state );
+    static int set_gc_mode( lua_State* lua_state );
+    static int gc_mode( lua_State* lua_state );
+};
+
+}
+
+}
+
+#endif
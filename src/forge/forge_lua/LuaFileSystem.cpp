@@ -6,11 +6,15 @@
 #include "LuaFileSystem.hpp"
 #include "types.hpp"
 #include <forge/Forge.hpp>
+#include <forge/System.hpp>
 #include <luaxx/luaxx.hpp>
 #include <assert/assert.hpp>
 #include <lua.hpp>
 
 using std::string;
+using std::vector;
+using std::pair;
+using std::make_pair;
 using boost::filesystem::directory_iterator;
 using boost::filesystem::recursive_directory_iterator;
 using namespace sweet;
@@ -44,11 +48,14 @@ void LuaFileSystem::create( Forge* forge, lua_State* lua_state )
         { "is_directory", &LuaFileSystem::is_directory },
         { "ls", &LuaFileSystem::ls },
         { "find", &LuaFileSystem::find },
+        { "glob", &LuaFileSystem::glob },
         { "mkdir", &LuaFileSystem::mkdir },
         { "rmdir", &LuaFileSystem::rmdir },
         { "cp", &LuaFileSystem::cp },
+        { "cpdir", &LuaFileSystem::cpdir },
         { "rm", &LuaFileSystem::rm },
         { "touch", &LuaFileSystem::touch },
+        { "invalidate", &LuaFileSystem::invalidate },
         { NULL, NULL }
     };
     lua_pushglobaltable( lua_state );
@@ -89,25 +96,31 @@ void LuaFileSystem::destroy()
 
 int LuaFileSystem::exists( lua_State* lua_state )
 {
+    const int FORGE = lua_upvalueindex( 1 );
     const int PATH = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
     boost::filesystem::path path = absolute( lua_state, PATH );
-    lua_pushboolean( lua_state, boost::filesystem::exists(path) ? 1 : 0 );
+    lua_pushboolean( lua_state, forge->system()->exists(path.string()) ? 1 : 0 );
     return 1;
 }
 
 int LuaFileSystem::is_file( lua_State* lua_state )
 {
+    const int FORGE = lua_upvalueindex( 1 );
     const int PATH = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
     boost::filesystem::path path = absolute( lua_state, PATH );
-    lua_pushboolean( lua_state, boost::filesystem::is_regular_file(path) ? 1 : 0 );
+    lua_pushboolean( lua_state, forge->system()->is_file(path.string()) ? 1 : 0 );
     return 1;
 }
 
 int LuaFileSystem::is_directory( lua_State* lua_state )
 {
+    const int FORGE = lua_upvalueindex( 1 );
     const int PATH = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
     boost::filesystem::path path = absolute( lua_state, PATH );
-    lua_pushboolean( lua_state, boost::filesystem::is_directory(path) ? 1 : 0 );
+    lua_pushboolean( lua_state, forge->system()->is_directory(path.string()) ? 1 : 0 );
     return 1;
 }
 
@@ -129,45 +142,122 @@ int LuaFileSystem::find( lua_State* lua_state )
     return 1;
 }
 
+int LuaFileSystem::glob( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int PATH = 1;
+    const int INCLUDES = 2;
+    const int EXCLUDES = 3;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    boost::filesystem::path path = absolute( lua_state, PATH );
+    vector<string> includes;
+    vector<string> excludes;
+    to_patterns( lua_state, INCLUDES, &includes );
+    to_patterns( lua_state, EXCLUDES, &excludes );
+
+    vector<string> matches;
+    forge->system()->glob( path.generic_string(), includes, excludes, &matches );
+    lua_createtable( lua_state, int(matches.size()), 0 );
+    for ( size_t i = 0; i < matches.size(); ++i )
+    {
+        lua_pushlstring( lua_state, matches[i].c_str(), matches[i].length() );
+        lua_rawseti( lua_state, -2, lua_Integer(i + 1) );
+    }
+    return 1;
+}
+
 int LuaFileSystem::mkdir( lua_State* lua_state )
 {
+    const int FORGE = lua_upvalueindex( 1 );
     const int PATH = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
     boost::filesystem::path path = absolute( lua_state, PATH );
-    boost::filesystem::create_directories( path );
+    forge->system()->mkdir( path.string() );
     return 0;
 }
 
 int LuaFileSystem::rmdir( lua_State* lua_state )
 {
+    const int FORGE = lua_upvalueindex( 1 );
     const int PATH = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
     boost::filesystem::path path = absolute( lua_state, PATH );
-    boost::filesystem::remove_all( path );
+    forge->system()->rmdir( path.string() );
     return 0;
 }
 
 int LuaFileSystem::cp( lua_State* lua_state )
 {
+    const int FORGE = lua_upvalueindex( 1 );
+    const int FILES = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    if ( lua_istable(lua_state, FILES) )
+    {
+        const int LINK = 2;
+        vector<pair<string, string>> files;
+        lua_pushnil( lua_state );
+        while ( lua_next(lua_state, FILES) )
+        {
+            luaL_argcheck( lua_state, lua_type(lua_state, -2) == LUA_TSTRING && lua_type(lua_state, -1) == LUA_TSTRING, FILES, "expected a table mapping destinations to sources" );
+            string to = forge->absolute( string(lua_tostring(lua_state, -2)) ).string();
+            string from = forge->absolute( string(lua_tostring(lua_state, -1)) ).string();
+            files.push_back( make_pair(from, to) );
+            lua_pop( lua_state, 1 );
+        }
+        forge->system()->cp( files, lua_toboolean(lua_state, LINK) != 0 );
+        return 0;
+    }
+
     const int TO = 1;
     const int FROM = 2;
+    const int LINK = 3;
     boost::filesystem::path to = absolute( lua_state, TO );
     boost::filesystem::path from = absolute( lua_state, FROM );
-    boost::filesystem::copy_file( from, to );
+    forge->system()->cp( from.string(), to.string(), lua_toboolean(lua_state, LINK) != 0 );
     return 0;
 }
 
+int LuaFileSystem::cpdir( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int TO = 1;
+    const int FROM = 2;
+    const int LINK = 3;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    boost::filesystem::path to = absolute( lua_state, TO );
+    boost::filesystem::path from = absolute( lua_state, FROM );
+    int files = forge->system()->cpdir( from.string(), to.string(), lua_toboolean(lua_state, LINK) != 0 );
+    lua_pushinteger( lua_state, files );
+    return 1;
+}
+
 int LuaFileSystem::rm( lua_State* lua_state )
 {
+    const int FORGE = lua_upvalueindex( 1 );
     const int PATH = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
     boost::filesystem::path path = absolute( lua_state, PATH );
-    boost::filesystem::remove( path );
+    forge->system()->rm( path.string() );
     return 0;
 }
 
 int LuaFileSystem::touch( lua_State* lua_state )
 {
+    const int FORGE = lua_upvalueindex( 1 );
     const int PATH = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
     boost::filesystem::path path = absolute( lua_state, PATH );
-    boost::filesystem::last_write_time( path, std::time(nullptr) );
+    forge->system()->touch( path.string() );
+    return 0;
+}
+
+int LuaFileSystem::invalidate( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int PATH = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    boost::filesystem::path path = absolute( lua_state, PATH );
+    forge->system()->invalidate( path.string() );
     return 0;
 }
 
@@ -253,3 +343,26 @@ boost::filesystem::path LuaFileSystem::absolute( lua_State* lua_state, int index
     Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
     return forge->absolute( string(path, length) );
 }
+
+void LuaFileSystem::to_patterns( lua_State* lua_state, int index, std::vector<std::string>* patterns )
+{
+    SWEET_ASSERT( patterns );
+    if ( lua_type(lua_state, index) == LUA_TSTRING )
+    {
+        size_t length = 0;
+        const char* pattern = lua_tolstring( lua_state, index, &length );
+        patterns->push_back( string(pattern, length) );
+    }
+    else if ( !lua_isnoneornil(lua_state, index) )
+    {
+        luaL_checktype( lua_state, index, LUA_TTABLE );
+        for ( lua_Integer i = 1; lua_rawgeti(lua_state, index, i) != LUA_TNIL; ++i )
+        {
+            size_t length = 0;
+            const char* pattern = luaL_checklstring( lua_state, -1, &length );
+            patterns->push_back( string(pattern, length) );
+            lua_pop( lua_state, 1 );
+        }
+        lua_pop( lua_state, 1 );
+    }
+}
@@ -2,6 +2,8 @@
 #define FORGE_LUAFILESYSTEM_HPP_INCLUDED
 
 #include <boost/filesystem.hpp>
+#include <string>
+#include <vector>
 
 struct lua_State;
 
@@ -32,11 +34,14 @@ private:
     static int is_directory( lua_State* lua_state );
     static int ls( lua_State* lua_state );
     static int find( lua_State* lua_state );
+    static int glob( lua_State* lua_state );
     static int mkdir( lua_State* lua_state );
     static int rmdir( lua_State* lua_state );
     static int cp( lua_State* lua_state );
+    static int cpdir( lua_State* lua_state );
     static int rm( lua_State* lua_state );
     static int touch( lua_State* lua_state );
+    static int invalidate( lua_State* lua_state );
 
     static int ls_iterator( lua_State* lua_state );
     static void push_directory_iterator( lua_State* lua_state, const boost::filesystem::directory_iterator& iterator );
@@ -49,6 +54,7 @@ private:
     static int recursive_directory_iterator_gc( lua_State* lua_state );
 
     static boost::filesystem::path absolute( lua_State* lua_state, int index );
+    static void to_patterns( lua_State* lua_state, int index, std::vector<std::string>* patterns );
 }; 
 
 }
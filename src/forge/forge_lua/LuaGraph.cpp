@@ -12,6 +12,8 @@
 #include <forge/Toolset.hpp>
 #include <forge/Target.hpp>
 #include <forge/TargetPrototype.hpp>
+#include <forge/Watcher.hpp>
+#include <forge/ChunkCache.hpp>
 #include <luaxx/luaxx.hpp>
 #include <assert/assert.hpp>
 #include <lua.hpp>
@@ -47,8 +49,12 @@ void LuaGraph::create( Forge* forge, lua_State* lua_state )
         { "add_toolset", &LuaGraph::add_toolset },
         { "all_toolsets", &LuaGraph::all_toolsets },
         { "find_target", &LuaGraph::find_target },
+        { "affected_targets", &LuaGraph::affected_targets },
+        { "wait_for_changes", &LuaGraph::wait_for_changes },
+        { "reload_buildfiles", &LuaGraph::reload_buildfiles },
         { "anonymous", &LuaGraph::anonymous },
         { "current_buildfile", &LuaGraph::current_buildfile },
+        { "current_command", &LuaGraph::current_command },
         { "working_directory", &LuaGraph::working_directory },
         { "buildfile", &LuaGraph::buildfile },
         { "postorder", &LuaGraph::postorder },
@@ -58,6 +64,10 @@ void LuaGraph::create( Forge* forge, lua_State* lua_state )
         { "clear", &LuaGraph::clear },
         { "load_binary", &LuaGraph::load_binary },
         { "save_binary", &LuaGraph::save_binary },
+        { "restore_evaluation", &LuaGraph::restore_evaluation },
+        { "save_evaluation", &LuaGraph::save_evaluation },
+        { "remove_evaluation", &LuaGraph::remove_evaluation },
+        { "up_to_date", &LuaGraph::up_to_date },
         { NULL, NULL }
     };
     lua_pushglobaltable( lua_state );
@@ -167,6 +177,88 @@ int LuaGraph::find_target( lua_State* lua_state )
     return 1;
 }
 
+int LuaGraph::affected_targets( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int FILENAMES = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    Graph* graph = forge->graph();
+    if ( graph->traversal_in_progress() )
+    {
+        return luaL_error( lua_state, "Affected targets called from within a bind or postorder traversal" );
+    }
+
+    vector<string> filenames;
+    if ( lua_type(lua_state, FILENAMES) == LUA_TSTRING )
+    {
+        filenames.push_back( lua_tostring(lua_state, FILENAMES) );
+    }
+    else
+    {
+        luaL_argcheck( lua_state, lua_istable(lua_state, FILENAMES), FILENAMES, "expected filename or table of filenames" );
+        int length = int(luaL_len( lua_state, FILENAMES ));
+        for ( int i = 1; i <= length; ++i )
+        {
+            lua_rawgeti( lua_state, FILENAMES, i );
+            size_t filename_length = 0;
+            const char* filename = luaL_checklstring( lua_state, -1, &filename_length );
+            filenames.push_back( string(filename, filename_length) );
+            lua_pop( lua_state, 1 );
+        }
+    }
+
+    vector<Target*> targets;
+    Context* context = forge->context();
+    graph->affected_targets( filenames, context->working_directory(), &targets );
+
+    lua_createtable( lua_state, int(targets.size()), 0 );
+    for ( size_t i = 0; i < targets.size(); ++i )
+    {
+        Target* target = targets[i];
+        if ( !target->referenced_by_script() )
+        {
+            forge->create_target_lua_binding( target );
+        }
+        luaxx_push( lua_state, target );
+        lua_rawseti( lua_state, -2, int(i + 1) );
+    }
+    return 1;
+}
+
+int LuaGraph::wait_for_changes( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    Graph* graph = forge->graph();
+    if ( graph->traversal_in_progress() )
+    {
+        return luaL_error( lua_state, "Wait for changes called from within a bind or postorder traversal" );
+    }
+
+    vector<string> filenames;
+    Watcher* watcher = forge->watcher();
+    watcher->watch( graph );
+    bool buildfiles_changed = watcher->wait( &filenames );
+    graph->unbind();
+
+    lua_createtable( lua_state, int(filenames.size()), 0 );
+    for ( size_t i = 0; i < filenames.size(); ++i )
+    {
+        lua_pushlstring( lua_state, filenames[i].c_str(), filenames[i].size() );
+        lua_rawseti( lua_state, -2, int(i + 1) );
+    }
+    lua_pushboolean( lua_state, buildfiles_changed ? 1 : 0 );
+    return 2;
+}
+
+int LuaGraph::reload_buildfiles( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    forge->set_reload_requested( true );
+    return 0;
+}
+
 int LuaGraph::anonymous( lua_State* lua_state )
 {
     const int FORGE = lua_upvalueindex( 1 );
@@ -194,6 +286,14 @@ int LuaGraph::current_buildfile( lua_State* lua_state )
     return 1;
 }
 
+int LuaGraph::current_command( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    lua_pushlstring( lua_state, forge->command().c_str(), forge->command().size() );
+    return 1;
+}
+
 int LuaGraph::working_directory( lua_State* lua_state )
 {
     const int FORGE = lua_upvalueindex( 1 );
@@ -309,6 +409,19 @@ int LuaGraph::load_binary( lua_State* lua_state )
     if ( cache_target )
     {
         forge->create_target_lua_binding( cache_target );
+
+        // Start reading and compiling the buildfiles loaded by the previous
+        // run ahead of the calls to `buildfile()` that execute them.
+        vector<string> buildfiles;
+        int index = 0;
+        Target* buildfile = cache_target->explicit_dependency( index );
+        while ( buildfile )
+        {
+            buildfiles.insert( buildfiles.end(), buildfile->filenames().begin(), buildfile->filenames().end() );
+            ++index;
+            buildfile = cache_target->explicit_dependency( index );
+        }
+        forge->chunk_cache()->preload( buildfiles );
     }
     luaxx_push( lua_state, cache_target );
     return 1;
@@ -321,3 +434,52 @@ int LuaGraph::save_binary( lua_State* lua_state )
     forge->graph()->save_binary();
     return 0;
 }
+
+int LuaGraph::restore_evaluation( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    Context* context = forge->context();
+    string working_directory = context->working_directory()->path();
+    bool restored = forge->graph()->restore_evaluation();
+    context->reset_directory( working_directory );
+    lua_pushboolean( lua_state, restored ? 1 : 0 );
+    return 1;
+}
+
+int LuaGraph::save_evaluation( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    bool saved = forge->graph()->save_evaluation();
+    lua_pushboolean( lua_state, saved ? 1 : 0 );
+    return 1;
+}
+
+int LuaGraph::remove_evaluation( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    forge->graph()->remove_evaluation();
+    return 0;
+}
+
+int LuaGraph::up_to_date( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int TARGET = 1;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    Graph* graph = forge->graph();
+    if ( graph->traversal_in_progress() )
+    {
+        return luaL_error( lua_state, "Up to date called from within another bind or postorder traversal" );
+    }
+
+    Target* target = nullptr;
+    if ( !lua_isnoneornil(lua_state, TARGET) )
+    {
+        target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
+    }
+    lua_pushboolean( lua_state, graph->up_to_date(target) ? 1 : 0 );
+    return 1;
+}
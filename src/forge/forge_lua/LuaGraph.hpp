@@ -26,8 +26,12 @@ private:
     static int all_toolsets_iterator( lua_State* lua_state );
     static int all_toolsets( lua_State* lua_state );
     static int find_target( lua_State* lua_state );
+    static int affected_targets( lua_State* lua_state );
+    static int wait_for_changes( lua_State* lua_state );
+    static int reload_buildfiles( lua_State* lua_state );
     static int anonymous( lua_State* lua_state );
     static int current_buildfile( lua_State* lua_state );
+    static int current_command( lua_State* lua_state );
     static int working_directory( lua_State* lua_state );
     static int buildfile( lua_State* lua_state );
     static int postorder( lua_State* lua_state );
@@ -37,6 +41,10 @@ private:
     static int clear( lua_State* lua_state );
     static int load_binary( lua_State* lua_state );
     static int save_binary( lua_State* lua_state );
+    static int restore_evaluation( lua_State* lua_state );
+    static int save_evaluation( lua_State* lua_state );
+    static int remove_evaluation( lua_State* lua_state );
+    static int up_to_date( lua_State* lua_state );
 };
 
 }
@@ -4,12 +4,20 @@
 //
 
 #include "LuaSystem.hpp"
+#include "LuaTarget.hpp"
 #include "types.hpp"
 #include <forge/Forge.hpp>
 #include <forge/System.hpp>
 #include <forge/Filter.hpp>
 #include <forge/Arguments.hpp>
 #include <forge/Scheduler.hpp>
+#include <forge/Context.hpp>
+#include <forge/Job.hpp>
+#include <forge/Target.hpp>
+#include <forge/Hasher.hpp>
+#include <forge/ArtifactCache.hpp>
+#include <forge/RemoteCache.hpp>
+#include <forge/path_functions.hpp>
 #include <process/Environment.hpp>
 #include <luaxx/luaxx.hpp>
 #include <assert/assert.hpp>
@@ -17,13 +25,57 @@
 #include <luaxx/luaxx.hpp>
 #include <assert/assert.hpp>
 #include <lua.hpp>
+#include <string.h>
 
 using std::string;
 using std::unique_ptr;
+using std::vector;
+using std::pair;
 using namespace sweet;
 using namespace sweet::luaxx;
 using namespace sweet::forge;
 
+/**
+// The tags that seed the hash of each key and value hashed by `hash()` so
+// that values of different types with the same bytes hash differently.
+*/
+enum HashTag
+{
+    HASH_STRING = 1,
+    HASH_INTEGER,
+    HASH_NUMBER,
+    HASH_TRUE,
+    HASH_FALSE,
+    HASH_TABLE,
+    HASH_OTHER
+};
+
+/**
+// Hash a string chained from \e seed, e.g. the hash of the key that the
+// string is the value of.
+*/
+static uint64_t hash_string( const char* value, size_t length, uint64_t seed )
+{
+    SWEET_ASSERT( value || length == 0 );
+    return Hasher::hash( value, length, seed + HASH_STRING );
+}
+
+/**
+// Hash a 64 bit integer chained from \e seed.
+//
+// The integer is hashed in little-endian byte order so that the hash is the
+// same whatever the byte order of the platform.
+*/
+static uint64_t hash_integer( HashTag tag, uint64_t value, uint64_t seed )
+{
+    unsigned char bytes [8];
+    for ( int i = 0; i < 8; ++i )
+    {
+        bytes[i] = (unsigned char) (value >> (i * 8));
+    }
+    return Hasher::hash( bytes, sizeof(bytes), seed + tag );
+}
+
 LuaSystem::LuaSystem()
 {
 }
@@ -43,7 +95,12 @@ void LuaSystem::create( Forge* forge, lua_State* lua_state )
     {
         { "set_forge_hooks_library", &LuaSystem::set_forge_hooks_library },
         { "forge_hooks_library", &LuaSystem::forge_hooks_library },
+        { "set_artifact_cache", &LuaSystem::set_artifact_cache },
+        { "artifact_cache", &LuaSystem::artifact_cache },
+        { "set_remote_artifact_cache", &LuaSystem::set_remote_artifact_cache },
+        { "remote_artifact_cache", &LuaSystem::remote_artifact_cache },
         { "hash", &LuaSystem::hash },
+        { "walk_tables", &LuaSystem::walk_tables },
         { "execute", &LuaSystem::execute },
         { "print", &LuaSystem::print },
         { "getenv", &LuaSystem::getenv },
@@ -62,6 +119,73 @@ void LuaSystem::destroy()
 {
 }
 
+/**
+// Calculate the signature of a command.
+//
+// The signature covers the command, the command line, and the environment
+// that the command is executed in.  Environment variables are combined so 
+// that the signature doesn't depend on the order that they are iterated
+// from the environment table.  The root directory is replaced wherever it
+// appears (see `replace_root_directory()`) so that the same command in 
+// checkouts of a project in different directories has the same signature
+// and shares entries in the ArtifactCache.
+//
+// @param lua_state
+//  The lua_State that the command's arguments are on the stack of.
+//
+// @param command
+//  The absolute stack index of the command.
+//
+// @param command_line
+//  The absolute stack index of the command line.
+//
+// @param environment
+//  The absolute stack index of the environment table (may be nil).
+//
+// @param root_directory
+//  The root directory to replace in the command, command line, and 
+//  environment.
+//
+// @return
+//  The signature.
+*/
+uint64_t LuaSystem::signature( lua_State* lua_state, int command, int command_line, int environment, const std::string& root_directory )
+{
+    SWEET_ASSERT( lua_state );
+
+    Hasher hasher;
+    size_t length = 0;
+    const char* value = luaL_tolstring( lua_state, command, &length );
+    string text = replace_root_directory( string(value, length), root_directory );
+    hasher.append( text.c_str(), text.size() + 1 );
+    lua_pop( lua_state, 1 );
+    value = luaL_checklstring( lua_state, command_line, &length );
+    text = replace_root_directory( string(value, length), root_directory );
+    hasher.append( text.c_str(), text.size() + 1 );
+
+    uint64_t environment_hash = 0;
+    if ( lua_istable(lua_state, environment) )
+    {
+        lua_pushnil( lua_state );
+        while ( lua_next(lua_state, environment) )
+        {
+            if ( lua_type(lua_state, -2) == LUA_TSTRING && lua_isstring(lua_state, -1) )
+            {
+                Hasher variable;
+                value = lua_tolstring( lua_state, -2, &length );
+                variable.append( value, length + 1 );
+                value = lua_tolstring( lua_state, -1, &length );
+                text = replace_root_directory( string(value, length), root_directory );
+                variable.append( text.c_str(), text.size() );
+                environment_hash += variable.value();
+            }
+            lua_pop( lua_state, 1 );
+        }
+    }
+    hasher.append( &environment_hash, sizeof(environment_hash) );
+    return hasher.value();
+}
+
 int LuaSystem::set_forge_hooks_library( lua_State* lua_state )
 {
     const int FORGE = lua_upvalueindex( 1 );
@@ -81,20 +205,108 @@ int LuaSystem::forge_hooks_library( lua_State* lua_state )
     return 1;
 }
 
+int LuaSystem::set_artifact_cache( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int DIRECTORY = 1;
+    const int MAXIMUM_SIZE = 2;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    const char* directory = luaL_optstring( lua_state, DIRECTORY, "" );
+    lua_Integer maximum_size = luaL_optinteger( lua_state, MAXIMUM_SIZE, 0 );
+    luaL_argcheck( lua_state, maximum_size >= 0, MAXIMUM_SIZE, "maximum size must not be negative" );
+    ArtifactCache* artifact_cache = forge->artifact_cache();
+    artifact_cache->set_directory( string(directory) );
+    artifact_cache->set_maximum_size( uint64_t(maximum_size) );
+    return 0;
+}
+
+int LuaSystem::artifact_cache( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    ArtifactCache* artifact_cache = forge->artifact_cache();
+    const string& directory = artifact_cache->directory();
+    lua_pushlstring( lua_state, directory.c_str(), directory.size() );
+    lua_pushinteger( lua_state, lua_Integer(artifact_cache->maximum_size()) );
+    lua_pushinteger( lua_state, artifact_cache->hits() );
+    lua_pushinteger( lua_state, artifact_cache->misses() );
+    return 4;
+}
+
+int LuaSystem::set_remote_artifact_cache( lua_State* lua_state )
+{
+    try
+    {
+        const int FORGE = lua_upvalueindex( 1 );
+        const int URL = 1;
+        const int MAXIMUM_DOWNLOADS = 2;
+        Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+        const char* url = luaL_optstring( lua_state, URL, "" );
+        lua_Integer maximum_downloads = luaL_optinteger( lua_state, MAXIMUM_DOWNLOADS, 8 );
+        luaL_argcheck( lua_state, maximum_downloads > 0, MAXIMUM_DOWNLOADS, "maximum downloads must be positive" );
+        RemoteCache* remote_cache = forge->artifact_cache()->remote_cache();
+        remote_cache->set_url( string(url) );
+        remote_cache->set_maximum_downloads( int(maximum_downloads) );
+        return 0;
+    }
+
+    catch ( const std::exception& exception )
+    {
+        lua_pushstring( lua_state, exception.what() );
+        return lua_error( lua_state );
+    }
+}
+
+int LuaSystem::remote_artifact_cache( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    RemoteCache* remote_cache = forge->artifact_cache()->remote_cache();
+    const string& url = remote_cache->url();
+    lua_pushlstring( lua_state, url.c_str(), url.size() );
+    lua_pushinteger( lua_state, remote_cache->downloads() );
+    lua_pushinteger( lua_state, remote_cache->uploads() );
+    lua_pushinteger( lua_state, remote_cache->failures() );
+    return 4;
+}
+
 int LuaSystem::hash( lua_State* lua_state )
 {
     const int TABLE = 1;
     const int args = lua_gettop( lua_state );
-    lua_Integer hash = 0;
+    uint64_t hash = 0;
     for ( int index = TABLE; index <= args; ++index )
     {
         luaL_checktype( lua_state, index, LUA_TTABLE );
-        hash ^= hash_recursively( lua_state, index, false );
+        hash += hash_recursively( lua_state, index, false );
     }
-    lua_pushinteger( lua_state, hash );
+    lua_pushinteger( lua_state, lua_Integer(hash) );
     return 1;
 }
 
+/**
+// Iterate over the values in an array and, recursively, the arrays nested
+// in it.
+//
+// Targets are treated as values rather than nested arrays.  The values are
+// flattened into an array that is iterated with `ipairs()` so that nested
+// arrays are walked without a coroutine.
+*/
+int LuaSystem::walk_tables( lua_State* lua_state )
+{
+    const int VALUES = 1;
+    luaL_checkany( lua_state, VALUES );
+    lua_getglobal( lua_state, "ipairs" );
+    lua_newtable( lua_state );
+    if ( lua_istable(lua_state, VALUES) )
+    {
+        lua_Integer count = 0;
+        flatten( lua_state, VALUES, lua_gettop(lua_state), &count );
+    }
+    lua_call( lua_state, 1, 3 );
+    return 3;
+}
+
 int LuaSystem::execute( lua_State* lua_state )
 {
     try
@@ -190,6 +402,41 @@ int LuaSystem::execute( lua_State* lua_state )
         string command_string( command, command_length );
         string command_line_string( command_line, command_line_length );
 
+        // Record the signature of the command against the Target being built
+        // so that changes to the command outdate the Target in later builds
+        // (see `Target::bind_to_signature()`).
+        Context* context = forge->context();
+        if ( context && context->job() )
+        {
+            Target* target = context->job()->target();
+            uint64_t command_signature = signature( lua_state, COMMAND, COMMAND_LINE, ENVIRONMENT, forge->root().generic_string() );
+            target->set_signature( command_signature );
+
+            // Restore the files of cacheable Targets from the artifact cache
+            // when there is an entry for the command and its inputs and 
+            // replay the output captured with that entry through the filters
+            // the command would have used instead of executing it.  Commands
+            // that report dependencies are only cached when the build hooks
+            // library is available to report them; otherwise entries would
+            // be keyed without their implicit dependencies.
+            ArtifactCache* artifact_cache = forge->artifact_cache();
+            bool dependencies_reported = !dependencies_filter || !forge->forge_hooks_library().empty();
+            vector<pair<int, string>> output;
+            if ( artifact_cache->enabled() && dependencies_reported && cacheable(lua_state, target) && artifact_cache->restore(target, command_string, command_signature, &output) )
+            {
+                Filter* filters [] = { dependencies_filter.get(), stdout_filter.get(), stderr_filter.get() };
+                for ( vector<pair<int, string>>::const_iterator line = output.begin(); line != output.end(); ++line )
+                {
+                    if ( line->first >= OUTPUT_DEPENDENCIES && line->first <= OUTPUT_STDERR && (line->first != OUTPUT_DEPENDENCIES || filters[line->first]) )
+                    {
+                        forge->scheduler()->output( line->second, filters[line->first], arguments.get(), context->working_directory(), nullptr, line->first );
+                    }
+                }
+                lua_pushinteger( lua_state, 0 );
+                return 1;
+            }
+        }
+
         forge->scheduler()->execute(
             command_string,
             command_line_string,
@@ -198,7 +445,7 @@ int LuaSystem::execute( lua_State* lua_state )
             stdout_filter.release(),
             stderr_filter.release(),
             arguments.release(),
-            forge->context()
+            context
         );
 
         return lua_yield( lua_state, 0 );
@@ -263,113 +510,262 @@ int LuaSystem::operating_system( lua_State* lua_state )
     return 1;
 }
 
-lua_Integer LuaSystem::hash_recursively( lua_State* lua_state, int table, bool hash_integer_keys )
+/**
+// Is \e target's prototype or \e target itself marked as cacheable?
+//
+// @param lua_state
+//  The lua_State to look up the `cacheable` field in.
+//
+// @param target
+//  The Target to check (assumed not null).
+//
+// @return
+//  True if the `cacheable` field of \e target is true otherwise false.
+*/
+bool LuaSystem::cacheable( lua_State* lua_state, Target* target )
+{
+    SWEET_ASSERT( lua_state );
+    SWEET_ASSERT( target );
+    luaxx_push( lua_state, target );
+    lua_getfield( lua_state, -1, "cacheable" );
+    bool cacheable = lua_toboolean( lua_state, -1 ) != 0;
+    lua_pop( lua_state, 2 );
+    return cacheable;
+}
+
+/**
+// Calculate the hash of the fields in a table.
+//
+// See `LuaSystem::hash_recursively()`.
+//
+// @param lua_state
+//  The lua_State that the table is in.
+//
+// @param table
+//  The stack index of the table to hash.
+//
+// @return
+//  The hash.
+*/
+lua_Integer LuaSystem::hash_table( lua_State* lua_state, int table )
+{
+    SWEET_ASSERT( lua_state );
+    SWEET_ASSERT( lua_istable(lua_state, table) );
+    return lua_Integer( hash_recursively(lua_state, lua_absindex(lua_state, table), false) );
+}
+
+/**
+// Calculate the hash of the fields in a table, its nested tables, and any
+// table it inherits from through an `__index` or `__forge_index` metatable.
+// Tables with a `__forge_proxy` metafield hash as the table that it names.
+//
+// Each field is hashed on its own, with the hash of its value seeded from
+// the hash of its key and the type of its value, and the hashes of fields
+// are added together so that the hash doesn't depend on the order that
+// fields are visited in.  Nested tables contribute their hash to the hash
+// of the field that holds them so that identical nested tables under
+// different keys don't cancel each other out.
+//
+// Strings are hashed with the Hasher, whose four independent lanes hash
+// long strings like include paths several bytes at a time, and numbers are
+// hashed in little-endian byte order.  Hashes are the same across runs and
+// across the little-endian platforms that Forge supports so that hashes
+// stored in the dependency graph cache stay valid.
+//
+// The hash of each table is stored in its `__forge_hash` field, marking
+// the table as hashed and sealed, so that tables shared between targets,
+// e.g. toolset settings, are only hashed once.  A zero `__forge_hash` is
+// stored while a table is being hashed so that cyclic references end the
+// recursion.
+//
+// @param lua_state
+//  The lua_State that the table is in.
+//
+// @param table
+//  The absolute stack index of the table to hash.
+//
+// @param hash_integer_keys
+//  True to include fields with integer keys, i.e. the elements of arrays,
+//  otherwise false to include only fields with string keys.
+//
+// @return
+//  The hash.
+*/
+uint64_t LuaSystem::hash_recursively( lua_State* lua_state, int table, bool hash_integer_keys )
 {
     const char HASH_KEYWORD [] = "__forge_hash";
     const size_t HASH_KEYWORD_LENGTH = sizeof(HASH_KEYWORD) - 1;
 
-    // Hashed and sealed tables store their hash value in "__forge_hash".  
-    // Checking for the presence of "__forge_hash" also prevents infinite
-    // recursion in the case of cyclic references in the tables.
+    SWEET_ASSERT( lua_state );
+    SWEET_ASSERT( table > 0 );
+
+    // Hashed and sealed tables store their hash value in "__forge_hash".
     lua_pushlstring( lua_state, HASH_KEYWORD, HASH_KEYWORD_LENGTH );
     if ( lua_rawget(lua_state, table) != LUA_TNIL )
     {
-        lua_Integer hash = luaL_checkinteger( lua_state, -1 );
+        uint64_t hash = uint64_t( luaL_checkinteger(lua_state, -1) );
         lua_pop( lua_state, 1 );
         return hash;
     }
+    lua_pop( lua_state, 1 );
 
-    // Initiate iteration with the nil left on top of the stack by the call
-    // to `lua_getfield()` that failed to find a "__forge_hash" field.
-    lua_Integer hash = 0;
-    while ( lua_next(lua_state, table) )
+    // Proxies for nested tables shared between settings hash as the table
+    // that they read through to until they're written to (see 
+    // Settings.lua) reusing the hash stored there.
+    int proxy = luaL_getmetafield( lua_state, table, "__forge_proxy" );
+    if ( proxy == LUA_TTABLE )
+    {
+        uint64_t hash = hash_recursively( lua_state, lua_gettop(lua_state), hash_integer_keys );
+        lua_pop( lua_state, 1 );
+        return hash;
+    }
+    else if ( proxy != LUA_TNIL )
     {
-        uint64_t working_hash = fnv1a_start();
+        lua_pop( lua_state, 1 );
+    }
+
+    // Mark the table as being hashed to prevent infinite recursion in the
+    // case of cyclic references in the tables.
+    lua_pushlstring( lua_state, HASH_KEYWORD, HASH_KEYWORD_LENGTH );
+    lua_pushinteger( lua_state, 0 );
+    lua_rawset( lua_state, table );
 
-        bool hash_value = false;
-        int type = lua_type( lua_state, -2 );
-        if ( type == LUA_TSTRING || (hash_integer_keys && type == LUA_TNUMBER) )
+    uint64_t hash = 0;
+    lua_pushnil( lua_state );
+    while ( lua_next(lua_state, table) )
+    {
+        int key_type = lua_type( lua_state, -2 );
+        if ( key_type == LUA_TSTRING || (hash_integer_keys && lua_isinteger(lua_state, -2)) )
         {
-            if ( type == LUA_TSTRING )
+            uint64_t entry = 0;
+            if ( key_type == LUA_TSTRING )
             {
                 size_t length = 0;
                 const char* key = lua_tolstring( lua_state, -2, &length );
-                working_hash = fnv1a_append( working_hash, (const unsigned char*) key, length );
-                hash_value = true;
+                if ( length == HASH_KEYWORD_LENGTH && memcmp(key, HASH_KEYWORD, HASH_KEYWORD_LENGTH) == 0 )
+                {
+                    lua_pop( lua_state, 1 );
+                    continue;
+                }
+                entry = hash_string( key, length, 0 );
             }
             else
             {
-                lua_Integer key = lua_tointeger( lua_state, -2 );
-                working_hash = fnv1a_append( working_hash, (const unsigned char*) &key, sizeof(key) );
-                hash_value = true;
+                entry = hash_integer( HASH_INTEGER, uint64_t(lua_tointeger(lua_state, -2)), 0 );
             }
 
-            if ( lua_type(lua_state, -1) == LUA_TSTRING )
+            switch ( lua_type(lua_state, -1) )
             {
-                size_t length = 0;
-                const char* value = lua_tolstring( lua_state, -1, &length );
-                working_hash = fnv1a_append( working_hash, (const unsigned char*) value, length );
-            }
-            else if ( lua_isinteger(lua_state, -1) )
-            {
-                lua_Integer value = lua_tointeger( lua_state, -1 );
-                working_hash = fnv1a_append( working_hash, (const unsigned char*) &value, sizeof(value) );
-            }
-            else if ( lua_isnumber(lua_state, -1) )
-            {
-                lua_Number value = lua_tonumber( lua_state, -1 );
-                working_hash = fnv1a_append( working_hash, (const unsigned char*) &value, sizeof(value) );
-            }
-            else if ( lua_isboolean(lua_state, -1) )
-            {
-                bool value = lua_toboolean( lua_state, -1 ) == 1;
-                working_hash = fnv1a_append( working_hash, (const unsigned char*) &value, sizeof(value) );
-            }
-            else if ( lua_istable(lua_state, -1) )
-            {
-                hash ^= hash_recursively( lua_state, lua_gettop(lua_state), true );
-            }
+                case LUA_TSTRING:
+                {
+                    size_t length = 0;
+                    const char* value = lua_tolstring( lua_state, -1, &length );
+                    entry = hash_string( value, length, entry );
+                    break;
+                }
 
-            hash ^= working_hash;
+                case LUA_TNUMBER:
+                    if ( lua_isinteger(lua_state, -1) )
+                    {
+                        entry = hash_integer( HASH_INTEGER, uint64_t(lua_tointeger(lua_state, -1)), entry );
+                    }
+                    else
+                    {
+                        double value = double( lua_tonumber(lua_state, -1) );
+                        uint64_t bits = 0;
+                        memcpy( &bits, &value, sizeof(bits) );
+                        entry = hash_integer( HASH_NUMBER, bits, entry );
+                    }
+                    break;
+
+                case LUA_TBOOLEAN:
+                    entry = hash_integer( lua_toboolean(lua_state, -1) ? HASH_TRUE : HASH_FALSE, 0, entry );
+                    break;
+
+                case LUA_TTABLE:
+                    entry = hash_integer( HASH_TABLE, hash_recursively(lua_state, lua_gettop(lua_state), true), entry );
+                    break;
+
+                default:
+                    entry = hash_integer( HASH_OTHER, 0, entry );
+                    break;
+            }
+            hash += entry;
         }
         lua_pop( lua_state, 1 );
     }
 
     // Recursively calculate hashes from fields in tables that this table
-    // inherits from.
-    int type = luaL_getmetafield( lua_state, table, "__index" );
-    if ( type != LUA_TNIL )
+    // inherits from.  Tables that look fields up with an `__index` function
+    // name the table that they look them up in with `__forge_index`, e.g.
+    // the nested tables that settings share (see Settings.lua).
+    const char* inherited [] = { "__index", "__forge_index" };
+    for ( size_t i = 0; i < sizeof(inherited) / sizeof(inherited[0]); ++i )
     {
-        if ( type == LUA_TTABLE )
+        int type = luaL_getmetafield( lua_state, table, inherited[i] );
+        if ( type != LUA_TNIL )
         {
-            hash ^= hash_recursively( lua_state, lua_gettop(lua_state), false );
+            if ( type == LUA_TTABLE )
+            {
+                hash += hash_recursively( lua_state, lua_gettop(lua_state), false );
+            }
+            lua_pop( lua_state, 1 );
         }
-        lua_pop( lua_state, 1 );
     }
 
     // Store the hash in the "__forge_hash" key in the table to make it
     // available afterwards and to mark the table as hashed and sealed.
-    lua_pushstring( lua_state, HASH_KEYWORD );
-    lua_pushinteger( lua_state, hash );
+    lua_pushlstring( lua_state, HASH_KEYWORD, HASH_KEYWORD_LENGTH );
+    lua_pushinteger( lua_state, lua_Integer(hash) );
     lua_rawset( lua_state, table );
 
     return hash;
 }
 
-uint64_t LuaSystem::fnv1a_start()
-{
-    const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325;
-    return FNV_OFFSET_BASIS;
-}
-
-uint64_t LuaSystem::fnv1a_append( uint64_t hash, const unsigned char* data, size_t length )
+/**
+// Append the values in an array and, recursively, the arrays nested in it
+// to another array.
+//
+// @param lua_state
+//  The lua_State that the arrays are in.
+//
+// @param values
+//  The absolute stack index of the array of values to append.
+//
+// @param flattened
+//  The absolute stack index of the array to append to.
+//
+// @param count
+//  The number of values in the array to append to (assumed not null).
+*/
+void LuaSystem::flatten( lua_State* lua_state, int values, int flattened, lua_Integer* count )
 {
-    SWEET_ASSERT( data );
-    SWEET_ASSERT( length >= 0 );
-    for ( size_t i = 0; i < length; ++i )
+    SWEET_ASSERT( lua_state );
+    SWEET_ASSERT( count );
+    luaL_checkstack( lua_state, 2, "too many nested tables" );
+    for ( lua_Integer index = 1; lua_geti(lua_state, values, index) != LUA_TNIL; ++index )
     {
-        const uint64_t FNV_PRIME = 0x100000001b3;
-        hash = (hash ^ data[i]) * FNV_PRIME;
+        bool nested = false;
+        if ( lua_istable(lua_state, -1) )
+        {
+            nested = true;
+            if ( luaL_getmetafield(lua_state, -1, "__name") != LUA_TNIL )
+            {
+                const char* name = lua_tostring( lua_state, -1 );
+                nested = !name || strcmp( name, LuaTarget::TARGET_METATABLE ) != 0;
+                lua_pop( lua_state, 1 );
+            }
+        }
+
+        if ( nested )
+        {
+            flatten( lua_state, lua_gettop(lua_state), flattened, count );
+            lua_pop( lua_state, 1 );
+        }
+        else
+        {
+            lua_rawseti( lua_state, flattened, ++*count );
+        }
     }
-    return hash;
+    lua_pop( lua_state, 1 );
 }
@@ -2,6 +2,7 @@
 #define FORGE_LUASYSTEM_HPP_INCLUDED
 
 #include <lua.hpp>
+#include <string>
 #include <stdint.h>
 
 namespace sweet
@@ -11,6 +12,7 @@ namespace forge
 {
 
 class Forge;
+class Target;
 
 class LuaSystem
 {
@@ -19,20 +21,27 @@ public:
     ~LuaSystem();
     void create( Forge* forge, lua_State* lua_state );
     void destroy();
+    static uint64_t signature( lua_State* lua_state, int command, int command_line, int environment, const std::string& root_directory );
+    static lua_Integer hash_table( lua_State* lua_state, int table );
+    static void flatten( lua_State* lua_state, int values, int flattened, lua_Integer* count );
 
 private:
     static int set_forge_hooks_library( lua_State* lua_state );
     static int forge_hooks_library( lua_State* lua_state );
+    static int set_artifact_cache( lua_State* lua_state );
+    static int artifact_cache( lua_State* lua_state );
+    static int set_remote_artifact_cache( lua_State* lua_state );
+    static int remote_artifact_cache( lua_State* lua_state );
     static int hash( lua_State* lua_state );
+    static int walk_tables( lua_State* lua_state );
     static int execute( lua_State* lua_state );
     static int print( lua_State* lua_state );
     static int getenv( lua_State* lua_state );
     static int sleep( lua_State* lua_state );
     static int ticks( lua_State* lua_state );
     static int operating_system( lua_State* lua_state );
-    static lua_Integer hash_recursively( lua_State* lua_state, int table, bool hash_integer_keys );
-    static uint64_t fnv1a_start();
-    static uint64_t fnv1a_append( uint64_t hash, const unsigned char* data, size_t length );
+    static bool cacheable( lua_State* lua_state, Target* target );
+    static uint64_t hash_recursively( lua_State* lua_state, int table, bool hash_integer_keys );
 };
 
 }
@@ -5,21 +5,29 @@
 
 #include "LuaTarget.hpp"
 #include "LuaGraph.hpp"
+#include "LuaSystem.hpp"
 #include "types.hpp"
 #include <forge/Target.hpp>
 #include <forge/TargetPrototype.hpp>
 #include <forge/Context.hpp>
 #include <forge/Forge.hpp>
 #include <forge/Graph.hpp>
+#include <forge/path_functions.hpp>
 #include <luaxx/luaxx.hpp>
 #include <assert/assert.hpp>
 #include <lua.hpp>
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <string.h>
+#include <limits.h>
 
 using std::min;
 using std::max;
 using std::string;
 using std::vector;
+using std::unordered_map;
+using std::unordered_set;
 using namespace sweet;
 using namespace sweet::luaxx;
 using namespace sweet::forge;
@@ -27,6 +35,603 @@ using namespace sweet::forge;
 static const char* STRING_VECTOR_CONST_ITERATOR_METATABLE = "forge.vector<string>::const_iterator";
 const char* LuaTarget::TARGET_METATABLE = "forge.Target";
 
+/**
+// Select the dependencies that walks of explicit dependencies yield and
+// recurse into.
+//
+// Without prototypes dependencies that are bound to files are yielded and
+// phony dependencies are recursed into; that is, walks stop at the first
+// dependency with a filename.  Otherwise dependencies are yielded and
+// recursed into when their prototype is one of the yield or recurse
+// prototypes respectively.
+*/
+struct WalkFilter
+{
+    vector<TargetPrototype*> yield_prototypes; ///< The prototypes of dependencies to yield.
+    vector<TargetPrototype*> recurse_prototypes; ///< The prototypes of dependencies to recurse into.
+    bool prototypes; ///< True if dependencies are selected by prototype.
+
+    bool yield( Target* target ) const
+    {
+        if ( !prototypes )
+        {
+            return !phony( target );
+        }
+        return std::find( yield_prototypes.begin(), yield_prototypes.end(), target->prototype() ) != yield_prototypes.end();
+    }
+
+    bool recurse( Target* target ) const
+    {
+        if ( !prototypes )
+        {
+            return phony( target );
+        }
+        return std::find( recurse_prototypes.begin(), recurse_prototypes.end(), target->prototype() ) != recurse_prototypes.end();
+    }
+
+    static bool phony( Target* target )
+    {
+        const vector<string>& filenames = target->filenames();
+        return filenames.empty() || filenames.front().empty();
+    }
+};
+
+/**
+// Read an optional array of TargetPrototypes from the Lua stack.
+//
+// @return
+//  True if there is a table at \e index otherwise false.
+*/
+static bool read_prototypes( lua_State* lua_state, int index, vector<TargetPrototype*>* prototypes )
+{
+    SWEET_ASSERT( lua_state );
+    SWEET_ASSERT( prototypes );
+    if ( lua_isnoneornil(lua_state, index) )
+    {
+        return false;
+    }
+    luaL_checktype( lua_state, index, LUA_TTABLE );
+    for ( lua_Integer i = 1; lua_rawgeti(lua_state, index, i) != LUA_TNIL; ++i )
+    {
+        TargetPrototype* prototype = (TargetPrototype*) luaxx_to( lua_state, lua_gettop(lua_state), TARGET_PROTOTYPE_TYPE );
+        luaL_argcheck( lua_state, prototype != nullptr, index, "expected array of target prototypes" );
+        prototypes->push_back( prototype );
+        lua_pop( lua_state, 1 );
+    }
+    lua_pop( lua_state, 1 );
+    return true;
+}
+
+/**
+// Read the prototypes passed to `Target.walk_dependencies()` and
+// `Target.transitive_dependencies()` into \e filter.
+*/
+static void read_filter( lua_State* lua_state, int yield, int recurse, WalkFilter* filter )
+{
+    SWEET_ASSERT( filter );
+    filter->prototypes = read_prototypes( lua_state, yield, &filter->yield_prototypes );
+    if ( !read_prototypes(lua_state, recurse, &filter->recurse_prototypes) )
+    {
+        filter->recurse_prototypes = filter->yield_prototypes;
+    }
+    else
+    {
+        filter->prototypes = true;
+    }
+}
+
+/**
+// Walk the explicit dependencies of \e target depth first.
+//
+// The dependencies yielded by walking each dependency that is recursed into
+// are remembered for the rest of the walk so that dependencies shared by
+// many targets, e.g. the static libraries at the bottom of a stack of
+// libraries, are only walked once.
+//
+// A dependency cycle ends the walk at the target that is revisited; that 
+// target is yielded, if it is yielded at all, but not recursed into again.
+// The dependencies yielded by a target whose walk revisits a target further
+// up the path depend on that path so they aren't remembered; only targets 
+// whose walks have completed without leaving the cycle are remembered and 
+// later visits never see a partially walked target.
+//
+// @param depth
+//  The number of targets being walked that \e target is reached through.
+//
+// @param walking
+//  The depth of each target that is being walked, i.e. the targets on the
+//  path to \e target.
+//
+// @return
+//  The smallest depth of a target being walked that was revisited through
+//  a cycle or `INT_MAX` if the dependencies yielded don't depend on the 
+//  targets being walked.
+*/
+static int walk_dependencies( Target* target, const WalkFilter& filter, int depth, unordered_map<Target*, vector<Target*>>* walked, unordered_map<Target*, int>* walking, vector<Target*>* dependencies )
+{
+    SWEET_ASSERT( target );
+    SWEET_ASSERT( walked );
+    SWEET_ASSERT( walking );
+    SWEET_ASSERT( dependencies );
+
+    unordered_map<Target*, vector<Target*>>::const_iterator i = walked->find( target );
+    if ( i != walked->end() )
+    {
+        dependencies->insert( dependencies->end(), i->second.begin(), i->second.end() );
+        return INT_MAX;
+    }
+
+    unordered_map<Target*, int>::const_iterator j = walking->find( target );
+    if ( j != walking->end() )
+    {
+        return j->second;
+    }
+
+    walking->insert( std::make_pair(target, depth) );
+    size_t begin = dependencies->size();
+    int revisited = INT_MAX;
+    Target* dependency = target->explicit_dependency( 0 );
+    for ( int n = 1; dependency; ++n )
+    {
+        if ( filter.yield(dependency) )
+        {
+            dependencies->push_back( dependency );
+        }
+        if ( filter.recurse(dependency) )
+        {
+            revisited = std::min( revisited, walk_dependencies(dependency, filter, depth + 1, walked, walking, dependencies) );
+        }
+        dependency = target->explicit_dependency( n );
+    }
+    walking->erase( target );
+
+    if ( revisited < depth )
+    {
+        return revisited;
+    }
+    (*walked)[target].assign( dependencies->begin() + begin, dependencies->end() );
+    return INT_MAX;
+}
+
+/**
+// Walk the explicit dependencies of \e target depth first in reverse.
+//
+// Walking in reverse and keeping only the first time that each dependency
+// is reached gives the same dependencies in reverse as walking forwards and
+// keeping only the last time that each dependency is reached.  Each target
+// need only be recursed into once because every dependency it yields has
+// already been reached the first time that it is recursed into.  This also
+// ends the walk at a target revisited through a dependency cycle.
+*/
+static void walk_dependencies_in_reverse( Target* target, const WalkFilter& filter, unordered_set<Target*>* walked, unordered_set<Target*>* yielded, vector<Target*>* dependencies )
+{
+    SWEET_ASSERT( target );
+    SWEET_ASSERT( walked );
+    SWEET_ASSERT( yielded );
+    SWEET_ASSERT( dependencies );
+
+    if ( !walked->insert(target).second )
+    {
+        return;
+    }
+
+    vector<Target*> explicit_dependencies;
+    Target* dependency = target->explicit_dependency( 0 );
+    for ( int n = 1; dependency; ++n )
+    {
+        explicit_dependencies.push_back( dependency );
+        dependency = target->explicit_dependency( n );
+    }
+
+    for ( vector<Target*>::const_reverse_iterator i = explicit_dependencies.rbegin(); i != explicit_dependencies.rend(); ++i )
+    {
+        Target* dependency = *i;
+        if ( filter.recurse(dependency) )
+        {
+            walk_dependencies_in_reverse( dependency, filter, walked, yielded, dependencies );
+        }
+        if ( filter.yield(dependency) && yielded->insert(dependency).second )
+        {
+            dependencies->push_back( dependency );
+        }
+    }
+}
+
+/**
+// Find or create a target as `Target()` does.
+//
+// @param lua_state
+//  The lua_State to create the target's Lua object in.
+//
+// @param forge
+//  The Forge to create the target in.
+//
+// @param toolset
+//  The absolute stack index of the toolset that the target is created by.
+//
+// @param identifier
+//  The identifier of the target relative to the current working directory.
+//
+// @param target_prototype
+//  The prototype of the target or null to create a target without a
+//  prototype.
+//
+// @return
+//  The target.
+*/
+static Target* create_target( lua_State* lua_state, Forge* forge, int toolset, const char* identifier, TargetPrototype* target_prototype )
+{
+    SWEET_ASSERT( forge );
+    Context* context = forge->context();
+    Graph* graph = forge->graph();
+    Target* working_directory = context->working_directory();
+    Target* target = graph->add_or_find_target( identifier, working_directory );
+
+    bool update_target_prototype = target_prototype && !target->prototype();
+    if ( update_target_prototype )
+    {
+        target->set_prototype( target_prototype );
+        target->set_working_directory( working_directory );
+    }
+
+    bool update_working_directory = !target->working_directory();
+    if ( update_working_directory )
+    {
+        target->set_working_directory( working_directory );
+    }
+
+    if ( target_prototype && target->prototype() != target_prototype )
+    {
+        forge->errorf( "The target '%s' has been created with prototypes '%s' and '%s'", identifier, target->prototype()->id().c_str(), target_prototype ? target_prototype->id().c_str() : "none" );
+    }
+
+    bool create_lua_binding = !target->referenced_by_script();
+    if ( create_lua_binding )
+    {
+        forge->create_target_lua_binding( target );
+    }
+
+    // Set `target.toolset` to the toolset that created this target.  The
+    // toolset is used to provide the correct toolset and settings when
+    // visiting targets in a postorder traversal.
+    //
+    // This also happens when the target prototype is set for the first time
+    // so that targets that are lazily defined after they have been created by
+    // another target depending on them have access to the Forge instance they
+    // are defined in rather than just the first Forge instance that first 
+    // referenced them which is difficult to control and typically incorrect.
+    if ( update_target_prototype || update_working_directory || create_lua_binding )
+    {
+        luaxx_push( lua_state, target );
+        lua_pushvalue( lua_state, toolset );
+        lua_setfield( lua_state, -2, "toolset" );
+        lua_pop( lua_state, 1 );
+
+        // Targets that describe the command that builds them are outdated 
+        // when that command changes (see `build_visit()`) and so ignore the
+        // settings hash that otherwise outdates them when any setting 
+        // changes.
+        luaxx_push( lua_state, target );
+        lua_getfield( lua_state, -1, "command" );
+        bool command = lua_isfunction( lua_state, -1 );
+        lua_pop( lua_state, 2 );
+        if ( command )
+        {
+            target->set_hash( 0 );
+        }
+        else
+        {
+            lua_getfield( lua_state, toolset, "settings" );
+            if ( lua_istable(lua_state, -1) )
+            {
+                target->set_hash( LuaSystem::hash_table(lua_state, -1) );
+            }
+            lua_pop( lua_state, 1 );
+        }
+    }
+
+    return target;
+}
+
+/**
+// Find or create the target for a source file as `Toolset.SourceFile()`
+// does.
+//
+// Filenames are only interpolated when they contain a `$`.
+//
+// @param value
+//  The absolute stack index of the filename or target; a filename is
+//  replaced by its interpolated value.
+//
+// @return
+//  The target or null if the value is neither a filename nor a target.
+*/
+static Target* source_file( lua_State* lua_state, Forge* forge, int toolset, int interpolate, int value, bool digests )
+{
+    if ( lua_type(lua_state, value) != LUA_TSTRING )
+    {
+        return lua_istable( lua_state, value ) ? (Target*) luaxx_to( lua_state, value, TARGET_TYPE ) : nullptr;
+    }
+
+    size_t length = 0;
+    const char* identifier = lua_tolstring( lua_state, value, &length );
+    if ( memchr(identifier, '$', length) )
+    {
+        lua_pushvalue( lua_state, interpolate );
+        lua_pushvalue( lua_state, toolset );
+        lua_pushvalue( lua_state, value );
+        lua_call( lua_state, 2, 1 );
+        lua_replace( lua_state, value );
+        identifier = luaL_checklstring( lua_state, value, &length );
+    }
+
+    Target* target = ::create_target( lua_state, forge, toolset, identifier, nullptr );
+    if ( target->filenames().empty() || target->filename(0).empty() )
+    {
+        target->set_filename( target->path(), 0 );
+    }
+    target->set_cleanable( false );
+    target->set_cutoff( digests );
+    return target;
+}
+
+/**
+// Merge fields with string keys from one table to another as
+// `forge:merge()` does; arrays are appended and other values are replaced.
+*/
+static void merge( lua_State* lua_state, int destination, int source )
+{
+    luaL_checkstack( lua_state, 4, "too many values" );
+    lua_pushnil( lua_state );
+    while ( lua_next(lua_state, source) )
+    {
+        if ( lua_type(lua_state, -2) == LUA_TSTRING )
+        {
+            const char* key = lua_tostring( lua_state, -2 );
+            if ( lua_istable(lua_state, -1) )
+            {
+                const int VALUE = lua_gettop( lua_state );
+                if ( lua_getfield(lua_state, destination, key) == LUA_TNIL )
+                {
+                    lua_pop( lua_state, 1 );
+                    lua_newtable( lua_state );
+                }
+                const int VALUES = lua_gettop( lua_state );
+                lua_Integer count = luaL_len( lua_state, VALUES );
+                for ( lua_Integer index = 1; lua_geti(lua_state, VALUE, index) != LUA_TNIL; ++index )
+                {
+                    lua_seti( lua_state, VALUES, ++count );
+                }
+                lua_pop( lua_state, 1 );
+                lua_setfield( lua_state, destination, key );
+            }
+            else
+            {
+                lua_pushvalue( lua_state, -1 );
+                lua_setfield( lua_state, destination, key );
+            }
+        }
+        lua_pop( lua_state, 1 );
+    }
+}
+
+/**
+// Push the path of a source file relative to the root directory.
+//
+// The path is built and destroyed here so that it isn't live in
+// create_files() when Lua is called.
+*/
+static void push_root_relative( lua_State* lua_state, Forge* forge, Target* source )
+{
+    const string& filename = !source->filenames().empty() ? source->filename( 0 ) : string();
+    string root_relative = relative( forge->absolute(filename), forge->root() ).generic_string();
+    lua_pushlstring( lua_state, root_relative.c_str(), root_relative.size() );
+}
+
+/**
+// Push the directory that contains the file a target is bound to.
+//
+// The path is built and destroyed here so that it isn't live in
+// create_files() when Lua is called.
+*/
+static void push_branch( lua_State* lua_state, Target* file )
+{
+    string branch = boost::filesystem::path( file->filename(0) ).parent_path().generic_string();
+    lua_pushlstring( lua_state, branch.c_str(), branch.size() );
+}
+
+/**
+// Create a file for each source file passed to a pattern or group
+// prototype.
+//
+// Each file is identified by replacing \e pattern in the path of its
+// source file relative to the root directory with \e replacement and then
+// passing the result to the `identify()` function of the prototype or
+// `Toolset.interpolate()` when there is no `identify()` function.  Files
+// are cleanable, bound to the filename returned from `identify()` or their
+// path, and depend on their source file and, for ordering, the directory
+// that contains them.
+//
+// Files created for a pattern prototype have that prototype, are passed
+// the attributes to merge, and are passed to the prototype's `created()`
+// function.  Files created for a group have no prototype and are added as
+// dependencies of the group with its `created()` function called for each.
+//
+// Everything except the calls back to Lua for the `identify()`,
+// `created()`, and `string.gsub()` functions and the creation of distinct
+// directories happens without leaving C++.
+//
+// Lua is built as C so errors raised here or in those calls unwind with
+// `longjmp()` and skip the destructors of C++ objects.  The paths passed
+// to Lua are pushed as soon as they're made and the directories already
+// created are kept in a Lua table so that no C++ objects are live when
+// Lua is called or an error is raised.
+//
+// @return
+//  An array of the created files.
+*/
+static int create_files( lua_State* lua_state, Forge* forge, TargetPrototype* target_prototype, Target* group )
+{
+    const int TOOLSET = 1;
+    const int PATTERN = 3;
+    const int REPLACEMENT = 4;
+    const int DEPENDENCIES = 5;
+    const int ATTRIBUTES = 6;
+    const int GSUB = 7;
+    const int INTERPOLATE = 8;
+    const int IDENTIFY = 9;
+    const int SOURCES = 10;
+    const int FILES = 11;
+    const int DIRECTORIES = 12;
+
+    luaL_checktype( lua_state, TOOLSET, LUA_TTABLE );
+    luaL_checkstring( lua_state, PATTERN );
+    luaL_checkstring( lua_state, REPLACEMENT );
+    lua_settop( lua_state, ATTRIBUTES );
+
+    lua_getglobal( lua_state, "string" );
+    lua_getfield( lua_state, -1, "gsub" );
+    lua_remove( lua_state, -2 );
+    lua_getglobal( lua_state, "Toolset" );
+    lua_getfield( lua_state, -1, "interpolate" );
+    lua_remove( lua_state, -2 );
+    if ( target_prototype )
+    {
+        luaxx_push( lua_state, target_prototype );
+        lua_getfield( lua_state, -1, "identify" );
+        lua_remove( lua_state, -2 );
+    }
+    else
+    {
+        lua_pushnil( lua_state );
+    }
+    lua_newtable( lua_state );
+    lua_Integer sources = 0;
+    if ( lua_istable(lua_state, DEPENDENCIES) )
+    {
+        LuaSystem::flatten( lua_state, DEPENDENCIES, SOURCES, &sources );
+    }
+    lua_createtable( lua_state, int(sources), 0 );
+    lua_newtable( lua_state );
+
+    lua_getglobal( lua_state, "forge" );
+    bool digests = lua_istable( lua_state, -1 ) && lua_getfield( lua_state, -1, "digests" ) == LUA_TBOOLEAN && lua_toboolean( lua_state, -1 );
+    lua_settop( lua_state, DIRECTORIES );
+
+    for ( lua_Integer index = 1; index <= sources; ++index )
+    {
+        lua_rawgeti( lua_state, SOURCES, index );
+        const int SOURCE = lua_gettop( lua_state );
+        Target* source = source_file( lua_state, forge, TOOLSET, INTERPOLATE, SOURCE, digests );
+        if ( !source )
+        {
+            return luaL_error( lua_state, "Expected a filename or target but found a %s", luaL_typename(lua_state, SOURCE) );
+        }
+
+        lua_pushvalue( lua_state, GSUB );
+        push_root_relative( lua_state, forge, source );
+        lua_pushvalue( lua_state, PATTERN );
+        lua_pushvalue( lua_state, REPLACEMENT );
+        lua_call( lua_state, 3, 1 );
+
+        // Call `identify()` to get the identifier and filename.  The default
+        // `Toolset.interpolate()` is skipped for identifiers without 
+        // substitutions as it would return them unchanged.
+        size_t length = 0;
+        const char* identifier = lua_tolstring( lua_state, -1, &length );
+        if ( !lua_isnil(lua_state, IDENTIFY) || memchr(identifier, '$', length) )
+        {
+            lua_pushvalue( lua_state, !lua_isnil(lua_state, IDENTIFY) ? IDENTIFY : INTERPOLATE );
+            lua_insert( lua_state, -2 );
+            lua_pushvalue( lua_state, TOOLSET );
+            lua_insert( lua_state, -2 );
+            lua_call( lua_state, 2, 2 );
+        }
+        else
+        {
+            lua_pushnil( lua_state );
+        }
+        const int IDENTIFIER = SOURCE + 1;
+        const int FILENAME = SOURCE + 2;
+        if ( lua_type(lua_state, IDENTIFIER) != LUA_TSTRING )
+        {
+            return luaL_error( lua_state, "Expected an identifier for '%s' but found a %s", !source->filenames().empty() ? source->filename(0).c_str() : "", luaL_typename(lua_state, IDENTIFIER) );
+        }
+
+        identifier = lua_tostring( lua_state, IDENTIFIER );
+        Target* file = ::create_target( lua_state, forge, TOOLSET, identifier, group ? nullptr : target_prototype );
+        if ( lua_toboolean(lua_state, FILENAME) )
+        {
+            size_t filename_length = 0;
+            const char* filename = luaL_tolstring( lua_state, FILENAME, &filename_length );
+            file->set_filename( string(filename, filename_length), 0 );
+            lua_pop( lua_state, 1 );
+        }
+        else
+        {
+            file->set_filename( file->path(), 0 );
+        }
+        file->set_cleanable( true );
+
+        push_branch( lua_state, file );
+        const int BRANCH = lua_gettop( lua_state );
+        lua_pushvalue( lua_state, BRANCH );
+        if ( lua_rawget(lua_state, DIRECTORIES) == LUA_TNIL )
+        {
+            lua_pop( lua_state, 1 );
+            lua_getfield( lua_state, TOOLSET, "Directory" );
+            lua_pushvalue( lua_state, TOOLSET );
+            lua_pushvalue( lua_state, BRANCH );
+            lua_call( lua_state, 2, 1 );
+            if ( !lua_istable(lua_state, -1) || !luaxx_to(lua_state, lua_gettop(lua_state), TARGET_TYPE) )
+            {
+                return luaL_error( lua_state, "Expected a target from Directory() for '%s'", lua_tostring(lua_state, BRANCH) );
+            }
+            lua_pushvalue( lua_state, BRANCH );
+            lua_pushvalue( lua_state, -2 );
+            lua_rawset( lua_state, DIRECTORIES );
+        }
+        Target* directory = (Target*) luaxx_to( lua_state, lua_gettop(lua_state), TARGET_TYPE );
+        file->add_ordering_dependency( directory );
+
+        if ( !group )
+        {
+            luaxx_push( lua_state, file );
+            const int FILE = lua_gettop( lua_state );
+            if ( lua_istable(lua_state, ATTRIBUTES) )
+            {
+                merge( lua_state, FILE, ATTRIBUTES );
+            }
+            if ( lua_getfield(lua_state, FILE, "created") != LUA_TNIL )
+            {
+                lua_pushvalue( lua_state, TOOLSET );
+                lua_pushvalue( lua_state, FILE );
+                lua_call( lua_state, 2, 0 );
+            }
+            file->add_explicit_dependency( source );
+        }
+        else
+        {
+            file->add_explicit_dependency( source );
+            luaxx_push( lua_state, group );
+            const int GROUP = lua_gettop( lua_state );
+            if ( lua_getfield(lua_state, GROUP, "created") != LUA_TNIL )
+            {
+                lua_pushvalue( lua_state, TOOLSET );
+                lua_pushvalue( lua_state, GROUP );
+                lua_call( lua_state, 2, 0 );
+            }
+            group->add_explicit_dependency( file );
+        }
+
+        luaxx_push( lua_state, file );
+        lua_rawseti( lua_state, FILES, index );
+        lua_settop( lua_state, DIRECTORIES );
+    }
+    lua_settop( lua_state, FILES );
+    return 1;
+}
+
 LuaTarget::LuaTarget()
 : lua_state_( nullptr )
 {
@@ -57,6 +662,10 @@ void LuaTarget::create( lua_State* lua_state, Forge* forge )
         { "cleanable", &LuaTarget::cleanable },
         { "set_built", &LuaTarget::set_built },
         { "built", &LuaTarget::built },
+        { "set_cutoff", &LuaTarget::set_cutoff },
+        { "bind_to_command", &LuaTarget::bind_to_command },
+        { "record_command", &LuaTarget::record_command },
+        { "cutoff", &LuaTarget::cutoff },
         { "timestamp", &LuaTarget::timestamp },
         { "last_write_time", &LuaTarget::last_write_time },
         { "outdated", &LuaTarget::outdated },
@@ -90,6 +699,9 @@ void LuaTarget::create( lua_State* lua_state, Forge* forge )
         { "ordering_dependencies", &LuaTarget::ordering_dependencies },
         { "any_dependency", &LuaTarget::any_dependency },
         { "any_dependencies", &LuaTarget::any_dependencies },
+        { "dependents", &LuaTarget::dependents },
+        { "walk_dependencies", &LuaTarget::walk_dependencies },
+        { "transitive_dependencies", &LuaTarget::transitive_dependencies },
         { nullptr, nullptr }
     };
     luaxx_push( lua_state_, this );
@@ -97,6 +709,17 @@ void LuaTarget::create( lua_State* lua_state, Forge* forge )
     luaL_setfuncs( lua_state_, implicit_creation_functions, 1 );    
     lua_pop( lua_state_, 1 );
 
+    static const luaL_Reg bulk_creation_functions [] = 
+    {
+        { "create_pattern_targets", &LuaTarget::create_pattern_targets },
+        { "create_group_targets", &LuaTarget::create_group_targets },
+        { nullptr, nullptr }
+    };
+    luaxx_push( lua_state_, this );
+    lua_pushlightuserdata( lua_state_, forge );
+    luaL_setfuncs( lua_state_, bulk_creation_functions, 1 );
+    lua_pop( lua_state_, 1 );
+
     // Set the metatable for `Target` to redirect calls to create new targets.
     luaxx_push( lua_state_, this );
     lua_newtable( lua_state_ );
@@ -314,6 +937,76 @@ int LuaTarget::built( lua_State* lua_state )
     return 0;
 }
 
+int LuaTarget::set_cutoff( lua_State* lua_state )
+{
+    const int TARGET = 1;
+    const int CUTOFF = 2;
+    Target* target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
+    luaL_argcheck( lua_state, target != nullptr, TARGET, "nil target" );
+    if ( target )
+    {
+        bool cutoff = lua_toboolean( lua_state, CUTOFF ) != 0;
+        target->set_cutoff( cutoff );
+    }
+    return 0;
+}
+
+int LuaTarget::cutoff( lua_State* lua_state )
+{
+    const int TARGET = 1;
+    Target* target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
+    luaL_argcheck( lua_state, target != nullptr, TARGET, "nil target" );
+    if ( target )
+    {
+        lua_pushboolean( lua_state, target->cutoff() ? 1 : 0 );
+        return 1;
+    }
+    return 0;
+}
+
+int LuaTarget::bind_to_command( lua_State* lua_state )
+{
+    const int TARGET = 1;
+    const int COMMAND = 2;
+    const int COMMAND_LINE = 3;
+    const int ENVIRONMENT = 4;
+    Target* target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
+    luaL_argcheck( lua_state, target != nullptr, TARGET, "nil target" );
+    if ( target )
+    {
+        // Targets that don't execute a command have a signature of 0, the
+        // same as Targets that haven't executed a command when built.
+        uint64_t signature = 0;
+        if ( !lua_isnoneornil(lua_state, COMMAND) )
+        {
+            signature = LuaSystem::signature( lua_state, COMMAND, COMMAND_LINE, ENVIRONMENT, target->graph()->forge()->root().generic_string() );
+        }
+        lua_pushboolean( lua_state, target->bind_to_signature(signature) ? 1 : 0 );
+        return 1;
+    }
+    return 0;
+}
+
+int LuaTarget::record_command( lua_State* lua_state )
+{
+    const int TARGET = 1;
+    const int COMMAND = 2;
+    const int COMMAND_LINE = 3;
+    const int ENVIRONMENT = 4;
+    Target* target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
+    luaL_argcheck( lua_state, target != nullptr, TARGET, "nil target" );
+    if ( target )
+    {
+        uint64_t signature = 0;
+        if ( !lua_isnoneornil(lua_state, COMMAND) )
+        {
+            signature = LuaSystem::signature( lua_state, COMMAND, COMMAND_LINE, ENVIRONMENT, target->graph()->forge()->root().generic_string() );
+        }
+        target->set_signature( signature );
+    }
+    return 0;
+}
+
 int LuaTarget::timestamp( lua_State* lua_state )
 {
     const int TARGET = 1;
@@ -940,6 +1633,163 @@ int LuaTarget::ordering_dependencies( lua_State* lua_state )
     return 3;
 }
 
+int LuaTarget::dependents( lua_State* lua_state )
+{
+    SWEET_ASSERT( lua_state );
+
+    const int TARGET = 1;
+    Target* target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
+    luaL_argcheck( lua_state, target != NULL, TARGET, "expected target table" );
+
+    // Copy the dependents into a table and iterate over that with `ipairs()`
+    // so that adding or removing dependencies while iterating is safe.
+    LuaTarget* lua_target = reinterpret_cast<LuaTarget*>( lua_touserdata(lua_state, lua_upvalueindex(1)) );
+    SWEET_ASSERT( lua_target );
+    lua_getglobal( lua_state, "ipairs" );
+    const std::unordered_set<Target*>& dependents = target->dependents();
+    lua_createtable( lua_state, int(dependents.size()), 0 );
+    int index = 1;
+    for ( std::unordered_set<Target*>::const_iterator i = dependents.begin(); i != dependents.end(); ++i )
+    {
+        Target* dependent = *i;
+        if ( !dependent->referenced_by_script() )
+        {
+            lua_target->create_target( dependent );
+        }
+        luaxx_push( lua_state, dependent );
+        lua_rawseti( lua_state, -2, index );
+        ++index;
+    }
+    lua_call( lua_state, 1, 3 );
+    return 3;
+}
+
+/**
+// Walk the explicit dependencies of a target.
+//
+// Walks the same dependencies as the `walk_dependencies()` function in Lua
+// but collects them into an array without a coroutine and without walking
+// dependencies shared between targets more than once.
+//
+// @return
+//  An array of the dependencies yielded in depth first order.
+*/
+int LuaTarget::walk_dependencies( lua_State* lua_state )
+{
+    const int TARGET = 1;
+    const int YIELD_PROTOTYPES = 2;
+    const int RECURSE_PROTOTYPES = 3;
+
+    Target* target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
+    luaL_argcheck( lua_state, target != nullptr, TARGET, "expected target table" );
+    WalkFilter filter;
+    read_filter( lua_state, YIELD_PROTOTYPES, RECURSE_PROTOTYPES, &filter );
+
+    unordered_map<Target*, vector<Target*>> walked;
+    unordered_map<Target*, int> walking;
+    vector<Target*> dependencies;
+    ::walk_dependencies( target, filter, 0, &walked, &walking, &dependencies );
+    push_targets( lua_state, dependencies );
+    return 1;
+}
+
+/**
+// Walk the explicit dependencies of a target keeping only the last time
+// that each dependency is reached.
+//
+// This is the order in which static libraries are passed to linkers that
+// resolve symbols in a single pass; each library appears after all of the
+// libraries that depend on it.
+//
+// @return
+//  An array of the distinct dependencies yielded.
+*/
+int LuaTarget::transitive_dependencies( lua_State* lua_state )
+{
+    const int TARGET = 1;
+    const int YIELD_PROTOTYPES = 2;
+    const int RECURSE_PROTOTYPES = 3;
+
+    Target* target = (Target*) luaxx_to( lua_state, TARGET, TARGET_TYPE );
+    luaL_argcheck( lua_state, target != nullptr, TARGET, "expected target table" );
+    WalkFilter filter;
+    read_filter( lua_state, YIELD_PROTOTYPES, RECURSE_PROTOTYPES, &filter );
+
+    unordered_set<Target*> walked;
+    unordered_set<Target*> yielded;
+    vector<Target*> dependencies;
+    walk_dependencies_in_reverse( target, filter, &walked, &yielded, &dependencies );
+    std::reverse( dependencies.begin(), dependencies.end() );
+    push_targets( lua_state, dependencies );
+    return 1;
+}
+
+/**
+// Push an array of targets, creating the Lua objects for any targets that
+// haven't been referenced from Lua yet.
+*/
+void LuaTarget::push_targets( lua_State* lua_state, const std::vector<Target*>& targets )
+{
+    LuaTarget* lua_target = reinterpret_cast<LuaTarget*>( lua_touserdata(lua_state, lua_upvalueindex(1)) );
+    SWEET_ASSERT( lua_target );
+    lua_createtable( lua_state, int(targets.size()), 0 );
+    int index = 1;
+    for ( vector<Target*>::const_iterator i = targets.begin(); i != targets.end(); ++i )
+    {
+        Target* target = *i;
+        if ( !target->referenced_by_script() )
+        {
+            lua_target->create_target( target );
+        }
+        luaxx_push( lua_state, target );
+        lua_rawseti( lua_state, -2, index );
+        ++index;
+    }
+}
+
+/**
+// Create the files for the source files passed to a pattern prototype.
+//
+// ~~~lua
+// function Target.create_pattern_targets( toolset, target_prototype, pattern, replacement, dependencies, attributes )
+// ~~~
+//
+// @return
+//  An array of the created targets.
+*/
+int LuaTarget::create_pattern_targets( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int TARGET_PROTOTYPE = 2;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    TargetPrototype* target_prototype = (TargetPrototype*) luaxx_to( lua_state, TARGET_PROTOTYPE, TARGET_PROTOTYPE_TYPE );
+    luaL_argcheck( lua_state, target_prototype != nullptr, TARGET_PROTOTYPE, "expected target prototype table" );
+    return create_files( lua_state, forge, target_prototype, nullptr );
+}
+
+/**
+// Create the files for the source files passed to a group prototype and
+// add them as dependencies of the group.
+//
+// ~~~lua
+// function Target.create_group_targets( toolset, group, pattern, replacement, dependencies )
+// ~~~
+//
+// @return
+//  An array of the created files.
+*/
+int LuaTarget::create_group_targets( lua_State* lua_state )
+{
+    const int FORGE = lua_upvalueindex( 1 );
+    const int GROUP = 2;
+    const int DEPENDENCIES = 5;
+    Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+    Target* group = (Target*) luaxx_to( lua_state, GROUP, TARGET_TYPE );
+    luaL_argcheck( lua_state, group != nullptr, GROUP, "expected target table" );
+    lua_settop( lua_state, DEPENDENCIES );
+    return create_files( lua_state, forge, group->prototype(), group );
+}
+
 int LuaTarget::vector_string_const_iterator_gc( lua_State* lua_state )
 {
     return luaxx_gc<vector<string>::const_iterator>( lua_state );
@@ -960,73 +1810,9 @@ int LuaTarget::target_call_metamethod( lua_State* lua_state )
     (void) TARGET;
 
     Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
-    Context* context = forge->context();
-    Graph* graph = forge->graph();
-    Target* working_directory = context->working_directory();
-    size_t identifier_length = 0;
-    const char* identifier = luaL_checklstring( lua_state, IDENTIFIER, &identifier_length );
+    const char* identifier = luaL_checkstring( lua_state, IDENTIFIER );
     TargetPrototype* target_prototype = (TargetPrototype*) luaxx_to( lua_state, TARGET_PROTOTYPE, TARGET_PROTOTYPE_TYPE );
-
-    Target* target = graph->add_or_find_target( string(identifier, identifier_length), working_directory );
-
-    bool update_target_prototype = target_prototype && !target->prototype();
-    if ( update_target_prototype )
-    {
-        target->set_prototype( target_prototype );
-        target->set_working_directory( working_directory );
-    }
-
-    bool update_working_directory = !target->working_directory();
-    if ( update_working_directory )
-    {
-        target->set_working_directory( working_directory );
-    }
-
-    if ( target_prototype && target->prototype() != target_prototype )
-    {
-        forge->errorf( "The target '%s' has been created with prototypes '%s' and '%s'", identifier, target->prototype()->id().c_str(), target_prototype ? target_prototype->id().c_str() : "none" );
-    }
-
-    bool create_lua_binding = !target->referenced_by_script();
-    if ( create_lua_binding )
-    {
-        forge->create_target_lua_binding( target );
-    }
-
-    // Set `target.toolset` to the toolset that created this target.  The
-    // toolset is used to provide the correct toolset and settings when
-    // visiting targets in a postorder traversal.
-    //
-    // This also happens when the target prototype is set for the first time
-    // so that targets that are lazily defined after they have been created by
-    // another target depending on them have access to the Forge instance they
-    // are defined in rather than just the first Forge instance that first 
-    // referenced them which is difficult to control and typically incorrect.
-    if ( update_target_prototype || update_working_directory || create_lua_binding )
-    {
-        luaxx_push( lua_state, target );
-        lua_pushvalue( lua_state, TOOLSET );
-        lua_setfield( lua_state, -2, "toolset" );
-        lua_pop( lua_state, 1 );
-
-        lua_getglobal( lua_state, "hash" );
-        lua_getfield( lua_state, TOOLSET, "settings" );
-        if ( lua_istable(lua_state, -1) )
-        {
-            lua_call( lua_state, 1, 1 );
-            const lua_Integer hash = luaL_checkinteger( lua_state, -1 );
-            target->set_hash( hash );
-        }
-        lua_pop( lua_state, 1 );
-
-        // The following calculation of the hash of the settings table without
-        // calling into the Lua API so much should work but crashes for some
-        // reason I don't understand.
-        // lua_getfield( lua_state, TOOLSET, "settings" );
-        // lua_Integer hash = LuaSystem::hash_recursively( lua_state, -1, false );
-        // lua_pop( lua_state, 1 );
-    }
-
+    Target* target = ::create_target( lua_state, forge, TOOLSET, identifier, target_prototype );
     luaxx_push( lua_state, target );    
     return 1;
 }
@@ -1,6 +1,7 @@
 #ifndef FORGE_LUATARGET_HPP_INCLUDED
 #define FORGE_LUATARGET_HPP_INCLUDED
 
+#include <vector>
 #include <ctime>
 
 struct lua_State;
@@ -40,6 +41,10 @@ public:
     static int cleanable( lua_State* lua_state );
     static int set_built( lua_State* lua_state );
     static int built( lua_State* lua_state );
+    static int set_cutoff( lua_State* lua_state );
+    static int cutoff( lua_State* lua_state );
+    static int bind_to_command( lua_State* lua_state );
+    static int record_command( lua_State* lua_state );
     static int timestamp( lua_State* lua_state );
     static int last_write_time( lua_State* lua_state );
     static int outdated( lua_State* lua_state );
@@ -69,6 +74,12 @@ public:
     static int ordering_dependency( lua_State* lua_state );
     static int ordering_dependencies_iterator( lua_State* lua_state );
     static int ordering_dependencies( lua_State* lua_state );
+    static int dependents( lua_State* lua_state );
+    static int walk_dependencies( lua_State* lua_state );
+    static int transitive_dependencies( lua_State* lua_state );
+    static void push_targets( lua_State* lua_state, const std::vector<Target*>& targets );
+    static int create_pattern_targets( lua_State* lua_state );
+    static int create_group_targets( lua_State* lua_state );
     static int vector_string_const_iterator_gc( lua_State* lua_state );
     static int target_call_metamethod( lua_State* lua_state );
     static int depend_call_metamethod( lua_State* lua_state );
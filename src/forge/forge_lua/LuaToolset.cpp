@@ -11,16 +11,52 @@
 #include <luaxx/luaxx.hpp>
 #include <assert/assert.hpp>
 #include <lua.hpp>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
 
 using std::string;
+using std::vector;
 using namespace sweet;
 using namespace sweet::luaxx;
 using namespace sweet::forge;
 
 const char* LuaToolset::TOOLSET_METATABLE = "forge.Toolset";
 
+/**
+// The most parsed templates kept before the cache of parsed templates is
+// cleared.
+*/
+static const size_t MAXIMUM_TEMPLATES = 65536;
+
+/**
+// Split \e text into whitespace separated words.
+*/
+static void split( const string& text, vector<string>* words )
+{
+    SWEET_ASSERT( words );
+    string::const_iterator i = text.begin();
+    while ( i != text.end() )
+    {
+        while ( i != text.end() && isspace((unsigned char) *i) )
+        {
+            ++i;
+        }
+        string::const_iterator begin = i;
+        while ( i != text.end() && !isspace((unsigned char) *i) )
+        {
+            ++i;
+        }
+        if ( i != begin )
+        {
+            words->push_back( string(begin, i) );
+        }
+    }
+}
+
 LuaToolset::LuaToolset()
-: lua_state_( nullptr )
+: lua_state_( nullptr ),
+  templates_()
 {
 }
 
@@ -48,6 +84,16 @@ void LuaToolset::create( lua_State* lua_state )
     luaL_setfuncs( lua_state_, functions, 0 );
     lua_pop( lua_state_, 1 );
 
+    static const luaL_Reg template_functions[] = 
+    {
+        { "interpolate", &LuaToolset::interpolate },
+        { nullptr, nullptr }
+    };
+    luaxx_push( lua_state_, this );
+    lua_pushlightuserdata( lua_state_, this );
+    luaL_setfuncs( lua_state_, template_functions, 1 );
+    lua_pop( lua_state_, 1 );
+
     // Set the metatable for `Toolset` to redirect calls to create new
     // toolsets in `Toolset.create()`.
     luaxx_push( lua_state_, this );
@@ -82,6 +128,7 @@ void LuaToolset::destroy()
     {
         luaxx_destroy( lua_state_, this );
         lua_state_ = nullptr;
+        templates_.clear();
     }
 }
 
@@ -185,3 +232,348 @@ int LuaToolset::continue_create_call_metamethod( lua_State* /*lua_state*/, int /
 {
     return 1;
 }
+
+/**
+// Provide GNU Make like string substitution.
+//
+// Replaces each `${...}` in a template with the value of the first word
+// between the braces looked up in the variables, the settings of the
+// toolset, the toolset, global variables, and finally environment
+// variables.  Functions are called passing the toolset and any following
+// words and tables are indexed by the second word.  Substitutions nested
+// between the braces are replaced first.
+//
+// Templates are parsed once and kept by their text so that the many
+// identifiers and filenames interpolated with the same template, e.g.
+// `${obj}/%1`, aren't parsed again.  Templates without substitutions are
+// returned as is.
+//
+// Lua is built as C so errors unwind with `longjmp()` and skip the
+// destructors of any C++ objects in the frames they unwind through.
+// Substitutions are looked up in protected mode and any error is only
+// raised here once the expanded output has been destroyed.
+//
+// ~~~lua
+// function Toolset.interpolate( toolset, template, variables )
+// ~~~
+*/
+int LuaToolset::interpolate( lua_State* lua_state )
+{
+    const int LUA_TOOLSET = lua_upvalueindex( 1 );
+    const int TOOLSET = 1;
+    const int TEMPLATE = 2;
+    const int VARIABLES = 3;
+
+    size_t length = 0;
+    const char* text = luaL_checklstring( lua_state, TEMPLATE, &length );
+    if ( !memchr(text, '$', length) )
+    {
+        lua_pushvalue( lua_state, TEMPLATE );
+        return 1;
+    }
+
+    LuaToolset* lua_toolset = (LuaToolset*) lua_touserdata( lua_state, LUA_TOOLSET );
+    SWEET_ASSERT( lua_toolset );
+    lua_settop( lua_state, VARIABLES );
+    lua_getfield( lua_state, TOOLSET, "settings" );
+    const int SETTINGS = lua_gettop( lua_state );
+    if ( !lua_toboolean(lua_state, VARIABLES) )
+    {
+        lua_pushvalue( lua_state, SETTINGS );
+        lua_replace( lua_state, VARIABLES );
+    }
+
+    bool expanded = false;
+    {
+        string output;
+        expanded = lua_toolset->expand( lua_state, string(text, length), TOOLSET, VARIABLES, SETTINGS, &output );
+        if ( expanded )
+        {
+            lua_pushlstring( lua_state, output.c_str(), output.size() );
+        }
+    }
+    return expanded ? 1 : lua_error( lua_state );
+}
+
+/**
+// Find or parse a template.
+//
+// Substitutions are found in the same way as matching the Lua pattern
+// `%$(%b{})`; a `$` followed by a `{` and everything up to the matching,
+// balanced `}`.  A `$` that doesn't start a substitution is literal.
+//
+// @param text
+//  The text of the template.
+//
+// @return
+//  The literal and substitution segments of the template.
+*/
+const std::vector<LuaToolset::TemplateSegment>& LuaToolset::parse( const std::string& text )
+{
+    std::unordered_map<string, vector<TemplateSegment>>::const_iterator i = templates_.find( text );
+    if ( i != templates_.end() )
+    {
+        return i->second;
+    }
+
+    if ( templates_.size() >= MAXIMUM_TEMPLATES )
+    {
+        templates_.clear();
+    }
+
+    vector<TemplateSegment> segments;
+    string literal;
+    size_t position = 0;
+    while ( position < text.size() )
+    {
+        size_t end = string::npos;
+        if ( text[position] == '$' && position + 1 < text.size() && text[position + 1] == '{' )
+        {
+            int depth = 0;
+            for ( size_t j = position + 1; j < text.size() && end == string::npos; ++j )
+            {
+                if ( text[j] == '{' )
+                {
+                    ++depth;
+                }
+                else if ( text[j] == '}' && --depth == 0 )
+                {
+                    end = j;
+                }
+            }
+        }
+
+        if ( end != string::npos )
+        {
+            if ( !literal.empty() )
+            {
+                TemplateSegment segment = { literal, false };
+                segments.push_back( segment );
+                literal.clear();
+            }
+            TemplateSegment segment = { text.substr(position + 2, end - position - 2), true };
+            segments.push_back( segment );
+            position = end + 1;
+        }
+        else
+        {
+            literal.push_back( text[position] );
+            ++position;
+        }
+    }
+    if ( !literal.empty() )
+    {
+        TemplateSegment segment = { literal, false };
+        segments.push_back( segment );
+    }
+
+    return templates_.insert( std::make_pair(text, segments) ).first->second;
+}
+
+/**
+// Append a template with its substitutions replaced to \e output.
+//
+// @param lua_state
+//  The lua_State to look up substitutions in.
+//
+// @param text
+//  The text of the template to expand.
+//
+// @param toolset
+//  The absolute stack index of the toolset.
+//
+// @param variables
+//  The absolute stack index of the variables.
+//
+// @param settings
+//  The absolute stack index of the settings of the toolset.
+//
+// @param output
+//  The string to append the expanded template to (assumed not null).
+//
+// @return
+//  True if the template was expanded otherwise false with the error left
+//  on the top of the Lua stack.
+*/
+bool LuaToolset::expand( lua_State* lua_state, const std::string& text, int toolset, int variables, int settings, std::string* output )
+{
+    SWEET_ASSERT( output );
+
+    // Copy the segments as the cache may be cleared while expanding nested
+    // substitutions or calling functions that interpolate other templates.
+    vector<TemplateSegment> segments = parse( text );
+    for ( vector<TemplateSegment>::const_iterator segment = segments.begin(); segment != segments.end(); ++segment )
+    {
+        if ( !segment->substitution_ )
+        {
+            output->append( segment->text_ );
+        }
+        else
+        {
+            string expression;
+            if ( memchr(segment->text_.c_str(), '$', segment->text_.size()) )
+            {
+                if ( !expand(lua_state, segment->text_, toolset, variables, settings, &expression) )
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                expression = segment->text_;
+            }
+            if ( !substitute(lua_state, text, expression, toolset, variables, settings, output) )
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+// Append the value of a substitution to \e output.
+//
+// @param lua_state
+//  The lua_State to look up the substitution in.
+//
+// @param text
+//  The template that the substitution is part of (for error messages).
+//
+// @param expression
+//  The text between the braces of the substitution with any nested
+//  substitutions already replaced.
+//
+// @param toolset
+//  The absolute stack index of the toolset.
+//
+// @param variables
+//  The absolute stack index of the variables.
+//
+// @param settings
+//  The absolute stack index of the settings of the toolset.
+//
+// @param output
+//  The string to append the value of the substitution to (assumed not
+//  null).
+//
+// @return
+//  True if the substitution was appended otherwise false with the error
+//  left on the top of the Lua stack.
+*/
+bool LuaToolset::substitute( lua_State* lua_state, const std::string& text, const std::string& expression, int toolset, int variables, int settings, std::string* output )
+{
+    SWEET_ASSERT( output );
+
+    vector<string> parameters;
+    split( expression, &parameters );
+    if ( !lua_checkstack(lua_state, int(parameters.size()) + 6) )
+    {
+        lua_pushstring( lua_state, "too many parameters" );
+        return false;
+    }
+
+    lua_pushcfunction( lua_state, &LuaToolset::lookup );
+    lua_pushlstring( lua_state, text.c_str(), text.size() );
+    lua_pushvalue( lua_state, toolset );
+    lua_pushvalue( lua_state, variables );
+    lua_pushvalue( lua_state, settings );
+    for ( vector<string>::const_iterator parameter = parameters.begin(); parameter != parameters.end(); ++parameter )
+    {
+        lua_pushlstring( lua_state, parameter->c_str(), parameter->size() );
+    }
+    if ( lua_pcall(lua_state, int(parameters.size()) + 4, 1, 0) != LUA_OK )
+    {
+        return false;
+    }
+
+    size_t length = 0;
+    const char* value = lua_tolstring( lua_state, -1, &length );
+    output->append( value, length );
+    lua_pop( lua_state, 1 );
+    return true;
+}
+
+/**
+// Look up the value of a substitution.
+//
+// Called in protected mode by substitute() so that errors from metamethods,
+// substitute functions, and missing or invalid substitutes don't unwind
+// through its C++ frames.
+//
+// ~~~lua
+// function lookup( template, toolset, variables, settings, identifier, ... )
+// ~~~
+*/
+int LuaToolset::lookup( lua_State* lua_state )
+{
+    const int TEMPLATE = 1;
+    const int TOOLSET = 2;
+    const int VARIABLES = 3;
+    const int SETTINGS = 4;
+    const int IDENTIFIER = 5;
+    const int parameters = lua_gettop( lua_state ) - IDENTIFIER + 1;
+
+    const char* identifier = parameters > 0 ? lua_tostring( lua_state, IDENTIFIER ) : nullptr;
+    lua_pushnil( lua_state );
+    if ( identifier )
+    {
+        const int lookups [] = { VARIABLES, SETTINGS, TOOLSET };
+        for ( size_t i = 0; i < sizeof(lookups) / sizeof(lookups[0]) && !lua_toboolean(lua_state, -1); ++i )
+        {
+            if ( lua_toboolean(lua_state, lookups[i]) )
+            {
+                lua_pop( lua_state, 1 );
+                lua_getfield( lua_state, lookups[i], identifier );
+            }
+        }
+        if ( !lua_toboolean(lua_state, -1) )
+        {
+            lua_pop( lua_state, 1 );
+            lua_getglobal( lua_state, identifier );
+        }
+        if ( !lua_toboolean(lua_state, -1) )
+        {
+            const char* value = ::getenv( identifier );
+            if ( value )
+            {
+                lua_pop( lua_state, 1 );
+                lua_pushstring( lua_state, value );
+            }
+        }
+    }
+
+    if ( lua_isfunction(lua_state, -1) )
+    {
+        lua_pushvalue( lua_state, TOOLSET );
+        for ( int i = 1; i < parameters; ++i )
+        {
+            lua_pushvalue( lua_state, IDENTIFIER + i );
+        }
+        lua_call( lua_state, parameters, 1 );
+    }
+    else if ( lua_istable(lua_state, -1) )
+    {
+        if ( parameters > 1 )
+        {
+            lua_getfield( lua_state, -1, lua_tostring(lua_state, IDENTIFIER + 1) );
+        }
+        else
+        {
+            lua_pushnil( lua_state );
+        }
+        lua_remove( lua_state, -2 );
+    }
+
+    if ( !lua_toboolean(lua_state, -1) )
+    {
+        return luaL_error( lua_state, "Missing substitute for \"%s\" in \"%s\"", identifier ? identifier : "", lua_tostring(lua_state, TEMPLATE) );
+    }
+
+    int type = lua_type( lua_state, -1 );
+    if ( type != LUA_TSTRING && type != LUA_TNUMBER )
+    {
+        return luaL_error( lua_state, "invalid replacement value (a %s)", luaL_typename(lua_state, -1) );
+    }
+    return 1;
+}
@@ -2,6 +2,9 @@
 #define FORGE_LUATOOLSET_HPP_INCLUDED
 
 #include <ctime>
+#include <string>
+#include <vector>
+#include <unordered_map>
 #include <lua.hpp>
 
 struct lua_State;
@@ -16,7 +19,17 @@ class Toolset;
 
 class LuaToolset
 {
+    /**
+    // A literal part of a template or a `${...}` substitution in it.
+    */
+    struct TemplateSegment
+    {
+        std::string text_; ///< The literal text or the text between the braces of the substitution.
+        bool substitution_; ///< True if this segment is a substitution otherwise false.
+    };
+
     lua_State* lua_state_; ///< The main Lua virtual machine to create the toolset API in.
+    std::unordered_map<std::string, std::vector<TemplateSegment>> templates_; ///< Parsed templates by their text.
 
 public:
     static const char* TOOLSET_METATABLE;
@@ -34,6 +47,13 @@ public:
     static int prototype( lua_State* lua_state );
     static int create_call_metamethod( lua_State* lua_state );
     static int continue_create_call_metamethod( lua_State* lua_state, int /*status*/, lua_KContext /*context*/ );
+    static int interpolate( lua_State* lua_state );
+
+private:
+    const std::vector<TemplateSegment>& parse( const std::string& text );
+    bool expand( lua_State* lua_state, const std::string& text, int toolset, int variables, int settings, std::string* output );
+    bool substitute( lua_State* lua_state, const std::string& text, const std::string& expression, int toolset, int variables, int settings, std::string* output );
+    static int lookup( lua_State* lua_state );
 };
 
 }
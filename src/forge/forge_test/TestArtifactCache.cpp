@@ -0,0 +1,252 @@
+//
+// TestArtifactCache.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "ErrorChecker.hpp"
+#include <forge/Forge.hpp>
+#include <forge/ArtifactCache.hpp>
+#include <UnitTest++/UnitTest++.h>
+#include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <fstream>
+#include <iterator>
+#include <ctime>
+#include <string>
+
+using std::string;
+using namespace sweet::forge;
+using namespace boost::filesystem;
+
+SUITE( TestArtifactCache )
+{
+    static const char* COPY =
+        "local Copy = TargetPrototype( 'Copy' ); \n"
+        "Copy.cacheable = true; \n"
+        "local source = Target( forge, 'source.txt' ); \n"
+        "source:set_filename( source:path() ); \n"
+        "local copy = Target( forge, 'copy.txt', Copy ); \n"
+        "copy:set_filename( copy:path() ); \n"
+        "copy:add_dependency( source ); \n"
+        "postorder( copy, function(target) \n"
+        "    if target == copy then \n"
+        "        execute( '/bin/cp', ('cp %s %s'):format(source:filename(), copy:filename()) ); \n"
+        "    end \n"
+        "    target:set_built( true ); \n"
+        "end ); \n"
+    ;
+
+    // Concatenate a source file and a header into a target file reporting
+    // the header as read on the dependencies pipe as the build hooks 
+    // library would.
+    static const char* CONCATENATE =
+        "local Concatenate = TargetPrototype( 'Concatenate' ); \n"
+        "Concatenate.cacheable = true; \n"
+        "local source = Target( forge, 'source.txt' ); \n"
+        "source:set_filename( source:path() ); \n"
+        "local header = root( 'header.h' ); \n"
+        "copy = Target( forge, 'copy.txt', Concatenate ); \n"
+        "copy:set_filename( copy:path() ); \n"
+        "copy:add_dependency( source ); \n"
+        "filtered = 0; \n"
+        "postorder( copy, function(target) \n"
+        "    if target == copy then \n"
+        "        local command_line = ('sh %s %s %s %s'):format( root('concatenate.sh'), source:filename(), copy:filename(), header ); \n"
+        "        execute( '/bin/sh', command_line, nil, function(line) \n"
+        "            local filename = line:match( \"^== read '([^']*%.h)'\" ); \n"
+        "            if filename then \n"
+        "                filtered = filtered + 1; \n"
+        "                local header = Target( forge, filename ); \n"
+        "                header:set_filename( filename ); \n"
+        "                copy:add_implicit_dependency( header ); \n"
+        "            end \n"
+        "        end ); \n"
+        "    end \n"
+        "    target:set_built( true ); \n"
+        "end ); \n"
+    ;
+
+    static void write( const path& filename, const char* content )
+    {
+        std::ofstream( filename.string().c_str(), std::ios::binary ) << content;
+    }
+
+    static string read( const path& filename )
+    {
+        std::ifstream file( filename.string().c_str(), std::ios::binary );
+        return string( std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() );
+    }
+
+    static void build( ErrorChecker* checker, const path& root, const path& cache, const string& script, const char* prototype = COPY )
+    {
+        create_directories( root );
+        if ( !exists(root / "source.txt") )
+        {
+            write( root / "source.txt", "source" );
+        }
+        if ( !exists(root / "header.h") )
+        {
+            write( root / "header.h", "header" );
+        }
+        write( root / "concatenate.sh", "echo \"== read '$3'\" >&3\n/bin/cat \"$1\" \"$3\" > \"$2\"\n" );
+        Forge forge( root.string(), *checker, checker );
+        forge.set_root_directory( root.generic_string() );
+        forge.script( "set_artifact_cache('" + cache.generic_string() + "'); \n" + prototype + script );
+    }
+
+    // Count the directories in \e directory.
+    static int directories( const path& directory )
+    {
+        int count = 0;
+        for ( directory_iterator entry(directory); entry != directory_iterator(); ++entry )
+        {
+            count += is_directory( entry->status() ) ? 1 : 0;
+        }
+        return count;
+    }
+
+    // Find the only manifest directory in the artifact cache \e cache.
+    static path manifest_directory( const path& cache )
+    {
+        path manifest;
+        for ( directory_iterator shard(cache); shard != directory_iterator(); ++shard )
+        {
+            if ( shard->path().filename() != "tmp" )
+            {
+                for ( directory_iterator directory(shard->path()); directory != directory_iterator(); ++directory )
+                {
+                    manifest = directory->path();
+                }
+            }
+        }
+        return manifest;
+    }
+
+    // Create an entry of \e size bytes last used at \e time under 
+    // \e manifest in the artifact cache \e cache.
+    static void entry( const path& cache, const char* manifest, const char* entry, size_t size, std::time_t time )
+    {
+        path directory = cache / string( manifest, 2 ) / manifest / entry;
+        create_directories( directory );
+        write( directory / "0", string(size, 'x').c_str() );
+        last_write_time( directory, time );
+    }
+
+    TEST_FIXTURE( ErrorChecker, checkouts_in_different_root_directories_share_entries )
+    {
+#if !defined(BUILD_OS_WINDOWS)
+        path directory = initial_path<path>() / "artifact_cache";
+        remove_all( directory );
+        build( this, directory / "a", directory / "cache",
+            "local _, _, hits, misses = artifact_cache(); \n"
+            "assert( hits == 0 and misses == 1 ); \n"
+        );
+        CHECK( errors == 0 );
+        build( this, directory / "b", directory / "cache",
+            "local _, _, hits, misses = artifact_cache(); \n"
+            "assert( hits == 1 and misses == 0 ); \n"
+        );
+        CHECK( errors == 0 );
+        CHECK( exists(directory / "b" / "copy.txt") );
+        remove_all( directory );
+#endif
+    }
+
+    TEST_FIXTURE( ErrorChecker, editing_an_explicit_input_misses )
+    {
+#if !defined(BUILD_OS_WINDOWS)
+        path directory = initial_path<path>() / "artifact_cache";
+        remove_all( directory );
+        const char* HIT = "local _, _, hits, misses = artifact_cache(); assert( hits == 1 and misses == 0 ); \n";
+        const char* MISS = "local _, _, hits, misses = artifact_cache(); assert( hits == 0 and misses == 1 ); \n";
+        build( this, directory / "a", directory / "cache", MISS, CONCATENATE );
+        build( this, directory / "a", directory / "cache", HIT, CONCATENATE );
+        write( directory / "a" / "source.txt", "edited" );
+        build( this, directory / "a", directory / "cache", MISS, CONCATENATE );
+        CHECK_EQUAL( string("editedheader"), read(directory / "a" / "copy.txt") );
+        build( this, directory / "a", directory / "cache", HIT, CONCATENATE );
+        CHECK( errors == 0 );
+        remove_all( directory );
+#endif
+    }
+
+    TEST_FIXTURE( ErrorChecker, editing_an_implicit_dependency_misses_and_stores_a_second_entry )
+    {
+#if !defined(BUILD_OS_WINDOWS)
+        path directory = initial_path<path>() / "artifact_cache";
+        remove_all( directory );
+        const char* HIT = "local _, _, hits, misses = artifact_cache(); assert( hits == 1 and misses == 0 ); \n";
+        const char* MISS = "local _, _, hits, misses = artifact_cache(); assert( hits == 0 and misses == 1 ); \n";
+        build( this, directory / "a", directory / "cache", MISS, CONCATENATE );
+        path manifest = manifest_directory( directory / "cache" );
+        CHECK_EQUAL( 1, directories(manifest) );
+
+        write( directory / "a" / "header.h", "edited" );
+        build( this, directory / "a", directory / "cache", MISS, CONCATENATE );
+        CHECK_EQUAL( string("sourceedited"), read(directory / "a" / "copy.txt") );
+        CHECK( manifest_directory(directory / "cache") == manifest );
+        CHECK_EQUAL( 2, directories(manifest) );
+        string records = read( manifest / "manifest" );
+        CHECK_EQUAL( string("1\n${root}/header.h\n"), records );
+
+        write( directory / "a" / "header.h", "header" );
+        build( this, directory / "a", directory / "cache", HIT, CONCATENATE );
+        CHECK_EQUAL( string("sourceheader"), read(directory / "a" / "copy.txt") );
+        CHECK( errors == 0 );
+        remove_all( directory );
+#endif
+    }
+
+    TEST_FIXTURE( ErrorChecker, restoring_replays_reported_dependencies )
+    {
+#if !defined(BUILD_OS_WINDOWS)
+        path directory = initial_path<path>() / "artifact_cache";
+        remove_all( directory );
+        const char* IMPLICIT_DEPENDENCY = 
+            "assert( filtered == 1 ); \n"
+            "local header = copy:implicit_dependency( 1 ); \n"
+            "assert( header and header:filename() == root('header.h') ); \n"
+            "assert( copy:implicit_dependency(2) == nil ); \n"
+        ;
+        build( this, directory / "a", directory / "cache", IMPLICIT_DEPENDENCY, CONCATENATE );
+        remove( directory / "a" / "copy.txt" );
+        build( this, directory / "a", directory / "cache", 
+            string("local _, _, hits, misses = artifact_cache(); assert( hits == 1 and misses == 0 ); \n") + IMPLICIT_DEPENDENCY, 
+            CONCATENATE 
+        );
+        CHECK_EQUAL( string("sourceheader"), read(directory / "a" / "copy.txt") );
+        CHECK( errors == 0 );
+        remove_all( directory );
+#endif
+    }
+
+    TEST_FIXTURE( ErrorChecker, trimming_evicts_least_recently_used_entries_and_empty_manifests )
+    {
+        path directory = initial_path<path>() / "artifact_cache";
+        remove_all( directory );
+        path cache = directory / "cache";
+        entry( cache, "aa00000000000000", "0000000000000001", 100, 2000 );
+        entry( cache, "aa00000000000000", "0000000000000002", 100, 3000 );
+        entry( cache, "bb00000000000000", "0000000000000003", 100, 1000 );
+        entry( cache, "cc00000000000000", "0000000000000004", 100, 4000 );
+        create_directories( cache / "tmp" / "partial" );
+
+        Forge forge( directory.string(), *this, this );
+        ArtifactCache* artifact_cache = forge.artifact_cache();
+        artifact_cache->set_directory( cache.generic_string() );
+        artifact_cache->set_maximum_size( 400 );
+        artifact_cache->trim();
+        CHECK( exists(cache / "bb" / "bb00000000000000" / "0000000000000003") );
+
+        artifact_cache->set_maximum_size( 300 );
+        artifact_cache->trim();
+        CHECK( !exists(cache / "bb" / "bb00000000000000") );
+        CHECK( !exists(cache / "aa" / "aa00000000000000" / "0000000000000001") );
+        CHECK( exists(cache / "aa" / "aa00000000000000" / "0000000000000002") );
+        CHECK( exists(cache / "cc" / "cc00000000000000" / "0000000000000004") );
+        CHECK( exists(cache / "tmp" / "partial") );
+        CHECK( errors == 0 );
+        remove_all( directory );
+    }
+}
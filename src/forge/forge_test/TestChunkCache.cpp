@@ -0,0 +1,106 @@
+//
+// TestChunkCache.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "ErrorChecker.hpp"
+#include <forge/Forge.hpp>
+#include <forge/ChunkCache.hpp>
+#include <UnitTest++/UnitTest++.h>
+#include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <lua.hpp>
+#include <fstream>
+#include <string>
+
+using std::string;
+using namespace sweet::forge;
+using namespace boost::filesystem;
+
+SUITE( TestChunkCache )
+{
+    static void write( const path& filename, const char* content )
+    {
+        std::ofstream( filename.string().c_str(), std::ios::binary ) << content;
+    }
+
+    // Load \e filename through \e chunk_cache and return the integer that the
+    // loaded chunk returns or -1 if it couldn't be loaded.
+    static int load( ChunkCache* chunk_cache, lua_State* lua_state, const path& filename )
+    {
+        int result = -1;
+        if ( chunk_cache->load(lua_state, filename.generic_string()) == LUA_OK && lua_pcall(lua_state, 0, 1, 0) == LUA_OK )
+        {
+            result = int( lua_tointeger(lua_state, -1) );
+        }
+        lua_pop( lua_state, 1 );
+        return result;
+    }
+
+    TEST_FIXTURE( ErrorChecker, edited_buildfiles_miss_and_unchanged_buildfiles_load_stored_chunks )
+    {
+        path directory = initial_path<path>() / "chunk_cache";
+        remove_all( directory );
+        create_directories( directory );
+        path buildfile = directory / "buildfile.lua";
+        write( buildfile, "return 1;" );
+
+        Forge forge( directory.string(), *this, this );
+        ChunkCache* chunk_cache = forge.chunk_cache();
+        chunk_cache->set_directory( (directory / "chunks").generic_string() );
+        lua_State* lua_state = forge.lua_state();
+
+        CHECK_EQUAL( 1, load(chunk_cache, lua_state, buildfile) );
+        CHECK_EQUAL( 0, chunk_cache->hits() );
+        CHECK_EQUAL( 1, chunk_cache->misses() );
+
+        CHECK_EQUAL( 1, load(chunk_cache, lua_state, buildfile) );
+        CHECK_EQUAL( 1, chunk_cache->hits() );
+        CHECK_EQUAL( 1, chunk_cache->misses() );
+
+        write( buildfile, "return 2;" );
+        CHECK_EQUAL( 2, load(chunk_cache, lua_state, buildfile) );
+        CHECK_EQUAL( 1, chunk_cache->hits() );
+        CHECK_EQUAL( 2, chunk_cache->misses() );
+
+        CHECK_EQUAL( 2, load(chunk_cache, lua_state, buildfile) );
+        CHECK_EQUAL( 2, chunk_cache->hits() );
+        CHECK_EQUAL( 2, chunk_cache->misses() );
+        CHECK( errors == 0 );
+        remove_all( directory );
+    }
+
+    TEST_FIXTURE( ErrorChecker, trimming_removes_the_least_recently_used_chunks )
+    {
+        path directory = initial_path<path>() / "chunk_cache";
+        remove_all( directory );
+        create_directories( directory );
+        path old_buildfile = directory / "old.lua";
+        path new_buildfile = directory / "new.lua";
+        write( old_buildfile, "return 1;" );
+        write( new_buildfile, "return 2;" );
+
+        Forge forge( directory.string(), *this, this );
+        ChunkCache* chunk_cache = forge.chunk_cache();
+        path chunks = directory / "chunks";
+        chunk_cache->set_directory( chunks.generic_string() );
+        lua_State* lua_state = forge.lua_state();
+        CHECK_EQUAL( 1, load(chunk_cache, lua_state, old_buildfile) );
+        CHECK_EQUAL( 2, load(chunk_cache, lua_state, new_buildfile) );
+        for ( directory_iterator chunk(chunks); chunk != directory_iterator(); ++chunk )
+        {
+            last_write_time( chunk->path(), 1 );
+        }
+        CHECK_EQUAL( 2, load(chunk_cache, lua_state, new_buildfile) );
+        CHECK_EQUAL( 1, chunk_cache->hits() );
+
+        chunk_cache->trim( 1 );
+        CHECK_EQUAL( 1, load(chunk_cache, lua_state, old_buildfile) );
+        CHECK_EQUAL( 2, load(chunk_cache, lua_state, new_buildfile) );
+        CHECK_EQUAL( 2, chunk_cache->hits() );
+        CHECK_EQUAL( 3, chunk_cache->misses() );
+        CHECK( errors == 0 );
+        remove_all( directory );
+    }
+}
@@ -94,4 +94,123 @@ SUITE( TestGraph )
         test( script );
         CHECK( errors == 0 );
     }
+
+    TEST_FIXTURE( ErrorChecker, dependencies_keep_insertion_order_and_are_unique )
+    {
+        const char* script =
+            "local foo_obj = Target( forge, 'foo.obj' ); \n"
+            "local headers = {}; \n"
+            "for i = 1, 64 do \n"
+            "    local header = Target( forge, ('foo%d.hpp'):format(i) ); \n"
+            "    foo_obj:add_implicit_dependency( header ); \n"
+            "    foo_obj:add_implicit_dependency( header ); \n"
+            "    table.insert( headers, header ); \n"
+            "end \n"
+            "foo_obj:add_dependency( headers[1] ); \n"
+            "foo_obj:add_implicit_dependency( headers[1] ); \n"
+            "foo_obj:remove_dependency( headers[2] ); \n"
+            "assert( foo_obj:dependency(1) == headers[1] ); \n"
+            "local count = 0; \n"
+            "for index, header in foo_obj:implicit_dependencies() do \n"
+            "    assert( header == headers[index + 2] ); \n"
+            "    count = index; \n"
+            "end \n"
+            "assert( count == 62 ); \n"
+        ;
+        test( script );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, targets_added_and_found_by_equivalent_paths_are_the_same )
+    {
+        const char* script =
+            "local foo_cpp = Target( forge, 'foo.cpp' ); \n"
+            "assert( Target(forge, './foo.cpp') == foo_cpp ); \n"
+            "assert( Target(forge, 'bar/../foo.cpp') == foo_cpp ); \n"
+            "assert( Target(forge, foo_cpp:path()) == foo_cpp ); \n"
+            "assert( find_target('foo.cpp') == foo_cpp ); \n"
+            "assert( find_target(foo_cpp:path()) == foo_cpp ); \n"
+            "assert( find_target('baz/foo.cpp') == nil ); \n"
+        ;
+        test( script );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, targets_affected_by_changed_files_are_found_through_dependents )
+    {
+        const char* script =
+            "local foo_hpp = Target( forge, 'foo.hpp' ); \n"
+            "local foo_cpp = Target( forge, 'foo.cpp' ); \n"
+            "local foo_obj = Target( forge, 'foo.obj' ); \n"
+            "local bar_obj = Target( forge, 'bar.obj' ); \n"
+            "foo_obj:add_dependency( foo_cpp ); \n"
+            "foo_obj:add_implicit_dependency( foo_hpp ); \n"
+            "bar_obj:add_ordering_dependency( foo_obj ); \n"
+            "local affected = affected_targets( {'foo.hpp'} ); \n"
+            "assert( #affected == 3 ); \n"
+            "assert( affected[1] == foo_hpp ); \n"
+            "assert( affected[2] == foo_obj ); \n"
+            "assert( affected[3] == bar_obj ); \n"
+            "bar_obj:remove_dependency( foo_obj ); \n"
+            "assert( #affected_targets('foo.cpp') == 2 ); \n"
+            "for _, dependent in foo_obj:dependents() do \n"
+            "    assert( false ); \n"
+            "end \n"
+        ;
+        test( script );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, targets_and_implicit_dependencies_are_saved_and_loaded )
+    {
+        const char* script =
+            "rm( 'forge_test_graph.forge' ); \n"
+            "assert( load_binary('forge_test_graph.forge') == nil ); \n"
+            "local foo_hpp = Target( forge, 'foo.hpp' ); \n"
+            "local foo_obj = Target( forge, 'foo.obj' ); \n"
+            "foo_obj:add_filename( foo_obj:path() ); \n"
+            "foo_obj:add_implicit_dependency( foo_hpp ); \n"
+            "foo_obj:set_built( true ); \n"
+            "save_binary(); \n"
+            "clear(); \n"
+            "load_binary( 'forge_test_graph.forge' ); \n"
+            "foo_hpp = find_target( 'foo.hpp' ); \n"
+            "foo_obj = find_target( 'foo.obj' ); \n"
+            "assert( foo_obj:implicit_dependency(1) == foo_hpp ); \n"
+            "assert( foo_obj:filename(1) == foo_obj:path() ); \n"
+            "assert( foo_obj:built() ); \n"
+            "for _, dependent in foo_hpp:dependents() do \n"
+            "    assert( dependent == foo_obj ); \n"
+            "end \n"
+            "rm( 'forge_test_graph.forge' ); \n"
+        ;
+        test( script );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, targets_built_after_the_last_save_are_replayed_from_the_journal )
+    {
+        const char* script =
+            "rm( 'forge_test_journal.forge' ); \n"
+            "rm( 'forge_test_journal.forge.journal' ); \n"
+            "load_binary( 'forge_test_journal.forge' ); \n"
+            "local foo_hpp = Target( forge, 'foo.hpp' ); \n"
+            "local foo_obj = Target( forge, 'foo.obj' ); \n"
+            "save_binary(); \n"
+            "postorder( foo_obj, function(target) \n"
+            "    target:add_implicit_dependency( foo_hpp ); \n"
+            "    target:set_built( true ); \n"
+            "end ); \n"
+            "assert( exists('forge_test_journal.forge.journal') ); \n"
+            "load_binary( 'forge_test_journal.forge' ); \n"
+            "foo_obj = find_target( 'foo.obj' ); \n"
+            "assert( foo_obj:built() ); \n"
+            "assert( foo_obj:implicit_dependency(1) == find_target('foo.hpp') ); \n"
+            "save_binary(); \n"
+            "assert( not exists('forge_test_journal.forge.journal') ); \n"
+            "rm( 'forge_test_journal.forge' ); \n"
+        ;
+        test( script );
+        CHECK( errors == 0 );
+    }
 }
@@ -0,0 +1,132 @@
+//
+// TestGraphEvaluation.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "ErrorChecker.hpp"
+#include <forge/Forge.hpp>
+#include <UnitTest++/UnitTest++.h>
+#include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <lua.hpp>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+using namespace sweet::forge;
+using namespace boost::filesystem;
+
+SUITE( TestGraphEvaluation )
+{
+    static void write( const path& filename, const char* content, std::time_t timestamp )
+    {
+        std::ofstream( filename.string().c_str(), std::ios::binary ) << content;
+        last_write_time( filename, timestamp );
+    }
+
+    // Write a buildfile, local settings, and a directory of source files
+    // into \e directory that evaluating the buildfile depends on.
+    static void setup( const path& directory )
+    {
+        remove_all( directory );
+        create_directories( directory / "sources" );
+        write( directory / "build.lua", "local sources = glob( root('sources'), '*.c' ); \n", 1 );
+        write( directory / "local_settings.lua", "return {};", 1 );
+        write( directory / "sources" / "a.c", "", 1 );
+        last_write_time( directory / "sources", 1 );
+    }
+
+    // Load the dependency graph in \e directory, restore evaluated buildfiles
+    // or evaluate the buildfile and save a snapshot, and return true if
+    // evaluated buildfiles were restored.
+    static bool evaluate( ErrorChecker* checker, const path& directory, const vector<string>& assignments )
+    {
+        Forge forge( directory.string(), *checker, checker );
+        forge.set_root_directory( directory.generic_string() );
+        forge.assign_global_variables( assignments );
+        forge.script(
+            "load_binary( root('.forge') ); \n"
+            "restored = restore_evaluation(); \n"
+            "if not restored then \n"
+            "    buildfile( root('build.lua') ); \n"
+            "    save_evaluation(); \n"
+            "end \n"
+        );
+        lua_State* lua_state = forge.lua_state();
+        lua_getglobal( lua_state, "restored" );
+        bool restored = lua_toboolean( lua_state, -1 ) != 0;
+        lua_pop( lua_state, 1 );
+        return restored;
+    }
+
+    TEST_FIXTURE( ErrorChecker, unchanged_inputs_restore_evaluated_buildfiles )
+    {
+        path directory = initial_path<path>() / "graph_evaluation";
+        setup( directory );
+        vector<string> assignments( 1, "variant=debug" );
+        CHECK( !evaluate(this, directory, assignments) );
+        CHECK( evaluate(this, directory, assignments) );
+        assignments.push_back( "goal=sources" );
+        CHECK( evaluate(this, directory, assignments) );
+        CHECK( errors == 0 );
+        remove_all( directory );
+    }
+
+    TEST_FIXTURE( ErrorChecker, changed_buildfile_rejects_evaluated_buildfiles )
+    {
+        path directory = initial_path<path>() / "graph_evaluation";
+        setup( directory );
+        vector<string> assignments;
+        CHECK( !evaluate(this, directory, assignments) );
+        write( directory / "build.lua", "local sources = glob( root('sources'), '*.cpp' ); \n", 2 );
+        CHECK( !evaluate(this, directory, assignments) );
+        CHECK( evaluate(this, directory, assignments) );
+        CHECK( errors == 0 );
+        remove_all( directory );
+    }
+
+    TEST_FIXTURE( ErrorChecker, changed_local_settings_rejects_evaluated_buildfiles )
+    {
+        path directory = initial_path<path>() / "graph_evaluation";
+        setup( directory );
+        vector<string> assignments;
+        CHECK( !evaluate(this, directory, assignments) );
+        write( directory / "local_settings.lua", "return { variant = 'release' };", 2 );
+        CHECK( !evaluate(this, directory, assignments) );
+        remove( directory / "local_settings.lua" );
+        CHECK( !evaluate(this, directory, assignments) );
+        CHECK( errors == 0 );
+        remove_all( directory );
+    }
+
+    TEST_FIXTURE( ErrorChecker, changed_globbed_directory_rejects_evaluated_buildfiles )
+    {
+        path directory = initial_path<path>() / "graph_evaluation";
+        setup( directory );
+        vector<string> assignments;
+        CHECK( !evaluate(this, directory, assignments) );
+        write( directory / "sources" / "b.c", "", 2 );
+        last_write_time( directory / "sources", 2 );
+        CHECK( !evaluate(this, directory, assignments) );
+        CHECK( evaluate(this, directory, assignments) );
+        CHECK( errors == 0 );
+        remove_all( directory );
+    }
+
+    TEST_FIXTURE( ErrorChecker, changed_assignment_rejects_evaluated_buildfiles )
+    {
+        path directory = initial_path<path>() / "graph_evaluation";
+        setup( directory );
+        vector<string> assignments( 1, "variant=debug" );
+        CHECK( !evaluate(this, directory, assignments) );
+        assignments[0] = "variant=release";
+        CHECK( !evaluate(this, directory, assignments) );
+        assignments.clear();
+        CHECK( !evaluate(this, directory, assignments) );
+        CHECK( errors == 0 );
+        remove_all( directory );
+    }
+}
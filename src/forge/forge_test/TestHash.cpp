@@ -0,0 +1,96 @@
+//
+// TestHash.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "ErrorChecker.hpp"
+#include <forge/Forge.hpp>
+#include <UnitTest++/UnitTest++.h>
+
+using namespace sweet::forge;
+
+SUITE( TestHash )
+{
+    TEST_FIXTURE( ErrorChecker, hash_does_not_depend_on_field_order )
+    {
+        const char* script =
+            "local a = { foo = 'foo'; bar = 1; baz = true; }; \n"
+            "local b = {}; \n"
+            "b.baz = true; \n"
+            "b.bar = 1; \n"
+            "b.foo = 'foo'; \n"
+            "assert( hash(a) == hash(b) ); \n"
+        ;
+        test( script );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, hash_depends_on_array_order_and_types )
+    {
+        const char* script =
+            "assert( hash({defines = {'A', 'B'}}) ~= hash({defines = {'B', 'A'}}) ); \n"
+            "assert( hash({level = 1}) ~= hash({level = '1'}) ); \n"
+            "assert( hash({debug = true}) ~= hash({debug = false}) ); \n"
+        ;
+        test( script );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, identical_nested_tables_do_not_cancel )
+    {
+        const char* script =
+            "local a = { include_directories = {'include'}; library_directories = {'include'}; }; \n"
+            "local b = { include_directories = {'include'}; defines = {'include'}; }; \n"
+            "assert( hash(a) ~= hash({}) ); \n"
+            "assert( hash(a) ~= hash(b) ); \n"
+        ;
+        test( script );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, hash_includes_inherited_fields_and_ends_cycles )
+    {
+        const char* script =
+            "local parent = { optimization = true; }; \n"
+            "local child = setmetatable( {debug = true}, {__index = parent} ); \n"
+            "assert( hash(child) ~= hash({debug = true}) ); \n"
+            "local cyclic = { name = 'cyclic' }; \n"
+            "cyclic.self = cyclic; \n"
+            "assert( math.type(hash(cyclic)) == 'integer' ); \n"
+        ;
+        test( script );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, hash_is_stable )
+    {
+        const char* script =
+            "local settings = { a = 1; b = 'x'; c = {1, 2, 'three'}; d = 1.5; e = true; }; \n"
+            "assert( ('%x'):format(hash(settings)) == 'fc9aa3119db32344' ); \n"
+        ;
+        test( script );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, equal_tables_hash_equal )
+    {
+        const char* script =
+            "local function settings() \n"
+            "    return { debug = true; level = 3; name = 'gcc'; defines = {'A', 'B=1'}; gcc = { cc = 'gcc'; flags = {'-O2'}; }; }; \n"
+            "end \n"
+            "local a = settings(); \n"
+            "local b = settings(); \n"
+            "assert( a ~= b ); \n"
+            "assert( hash(a) == hash(b) ); \n"
+            "assert( hash(a) == hash(a) ); \n"
+            "assert( hash(settings()) == hash(a) ); \n"
+            "local c = settings(); \n"
+            "c.gcc.flags[1] = '-O3'; \n"
+            "assert( hash(c) ~= hash(a) ); \n"
+            "assert( hash({}) == hash({}) ); \n"
+        ;
+        test( script );
+        CHECK( errors == 0 );
+    }
+}
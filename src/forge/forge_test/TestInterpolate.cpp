@@ -0,0 +1,102 @@
+//
+// TestInterpolate.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "ErrorChecker.hpp"
+#include <forge/Forge.hpp>
+#include <UnitTest++/UnitTest++.h>
+#include <string>
+
+using namespace sweet::forge;
+
+SUITE( TestInterpolate )
+{
+    static const char* TOOLSET =
+        "local toolset = { \n"
+        "    settings = { \n"
+        "        architecture = 'x86_64'; \n"
+        "        lib_x86_64 = 'lib64'; \n"
+        "        directories = { bin = 'out/bin' }; \n"
+        "        join = function( toolset, ... ) \n"
+        "            assert( toolset.settings.architecture == 'x86_64' ); \n"
+        "            return table.concat( {...}, '-' ); \n"
+        "        end; \n"
+        "        fail = function() error( 'failed', 0 ); end; \n"
+        "        flag = true; \n"
+        "    }; \n"
+        "}; \n"
+        "local interpolate = Toolset.interpolate; \n"
+    ;
+
+    TEST_FIXTURE( ErrorChecker, templates_without_substitutions_are_returned_as_is )
+    {
+        std::string script = std::string(TOOLSET) +
+            "assert( interpolate(toolset, 'foo/bar.o') == 'foo/bar.o' ); \n"
+            "assert( interpolate(toolset, '$foo {bar} $') == '$foo {bar} $' ); \n"
+        ;
+        test( script.c_str() );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, nested_substitutions_are_replaced_first )
+    {
+        std::string script = std::string(TOOLSET) +
+            "assert( interpolate(toolset, '${architecture}/bar.o') == 'x86_64/bar.o' ); \n"
+            "assert( interpolate(toolset, '${lib_${architecture}}/libfoo.a') == 'lib64/libfoo.a' ); \n"
+            "assert( interpolate(toolset, '${architecture}', {architecture = 'arm64'}) == 'arm64' ); \n"
+        ;
+        test( script.c_str() );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, function_substitutes_are_called_with_the_toolset_and_arguments )
+    {
+        std::string script = std::string(TOOLSET) +
+            "assert( interpolate(toolset, '${join foo bar baz}.o') == 'foo-bar-baz.o' ); \n"
+            "assert( interpolate(toolset, '${join ${architecture}}') == 'x86_64' ); \n"
+        ;
+        test( script.c_str() );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, table_substitutes_are_indexed_by_their_argument )
+    {
+        std::string script = std::string(TOOLSET) +
+            "assert( interpolate(toolset, '${directories bin}/foo') == 'out/bin/foo' ); \n"
+            "local success, message = pcall( interpolate, toolset, '${directories lib}' ); \n"
+            "assert( not success and message:find('Missing substitute for \"directories\"', 1, true) ); \n"
+        ;
+        test( script.c_str() );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, environment_variables_are_substituted_last )
+    {
+        std::string script = std::string(TOOLSET) +
+            "local path = os.getenv( 'PATH' ); \n"
+            "assert( path ); \n"
+            "assert( interpolate(toolset, '${PATH}') == path ); \n"
+            "assert( interpolate(toolset, '${PATH}', {PATH = 'bin'}) == 'bin' ); \n"
+        ;
+        test( script.c_str() );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, missing_and_invalid_substitutes_are_errors )
+    {
+        std::string script = std::string(TOOLSET) +
+            "local success, message = pcall( interpolate, toolset, 'a ${missing_substitute} b' ); \n"
+            "assert( not success ); \n"
+            "assert( message:find('Missing substitute for \"missing_substitute\" in \"a ${missing_substitute} b\"', 1, true) ); \n"
+            "local success, message = pcall( interpolate, toolset, '${flag}' ); \n"
+            "assert( not success and message:find('invalid replacement value (a boolean)', 1, true) ); \n"
+            "local success, message = pcall( interpolate, toolset, '${lib_${fail}}' ); \n"
+            "assert( not success and message == 'failed' ); \n"
+            "assert( interpolate(toolset, '${lib_${architecture}}') == 'lib64' ); \n"
+        ;
+        test( script.c_str() );
+        CHECK( errors == 0 );
+    }
+}
@@ -0,0 +1,48 @@
+//
+// TestMemory.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "ErrorChecker.hpp"
+#include <forge/Forge.hpp>
+#include <UnitTest++/UnitTest++.h>
+
+using namespace sweet::forge;
+
+SUITE( TestMemory )
+{
+    TEST_FIXTURE( ErrorChecker, memory_statistics_count_allocations )
+    {
+        const char* script =
+            "local before = memory_statistics(); \n"
+            "local values = {}; \n"
+            "for i = 1, 1000 do values[i] = { ('value_%d'):format(i) }; end \n"
+            "local after = memory_statistics(); \n"
+            "assert( after.allocations > before.allocations + 1000 ); \n"
+            "assert( after.live > before.live ); \n"
+            "assert( after.peak >= after.live ); \n"
+            "assert( after.pooled > 0 ); \n"
+            "assert( #after.size_classes > 0 ); \n"
+            "assert( after.size_classes[1].size == 16 ); \n"
+            "assert( after.size_classes[1].live <= after.size_classes[1].allocations ); \n"
+            "assert( after.large.live <= after.large.allocations ); \n"
+        ;
+        test( script );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, gc_mode_switches_between_incremental_and_generational )
+    {
+        const char* script =
+            "assert( gc_mode() == 'incremental' ); \n"
+            "assert( set_gc_mode('generational') == 'incremental' ); \n"
+            "assert( gc_mode() == 'generational' ); \n"
+            "collectgarbage(); \n"
+            "assert( set_gc_mode('incremental') == 'generational' ); \n"
+            "assert( not pcall(set_gc_mode, 'unknown') ); \n"
+        ;
+        test( script );
+        CHECK( errors == 0 );
+    }
+}
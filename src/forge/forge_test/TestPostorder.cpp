@@ -69,4 +69,25 @@ SUITE( TestPostorder )
         }
         CHECK( errors == 2 );
     }
+
+    TEST_FIXTURE( ErrorChecker, cyclic_dependency_is_reported_and_handled )
+    {
+        const char* script = 
+            "local Cycle = TargetPrototype( 'Cycle' ); \n"
+            "local a = Target( forge, 'a', Cycle ); \n"
+            "local b = Target( forge, 'b', Cycle ); \n"
+            "local c = Target( forge, 'c', Cycle ); \n"
+            "a:add_dependency( b ); \n"
+            "b:add_dependency( c ); \n"
+            "c:add_dependency( a ); \n"
+            "postorder( a, function(target) end ); \n"
+        ;
+        test( script );
+        if ( messages.size() == 1 )
+        {
+            CHECK( messages[0].find("Cyclic dependency from Cycle '") == 0 );
+            CHECK( messages[0].find("in bind") != std::string::npos );
+        }
+        CHECK( errors == 1 );
+    }
 }
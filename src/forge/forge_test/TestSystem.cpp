@@ -0,0 +1,347 @@
+//
+// TestSystem.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "FileChecker.hpp"
+#include <forge/System.hpp>
+#include <UnitTest++/UnitTest++.h>
+#include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#if defined(BUILD_OS_LINUX)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+using std::string;
+using std::vector;
+using namespace sweet::forge;
+
+static string absolute( const char* filename )
+{
+    return (boost::filesystem::initial_path<boost::filesystem::path>() / filename).generic_string();
+}
+
+static void write( const boost::filesystem::path& filename, const char* content = "" )
+{
+    boost::filesystem::create_directories( filename.parent_path() );
+    std::ofstream( filename.string().c_str(), std::ios::binary ) << content;
+}
+
+static string read( const boost::filesystem::path& filename )
+{
+    std::ifstream file( filename.string().c_str(), std::ios::binary );
+    return string( std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() );
+}
+
+// Can files in \e directory be reflinked?
+static bool reflinks_supported( const boost::filesystem::path& directory )
+{
+    bool supported = false;
+#if defined(BUILD_OS_LINUX) && defined(FICLONE)
+    write( directory / "reflink_from", "reflink" );
+    int from = ::open( (directory / "reflink_from").string().c_str(), O_RDONLY );
+    int to = ::open( (directory / "reflink_to").string().c_str(), O_WRONLY | O_CREAT, 0644 );
+    supported = from >= 0 && to >= 0 && ::ioctl( to, FICLONE, from ) == 0;
+    ::close( from );
+    ::close( to );
+    boost::filesystem::remove( directory / "reflink_from" );
+    boost::filesystem::remove( directory / "reflink_to" );
+#elif defined(BUILD_OS_MACOS)
+    supported = true;
+#endif
+    return supported;
+}
+
+SUITE( TestSystem )
+{
+    TEST_FIXTURE( FileChecker, cached_status_is_invalidated_by_touch )
+    {
+        create( "system_touch.txt", "", 1 );
+        System system;
+        string path = absolute( "system_touch.txt" );
+        int64_t last_write_time = system.last_write_time( path );
+        CHECK_EQUAL( 1000000000LL, last_write_time );
+        system.touch( path );
+        CHECK( system.last_write_time(path) > last_write_time );
+    }
+
+    TEST_FIXTURE( FileChecker, cached_status_is_invalidated_by_rm )
+    {
+        create( "system_rm.txt", "" );
+        System system;
+        string path = absolute( "system_rm.txt" );
+        CHECK( system.exists(path) );
+        CHECK( system.is_file(path) );
+        system.rm( path );
+        CHECK( !system.exists(path) );
+        CHECK( !system.is_file(path) );
+    }
+
+    TEST_FIXTURE( FileChecker, cached_status_is_invalidated_by_cp )
+    {
+        create( "system_cp_from.txt", "content", 1 );
+        remove( "system_cp_to.txt" );
+        files_.push_back( "system_cp_to.txt" );
+        System system;
+        string from = absolute( "system_cp_from.txt" );
+        string to = absolute( "system_cp_to.txt" );
+        string missing = absolute( "system_cp_missing.txt" );
+        CHECK( !system.exists(to) );
+        CHECK( !system.exists(missing) );
+        system.cp( from, to );
+        CHECK( system.exists(to) );
+        CHECK( system.is_file(to) );
+        CHECK( system.last_write_time(to) != 0 );
+        CHECK( !system.exists(missing) );
+    }
+
+    TEST_FIXTURE( FileChecker, cached_status_is_not_invalidated_by_other_writes )
+    {
+        remove( "system_invalidate.txt" );
+        System system;
+        string path = absolute( "system_invalidate.txt" );
+        CHECK( !system.exists(path) );
+        create( "system_invalidate.txt", "" );
+        CHECK( !system.exists(path) );
+        system.invalidate( path );
+        CHECK( system.exists(path) );
+    }
+
+    TEST( glob_match_matches_wildcards_within_path_segments )
+    {
+        CHECK( System::glob_match("*.c", "a.c") );
+        CHECK( System::glob_match("*.c", ".c") );
+        CHECK( !System::glob_match("*.c", "a/b.c") );
+        CHECK( !System::glob_match("*.c", "a.cpp") );
+        CHECK( System::glob_match("a/*/c.h", "a/b/c.h") );
+        CHECK( !System::glob_match("a/*/c.h", "a/b/d/c.h") );
+        CHECK( System::glob_match("?.c", "a.c") );
+        CHECK( !System::glob_match("?.c", "ab.c") );
+        CHECK( !System::glob_match("a?b", "a/b") );
+        CHECK( System::glob_match("", "") );
+        CHECK( !System::glob_match("", "a") );
+    }
+
+    TEST( glob_match_matches_character_sets_and_ranges )
+    {
+        CHECK( System::glob_match("[abc].c", "b.c") );
+        CHECK( !System::glob_match("[abc].c", "d.c") );
+        CHECK( System::glob_match("[a-z].c", "q.c") );
+        CHECK( !System::glob_match("[a-z].c", "Q.c") );
+        CHECK( System::glob_match("[!a-z].c", "Q.c") );
+        CHECK( !System::glob_match("[!a-z].c", "q.c") );
+        CHECK( System::glob_match("[^0-9]", "x") );
+        CHECK( !System::glob_match("[^0-9]", "5") );
+        CHECK( !System::glob_match("a[!x]b", "a/b") );
+        CHECK( System::glob_match("[a-]", "-") );
+        CHECK( !System::glob_match("[abc", "a") );
+        CHECK( System::glob_match("[abc", "[abc") );
+    }
+
+    TEST( glob_match_matches_any_number_of_directories )
+    {
+        CHECK( System::glob_match("**/x.c", "x.c") );
+        CHECK( System::glob_match("**/x.c", "a/x.c") );
+        CHECK( System::glob_match("**/x.c", "a/b/x.c") );
+        CHECK( !System::glob_match("**/x.c", "ax.c") );
+        CHECK( System::glob_match("src/**/x.c", "src/x.c") );
+        CHECK( System::glob_match("src/**/x.c", "src/a/b/x.c") );
+        CHECK( !System::glob_match("src/**/x.c", "srcx.c") );
+        CHECK( System::glob_match("src/**", "src") );
+        CHECK( System::glob_match("src/**", "src/a") );
+        CHECK( System::glob_match("src/**", "src/a/b.c") );
+        CHECK( !System::glob_match("src/**", "srcs") );
+        CHECK( !System::glob_match("src/**", "other/src") );
+        CHECK( System::glob_match("**", "a/b/c") );
+        CHECK( System::glob_match("a**c", "ab/c") );
+    }
+
+    TEST( glob_finds_sorted_absolute_paths_of_matching_files )
+    {
+        boost::filesystem::path directory = boost::filesystem::initial_path<boost::filesystem::path>() / "system_glob";
+        boost::filesystem::remove_all( directory );
+        write( directory / "b.c" );
+        write( directory / "a.c" );
+        write( directory / "a.h" );
+        write( directory / "src" / "c.c" );
+        write( directory / "src" / "deep" / "d.c" );
+        write( directory / "build" / "e.c" );
+        write( directory / "build" / "nested" / "f.c" );
+        string root = directory.generic_string();
+
+        System system;
+        vector<string> matches;
+        system.glob( root, vector<string>(1, "*.c"), vector<string>(), &matches );
+        CHECK_EQUAL( 6u, matches.size() );
+        if ( matches.size() == 6 )
+        {
+            CHECK_EQUAL( root + "/a.c", matches[0] );
+            CHECK_EQUAL( root + "/b.c", matches[1] );
+            CHECK_EQUAL( root + "/build/e.c", matches[2] );
+            CHECK_EQUAL( root + "/build/nested/f.c", matches[3] );
+            CHECK_EQUAL( root + "/src/c.c", matches[4] );
+            CHECK_EQUAL( root + "/src/deep/d.c", matches[5] );
+        }
+
+        // Patterns with a slash match the relative path and excluded 
+        // directories aren't walked.
+        System pruning;
+        matches.clear();
+        pruning.glob( root + "/", vector<string>(1, "src/**/*.c"), vector<string>(1, "build"), &matches );
+        CHECK_EQUAL( 2u, matches.size() );
+        if ( matches.size() == 2 )
+        {
+            CHECK_EQUAL( root + "/src/c.c", matches[0] );
+            CHECK_EQUAL( root + "/src/deep/d.c", matches[1] );
+        }
+        vector<std::pair<string, int64_t>> directories;
+        pruning.globbed_directories( &directories );
+        for ( vector<std::pair<string, int64_t>>::const_iterator i = directories.begin(); i != directories.end(); ++i )
+        {
+            CHECK( i->first.find("/build") == string::npos );
+        }
+        CHECK_EQUAL( 3u, directories.size() );
+
+        // Excluded files aren't matched and no includes match everything.
+        matches.clear();
+        vector<string> excludes;
+        excludes.push_back( "*.c" );
+        excludes.push_back( "src/deep" );
+        system.glob( root, vector<string>(), excludes, &matches );
+        CHECK_EQUAL( 1u, matches.size() );
+        CHECK( matches.size() == 1 && matches[0] == root + "/a.h" );
+
+        // Missing directories match nothing.
+        matches.clear();
+        system.glob( root + "/missing", vector<string>(), vector<string>(), &matches );
+        CHECK( matches.empty() );
+        boost::filesystem::remove_all( directory );
+    }
+
+    TEST( glob_reads_directories_again_once_they_change )
+    {
+        boost::filesystem::path directory = boost::filesystem::initial_path<boost::filesystem::path>() / "system_glob";
+        boost::filesystem::remove_all( directory );
+        write( directory / "a.c" );
+        boost::filesystem::last_write_time( directory, 1000 );
+        string root = directory.generic_string();
+
+        System system;
+        vector<string> matches;
+        system.glob( root, vector<string>(), vector<string>(), &matches );
+        CHECK_EQUAL( 1u, matches.size() );
+
+        // Directories are stat'd each time they're globbed and their cached
+        // entries used while their last write time is unchanged.
+        write( directory / "b.c" );
+        boost::filesystem::last_write_time( directory, 1000 );
+        matches.clear();
+        system.glob( root, vector<string>(), vector<string>(), &matches );
+        CHECK_EQUAL( 1u, matches.size() );
+
+        boost::filesystem::last_write_time( directory, 2000 );
+        matches.clear();
+        system.glob( root, vector<string>(), vector<string>(), &matches );
+        CHECK_EQUAL( 2u, matches.size() );
+        CHECK( matches.size() == 2 && matches[1] == root + "/b.c" );
+        boost::filesystem::remove_all( directory );
+    }
+
+    TEST( cp_replaces_the_destination_and_keeps_permissions )
+    {
+        boost::filesystem::path directory = boost::filesystem::initial_path<boost::filesystem::path>() / "system_cp";
+        boost::filesystem::remove_all( directory );
+        write( directory / "from.sh", "new" );
+        write( directory / "to.sh", "old content" );
+#if !defined(BUILD_OS_WINDOWS)
+        boost::filesystem::permissions( directory / "from.sh", boost::filesystem::owner_all | boost::filesystem::group_read | boost::filesystem::group_exe );
+        boost::filesystem::permissions( directory / "to.sh", boost::filesystem::owner_read | boost::filesystem::owner_write );
+#endif
+
+        System system;
+        system.cp( (directory / "from.sh").string(), (directory / "to.sh").string() );
+        CHECK_EQUAL( string("new"), read(directory / "to.sh") );
+        CHECK( !boost::filesystem::equivalent(directory / "from.sh", directory / "to.sh") );
+#if !defined(BUILD_OS_WINDOWS)
+        boost::filesystem::perms permissions = boost::filesystem::status( directory / "to.sh" ).permissions() & boost::filesystem::all_all;
+        CHECK_EQUAL( int(boost::filesystem::owner_all | boost::filesystem::group_read | boost::filesystem::group_exe), int(permissions) );
+#endif
+        boost::filesystem::remove_all( directory );
+    }
+
+    TEST( cp_links_when_asked_and_a_reflink_is_not_possible )
+    {
+        boost::filesystem::path directory = boost::filesystem::initial_path<boost::filesystem::path>() / "system_cp";
+        boost::filesystem::remove_all( directory );
+        write( directory / "from.txt", "content" );
+        write( directory / "to.txt", "old content" );
+        bool reflinks = reflinks_supported( directory );
+
+        System system;
+        system.cp( (directory / "from.txt").string(), (directory / "to.txt").string(), true );
+        CHECK_EQUAL( string("content"), read(directory / "to.txt") );
+        CHECK( reflinks != boost::filesystem::equivalent(directory / "from.txt", directory / "to.txt") );
+
+        // Copies that aren't links never share the original's contents.
+        system.cp( (directory / "from.txt").string(), (directory / "copy.txt").string() );
+        CHECK( !boost::filesystem::equivalent(directory / "from.txt", directory / "copy.txt") );
+        write( directory / "copy.txt", "changed" );
+        CHECK_EQUAL( string("content"), read(directory / "from.txt") );
+        boost::filesystem::remove_all( directory );
+    }
+
+    TEST( cpdir_copies_nested_directories )
+    {
+        boost::filesystem::path directory = boost::filesystem::initial_path<boost::filesystem::path>() / "system_cpdir";
+        boost::filesystem::remove_all( directory );
+        write( directory / "from" / "a.txt", "a" );
+        write( directory / "from" / "sub" / "b.txt", "b" );
+        write( directory / "from" / "sub" / "deeper" / "c.txt", "c" );
+        boost::filesystem::create_directories( directory / "from" / "empty" );
+        write( directory / "to" / "a.txt", "old" );
+
+        System system;
+        string from = (directory / "from").generic_string();
+        string to = (directory / "to").generic_string();
+        CHECK_EQUAL( 3, system.cpdir(from, to) );
+        CHECK_EQUAL( string("a"), read(directory / "to" / "a.txt") );
+        CHECK_EQUAL( string("b"), read(directory / "to" / "sub" / "b.txt") );
+        CHECK_EQUAL( string("c"), read(directory / "to" / "sub" / "deeper" / "c.txt") );
+        CHECK( boost::filesystem::is_directory(directory / "to" / "empty") );
+        CHECK( system.is_file(to + "/sub/deeper/c.txt") );
+
+        // A trailing slash on the source directory copies the same tree.
+        CHECK_EQUAL( 3, system.cpdir(from + "/", (directory / "again").generic_string()) );
+        CHECK_EQUAL( string("c"), read(directory / "again" / "sub" / "deeper" / "c.txt") );
+        boost::filesystem::remove_all( directory );
+    }
+
+    TEST( cp_rethrows_exceptions_thrown_copying_in_parallel )
+    {
+        boost::filesystem::path directory = boost::filesystem::initial_path<boost::filesystem::path>() / "system_cp";
+        boost::filesystem::remove_all( directory );
+        vector<std::pair<string, string>> files;
+        for ( int i = 0; i < 64; ++i )
+        {
+            string name = std::to_string( i ) + ".txt";
+            if ( i != 37 )
+            {
+                write( directory / "from" / name, "content" );
+            }
+            files.push_back( std::make_pair((directory / "from" / name).string(), (directory / name).string()) );
+        }
+
+        System system;
+        CHECK_THROW( system.cp(files), boost::filesystem::filesystem_error );
+        CHECK( !boost::filesystem::exists(directory / "37.txt") );
+        boost::filesystem::remove_all( directory );
+    }
+}
@@ -0,0 +1,163 @@
+//
+// TestWalkDependencies.cpp
+// Copyright (c) Charles Baker. All rights reserved.
+//
+
+#include "stdafx.hpp"
+#include "ErrorChecker.hpp"
+#include <forge/Forge.hpp>
+#include <UnitTest++/UnitTest++.h>
+
+using namespace sweet::forge;
+
+SUITE( TestWalkDependencies )
+{
+    static const char* DIAMOND =
+        "local StaticLibrary = TargetPrototype( 'StaticLibrary' ); \n"
+        "local Executable = TargetPrototype( 'Executable' ); \n"
+        "local function library( identifier, ... ) \n"
+        "    local library = Target( forge, identifier, StaticLibrary ); \n"
+        "    library:set_filename( library:path() ); \n"
+        "    for _, dependency in ipairs({...}) do library:add_dependency( dependency ); end \n"
+        "    return library; \n"
+        "end \n"
+        "local baz = library( 'libbaz.a' ); \n"
+        "local bar = library( 'libbar.a', baz ); \n"
+        "local foo = library( 'libfoo.a', baz ); \n"
+        "local exe = Target( forge, 'exe', Executable ); \n"
+        "exe:set_filename( exe:path() ); \n"
+        "exe:add_dependency( foo ); \n"
+        "exe:add_dependency( bar ); \n"
+    ;
+
+    static const char* CHECK_TARGETS =
+        "local function check( targets, expected ) \n"
+        "    assert( #targets == #expected, ('expected %d targets but walked %d'):format(#expected, #targets) ); \n"
+        "    for index, target in ipairs(expected) do \n"
+        "        assert( targets[index] == target, ('expected %s but walked %s at %d'):format(target:id(), targets[index]:id(), index) ); \n"
+        "    end \n"
+        "end \n"
+    ;
+
+    TEST_FIXTURE( ErrorChecker, walk_dependencies_keeps_dependencies_reached_by_more_than_one_path )
+    {
+        std::string script = std::string(DIAMOND) + CHECK_TARGETS +
+            "check( exe:walk_dependencies({StaticLibrary}), {foo, baz, bar, baz} ); \n"
+            "check( foo:walk_dependencies({StaticLibrary}), {baz} ); \n"
+        ;
+        test( script.c_str() );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, transitive_dependencies_keep_the_last_time_each_dependency_is_reached )
+    {
+        std::string script = std::string(DIAMOND) + CHECK_TARGETS +
+            "check( exe:transitive_dependencies({StaticLibrary}), {foo, bar, baz} ); \n"
+            "check( foo:transitive_dependencies({StaticLibrary}), {baz} ); \n"
+            "check( baz:transitive_dependencies({StaticLibrary}), {} ); \n"
+        ;
+        test( script.c_str() );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, walks_yield_and_recurse_into_dependencies_by_prototype )
+    {
+        std::string script = std::string(DIAMOND) + CHECK_TARGETS +
+            "local Group = TargetPrototype( 'Group' ); \n"
+            "local File = TargetPrototype( 'File' ); \n"
+            "local qux = Target( forge, 'libqux.a', StaticLibrary ); \n"
+            "qux:set_filename( qux:path() ); \n"
+            "local group = Target( forge, 'group', Group ); \n"
+            "group:add_dependency( qux ); \n"
+            "local object = Target( forge, 'exe.o', File ); \n"
+            "object:set_filename( object:path() ); \n"
+            "exe:add_dependency( group ); \n"
+            "exe:add_dependency( object ); \n"
+            "check( exe:walk_dependencies({StaticLibrary}), {foo, baz, bar, baz} ); \n"
+            "check( exe:walk_dependencies({StaticLibrary}, {StaticLibrary, Group}), {foo, baz, bar, baz, qux} ); \n"
+            "check( exe:walk_dependencies({StaticLibrary, File}, {Group}), {foo, bar, qux, object} ); \n"
+            "check( exe:transitive_dependencies({StaticLibrary}, {StaticLibrary, Group}), {foo, bar, baz, qux} ); \n"
+            "check( exe:transitive_dependencies({File}, {StaticLibrary, Group}), {object} ); \n"
+        ;
+        test( script.c_str() );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, walks_without_prototypes_yield_files_and_recurse_into_phony_targets )
+    {
+        std::string script = std::string(CHECK_TARGETS) +
+            "local function file( identifier ) \n"
+            "    local file = Target( forge, identifier ); \n"
+            "    file:set_filename( file:path() ); \n"
+            "    return file; \n"
+            "end \n"
+            "local a_o = file( 'a.o' ); \n"
+            "local b_o = file( 'b.o' ); \n"
+            "local c_o = file( 'c.o' ); \n"
+            "b_o:add_dependency( c_o ); \n"
+            "local objects = Target( forge, 'objects' ); \n"
+            "objects:add_dependency( a_o ); \n"
+            "objects:add_dependency( b_o ); \n"
+            "local exe = file( 'exe' ); \n"
+            "exe:add_dependency( objects ); \n"
+            "check( exe:walk_dependencies(), {a_o, b_o} ); \n"
+            "check( exe:transitive_dependencies(), {a_o, b_o} ); \n"
+        ;
+        test( script.c_str() );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, walks_end_at_targets_revisited_through_cycles )
+    {
+        std::string script = std::string(CHECK_TARGETS) +
+            "local StaticLibrary = TargetPrototype( 'StaticLibrary' ); \n"
+            "local function library( identifier ) \n"
+            "    local library = Target( forge, identifier, StaticLibrary ); \n"
+            "    library:set_filename( library:path() ); \n"
+            "    return library; \n"
+            "end \n"
+            "local a = library( 'liba.a' ); \n"
+            "local b = library( 'libb.a' ); \n"
+            "local c = library( 'libc.a' ); \n"
+            "a:add_dependency( b ); \n"
+            "b:add_dependency( c ); \n"
+            "c:add_dependency( a ); \n"
+            "check( a:walk_dependencies({StaticLibrary}), {b, c, a} ); \n"
+            "check( b:walk_dependencies({StaticLibrary}), {c, a, b} ); \n"
+            "check( a:transitive_dependencies({StaticLibrary}), {b, c, a} ); \n"
+            "local x = library( 'libx.a' ); \n"
+            "x:add_dependency( a ); \n"
+            "x:add_dependency( c ); \n"
+            "local walked = x:walk_dependencies( {StaticLibrary} ); \n"
+            "check( {table.unpack(walked, 1, 4)}, {a, b, c, a} ); \n"
+            "assert( walked[5] == c ); \n"
+            "assert( walked[6] == a ); \n"
+            "assert( walked[7] == b ); \n"
+            "assert( walked[8] == c ); \n"
+            "assert( #walked < 12 ); \n"
+        ;
+        test( script.c_str() );
+        CHECK( errors == 0 );
+    }
+
+    TEST_FIXTURE( ErrorChecker, walk_tables_flattens_nested_arrays_but_not_targets )
+    {
+        const char* script =
+            "local foo = Target( forge, 'foo' ); \n"
+            "local bar = Target( forge, 'bar' ); \n"
+            "foo:add_dependency( bar ); \n"
+            "local expected = { 'a', foo, 'b', 'c', bar, 1 }; \n"
+            "local count = 0; \n"
+            "for index, value in walk_tables({ 'a', { foo, { 'b', {}, { 'c' } } }, bar, 1 }) do \n"
+            "    assert( index == count + 1 ); \n"
+            "    assert( value == expected[index] ); \n"
+            "    count = index; \n"
+            "end \n"
+            "assert( count == #expected ); \n"
+            "for _, value in walk_tables({}) do assert( false ); end \n"
+            "for _, value in walk_tables('a') do assert( false ); end \n"
+        ;
+        test( script );
+        CHECK( errors == 0 );
+    }
+}
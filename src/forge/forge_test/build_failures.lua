@@ -0,0 +1,46 @@
+
+-- Check that targets that fail to build stay bound to their filenames and
+-- are built again by the next build in the same Forge, as *watch* does,
+-- without reloading buildfiles.
+
+require 'forge';
+local toolset = require( 'forge.cc.gcc' ) {};
+remove( absolute('.forge') );
+remove( absolute('build_failures.txt') );
+
+local fail = true;
+local builds = 0;
+local Generated = FilePrototype( 'Generated' );
+toolset.Generated = Generated;
+function Generated.build( toolset, target )
+    builds = builds + 1;
+    if fail then
+        error( 'failed', 0 );
+    end
+    create( target:filename() );
+    invalidate( target:filename() );
+end
+
+_G.printf = function() end;
+local generated = toolset:Generated 'build_failures.txt';
+_G.goal = toolset:all { generated }:path();
+
+CHECK( build() == 1 );
+CHECK( builds == 1 );
+CHECK( generated:filename() == absolute('build_failures.txt') );
+CHECK( not generated:built() );
+
+fail = false;
+CHECK( build() == 0 );
+CHECK( builds == 2 );
+CHECK( generated:built() );
+
+-- Targets are unbound between builds, as *watch* does after waiting for 
+-- changes, so that the built file is seen and not built again.
+unbind();
+CHECK( build() == 0 );
+CHECK( builds == 2 );
+
+remove( absolute('build_failures.txt') );
+remove( absolute('.forge') );
+remove( absolute('local_settings.lua') );
@@ -0,0 +1,116 @@
+-- Check that targets that describe their command are outdated when that
+-- command changes and only then, and that targets rebuilt because their
+-- command changed outdate the targets that depend on them.
+
+require 'forge';
+local toolset = require( 'forge.cc.gcc' ) {};
+remove( absolute('.forge') );
+
+_G.printf = function() end;
+
+local timestamp = 1;
+
+if operating_system() ~= 'windows' then
+    -- Record the commands that compiling and linking would execute rather
+    -- than executing them.
+    local executions = {};
+    local execute_ = _G.execute;
+    _G.execute = function( command, command_line )
+        table.insert( executions, command_line );
+        return 0;
+    end
+
+    create( absolute('signature.c'), timestamp );
+    local object = toolset:Cc 'signature' { 'signature.c' }[1];
+    local executable = toolset:Executable 'signature' { object };
+    _G.goal = executable:path();
+
+    -- Build and then write the object and executable as the compiler and
+    -- linker would have.
+    local function build_executable()
+        executions = {};
+        CHECK( build() == 0 );
+        timestamp = timestamp + 1;
+        for _, target in ipairs({object, executable}) do
+            create( target:filename(), timestamp );
+            invalidate( target:filename() );
+        end
+        unbind();
+        return executions;
+    end
+
+    local executions = build_executable();
+    CHECK( #executions == 2 );
+    CHECK( #build_executable() == 0 );
+
+    -- Changing a link only setting relinks without recompiling.
+    toolset.settings.ldflags = { '-Wl,--as-needed' };
+    local executions = build_executable();
+    CHECK( #executions == 1 and executions[1]:find('^g%+%+') and executions[1]:find('--as-needed', 1, true) );
+    CHECK( #build_executable() == 0 );
+
+    -- Changing a compile flag recompiles and the recompiled object then
+    -- outdates the executable in the same build even though its link
+    -- command is unchanged.
+    toolset.settings.defines = { 'SIGNATURE' };
+    local executions = build_executable();
+    CHECK( #executions == 2 and executions[1]:find('^gcc') and executions[1]:find('-DSIGNATURE', 1, true) );
+    CHECK( executions[2] and executions[2]:find('^g%+%+') );
+    CHECK( #build_executable() == 0 );
+
+    _G.execute = execute_;
+    remove( object:filename() );
+    remove( executable:filename() );
+    remove( absolute('signature.c') );
+end
+
+-- Write the value of the environment variable *MODE* to a file by
+-- executing a shell script so that `execute()` records the signature of
+-- the command including its environment.
+if operating_system() ~= 'windows' then
+    local builds = {};
+    local mode = 'first';
+    local script = absolute( 'generate.sh' );
+    create( script, timestamp, 'echo "$MODE" > "$1"\n' );
+
+    local Generate = FilePrototype( 'Generate' );
+    toolset.Generate = Generate;
+    function Generate.command( toolset, target )
+        return '/bin/sh', ('sh "%s" "%s"'):format( script, target:filename() ), { MODE = target.mode or mode };
+    end
+    function Generate.build( toolset, target )
+        table.insert( builds, target:id() );
+        CHECK( execute(Generate.command(toolset, target)) == 0 );
+        invalidate( target:filename() );
+    end
+
+    local generated = toolset:Generate 'generated.txt' {};
+    local final = toolset:Generate 'final.txt' { generated };
+    final.mode = 'final';
+    _G.goal = final:path();
+
+    local function build_generated()
+        builds = {};
+        CHECK( build() == 0 );
+        unbind();
+        return builds;
+    end
+
+    CHECK( #build_generated() == 2 );
+    CHECK( #build_generated() == 0 );
+
+    -- Changing an environment variable passed to `execute()` rebuilds the
+    -- target and the rebuilt target outdates the target that depends on it
+    -- even though the latter's command is unchanged.
+    mode = 'second';
+    local builds = build_generated();
+    CHECK( #builds == 2 and builds[1] == generated:id() and builds[2] == final:id() );
+    CHECK( #build_generated() == 0 );
+
+    remove( generated:filename() );
+    remove( final:filename() );
+    remove( script );
+end
+
+remove( absolute('.forge') );
+remove( absolute('local_settings.lua') );
@@ -0,0 +1,118 @@
+-- Check that a dependency rebuilt with the same contents doesn't outdate
+-- the targets that depend on it when content cutoff is enabled and does
+-- when it isn't.
+
+require 'forge';
+local toolset = require( 'forge.cc.gcc' ) {};
+remove( absolute('.forge') );
+
+local builds = {};
+local timestamp = 1;
+
+-- Write *target*'s file with the same contents each time it's built and a
+-- later last write time than anything written before.
+local Generated = FilePrototype( 'Generated' );
+toolset.Generated = Generated;
+function Generated.build( toolset, target )
+    table.insert( builds, target:id() );
+    timestamp = timestamp + 1;
+    create( target:filename(), timestamp, 'generated' );
+    invalidate( target:filename() );
+end
+
+_G.printf = function() end;
+
+local function check_cutoff( cutoff )
+    local name = cutoff and 'cutoff_on' or 'cutoff_off';
+    local source_filename = absolute( ('%s.txt'):format(name) );
+    timestamp = timestamp + 1;
+    create( source_filename, timestamp, 'source' );
+
+    local generated = toolset:Generated( ('%s.generated'):format(name) ) {
+        source_filename
+    };
+    generated:set_cutoff( cutoff );
+    local final = toolset:Generated( ('%s.final'):format(name) ) {
+        generated
+    };
+    _G.goal = final:path();
+
+    builds = {};
+    CHECK( build() == 0 );
+    CHECK( #builds == 2 );
+
+    -- Touch the source file so that the generated file is rebuilt, with the
+    -- same contents, in a later build in the same Forge.
+    timestamp = timestamp + 1;
+    touch( source_filename, timestamp );
+    invalidate( source_filename );
+    unbind();
+
+    builds = {};
+    CHECK( build() == 0 );
+    CHECK( builds[1] == generated:id() );
+    if cutoff then
+        CHECK( #builds == 1 );
+    else
+        CHECK( #builds == 2 and builds[2] == final:id() );
+    end
+    unbind();
+
+    remove( source_filename );
+    remove( generated:filename() );
+    remove( final:filename() );
+end
+
+check_cutoff( true );
+check_cutoff( false );
+
+-- Check that touching a source file without changing its contents doesn't
+-- outdate the targets that depend on it when digests are enabled and that
+-- changing its contents does.
+local function check_digests( digests )
+    local name = digests and 'digests_on' or 'digests_off';
+    local source_filename = absolute( ('%s.txt'):format(name) );
+    timestamp = timestamp + 1;
+    create( source_filename, timestamp, 'source' );
+
+    forge.digests = digests;
+    local source = toolset:SourceFile( source_filename );
+    forge.digests = nil;
+    CHECK( source:cutoff() == digests );
+    local generated = toolset:Generated( ('%s.generated'):format(name) ) {
+        source
+    };
+    _G.goal = generated:path();
+
+    builds = {};
+    CHECK( build() == 0 );
+    CHECK( #builds == 1 );
+
+    timestamp = timestamp + 1;
+    touch( source_filename, timestamp );
+    invalidate( source_filename );
+    unbind();
+
+    builds = {};
+    CHECK( build() == 0 );
+    CHECK( #builds == (digests and 0 or 1) );
+
+    timestamp = timestamp + 1;
+    create( source_filename, timestamp, 'changed' );
+    invalidate( source_filename );
+    unbind();
+
+    builds = {};
+    CHECK( build() == 0 );
+    CHECK( #builds == 1 );
+    unbind();
+
+    remove( source_filename );
+    remove( generated:filename() );
+end
+
+check_digests( true );
+check_digests( false );
+
+remove( absolute('.forge') );
+remove( absolute('local_settings.lua') );
@@ -6,6 +6,7 @@
 #include "stdafx.hpp"
 #include "FileChecker.hpp"
 #include <forge/Forge.hpp>
+#include <forge/Graph.hpp>
 #include <forge/ForgeEventSink.hpp>
 #include <error/ErrorPolicy.hpp>
 #include <luaxx/luaxx_unit/LuaUnitTest.hpp>
@@ -57,6 +58,9 @@ SUITE( dependencies )
             lua_pushglobaltable( lua_state );
             lua_pushlightuserdata( lua_state, file_checker_ );
             luaL_setfuncs( lua_state, file_functions, 1 );    
+            lua_pushlightuserdata( lua_state, forge_ );
+            lua_pushcclosure( lua_state, &LuaTest::unbind, 1 );
+            lua_setglobal( lua_state, "unbind" );
             lua_pop( lua_state, 1 );
         }
 
@@ -130,10 +134,47 @@ SUITE( dependencies )
             return 0;
         }
 
+        static int unbind( lua_State* lua_state )
+        {
+            const int FORGE = lua_upvalueindex( 1 );
+            Forge* forge = (Forge*) lua_touserdata( lua_state, FORGE );
+            forge->graph()->unbind();
+            return 0;
+        }
+
     };
 
     TEST_FIXTURE( LuaTest, transitive_dependencies )
     {
         forge_->file( "transitive_dependencies.lua" );
     }
+
+    TEST_FIXTURE( LuaTest, build_failures )
+    {
+        forge_->file( "build_failures.lua" );
+    }
+
+    TEST_FIXTURE( LuaTest, command_signatures )
+    {
+        forge_->file( "command_signatures.lua" );
+        CHECK( error_policy_->errors() == 0 );
+    }
+
+    TEST_FIXTURE( LuaTest, content_cutoff )
+    {
+        forge_->file( "content_cutoff.lua" );
+        CHECK( error_policy_->errors() == 0 );
+    }
+
+    TEST_FIXTURE( LuaTest, prototypes )
+    {
+        forge_->file( "prototypes.lua" );
+        CHECK( error_policy_->errors() == 0 );
+    }
+
+    TEST_FIXTURE( LuaTest, settings )
+    {
+        forge_->file( "settings.lua" );
+        CHECK( error_policy_->errors() == 0 );
+    }
 }
@@ -0,0 +1,158 @@
+
+-- Check that the targets created natively for pattern and group prototypes
+-- match those created by the Lua implementations that they replaced.
+
+local function lua_pattern_targets( toolset, pattern_prototype, pattern, replacement, dependencies )
+    local targets = {};
+    local identify = pattern_prototype.identify or Toolset.interpolate;
+    local attributes = forge:merge( {}, dependencies );
+    for _, filename in walk_tables(dependencies) do
+        local source_file = toolset:SourceFile( filename );
+        local identifier, filename = identify( toolset, root_relative(source_file):gsub(pattern, replacement) );
+        local target = Target( toolset, identifier, pattern_prototype );
+        target:set_filename( filename or target:path() );
+        target:set_cleanable( true );
+        target:add_ordering_dependency( toolset:Directory(branch(target)) );
+        forge:merge( target, attributes );
+        local created = target.created;
+        if created then
+            created( toolset, target );
+        end
+        target:add_dependency( source_file );
+        table.insert( targets, target );
+    end
+    return targets;
+end
+
+local function lua_group_targets( toolset, target, pattern, replacement, dependencies )
+    local identify = target:prototype().identify or Toolset.interpolate;
+    forge:merge( target, dependencies );
+    for _, filename in walk_tables(dependencies) do
+        local source_file = toolset:SourceFile( filename );
+        local identifier, filename = identify( toolset, root_relative(source_file):gsub(pattern, replacement) );
+        local file = Target( toolset, identifier );
+        file:set_filename( filename or file:path() );
+        file:set_cleanable( true );
+        file:add_ordering_dependency( toolset:Directory(branch(file)) );
+        file:add_dependency( source_file );
+        local created = target.created;
+        if created then
+            created( toolset, target );
+        end
+        target:add_dependency( file );
+    end
+    return target;
+end
+
+-- Strip the directory that separates the targets created natively from
+-- those created in Lua from an identifier or filename.
+local function strip( value, directory )
+    return (value:gsub( ('/%s(/?)'):format(directory), '%1' ));
+end
+
+local function check_same_file( native, lua )
+    CHECK( strip(native:id(), 'native') == strip(lua:id(), 'lua') );
+    CHECK( strip(native:path(), 'native') == strip(lua:path(), 'lua') );
+    CHECK( strip(native:filename(), 'native') == strip(lua:filename(), 'lua') );
+    CHECK( native:prototype() == lua:prototype() );
+    CHECK( native:cleanable() == lua:cleanable() );
+    CHECK( native:dependency() == lua:dependency() );
+    CHECK( native:dependency(2) == nil and lua:dependency(2) == nil );
+    CHECK( strip(native:ordering_dependency():path(), 'native') == strip(lua:ordering_dependency():path(), 'lua') );
+    CHECK( native:ordering_dependency(2) == nil and lua:ordering_dependency(2) == nil );
+end
+
+local function source_files( toolset )
+    local generated = toolset:SourceFile( 'generated/d.c' );
+    return {
+        'a.c';
+        { 'sub/b.c', { 'sub/c.c' } };
+        generated;
+        defines = { 'A' };
+        flags = 'fast';
+    };
+end
+
+require 'forge';
+local toolset = require( 'forge.cc.gcc' ) {}:inherit {
+    obj = root( 'obj' );
+};
+
+local PATTERN = '(.-([^\\/]-))%.?([^%.\\/]*)$';
+
+-- Targets created natively and in Lua are kept apart by creating them in
+-- different directories.  The root relative paths of source files start
+-- with '..' here so the replacements add a directory for that to remove.
+local function replacement( directory )
+    return toolset:interpolate( ('${obj}/%s/objects/%%1.o'):format(directory) );
+end
+
+local calls = {};
+local function record( toolset, target )
+    table.insert( calls, target );
+end
+
+-- Pattern prototypes with and without `identify()`.
+local Object = PatternPrototype( 'Object' );
+Object.created = record;
+
+local IdentifiedObject = PatternPrototype( 'IdentifiedObject' );
+IdentifiedObject.created = record;
+IdentifiedObject.identify = function( toolset, identifier )
+    return ('%s.identified'):format( identifier ), ('%s.file'):format( toolset:interpolate(identifier) );
+end
+
+for _, prototype in ipairs({Object, IdentifiedObject}) do
+    calls = {};
+    local native = Target.create_pattern_targets( toolset, prototype, PATTERN, replacement('native'), source_files(toolset), forge:merge({}, source_files(toolset)) );
+    local native_calls = calls;
+    calls = {};
+    local lua = lua_pattern_targets( toolset, prototype, PATTERN, replacement('lua'), source_files(toolset) );
+    local lua_calls = calls;
+
+    CHECK( #native == 4 );
+    CHECK( #native == #lua );
+    for index = 1, #native do
+        check_same_file( native[index], lua[index] );
+        CHECK( #native[index].defines == 1 and native[index].defines[1] == 'A' );
+        CHECK( native[index].flags == lua[index].flags );
+        CHECK( #native_calls[index].defines == 1 );
+    end
+    CHECK( #native_calls == #lua_calls );
+    for index = 1, #native_calls do
+        CHECK( native_calls[index] == native[index] );
+        CHECK( lua_calls[index] == lua[index] );
+    end
+end
+
+-- Group prototypes with and without `identify()`.
+local Group = GroupPrototype( 'Group' );
+Group.created = record;
+
+local IdentifiedGroup = GroupPrototype( 'IdentifiedGroup' );
+IdentifiedGroup.created = record;
+IdentifiedGroup.identify = IdentifiedObject.identify;
+
+for _, prototype in ipairs({Group, IdentifiedGroup}) do
+    calls = {};
+    local native = Target( toolset, anonymous(), prototype );
+    forge:merge( native, source_files(toolset) );
+    Target.create_group_targets( toolset, native, PATTERN, replacement('native/group'), source_files(toolset) );
+    local native_calls = calls;
+    calls = {};
+    local lua = lua_group_targets( toolset, Target(toolset, anonymous(), prototype), PATTERN, replacement('lua/group'), source_files(toolset) );
+    local lua_calls = calls;
+
+    CHECK( native:dependency(4) ~= nil and native:dependency(5) == nil );
+    for index = 1, 4 do
+        check_same_file( native:dependency(index), lua:dependency(index) );
+        CHECK( native:dependency(index):prototype() == nil );
+    end
+    CHECK( #native.defines == #lua.defines );
+    CHECK( native.flags == lua.flags );
+    CHECK( #native_calls == 4 and #lua_calls == 4 );
+    for index = 1, #native_calls do
+        CHECK( native_calls[index] == native );
+        CHECK( lua_calls[index] == lua );
+    end
+end
@@ -0,0 +1,114 @@
+
+-- Check that settings cloned from other settings share nested tables
+-- without changes to one showing up in the other.
+
+local Settings = require 'forge.Settings';
+
+local function settings()
+    return Settings {
+        gcc = { flags = { '-O2' } };
+        defines = { 'A' };
+        architecture = 'x86_64';
+    };
+end
+
+-- Nested writes through a clone don't leak into the settings it was cloned
+-- from or its siblings.
+local parent = settings();
+local clone = parent:clone();
+local sibling = parent:clone();
+clone.gcc.flags[1] = '-O3';
+clone.gcc.warnings = 'all';
+table.insert( clone.defines, 'B' );
+clone.architecture = 'arm64';
+CHECK( clone.gcc.flags[1] == '-O3' );
+CHECK( clone.gcc.warnings == 'all' );
+CHECK( #clone.defines == 2 and clone.defines[2] == 'B' );
+CHECK( clone.architecture == 'arm64' );
+for _, settings in ipairs({parent, sibling}) do
+    CHECK( settings.gcc.flags[1] == '-O2' );
+    CHECK( settings.gcc.warnings == nil );
+    CHECK( #settings.defines == 1 );
+    CHECK( settings.architecture == 'x86_64' );
+end
+
+-- Nested writes through settings after they've been cloned don't leak into
+-- the clones.
+local parent = settings();
+local clone = parent:clone();
+parent.gcc.flags[1] = '-O0';
+table.insert( parent.defines, 'C' );
+CHECK( clone.gcc.flags[1] == '-O2' );
+CHECK( #clone.defines == 1 );
+local grandchild = clone:clone();
+clone.defines[1] = 'D';
+CHECK( grandchild.defines[1] == 'A' );
+CHECK( parent.defines[1] == 'A' );
+
+-- Applying values to a clone merges them into copies of its nested tables.
+local parent = settings();
+local clone = parent:clone { defines = { 'E' } };
+clone:apply { gcc = { warnings = 'all', flags = { [2] = '-g' } } };
+CHECK( #clone.defines == 1 and clone.defines[1] == 'E' );
+CHECK( clone.gcc.warnings == 'all' );
+CHECK( #clone.gcc.flags == 2 and clone.gcc.flags[1] == '-O2' and clone.gcc.flags[2] == '-g' );
+CHECK( parent.defines[1] == 'A' );
+CHECK( parent.gcc.warnings == nil );
+CHECK( #parent.gcc.flags == 1 );
+
+-- Replacing a shared nested table replaces it only in the clone.
+local parent = settings();
+local clone = parent:clone();
+clone.defines = { 'F' };
+CHECK( clone.defines[1] == 'F' );
+CHECK( parent.defines[1] == 'A' );
+
+-- Clones hash the same whether or not their nested tables have been copied
+-- into them and differently once their nested values change.
+local parent = settings();
+local copied = parent:clone();
+local _ = copied.gcc.flags;
+local _ = copied.defines;
+CHECK( hash(copied) == hash(parent:clone()) );
+CHECK( hash(parent:clone()) == hash(settings()) );
+local changed = parent:clone();
+changed.gcc.flags[1] = '-Os';
+CHECK( hash(changed) ~= hash(parent:clone()) );
+
+-- Reading nested tables through clones reads through to the tables shared
+-- with the settings they were cloned from without copying them, and their
+-- stored hashes are reused.
+local parent = settings();
+local defines = parent.defines;
+local gcc = parent.gcc;
+local clone = parent:clone();
+local sibling = parent:clone();
+CHECK( getmetatable(clone.defines).__forge_proxy == defines );
+CHECK( getmetatable(clone.gcc.flags).__forge_proxy == gcc.flags );
+CHECK( next(clone.defines) == nil and next(clone.gcc) == nil );
+CHECK( clone.defines == clone.defines and clone.gcc.flags == clone.gcc.flags );
+CHECK( #clone.defines == 1 and clone.defines[1] == 'A' );
+CHECK( table.concat(clone.gcc.flags, ' ') == '-O2' );
+local values = {};
+for key, value in pairs(clone.gcc) do
+    values[key] = value;
+end
+CHECK( values.flags == clone.gcc.flags and values.__forge_hash == nil );
+for _, define in ipairs(clone.defines) do
+    CHECK( define == 'A' );
+end
+CHECK( hash(clone) == hash(sibling) );
+CHECK( rawget(defines, '__forge_hash') ~= nil );
+CHECK( getmetatable(parent.defines).__forge_proxy == defines );
+CHECK( getmetatable(parent:clone().defines).__forge_proxy == defines );
+
+-- Writing to a nested table read through a clone copies only the level of
+-- nesting written to.
+table.insert( clone.gcc.flags, '-g' );
+CHECK( getmetatable(clone.gcc) == nil and getmetatable(clone.gcc.flags) == nil );
+CHECK( #clone.gcc.flags == 2 and #gcc.flags == 1 );
+clone.gcc.warnings = 'all';
+CHECK( gcc.warnings == nil and sibling.gcc.warnings == nil );
+local changed = parent:clone();
+changed.gcc.warnings = 'all';
+CHECK( hash(changed) ~= hash(parent:clone()) );
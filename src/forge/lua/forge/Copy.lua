@@ -2,8 +2,7 @@
 local Copy = PatternPrototype( 'Copy' );
 
 function Copy.build( toolset, target )
-    rm( target );
-    cp( target, target:dependency() );
+    cp( target, target:dependency(), toolset.settings.hard_links );
 end
 
 return Copy;
@@ -1,14 +1,244 @@
-
 local Settings = {};
 
-local function apply( destination, source )
+-- Settings share nested tables, e.g. include directories, defines, and
+-- libraries, with the settings they're cloned from rather than copying
+-- them.  Shared nested tables are kept in a separate table named by the
+-- `__forge_index` field of the settings' metatable, so that `hash()` still
+-- includes them, and are never changed in place.  Looking one up through
+-- settings returns a proxy that reads through to it.  A proxy copies the
+-- fields of the table it reads through to into itself the first time it's
+-- written to, and nested tables looked up through a proxy are proxies in
+-- turn, so a write copies only the level of nesting that it changes.
+-- `hash()` hashes a proxy that hasn't been written to as the table it
+-- reads through to, reusing the hash stored there.  Cloning costs the
+-- number of top level settings, reading nested settings costs nothing
+-- more, and changing the nested tables of one settings never changes
+-- another.
+--
+-- Proxies support indexing, `#`, `ipairs()`, `pairs()`, and the `table`
+-- functions but not `next()` or `rawget()`.
+
+-- Get the nested tables shared by settings or nil if the table isn't
+-- settings created by `Settings()`.
+local function shared_fields( settings )
+    local metatable = getmetatable( settings );
+    return metatable and rawget( metatable, '__forge_index' );
+end
+
+-- Get the table that a proxy reads through to or nil if the table isn't a
+-- proxy or has been written to.
+local function proxied( proxy )
+    local metatable = getmetatable( proxy );
+    return metatable and rawget( metatable, '__forge_proxy' );
+end
+
+local proxy;
+
+-- Look up a field through a proxy returning nested tables as proxies.  
+-- Proxies for nested tables are kept in the proxy's metatable, not the 
+-- proxy, so that every write to the proxy is seen by `__newindex`.
+local function proxy_index( proxy_, key )
+    local metatable = getmetatable( proxy_ );
+    local value = metatable.__forge_proxies[key];
+    if value == nil and key ~= '__forge_hash' then
+        value = rawget( metatable.__forge_proxy, key );
+        if type(value) == 'table' then
+            value = proxy( value, proxy_ );
+            metatable.__forge_proxies[key] = value;
+        end
+    end
+    return value;
+end
+
+-- Copy the fields of the table that a proxy reads through to into the 
+-- proxy and make it a plain table.  The proxy that a nested proxy was
+-- looked up through is copied first so that it no longer hashes as the
+-- table that it read through to.
+local function materialize( proxy_ )
+    local metatable = getmetatable( proxy_ );
+    local parent = metatable.__forge_parent;
+    if parent and proxied(parent) then
+        materialize( parent );
+    end
+    setmetatable( proxy_, nil );
+    for key, value in pairs(metatable.__forge_proxy) do
+        if key ~= '__forge_hash' then
+            rawset( proxy_, key, metatable.__forge_proxies[key] or (type(value) == 'table' and proxy(value, proxy_)) or value );
+        end
+    end
+end
+
+-- Copy the fields of the table that a proxy reads through to into the 
+-- proxy before setting a field in it.
+local function proxy_newindex( proxy_, key, value )
+    materialize( proxy_ );
+    rawset( proxy_, key, value );
+end
+
+local function proxy_len( proxy_ )
+    return #proxied( proxy_ );
+end
+
+local function proxy_pairs( proxy_ )
+    local source = proxied( proxy_ );
+    local function iterate( proxy_, key )
+        local value;
+        key, value = next( source, key );
+        if key == '__forge_hash' then
+            key, value = next( source, key );
+        end
+        if type(value) == 'table' then
+            value = proxy_[key];
+        end
+        return key, value;
+    end
+    return iterate, proxy_, nil;
+end
+
+-- Make a deep copy of a nested table.  The hash that `hash()` stores in 
+-- each table it hashes is skipped so that changing the copy isn't hidden 
+-- by a stale hash.  Proxies are copied by making another proxy for the
+-- same table.
+local function copy( source )
+    if proxied(source) then
+        return proxy( source );
+    end
+    local destination = {};
+    for key, value in pairs(source) do
+        if key ~= '__forge_hash' then
+            if type(value) == 'table' then
+                value = copy( value );
+            end
+            destination[key] = value;
+        end
+    end
+    return destination;
+end
+
+-- Whether or not each table that proxies read through to has nested tables.
+local nested_tables = setmetatable( {}, {__mode = 'k'} );
+
+-- Does a table that proxies read through to have nested tables?
+local function has_nested_tables( source )
+    local nested = nested_tables[source];
+    if nested == nil then
+        nested = false;
+        for _, value in pairs(source) do
+            if type(value) == 'table' then
+                nested = true;
+                break;
+            end
+        end
+        nested_tables[source] = nested;
+    end
+    return nested;
+end
+
+-- Make a proxy that reads through to a nested table, optionally looked up
+-- through another proxy.  Proxies for proxies read through to the same 
+-- table.  Proxies for tables without nested tables, e.g. lists of include
+-- directories and defines, index the table directly.  Tables with 
+-- metatables of their own can't be proxied and are copied instead.
+function proxy( source, parent )
+    local source = proxied( source ) or source;
+    if getmetatable(source) ~= nil then
+        return copy( source );
+    end
+    return setmetatable( {}, {
+        __index = has_nested_tables(source) and proxy_index or source;
+        __newindex = proxy_newindex;
+        __len = proxy_len;
+        __pairs = proxy_pairs;
+        __forge_proxy = source;
+        __forge_proxies = {};
+        __forge_parent = parent;
+    } );
+end
+
+-- Remove a nested table from the tables shared by settings.
+local function unshare( shared, key )
+    rawset( shared, key, nil );
+    rawset( shared, '__forge_hash', nil );
+end
+
+-- Look up a field missing from settings moving a proxy for the nested
+-- table shared for it into the settings or falling back to the `Settings`
+-- functions.
+local function index( settings, key )
+    local shared = shared_fields( settings );
+    local value = rawget( shared, key );
+    if value == nil then
+        return Settings[key];
+    end
+    value = proxy( value );
+    unshare( shared, key );
+    rawset( settings, key, value );
+    return value;
+end
+
+-- Set a field missing from settings replacing any nested table shared for
+-- it.
+local function newindex( settings, key, value )
+    local shared = shared_fields( settings );
+    if rawget(shared, key) ~= nil then
+        unshare( shared, key );
+    end
+    rawset( settings, key, value );
+end
+
+local apply;
+
+-- Set a field in destination merging nested tables.  Nested tables that 
+-- destination doesn't already have are shared when destination is settings
+-- and *shareable* is true otherwise they're copied.  Nested tables that 
+-- destination shares or inherits are copied before they're changed.
+local function apply_field( destination, key, value, shareable )
+    if key == '__forge_hash' then
+        return;
+    end
+    if type(value) ~= 'table' then
+        destination[key] = value;
+        return;
+    end
+    local nested = destination[key];
+    if type(nested) == 'table' then
+        if rawget(destination, key) ~= nested then
+            nested = copy( nested );
+        end
+        destination[key] = apply( nested, value );
+    else
+        local shared = shareable and shared_fields( destination );
+        if shared then
+            rawset( destination, key, nil );
+            rawset( shared, key, value );
+            rawset( shared, '__forge_hash', nil );
+        else
+            destination[key] = copy( value );
+        end
+    end
+end
+
+-- Copy fields from source to destination merging nested tables.  Nested
+-- tables are shared between settings and copied otherwise.  Settings stop
+-- changing nested tables in place once they've shared them by moving them
+-- into their shared tables to be proxied when next looked up.
+function apply( destination, source )
     if source then
         local destination = destination or {};
+        rawset( destination, '__forge_hash', nil );
+        local source_shared = shared_fields( source );
         for key, value in pairs(source) do
-            if type(value) ~= 'table' then
-                destination[key] = value;
+            if type(value) == 'table' and source_shared and shared_fields(destination) then
+                rawset( source, key, nil );
+                rawset( source_shared, key, value );
+                rawset( source_shared, '__forge_hash', nil );
             else
-                destination[key] = apply( destination[key], value );
+                apply_field( destination, key, value, false );
+            end
+        end
+        if source_shared then
+            for key, value in pairs(source_shared) do
+                apply_field( destination, key, value, true );
             end
         end
         return destination;
@@ -42,21 +272,25 @@ end
 
 function Settings.defaults( self, values )
     for key, value in pairs(values) do 
-        if type(key) == 'string' and self[key] == nil then
+        if type(key) == 'string' and key ~= '__forge_hash' and self[key] == nil then
+            if type(value) == 'table' then
+                value = copy( value );
+            end
+            rawset( self, '__forge_hash', nil );
             self[key] = value;
         end
     end
     return self;
 end
 
-local settings_metatable = {
-    __index = Settings;
-};
-
 setmetatable( Settings, {
     __call = function ( _, values )
         local settings = {};
-        setmetatable( settings, settings_metatable );
+        setmetatable( settings, {
+            __index = index;
+            __newindex = newindex;
+            __forge_index = {};
+        } );
         return settings:create( values );
     end
 } );
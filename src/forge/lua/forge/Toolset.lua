@@ -13,10 +13,7 @@ end
 
 function Toolset:clone( values )
     local toolset = {
-        settings = forge.Settings()
-            :apply( self.settings )
-            :apply( values )
-        ;
+        settings = self.settings:clone( values );
     };
     setmetatable( toolset, {__index = self} );
     return toolset;
@@ -83,46 +80,6 @@ function Toolset:install( toolset_prototype )
     end
 end
 
--- Provide GNU Make like string substitution.
-function Toolset:interpolate( template, variables )
-    local function split( input )
-        local output = {};
-        for value in input:gmatch('%S+') do 
-            table.insert( output, value );
-        end
-        return output;
-    end
-
-    local settings = self.settings;
-    local variables = variables or settings;
-    local interpolate = self.interpolate;
-    return (template:gsub('%$(%b{})', function(word) 
-        local parameters = split( interpolate(self, word:sub(2, -2), variables) );
-        local identifier = parameters[1];
-        local index = 1;
-        local substitute = variables and variables[identifier];
-        if not substitute then 
-            substitute = settings and settings[identifier];
-        end
-        if not substitute then
-            substitute = self[identifier];
-        end
-        if not substitute then 
-            substitute = _G[identifier]
-        end
-        if not substitute then 
-            substitute = os.getenv( identifier );
-        end
-        if type(substitute) == 'function' then 
-            substitute = substitute( self, table.unpack(parameters, 2) );
-        elseif type(substitute) == 'table' then
-            substitute = substitute[parameters[2]];
-        end
-        assertf( substitute, 'Missing substitute for "%s" in "%s"', identifier, template );
-        return substitute or word;
-    end));
-end
-
 -- Add dependencies detected by the injected build hooks library to the 
 -- target /target/.
 function Toolset:dependencies_filter( target )
@@ -192,20 +149,14 @@ function Toolset:obj_directory( target )
 end
 
 -- Recursively copy files from *source* to *destination*.
+--
+-- Files are copied in parallel and hard linked instead of copied, when they
+-- can't be reflinked, if the `hard_links` setting is true.
 function Toolset:cpdir( destination, source, settings )
     local settings = settings or self.settings;
     local destination = self:interpolate( destination, settings );
     local source = self:interpolate( source, settings );
-    pushd( source );
-    for source_filename in find('') do 
-        if is_file(source_filename) then
-            local filename = ('%s/%s'):format( destination, relative(source_filename) );
-            mkdir( branch(filename) );
-            rm( filename );
-            cp( filename, source_filename );
-        end
-    end
-    popd();
+    cpdir( destination, source, settings.hard_links );
 end
 
 -- Find first existing file named *filename* in *paths*.
@@ -257,6 +208,7 @@ function Toolset:SourceFile( identifier )
             target:set_filename( target:path() );
         end
         target:set_cleanable( false );
+        target:set_cutoff( forge.digests == true );
     end
     return target;
 end
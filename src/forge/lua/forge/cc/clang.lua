@@ -22,21 +22,25 @@ function clang.initialize( toolset )
     local Cc = PatternPrototype( 'Cc' );
     Cc.identify = clang.object_filename;
     Cc.build = function( toolset, target ) clang.compile( toolset, target, 'c' ) end;
+    Cc.command = function( toolset, target ) return clang.compile_command( toolset, target, 'c' ) end;
     toolset.Cc = Cc;
 
     local Cxx = PatternPrototype( 'Cxx' );
     Cxx.identify = clang.object_filename;
     Cxx.build = function( toolset, target ) clang.compile( toolset, target, 'c++' ) end;
+    Cxx.command = function( toolset, target ) return clang.compile_command( toolset, target, 'c++' ) end;
     toolset.Cxx = Cxx;
 
     local ObjC = PatternPrototype( 'ObjC' );
     ObjC.identify = clang.object_filename;
     ObjC.build = function( toolset, target ) clang.compile( toolset, target, 'objective-c' ) end;
+    ObjC.command = function( toolset, target ) return clang.compile_command( toolset, target, 'objective-c' ) end;
     toolset.ObjC = ObjC;
 
     local ObjCxx = PatternPrototype( 'ObjCxx' );
     ObjCxx.identify = clang.object_filename;
     ObjCxx.build = function( toolset, target ) clang.compile( toolset, target, 'objective-c++' ) end;
+    ObjCxx.command = function( toolset, target ) return clang.compile_command( toolset, target, 'objective-c++' ) end;
     toolset.ObjCxx = ObjCxx;
 
     local StaticLibrary = FilePrototype( 'StaticLibrary' );
@@ -47,11 +51,13 @@ function clang.initialize( toolset )
     local DynamicLibrary = FilePrototype( 'DynamicLibrary' );
     DynamicLibrary.identify = clang.dynamic_library_filename;
     DynamicLibrary.build = clang.link;
+    DynamicLibrary.command = clang.link_command;
     toolset.DynamicLibrary = DynamicLibrary;
 
     local Executable = FilePrototype( 'Executable' );
     Executable.identify = clang.executable_filename;
     Executable.build = clang.link;
+    Executable.command = clang.link_command;
     toolset.Executable = Executable;
 
     toolset:defaults {
@@ -110,8 +116,9 @@ function clang.executable_filename( toolset, identifier )
     return identifier, filename;
 end
 
--- Compile C, C++, Objective-C, and Objective-C++.
-function clang.compile( toolset, target, language ) 
+-- Describe the command that compiles C, C++, Objective-C, or Objective-C++
+-- source to an object file.
+function clang.compile_command( toolset, target, language ) 
     local settings = toolset.settings;
 
     local flags = {};
@@ -128,17 +135,22 @@ function clang.compile( toolset, target, language )
         cc = settings.clang.cc;
     end
     local environment = { PATH = branch(cc) };
-    local source = target:dependency();
-    printf( leaf(source) );
     local dependencies = ('%s.d'):format( target );
     local output = target:filename();
-    local input = absolute( source );
-    system( 
+    local input = absolute( target:dependency() );
+    return
         cc, 
         ('%s %s -MMD -MF "%s" -o "%s" "%s"'):format(leaf(cc), ccflags, dependencies, output, input),
         environment
-    );
-    clang.parse_dependencies_file( toolset, dependencies, target );
+    ;
+end
+
+-- Compile C, C++, Objective-C, and Objective-C++.
+function clang.compile( toolset, target, language ) 
+    local command, command_line, environment = clang.compile_command( toolset, target, language );
+    printf( leaf(target:dependency()) );
+    system( command, command_line, environment );
+    clang.parse_dependencies_file( toolset, ('%s.d'):format(target), target );
 end
 
 -- Archive objects into a static library. 
@@ -168,8 +180,10 @@ function clang.archive( toolset, target )
     popd();
 end
 
--- Link dynamic libraries and executables.
-function clang.link( toolset, target ) 
+-- Describe the command that links a dynamic library or executable.  The
+-- command line refers to objects relative to the target's object directory
+-- and nothing is returned when there are no objects to link.
+function clang.link_command( toolset, target ) 
     local objects = {};
     pushd( toolset:obj_directory(target) );
     for _, dependency in walk_dependencies(target) do
@@ -188,16 +202,29 @@ function clang.link( toolset, target )
     clang.append_libraries( toolset, target, libraries );
     clang.append_third_party_libraries( toolset, target, libraries );
 
+    local command, command_line, environment;
     if #objects > 0 then
         local settings = toolset.settings;
         local cxx = settings.clang.cxx;
-        local environment = { PATH = branch(cxx) };
         local ldflags = table.concat( flags, ' ' );
         local ldobjects = table.concat( objects, '" "' );
         local ldlibs = table.concat( libraries, ' ' );
-        system( cxx, ('clang++ %s "%s" %s'):format(ldflags, ldobjects, ldlibs), environment );
+        command = cxx;
+        command_line = ('clang++ %s "%s" %s'):format( ldflags, ldobjects, ldlibs );
+        environment = { PATH = branch(cxx) };
     end
     popd();
+    return command, command_line, environment;
+end
+
+-- Link dynamic libraries and executables.
+function clang.link( toolset, target ) 
+    local command, command_line, environment = clang.link_command( toolset, target );
+    if command then
+        pushd( toolset:obj_directory(target) );
+        system( command, command_line, environment );
+        popd();
+    end
 end
 
 function clang.append_flags( flags, values, format )
@@ -437,26 +464,8 @@ end
 -- Returns the list of static libraries to link with this executable.
 function clang.find_transitive_libraries( target )
     local toolset = target.toolset;
-    local function yield_recurse_on_library( target )
-        local prototype = target:prototype();
-        local library = prototype == toolset.StaticLibrary or prototype == toolset.DynamicLibrary;
-        return library, library;
-    end
-
-    local all_libraries = {};
-    local index_by_library = {};
-    for _, dependency in walk_dependencies(target, yield_recurse_on_library) do
-        table.insert( all_libraries, dependency );
-        index_by_library[dependency] = #all_libraries;
-    end
-
-    local libraries = {};
-    for index, library in ipairs(all_libraries) do
-        if index == index_by_library[library] then
-            table.insert( libraries, library );
-        end
-    end
-    return libraries;
+    local libraries = { toolset.StaticLibrary, toolset.DynamicLibrary };
+    return target:transitive_dependencies( libraries );
 end
 
 return clang;
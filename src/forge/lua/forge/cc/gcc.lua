@@ -22,11 +22,15 @@ function gcc.initialize( toolset )
     local Cc = PatternPrototype( 'Cc' );
     Cc.identify = gcc.object_filename;
     Cc.build = function( toolset, target ) gcc.compile( toolset, target, 'c' ) end;
+    Cc.command = function( toolset, target ) return gcc.compile_command( toolset, target, 'c' ) end;
+    Cc.cacheable = true;
     toolset.Cc = Cc;
 
     local Cxx = PatternPrototype( 'Cxx' );
     Cxx.identify = gcc.object_filename;
     Cxx.build = function( toolset, target ) gcc.compile( toolset, target, 'c++' ) end;
+    Cxx.command = function( toolset, target ) return gcc.compile_command( toolset, target, 'c++' ) end;
+    Cxx.cacheable = true;
     toolset.Cxx = Cxx;
 
     local StaticLibrary = FilePrototype( 'StaticLibrary' );
@@ -37,11 +41,13 @@ function gcc.initialize( toolset )
     local DynamicLibrary = FilePrototype( 'DynamicLibrary' );
     DynamicLibrary.identify = gcc.dynamic_library_filename;
     DynamicLibrary.build = gcc.link;
+    DynamicLibrary.command = gcc.link_command;
     toolset.DynamicLibrary = DynamicLibrary;
 
     local Executable = FilePrototype( 'Executable' );
     Executable.identify = gcc.executable_filename;
     Executable.build = gcc.link;
+    Executable.command = gcc.link_command;
     toolset.Executable = Executable;
 
     toolset:defaults {
@@ -87,8 +93,8 @@ function gcc.executable_filename( toolset, identifier )
     return identifier, filename;
 end
 
--- Compile C and C++ source to object files.
-function gcc.compile( toolset, target, language )
+-- Describe the command that compiles C and C++ source to an object file.
+function gcc.compile_command( toolset, target, language )
     local settings = toolset.settings;
 
     local flags = {};
@@ -100,17 +106,21 @@ function gcc.compile( toolset, target, language )
     local environment = { PATH = branch(gcc_) };
     local ccflags = table.concat( flags, ' ' );
     local dependencies = ('%s.d'):format( target );
-    local source = target:dependency();
     local output = target:filename();
-    local input = absolute( source:filename() );
-    printf( leaf(source:id()) );
-    target:clear_implicit_dependencies();
-    system(
+    local input = absolute( target:dependency():filename() );
+    return 
         gcc_, 
         ('gcc %s -MMD -MF "%s" -o "%s" "%s"'):format(ccflags, dependencies, output, input), 
-        environment,
-        toolset:dependencies_filter(target)
-    );
+        environment
+    ;
+end
+
+-- Compile C and C++ source to object files.
+function gcc.compile( toolset, target, language )
+    local command, command_line, environment = gcc.compile_command( toolset, target, language );
+    printf( leaf(target:dependency():id()) );
+    target:clear_implicit_dependencies();
+    system( command, command_line, environment, toolset:dependencies_filter(target) );
 end
 
 -- Archive objects into a static library. 
@@ -140,8 +150,10 @@ function gcc.archive( toolset, target )
     popd();
 end
 
--- Link dynamic libraries and executables.
-function gcc.link( toolset, target ) 
+-- Describe the command that links a dynamic library or executable.  The
+-- command line refers to objects relative to the target's object directory
+-- and nothing is returned when there are no objects to link.
+function gcc.link_command( toolset, target ) 
     pushd( toolset:obj_directory(target) );
 
     local objects = {};
@@ -160,18 +172,31 @@ function gcc.link( toolset, target )
     gcc.append_libraries( toolset, target, libraries );
     gcc.append_third_party_libraries( toolset, target, libraries );
 
+    local command, command_line, environment;
     if #objects > 0 then
         local settings = toolset.settings;
         local ldflags = table.concat( flags, ' ' );
         local ldobjects = table.concat( objects, '" "' );
         local ldlibs = table.concat( libraries, ' ' );
         local gxx = settings.gcc.gxx;
-        local environment = { PATH = branch(gxx) };
-        printf( leaf(target) );
-        system( gxx, ('g++ %s "%s" %s'):format(ldflags, ldobjects, ldlibs), environment );
+        command = gxx;
+        command_line = ('g++ %s "%s" %s'):format( ldflags, ldobjects, ldlibs );
+        environment = { PATH = branch(gxx) };
     end
 
     popd();
+    return command, command_line, environment;
+end
+
+-- Link dynamic libraries and executables.
+function gcc.link( toolset, target ) 
+    local command, command_line, environment = gcc.link_command( toolset, target );
+    if command then
+        pushd( toolset:obj_directory(target) );
+        printf( leaf(target) );
+        system( command, command_line, environment );
+        popd();
+    end
 end
 
 function gcc.append_flags( flags, values, format )
@@ -339,26 +364,8 @@ end
 -- Returns the list of static libraries to link with this executable.
 function gcc.find_transitive_libraries( target )
     local toolset = target.toolset;
-    local function yield_recurse_on_library( target )
-        local prototype = target:prototype();
-        local library = prototype == toolset.StaticLibrary or prototype == toolset.DynamicLibrary;
-        return library, library;
-    end
-
-    local all_libraries = {};
-    local index_by_library = {};
-    for _, dependency in walk_dependencies(target, yield_recurse_on_library) do
-        table.insert( all_libraries, dependency );
-        index_by_library[dependency] = #all_libraries;
-    end
-
-    local libraries = {};
-    for index, library in ipairs(all_libraries) do
-        if index == index_by_library[library] then
-            table.insert( libraries, library );
-        end
-    end
-    return libraries;
+    local libraries = { toolset.StaticLibrary, toolset.DynamicLibrary };
+    return target:transitive_dependencies( libraries );
 end
 
 return gcc;
@@ -490,6 +490,7 @@ function msvc.link( toolset, target )
                     rc:write( ('2 /* CREATEPROCESS_MANIFEST_RESOURCE_ID */ 24 /* RT_MANIFEST */ "%s_embedded.manifest"'):format(target:id()) );
                 end
                 rc:close();
+                invalidate( absolute(embedded_manifest_rc) );
             end
 
             local ignore_filter = function() end;
@@ -817,26 +818,8 @@ end
 -- Returns the list of static libraries to link with this executable.
 function msvc.find_transitive_libraries( target )
     local toolset = target.toolset;
-    local function yield_recurse_on_library( target )
-        local prototype = target:prototype();
-        local library = prototype == toolset.StaticLibrary or prototype == toolset.DynamicLibrary;
-        return library, library;
-    end
-
-    local all_libraries = {};
-    local index_by_library = {};
-    for _, dependency in walk_dependencies(target, yield_recurse_on_library) do
-        table.insert( all_libraries, dependency );
-        index_by_library[dependency] = #all_libraries;
-    end
-
-    local libraries = {};
-    for index, library in ipairs(all_libraries) do
-        if index == index_by_library[library] then
-            table.insert( libraries, library );
-        end
-    end
-    return libraries;
+    local libraries = { toolset.StaticLibrary, toolset.DynamicLibrary };
+    return target:transitive_dependencies( libraries );
 end
 
 return msvc;
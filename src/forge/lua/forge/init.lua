@@ -38,17 +38,40 @@ end
 
 -- Visit a target by calling a member function "build" if it exists and 
 -- setting that Target's built flag to true if the function returns with
--- no errors.
+-- no errors.  Up to date targets that describe the command that builds them
+-- with a member function "command" are first bound to that command so that
+-- they're outdated when it differs from the command last used to build them.
+-- The command is recorded once those targets are built so that build 
+-- functions that don't pass the command to `execute()` don't leave them
+-- outdated on every build.  Describing commands runs for every up to date
+-- target that provides "command" on every build, even when nothing is
+-- outdated.  Targets that fail to build are cleaned but stay bound to their
+-- filenames so that they're built again by the next build in the same 
+-- Forge, e.g. from *watch*, without reloading buildfiles.
 function build_visit( target )
+    local command_function = target.command;
+    if command_function and not target:outdated() then
+        target:bind_to_command( command_function(target.toolset, target) );
+    end
     if target:outdated() then
         local build_function = target.build;
         if build_function then 
             local success, error_message = pcall( build_function, target.toolset, target );
             target:set_built( success );
             if not success then 
+                local filenames = {};
+                for _, filename in target:filenames() do 
+                    table.insert( filenames, filename );
+                end
                 clean_visit( target );
+                for index, filename in ipairs(filenames) do 
+                    target:set_filename( filename, index );
+                end
                 assert( success, error_message );
             end
+            if command_function then 
+                target:record_command( command_function(target.toolset, target) );
+            end
         else
             target:set_built( true );
         end
@@ -56,7 +79,23 @@ function build_visit( target )
 end
 
 -- Provide global build command.
+--
+-- Evaluated buildfiles restored from a snapshot don't set the attributes
+-- that building needs on targets so a build from a restored snapshot only
+-- checks that everything is up to date.  Otherwise the snapshot is removed
+-- and buildfiles are reloaded, and evaluated, by a new Forge to build.
 function build()
+    if forge.evaluation_restored then
+        if not up_to_date( find_initial_target(goal) ) then
+            remove_evaluation();
+            reload_buildfiles();
+            return 0;
+        end
+        forge:save();
+        printf( "forge: default (build)=%dms", math.ceil(ticks()) );
+        return 0;
+    end
+
     local failures = postorder( find_initial_target(goal), build_visit );
     forge:save();
     printf( "forge: default (build)=%dms", math.ceil(ticks()) );
@@ -71,6 +110,26 @@ function clean()
     return failures;
 end
 
+-- Provide global watch command.
+--
+-- Builds outdated targets and then waits for source files or buildfiles to
+-- change before building again.  The Lua state, graph, and cached file
+-- system status stay resident between builds so that only changed files are
+-- stat'd again.  Changes to buildfiles reload them, and the build scripts
+-- that they load, in a new Forge before building again.
+function watch()
+    local failures = build();
+    while true do
+        local filenames, buildfiles_changed = wait_for_changes();
+        printf( 'forge: changed %s', table.concat(filenames, ', ') );
+        if buildfiles_changed then
+            reload_buildfiles();
+            return failures;
+        end
+        failures = build();
+    end
+end
+
 -- Provide global reconfigure command.
 function reconfigure()
     rm( root('local_settings.lua') );
@@ -83,6 +142,43 @@ function dependencies()
     return 0;
 end
 
+-- Provide global affected command.
+--
+-- Prints the goals and targets affected by changes to the files listed, 
+-- separated by commas or semicolons, in the *files* variable.  Goals are the
+-- affected targets that are dependencies of an all target.
+function affected()
+    local filenames = {};
+    for filename in tostring(files or ''):gmatch('[^,;]+') do 
+        table.insert( filenames, filename );
+    end
+
+    local goals = {};
+    local targets = affected_targets( filenames );
+    for _, target in ipairs(targets) do 
+        for _, dependent in target:dependents() do 
+            if dependent:id() == 'all' then 
+                table.insert( goals, target:path() );
+                break;
+            end
+        end
+    end
+    table.sort( goals );
+    for _, goal in ipairs(goals) do 
+        printf( 'goal %s', goal );
+    end
+
+    local paths = {};
+    for _, target in ipairs(targets) do 
+        table.insert( paths, target:path() );
+    end
+    table.sort( paths );
+    for _, path in ipairs(paths) do 
+        printf( 'target %s', path );
+    end
+    return 0;
+end
+
 -- Provide global namespace command.
 function namespace()
     print_namespace( find_initial_target(goal) );
@@ -95,11 +191,19 @@ function help()
 Variables:
   goal={goal}        Target to build.
   variant={variant}  Variant to build.
+  files={files}      Changed files for affected.
+  digests={digests}  Ignore source files rewritten without changes.
+  evaluation={evaluation}  Skip evaluating buildfiles when nothing changed.
+  artifacts={path}   Directory to cache built files in.
+  artifacts_size={n} Maximum size of the artifact cache in MiB.
+  artifacts_remote={url}  Remote artifact cache to share built files through.
 Commands:
   build              Build outdated targets.
+  watch              Build outdated targets each time source files change.
   clean              Clean all targets.
   reconfigure        Re-run auto-detected configuration.
   dependencies       Print dependency hierarchy.
+  affected           Print goals and targets affected by changed files.
   namespace          Print namespace hierarchy.
 ]];
 end
@@ -291,24 +395,9 @@ function PatternPrototype( identifier, pattern )
         local replacement = toolset:interpolate( replacement );
         local targets_metatable = {
             __call = function( targets, dependencies )
-                local identify = pattern_prototype.identify or Toolset.interpolate;
                 local attributes = forge:merge( {}, dependencies );
-                for _, filename in walk_tables(dependencies) do
-                    local source_file = toolset:SourceFile( filename );
-                    local identifier, filename = identify( toolset, root_relative(source_file):gsub(pattern, replacement) );
-                    local target = Target( toolset, identifier, pattern_prototype );
-                    target:set_filename( filename or target:path() );
-                    target:set_cleanable( true );
-                    target:add_ordering_dependency( toolset:Directory(branch(target)) );
-                    forge:merge( target, attributes );
-                    local created = target.created;
-                    if created then
-                        created( toolset, target );
-                    end
-                    target:add_dependency( source_file );
-                    table.insert( targets, target );
-                end
-                return targets;
+                local created = Target.create_pattern_targets( toolset, pattern_prototype, pattern, replacement, dependencies, attributes );
+                return table.move( created, 1, #created, #targets + 1, targets );
             end
         };
         setmetatable( targets, targets_metatable );
@@ -325,23 +414,9 @@ function GroupPrototype( identifier, pattern )
         local replacement = toolset:interpolate( replacement );
         local targets_metatable = {
             __call = function( targets, dependencies )
-                local identify = group_prototype.identify or Toolset.interpolate;
                 local target = targets[1];
                 forge:merge( target, dependencies );
-                for _, filename in walk_tables(dependencies) do
-                    local source_file = toolset:SourceFile( filename );
-                    local identifier, filename = identify( toolset, root_relative(source_file):gsub(pattern, replacement) );
-                    local file = Target( toolset, identifier );
-                    file:set_filename( filename or file:path() );
-                    file:set_cleanable( true );
-                    file:add_ordering_dependency( toolset:Directory(branch(file)) );
-                    file:add_dependency( source_file );
-                    local created = target.created;
-                    if created then
-                        created( toolset, target );
-                    end
-                    target:add_dependency( file );
-                end
+                Target.create_group_targets( toolset, target, pattern, replacement, dependencies );
                 return targets;
             end
         };
@@ -353,56 +428,32 @@ function GroupPrototype( identifier, pattern )
     return group_prototype;
 end
 
--- Recursively walk the tables passed in *dependencies* until reaching targets
--- or non-table values (e.g. strings) that are yielded back to the caller.
-function walk_tables( dependencies )
-    local function typename( value )
-        if type(value) == 'table' then 
-            local metatable = getmetatable( value );
-            return metatable and metatable.__name;
-        end
-    end
-
-    local index = 1;
-    local function walk( values )
-        for _, value in ipairs(values) do
-            if type(value) ~= 'table' or typename(value) == 'forge.Target' then
-                coroutine.yield( index, value );
-                index = index + 1;
-            else
-                walk( value );
-            end
-        end
-    end
-
-    return coroutine.wrap( function()
-        walk( dependencies );
-    end );
-end
-
 -- Recursively walk the dependencies of *target* until a target with a 
 -- filename is reached.
+--
+-- Walks without *yield_recurse* use the native `Target.walk_dependencies()`.
+-- Otherwise *yield_recurse* is called for each dependency and returns
+-- whether to yield that dependency and whether to walk its dependencies.
+-- Walking targets by prototype is faster with `Target.walk_dependencies()`
+-- and `Target.transitive_dependencies()` directly.
 function walk_dependencies( target, yield_recurse )
-    local yield_recurse = yield_recurse or function( dependency )
-        local phony = dependency:filename() == '';
-        return not phony, phony;
-    end;
-    local index = 1;
+    if not yield_recurse then 
+        return ipairs( target:walk_dependencies() );
+    end
+    local dependencies = {};
     local function walk( target )
         for _, dependency in target:dependencies() do
             local yield, recurse = yield_recurse( dependency )
             if yield then
-                coroutine.yield( index, dependency );
-                index = index + 1;
+                table.insert( dependencies, dependency );
             end
             if recurse then 
                 walk( dependency );
             end
         end
     end
-    return coroutine.wrap( function()
-        walk( target );
-    end );
+    walk( target );
+    return ipairs( dependencies );
 end
 
 -- Merge fields with string keys from /source/ to /destination/.
@@ -433,6 +484,24 @@ end
 -- Local settings are loaded from the file *local_settings.lua* in the root
 -- directory of the project if it exists or set to an empty table otherwise.
 --
+-- Source files keep digests of their contents, so that rewriting them 
+-- without changes doesn't outdate the targets that depend on them, if the
+-- variables `digests` or `forge.digests` are set.
+--
+-- Buildfiles aren't evaluated again by the build and default commands when
+-- nothing they depended on has changed, and a snapshot of their evaluation
+-- is saved next to the cached dependencies, if the variables `evaluation`
+-- or `forge.evaluation` are set.
+--
+-- Files built by cacheable targets are restored from and stored in the
+-- artifact cache in the directory named by the variables `artifacts` or
+-- `forge.artifacts`, if either is set, up to `artifacts_size` or 
+-- `forge.artifacts_size` MiB (5 GiB by default).  Local misses are looked 
+-- up in, and new entries uploaded to, the remote artifact cache at the HTTP
+-- URL named by the variables `artifacts_remote` or `forge.artifacts_remote`.
+-- The local artifact cache defaults to *~/.forge/artifacts* when only a 
+-- remote artifact cache is named.
+--
 -- Returns a new toolset initialized with the local settings.
 function forge:load( settings )
     if not self.loaded then
@@ -444,7 +513,27 @@ function forge:load( settings )
         elseif variant or self.variant then 
             self.cache = root( ('%s/.forge'):format(variant or self.variant) );
         end
+        if digests then 
+            self.digests = digests ~= 'false';
+        end
+        if evaluation then 
+            self.evaluation = evaluation ~= 'false';
+        end
+        self.artifacts_remote = artifacts_remote or self.artifacts_remote;
+        self.artifacts = artifacts or self.artifacts or (self.artifacts_remote and home('.forge/artifacts'));
+        self.artifacts_size = tonumber( artifacts_size or self.artifacts_size ) or 5 * 1024;
+        if self.artifacts then 
+            set_artifact_cache( absolute(self.artifacts), math.floor(self.artifacts_size * 1024 * 1024) );
+        end
+        if self.artifacts_remote then 
+            set_remote_artifact_cache( self.artifacts_remote );
+        end
         load_binary( self.cache );
+        local command = current_command();
+        self.evaluation_restored = nil;
+        if self.evaluation and (command == 'build' or command == 'default') then 
+            self.evaluation_restored = restore_evaluation();
+        end
     end
     return self;
 end
@@ -507,9 +596,13 @@ function forge:save()
         assertf( file, 'Opening "%s" to write settings failed', filename );
         serialize( file, local_settings, 0 );
         file:close();
+        invalidate( filename );
     end
     mkdir( branch(forge.cache) );
     save_binary();
+    if self.evaluation and not self.evaluation_saved then 
+        self.evaluation_saved = save_evaluation();
+    end
 end
 
 setmetatable( forge, {
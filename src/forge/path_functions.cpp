@@ -2,6 +2,7 @@
 #include "path_functions.hpp"
 #include <boost/filesystem/operations.hpp>
 #include <assert/assert.hpp>
+#include <ctype.h>
 
 namespace sweet
 {
@@ -145,6 +146,106 @@ boost::filesystem::path search_up_for_root_directory( const std::string& directo
     return make_drive_uppercase( root_directory.generic_string() );
 }
 
+/**
+// The text that stands in for the root directory in text returned from
+// `replace_root_directory()`.
+*/
+static const char ROOT_DIRECTORY_MARKER[] = "${root}";
+
+/**
+// Strip trailing slashes from \e root_directory.
+//
+// @return
+//  The root directory without trailing slashes or the empty string if the
+//  root directory is empty or the root of the file system.
+*/
+static std::string trim_root_directory( const std::string& root_directory )
+{
+    std::string::size_type length = root_directory.size();
+    while ( length > 0 && root_directory[length - 1] == '/' )
+    {
+        --length;
+    }
+    return root_directory.substr( 0, length );
+}
+
+/**
+// Replace occurrences of the root directory in \e text with a marker that
+// is independent of where the root directory is.
+//
+// Used to key cached results by paths relative to the root directory, e.g.
+// in the ArtifactCache, so that checkouts of the same project in different
+// directories share them.  Only occurrences that are whole path elements 
+// are replaced; the root directory must be followed by a slash, the end of
+// \e text, or a character that can't continue a path element.
+//
+// @param text
+//  The text to replace the root directory in, e.g. a path or command line.
+//
+// @param root_directory
+//  The absolute path to the root directory.
+//
+// @return
+//  The text with the root directory replaced (see 
+//  `expand_root_directory()`).
+*/
+std::string replace_root_directory( const std::string& text, const std::string& root_directory )
+{
+    std::string root = trim_root_directory( root_directory );
+    if ( root.empty() )
+    {
+        return text;
+    }
+
+    std::string replaced;
+    std::string::size_type position = 0;
+    std::string::size_type found = text.find( root );
+    while ( found != std::string::npos )
+    {
+        std::string::size_type end = found + root.size();
+        char next = end < text.size() ? text[end] : '/';
+        if ( next == '/' || next == '\\' || !(isalnum((unsigned char) next) || next == '_' || next == '-' || next == '.') )
+        {
+            replaced.append( text, position, found - position );
+            replaced.append( ROOT_DIRECTORY_MARKER );
+            position = end;
+        }
+        found = text.find( root, end );
+    }
+    replaced.append( text, position, std::string::npos );
+    return replaced;
+}
+
+/**
+// Expand the markers left by `replace_root_directory()` in \e text to the
+// root directory.
+//
+// @param text
+//  The text to expand the root directory in.
+//
+// @param root_directory
+//  The absolute path to the root directory.
+//
+// @return
+//  The text with the root directory expanded.
+*/
+std::string expand_root_directory( const std::string& text, const std::string& root_directory )
+{
+    std::string root = trim_root_directory( root_directory );
+    std::string expanded;
+    std::string::size_type position = 0;
+    std::string::size_type found = text.find( ROOT_DIRECTORY_MARKER );
+    while ( found != std::string::npos )
+    {
+        expanded.append( text, position, found - position );
+        expanded.append( root );
+        position = found + sizeof(ROOT_DIRECTORY_MARKER) - 1;
+        found = text.find( ROOT_DIRECTORY_MARKER, position );
+    }
+    expanded.append( text, position, std::string::npos );
+    return expanded;
+}
+
 }
 
 }
@@ -14,6 +14,8 @@ boost::filesystem::path absolute( const boost::filesystem::path& path, const boo
 boost::filesystem::path relative( const boost::filesystem::path& path, const boost::filesystem::path& base_path );
 boost::filesystem::path make_drive_uppercase( std::string path );
 boost::filesystem::path search_up_for_root_directory( const std::string& directory, const std::string& filename );
+std::string replace_root_directory( const std::string& text, const std::string& root_directory );
+std::string expand_root_directory( const std::string& text, const std::string& root_directory );
 
 }
 
@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
 
 using std::max;
 using namespace sweet::luaxx;
@@ -41,6 +42,17 @@ const char* TYPE_KEYWORD = "__luaxx_type";
 */
 const char* WEAK_OBJECTS_KEYWORD = "__luaxx_weak_objects";
 
+/**
+// Report an error raised outside of a protected call before Lua aborts.
+*/
+static int luaxx_panic( lua_State* lua_state )
+{
+    const char* message = lua_tostring( lua_state, -1 );
+    fprintf( stderr, "PANIC: unprotected error in call to Lua API (%s)\n", message ? message : "error object is not a string" );
+    fflush( stderr );
+    return 0;
+}
+
 /**
 // Create a new, independent Lua state.
 //
@@ -49,7 +61,31 @@ const char* WEAK_OBJECTS_KEYWORD = "__luaxx_weak_objects";
 */
 lua_State* luaxx_newstate()
 {
-    lua_State* lua_state = luaL_newstate();
+    return luaxx_newstate( &luaxx_allocate, nullptr );
+}
+
+/**
+// Create a new, independent Lua state that allocates memory through
+// \e allocate.
+//
+// @param allocate
+//  The lua_Alloc function to allocate memory with.
+//
+// @param context
+//  The application supplied context passed to \e allocate.
+//
+// @return 
+//  The newly created lua_State or null if creating the lua_State failed.
+*/
+lua_State* luaxx_newstate( void* (*allocate)(void*, void*, size_t, size_t), void* context )
+{
+    SWEET_ASSERT( allocate );
+    lua_State* lua_state = lua_newstate( allocate, context );
+    if ( !lua_state )
+    {
+        return nullptr;
+    }
+    lua_atpanic( lua_state, &luaxx_panic );
     luaL_openlibs( lua_state );
 
     // Create the weak objects metatable and table.  The metatable is used to 
@@ -16,6 +16,7 @@ extern const char* TYPE_KEYWORD;
 extern const char* WEAK_OBJECTS_KEYWORD;
 
 lua_State* luaxx_newstate();
+lua_State* luaxx_newstate( void* (*allocate)(void*, void*, size_t, size_t), void* context );
 void luaxx_create( lua_State* lua, void* object, const char* tname );
 void luaxx_destroy( lua_State* lua, void* object );
 void luaxx_attach( lua_State* lua, void* object, const char* tname );